@@ -4,19 +4,31 @@
 
 #include <sys/types.h>
 
+#include <algorithm>
 #include <atomic>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "db/trace.h"
+#include "db/write_batch_internal.h"
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/merge_operator.h"
+#include "leveldb/statistics.h"
 #include "leveldb/write_batch.h"
 #include "port/port.h"
+#include "util/coding.h"
 #include "util/crc32c.h"
-#include "util/histogram.h"
+#include "util/hash.h"
+#include "util/hdr_histogram.h"
 #include "util/mutexlock.h"
 #include "util/random.h"
 #include "util/testutil.h"
@@ -30,6 +42,8 @@
 //      fill100K      -- write N/1000 100K values in random order in async mode
 //      deleteseq     -- delete N keys in sequential order
 //      deleterandom  -- delete N keys in random order
+//      updaterandom  -- N Get+Put increments of 64-bit counters in random order
+//      mergerandom   -- N Merge increments of 64-bit counters in random order
 //      readseq       -- read N times sequentially
 //      readreverse   -- read N times in reverse order
 //      readrandom    -- read N times in random order
@@ -37,6 +51,18 @@
 //      readhot       -- read N times in random order from 1% section of DB
 //      seekrandom    -- N random seeks
 //      seekordered   -- N ordered seeks
+//      ycsba         -- YCSB workload A: 50% reads, 50% updates
+//      ycsbb         -- YCSB workload B: 95% reads, 5% updates
+//      ycsbc         -- YCSB workload C: reads only
+//      ycsbd         -- YCSB workload D: 95% reads of recent keys, 5% inserts
+//      ycsbe         -- YCSB workload E: 95% short scans, 5% inserts
+//      ycsbf         -- YCSB workload F: 50% reads, 50% read-modify-writes
+//      mixed         -- N reads, updates, inserts, scans and read-modify-writes
+//                       in the proportions of the --*_percent flags
+//      replay        -- re-issue the operations traced in --replay_file
+//   The ycsb* and mixed benchmarks expect a database filled by fillseq or
+//   fillrandom, do N operations (or run for --duration seconds) and pick
+//   their keys from the --key_dist distribution.
 //      open          -- cost of opening a DB
 //      crc32c        -- repeated crc32c of 4K of data
 //   Meta operations:
@@ -62,7 +88,9 @@ static const char* FLAGS_benchmarks =
     "snappycomp,"
     "snappyuncomp,"
     "zstdcomp,"
-    "zstduncomp,";
+    "zstduncomp,"
+    "lz4comp,"
+    "lz4uncomp,";
 
 // Number of key/values to place in database
 static int FLAGS_num = 1000000;
@@ -76,6 +104,68 @@ static int FLAGS_threads = 1;
 // Size of each value
 static int FLAGS_value_size = 100;
 
+// Distribution of the sizes of the values written: "fixed" (--value_size),
+// "uniform" between --value_size_min and --value_size_max, or "exponential"
+// with a mean of --value_size, clipped to the same range.
+static const char* FLAGS_value_size_dist = "fixed";
+static int FLAGS_value_size_min = 10;
+static int FLAGS_value_size_max = 1000;
+
+// Distribution of the keys the ycsb* and mixed benchmarks access: "uniform",
+// "zipfian", "latest" (zipfian, favoring the most recently inserted keys) or
+// "hotspot".  If empty, each workload uses its YCSB default.
+static const char* FLAGS_key_dist = "";
+
+// Skew of the zipfian and latest distributions, in (0, 1).
+static double FLAGS_zipfian_constant = 0.99;
+
+// The hotspot distribution sends --hotspot_op_fraction of the operations to
+// the first --hotspot_set_fraction of the keys.
+static double FLAGS_hotspot_set_fraction = 0.2;
+static double FLAGS_hotspot_op_fraction = 0.8;
+
+// Operations done by the mixed benchmark, in percent.  They must add up to
+// 100.
+static int FLAGS_read_percent = 50;
+static int FLAGS_update_percent = 50;
+static int FLAGS_insert_percent = 0;
+static int FLAGS_scan_percent = 0;
+static int FLAGS_rmw_percent = 0;
+
+// Scans read a uniformly distributed number of entries up to this many.
+static int FLAGS_scan_length = 100;
+
+// If positive, the ycsb* and mixed benchmarks run for this many seconds
+// instead of doing a fixed number of operations.
+static int FLAGS_duration = 0;
+
+// If positive, print the throughput and latency of the operations finished
+// in every interval of this many seconds while a benchmark runs.
+static int FLAGS_report_interval = 0;
+
+// Format of the results: "text", or "json" or "csv" for scripts.  The
+// machine-readable formats hold the latency percentiles of every benchmark
+// and operation type, the --report_interval time series, the effective
+// options and the DB stats at the end.
+static const char* FLAGS_output_format = "text";
+
+// If set, trace the operations of the benchmarks into this file with
+// DB::StartTrace().  The trace ends at the first benchmark after the first
+// traced one that recreates the database.
+static const char* FLAGS_trace_file = nullptr;
+
+// Trace re-issued by the replay benchmark.  Each of the --threads threads
+// replays every n-th operation.
+static const char* FLAGS_replay_file = nullptr;
+
+// Speed of the replay relative to the traced timing: 2 replays twice as
+// fast, and 0 issues the operations as fast as possible.
+static double FLAGS_replay_speed = 1.0;
+
+// File the json or csv results are written to.  If not set they go to
+// stdout, and the text report to stderr.
+static const char* FLAGS_output_file = nullptr;
+
 // Arrange to generate values that shrink to this fraction of
 // their original size after compression
 static double FLAGS_compression_ratio = 0.5;
@@ -86,6 +176,9 @@ static bool FLAGS_histogram = false;
 // Count the number of string comparisons performed
 static bool FLAGS_comparisons = false;
 
+// Collect database statistics and print them after the benchmarks
+static bool FLAGS_statistics = false;
+
 // Number of bytes to buffer in memtable before compacting
 // (initialized to default value by "main")
 static int FLAGS_write_buffer_size = 0;
@@ -129,11 +222,178 @@ static const char* FLAGS_db = nullptr;
 // ZSTD compression level to try out
 static int FLAGS_zstd_compression_level = 1;
 
+// Number of threads each table builder uses to compress blocks
+static int FLAGS_compression_threads = 0;
+
+// Number of threads that open the tables of the database when it is opened
+static int FLAGS_table_preload_threads = 0;
+
+// Values of at least this size are stored in blob files (0 disables)
+static int FLAGS_blob_value_threshold = 0;
+
+// How size compactions pick the file to compact: 0 = round robin,
+// 1 = smallest overlapping ratio, 2 = oldest largest sequence number.
+// Compare them by the write amplification reported by "stats".
+static int FLAGS_compaction_priority = 0;
+
+// If true, size the levels from the size of the deepest one
+static bool FLAGS_dynamic_level_bytes = false;
+
+// How to organize table files: 0 = leveled, 1 = universal, 2 = FIFO
+static int FLAGS_compaction_style = 0;
+
 namespace leveldb {
 
 namespace {
 leveldb::Env* g_env = nullptr;
 
+enum OutputFormat { kTextOutput, kJsonOutput, kCsvOutput };
+OutputFormat g_output_format = kTextOutput;
+
+// Where the human-readable report goes.
+FILE* g_text_out = stdout;
+
+bool ParseOutputFormat(const char* name, OutputFormat* format) {
+  if (strcmp(name, "text") == 0) {
+    *format = kTextOutput;
+  } else if (strcmp(name, "json") == 0) {
+    *format = kJsonOutput;
+  } else if (strcmp(name, "csv") == 0) {
+    *format = kCsvOutput;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Operation types whose latencies are recorded separately.
+enum OpType {
+  kOpRead,
+  kOpUpdate,
+  kOpInsert,
+  kOpScan,
+  kOpReadModifyWrite,
+  kOpWrite,  // A replayed write batch
+  kOpSeek,   // A replayed iterator seek
+  kNumOpTypes,
+  kOpOther = kNumOpTypes  // Only counted in the overall latency
+};
+
+const char* OpTypeName(OpType type) {
+  switch (type) {
+    case kOpRead:
+      return "read";
+    case kOpUpdate:
+      return "update";
+    case kOpInsert:
+      return "insert";
+    case kOpScan:
+      return "scan";
+    case kOpReadModifyWrite:
+      return "rmw";
+    case kOpWrite:
+      return "write";
+    case kOpSeek:
+      return "seek";
+    default:
+      return "other";
+  }
+}
+
+// Latency percentiles of a histogram, in microseconds.
+struct LatencySummary {
+  double count = 0;
+  double average = 0;
+  double p50 = 0;
+  double p90 = 0;
+  double p99 = 0;
+  double p999 = 0;
+  double p9999 = 0;
+  double max = 0;
+
+  LatencySummary() = default;
+  explicit LatencySummary(const HdrHistogram& hist) : count(hist.Count()) {
+    if (count > 0) {
+      average = hist.Average();
+      p50 = hist.Percentile(50);
+      p90 = hist.Percentile(90);
+      p99 = hist.Percentile(99);
+      p999 = hist.Percentile(99.9);
+      p9999 = hist.Percentile(99.99);
+      max = hist.Max();
+    }
+  }
+};
+
+// Operations finished in one --report_interval.
+struct IntervalResult {
+  double seconds;  // Since the benchmark started, at the end of the interval
+  double ops_per_sec;
+  LatencySummary latency;
+};
+
+struct BenchmarkResult {
+  std::string name;
+  int64_t ops = 0;
+  double seconds = 0;
+  double micros_per_op = 0;
+  double ops_per_sec = 0;
+  double mb_per_sec = 0;
+  std::string message;
+  LatencySummary latency;
+  std::vector<std::pair<std::string, LatencySummary>> op_latencies;
+  std::vector<IntervalResult> intervals;
+};
+
+// Whether the benchmarks must time every operation.
+bool MeasureLatency() {
+  return FLAGS_histogram || FLAGS_report_interval > 0 ||
+         g_output_format != kTextOutput;
+}
+
+std::string JsonString(const std::string& s) {
+  std::string r = "\"";
+  for (char c : s) {
+    switch (c) {
+      case '"':
+        r += "\\\"";
+        break;
+      case '\\':
+        r += "\\\\";
+        break;
+      case '\n':
+        r += "\\n";
+        break;
+      case '\t':
+        r += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buf[8];
+          std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+          r += buf;
+        } else {
+          r += c;
+        }
+    }
+  }
+  r += '"';
+  return r;
+}
+
+std::string CsvString(const std::string& s) {
+  if (s.find_first_of(",\"\n") == std::string::npos) {
+    return s;
+  }
+  std::string r = "\"";
+  for (char c : s) {
+    if (c == '"') r += '"';
+    r += c;
+  }
+  r += '"';
+  return r;
+}
+
 class CountComparator : public Comparator {
  public:
   CountComparator(const Comparator* wrapped) : wrapped_(wrapped) {}
@@ -161,6 +421,39 @@ class CountComparator : public Comparator {
   const Comparator* const wrapped_;
 };
 
+// Adds fixed 64-bit counters, for the "mergerandom" benchmark.
+class UInt64AddOperator : public MergeOperator {
+ public:
+  const char* Name() const override { return "leveldb.bench.UInt64Add"; }
+
+  bool FullMerge(const Slice& key, const Slice* existing_value,
+                 const std::vector<Slice>& operands,
+                 std::string* new_value) const override {
+    uint64_t sum = 0;
+    if (existing_value != nullptr) {
+      sum = Decode(*existing_value);
+    }
+    for (size_t i = 0; i < operands.size(); i++) {
+      sum += Decode(operands[i]);
+    }
+    new_value->clear();
+    PutFixed64(new_value, sum);
+    return true;
+  }
+
+  bool PartialMerge(const Slice& key, const Slice& older, const Slice& newer,
+                    std::string* new_value) const override {
+    new_value->clear();
+    PutFixed64(new_value, Decode(older) + Decode(newer));
+    return true;
+  }
+
+ private:
+  static uint64_t Decode(const Slice& value) {
+    return value.size() == sizeof(uint64_t) ? DecodeFixed64(value.data()) : 0;
+  }
+};
+
 // Helper for quickly generating random data.
 class RandomGenerator {
  private:
@@ -193,6 +486,159 @@ class RandomGenerator {
   }
 };
 
+enum ValueSizeDistribution {
+  kFixedValueSize,
+  kUniformValueSize,
+  kExponentialValueSize
+};
+ValueSizeDistribution g_value_size_dist = kFixedValueSize;
+
+bool ParseValueSizeDistribution(const char* name,
+                                ValueSizeDistribution* dist) {
+  if (strcmp(name, "fixed") == 0) {
+    *dist = kFixedValueSize;
+  } else if (strcmp(name, "uniform") == 0) {
+    *dist = kUniformValueSize;
+  } else if (strcmp(name, "exponential") == 0) {
+    *dist = kExponentialValueSize;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+enum KeyDistribution { kUniformKeys, kZipfianKeys, kLatestKeys, kHotspotKeys };
+
+// Only used if --key_dist is set.
+KeyDistribution g_key_dist = kUniformKeys;
+
+bool ParseKeyDistribution(const char* name, KeyDistribution* dist) {
+  if (strcmp(name, "uniform") == 0) {
+    *dist = kUniformKeys;
+  } else if (strcmp(name, "zipfian") == 0) {
+    *dist = kZipfianKeys;
+  } else if (strcmp(name, "latest") == 0) {
+    *dist = kLatestKeys;
+  } else if (strcmp(name, "hotspot") == 0) {
+    *dist = kHotspotKeys;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Return a uniformly distributed double in (0, 1).
+double NextDouble(Random* rnd) { return rnd->Next() / 2147483647.0; }
+
+// Picks the keys accessed by the ycsb* and mixed benchmarks.  Shared by all
+// threads of a benchmark, each of which passes its own Random.
+class KeyChooser {
+ public:
+  // "items" is the number of keys in the database when the benchmark starts,
+  // over which the zipfian ranks are spread.
+  KeyChooser(KeyDistribution dist, int items)
+      : dist_(dist), items_(std::max(items, 1)) {
+    if (dist_ == kZipfianKeys || dist_ == kLatestKeys) {
+      const double theta = FLAGS_zipfian_constant;
+      const double zeta2 = Zeta(2, theta);
+      zetan_ = Zeta(items_, theta);
+      alpha_ = 1.0 / (1.0 - theta);
+      eta_ = (1.0 - std::pow(2.0 / items_, 1.0 - theta)) /
+             (1.0 - zeta2 / zetan_);
+      half_pow_theta_ = std::pow(0.5, theta);
+    }
+  }
+
+  // Return a key in [0, n), where the n keys inserted so far were inserted in
+  // the order of their numbers.
+  int Next(Random* rnd, int n) const {
+    n = std::max(n, 1);
+    switch (dist_) {
+      case kZipfianKeys: {
+        // Scatter the popular keys over the key space, as YCSB does, so that
+        // they do not all share a few blocks.
+        char buf[sizeof(uint32_t)];
+        EncodeFixed32(buf, NextRank(rnd));
+        return Hash(buf, sizeof(buf), 0xbc9f1d34) % n;
+      }
+      case kLatestKeys:
+        return std::max(n - 1 - NextRank(rnd), 0);
+      case kHotspotKeys: {
+        const int hot = std::max(
+            1, static_cast<int>(n * FLAGS_hotspot_set_fraction));
+        if (hot >= n || NextDouble(rnd) < FLAGS_hotspot_op_fraction) {
+          return rnd->Uniform(hot);
+        }
+        return hot + rnd->Uniform(n - hot);
+      }
+      case kUniformKeys:
+      default:
+        return rnd->Uniform(n);
+    }
+  }
+
+ private:
+  static double Zeta(int n, double theta) {
+    double sum = 0;
+    for (int i = 1; i <= n; i++) {
+      sum += 1.0 / std::pow(i, theta);
+    }
+    return sum;
+  }
+
+  // Return a zipfian distributed rank in [0, items_), with 0 the most
+  // popular, using the method of Gray et al., "Quickly Generating
+  // Billion-Record Synthetic Databases".
+  int NextRank(Random* rnd) const {
+    const double u = NextDouble(rnd);
+    const double uz = u * zetan_;
+    if (uz < 1.0) return 0;
+    if (uz < 1.0 + half_pow_theta_) return 1;
+    const int rank =
+        static_cast<int>(items_ * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+    return std::min(rank, items_ - 1);
+  }
+
+  const KeyDistribution dist_;
+  const int items_;
+  double zetan_ = 0;
+  double alpha_ = 0;
+  double eta_ = 0;
+  double half_pow_theta_ = 0;
+};
+
+// The operations of a ycsb* or mixed benchmark, in percent.
+struct Workload {
+  int read_percent;
+  int update_percent;
+  int insert_percent;
+  int scan_percent;
+  int rmw_percent;
+  KeyDistribution key_dist;
+};
+
+// Set *workload to the YCSB core workload called "name", if there is one.
+bool GetYcsbWorkload(const Slice& name, Workload* workload) {
+  static const struct {
+    const char* name;
+    Workload workload;
+  } kWorkloads[] = {
+      {"ycsba", {50, 50, 0, 0, 0, kZipfianKeys}},
+      {"ycsbb", {95, 5, 0, 0, 0, kZipfianKeys}},
+      {"ycsbc", {100, 0, 0, 0, 0, kZipfianKeys}},
+      {"ycsbd", {95, 0, 5, 0, 0, kLatestKeys}},
+      {"ycsbe", {0, 0, 5, 95, 0, kZipfianKeys}},
+      {"ycsbf", {50, 0, 0, 0, 50, kZipfianKeys}},
+  };
+  for (const auto& w : kWorkloads) {
+    if (name == Slice(w.name)) {
+      *workload = w.workload;
+      return true;
+    }
+  }
+  return false;
+}
+
 class KeyBuffer {
  public:
   KeyBuffer() {
@@ -244,15 +690,27 @@ class Stats {
   int next_report_;
   int64_t bytes_;
   double last_op_finish_;
-  Histogram hist_;
+  HdrHistogram hist_;
+  HdrHistogram op_hist_[kNumOpTypes];
   std::string message_;
 
+  // Operations finished since the last TakeInterval(), for --report_interval.
+  port::Mutex interval_mu_;
+  HdrHistogram interval_hist_ GUARDED_BY(interval_mu_);
+
  public:
   Stats() { Start(); }
 
   void Start() {
     next_report_ = 100;
     hist_.Clear();
+    for (int i = 0; i < kNumOpTypes; i++) {
+      op_hist_[i].Clear();
+    }
+    {
+      MutexLock l(&interval_mu_);
+      interval_hist_.Clear();
+    }
     done_ = 0;
     bytes_ = 0;
     seconds_ = 0;
@@ -262,6 +720,9 @@ class Stats {
 
   void Merge(const Stats& other) {
     hist_.Merge(other.hist_);
+    for (int i = 0; i < kNumOpTypes; i++) {
+      op_hist_[i].Merge(other.op_hist_[i]);
+    }
     done_ += other.done_;
     bytes_ += other.bytes_;
     seconds_ += other.seconds_;
@@ -279,15 +740,31 @@ class Stats {
 
   void AddMessage(Slice msg) { AppendWithSpace(&message_, msg); }
 
-  void FinishedSingleOp() {
-    if (FLAGS_histogram) {
+  // Leave the time since the last operation, spent waiting, out of the
+  // latency of the next one.
+  void SkipIdleTime() {
+    if (MeasureLatency()) {
+      last_op_finish_ = g_env->NowMicros();
+    }
+  }
+
+  void FinishedSingleOp(OpType type = kOpOther) {
+    if (MeasureLatency()) {
       double now = g_env->NowMicros();
-      double micros = now - last_op_finish_;
+      const uint64_t micros = static_cast<uint64_t>(now - last_op_finish_);
       hist_.Add(micros);
-      if (micros > 20000) {
-        std::fprintf(stderr, "long op: %.1f micros%30s\r", micros, "");
+      if (type != kOpOther) {
+        op_hist_[type].Add(micros);
+      }
+      if (FLAGS_histogram && micros > 20000) {
+        std::fprintf(stderr, "long op: %.1f micros%30s\r",
+                     static_cast<double>(micros), "");
         std::fflush(stderr);
       }
+      if (FLAGS_report_interval > 0) {
+        MutexLock l(&interval_mu_);
+        interval_hist_.Add(micros);
+      }
       last_op_finish_ = now;
     }
 
@@ -314,31 +791,61 @@ class Stats {
 
   void AddBytes(int64_t n) { bytes_ += n; }
 
-  void Report(const Slice& name) {
+  // Merge the operations finished since the last call into *hist.  May be
+  // called from another thread than the one running the benchmark.
+  void TakeInterval(HdrHistogram* hist) {
+    MutexLock l(&interval_mu_);
+    hist->Merge(interval_hist_);
+    interval_hist_.Clear();
+  }
+
+  // Print the results and store them in *result.
+  void Report(const Slice& name, BenchmarkResult* result) {
     // Pretend at least one op was done in case we are running a benchmark
     // that does not call FinishedSingleOp().
     if (done_ < 1) done_ = 1;
 
+    // Rates are computed on actual elapsed time, not the sum of per-thread
+    // elapsed times.
+    const double elapsed = (finish_ - start_) * 1e-6;
+    result->name = name.ToString();
+    result->ops = done_;
+    result->seconds = elapsed;
+    result->micros_per_op = seconds_ * 1e6 / done_;
+    result->ops_per_sec = elapsed > 0 ? done_ / elapsed : 0;
+    result->message = message_;
+    result->latency = LatencySummary(hist_);
+    for (int i = 0; i < kNumOpTypes; i++) {
+      if (op_hist_[i].Count() > 0) {
+        result->op_latencies.emplace_back(OpTypeName(static_cast<OpType>(i)),
+                                          LatencySummary(op_hist_[i]));
+      }
+    }
+
     std::string extra;
     if (bytes_ > 0) {
-      // Rate is computed on actual elapsed time, not the sum of per-thread
-      // elapsed times.
-      double elapsed = (finish_ - start_) * 1e-6;
+      result->mb_per_sec = (bytes_ / 1048576.0) / elapsed;
       char rate[100];
-      std::snprintf(rate, sizeof(rate), "%6.1f MB/s",
-                    (bytes_ / 1048576.0) / elapsed);
+      std::snprintf(rate, sizeof(rate), "%6.1f MB/s", result->mb_per_sec);
       extra = rate;
     }
     AppendWithSpace(&extra, message_);
 
-    std::fprintf(stdout, "%-12s : %11.3f micros/op;%s%s\n",
+    std::fprintf(g_text_out, "%-12s : %11.3f micros/op;%s%s\n",
                  name.ToString().c_str(), seconds_ * 1e6 / done_,
                  (extra.empty() ? "" : " "), extra.c_str());
     if (FLAGS_histogram) {
-      std::fprintf(stdout, "Microseconds per op:\n%s\n",
+      std::fprintf(g_text_out, "Microseconds per op:\n%s\n",
                    hist_.ToString().c_str());
+      for (int i = 0; i < kNumOpTypes; i++) {
+        if (op_hist_[i].Count() > 0) {
+          std::fprintf(g_text_out, "Microseconds per %s:\n%s\n",
+                       OpTypeName(static_cast<OpType>(i)),
+                       op_hist_[i].ToString().c_str());
+        }
+      }
     }
-    std::fflush(stdout);
+    std::fflush(g_text_out);
   }
 };
 
@@ -429,45 +936,65 @@ class Benchmark {
  private:
   Cache* cache_;
   const FilterPolicy* filter_policy_;
+  Statistics* statistics_;
   DB* db_;
   int num_;
   int value_size_;
+  ValueSizeDistribution value_size_dist_;
   int entries_per_batch_;
   WriteOptions write_options_;
   int reads_;
   int heap_counter_;
   CountComparator count_comparator_;
+  UInt64AddOperator merge_operator_;
   int total_thread_count_;
+  std::vector<BenchmarkResult> results_;
+  bool trace_started_;  // --trace_file was started
+  bool tracing_;        // ... and db_ is still recording into it
+
+  // State of the ycsb* and mixed benchmarks.  Keys below insert_count_ have
+  // been inserted.
+  Workload workload_;
+  std::unique_ptr<KeyChooser> key_chooser_;
+  std::atomic<int> insert_count_;
 
   void PrintHeader() {
     const int kKeySize = 16 + FLAGS_key_prefix;
     PrintEnvironment();
-    std::fprintf(stdout, "Keys:       %d bytes each\n", kKeySize);
+    std::fprintf(g_text_out, "Keys:       %d bytes each\n", kKeySize);
     std::fprintf(
-        stdout, "Values:     %d bytes each (%d bytes after compression)\n",
+        g_text_out, "Values:     %d bytes each (%d bytes after compression)\n",
         FLAGS_value_size,
         static_cast<int>(FLAGS_value_size * FLAGS_compression_ratio + 0.5));
-    std::fprintf(stdout, "Entries:    %d\n", num_);
-    std::fprintf(stdout, "RawSize:    %.1f MB (estimated)\n",
+    if (g_value_size_dist == kUniformValueSize) {
+      std::fprintf(g_text_out, "            uniform in [%d, %d]\n",
+                   FLAGS_value_size_min, FLAGS_value_size_max);
+    } else if (g_value_size_dist == kExponentialValueSize) {
+      std::fprintf(g_text_out, "            exponential in [%d, %d]\n",
+                   FLAGS_value_size_min, FLAGS_value_size_max);
+    }
+    std::fprintf(g_text_out, "Entries:    %d\n", num_);
+    std::fprintf(g_text_out, "RawSize:    %.1f MB (estimated)\n",
                  ((static_cast<int64_t>(kKeySize + FLAGS_value_size) * num_) /
                   1048576.0));
     std::fprintf(
-        stdout, "FileSize:   %.1f MB (estimated)\n",
+        g_text_out, "FileSize:   %.1f MB (estimated)\n",
         (((kKeySize + FLAGS_value_size * FLAGS_compression_ratio) * num_) /
          1048576.0));
     PrintWarnings();
-    std::fprintf(stdout, "------------------------------------------------\n");
+    std::fprintf(g_text_out,
+                 "------------------------------------------------\n");
   }
 
   void PrintWarnings() {
 #if defined(__GNUC__) && !defined(__OPTIMIZE__)
     std::fprintf(
-        stdout,
+        g_text_out,
         "WARNING: Optimization is disabled: benchmarks unnecessarily slow\n");
 #endif
 #ifndef NDEBUG
     std::fprintf(
-        stdout,
+        g_text_out,
         "WARNING: Assertions are enabled; benchmarks unnecessarily slow\n");
 #endif
 
@@ -475,9 +1002,10 @@ class Benchmark {
     const char text[] = "yyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyy";
     std::string compressed;
     if (!port::Snappy_Compress(text, sizeof(text), &compressed)) {
-      std::fprintf(stdout, "WARNING: Snappy compression is not enabled\n");
+      std::fprintf(g_text_out, "WARNING: Snappy compression is not enabled\n");
     } else if (compressed.size() >= sizeof(text)) {
-      std::fprintf(stdout, "WARNING: Snappy compression is not effective\n");
+      std::fprintf(g_text_out,
+                   "WARNING: Snappy compression is not effective\n");
     }
   }
 
@@ -523,14 +1051,19 @@ class Benchmark {
         filter_policy_(FLAGS_bloom_bits >= 0
                            ? NewBloomFilterPolicy(FLAGS_bloom_bits)
                            : nullptr),
+        statistics_(FLAGS_statistics ? NewStatistics() : nullptr),
         db_(nullptr),
         num_(FLAGS_num),
         value_size_(FLAGS_value_size),
+        value_size_dist_(kFixedValueSize),
         entries_per_batch_(1),
         reads_(FLAGS_reads < 0 ? FLAGS_num : FLAGS_reads),
         heap_counter_(0),
         count_comparator_(BytewiseComparator()),
-        total_thread_count_(0) {
+        total_thread_count_(0),
+        trace_started_(false),
+        tracing_(false),
+        insert_count_(0) {
     std::vector<std::string> files;
     g_env->GetChildren(FLAGS_db, &files);
     for (size_t i = 0; i < files.size(); i++) {
@@ -547,6 +1080,7 @@ class Benchmark {
     delete db_;
     delete cache_;
     delete filter_policy_;
+    delete statistics_;
   }
 
   void Run() {
@@ -569,6 +1103,7 @@ class Benchmark {
       num_ = FLAGS_num;
       reads_ = (FLAGS_reads < 0 ? FLAGS_num : FLAGS_reads);
       value_size_ = FLAGS_value_size;
+      value_size_dist_ = g_value_size_dist;
       entries_per_batch_ = 1;
       write_options_ = WriteOptions();
 
@@ -602,6 +1137,7 @@ class Benchmark {
         fresh_db = true;
         num_ /= 1000;
         value_size_ = 100 * 1000;
+        value_size_dist_ = kFixedValueSize;
         method = &Benchmark::WriteRandom;
       } else if (name == Slice("readseq")) {
         method = &Benchmark::ReadSequential;
@@ -624,9 +1160,22 @@ class Benchmark {
         method = &Benchmark::DeleteSeq;
       } else if (name == Slice("deleterandom")) {
         method = &Benchmark::DeleteRandom;
+      } else if (name == Slice("updaterandom")) {
+        method = &Benchmark::UpdateRandom;
+      } else if (name == Slice("mergerandom")) {
+        method = &Benchmark::MergeRandom;
       } else if (name == Slice("readwhilewriting")) {
         num_threads++;  // Add extra thread for writing
         method = &Benchmark::ReadWhileWriting;
+      } else if (GetYcsbWorkload(name, &workload_)) {
+        method = &Benchmark::RunWorkload;
+      } else if (name == Slice("mixed")) {
+        workload_ = Workload{FLAGS_read_percent, FLAGS_update_percent,
+                             FLAGS_insert_percent, FLAGS_scan_percent,
+                             FLAGS_rmw_percent, kUniformKeys};
+        method = &Benchmark::RunWorkload;
+      } else if (name == Slice("replay")) {
+        method = &Benchmark::Replay;
       } else if (name == Slice("compact")) {
         method = &Benchmark::Compact;
       } else if (name == Slice("crc32c")) {
@@ -639,6 +1188,10 @@ class Benchmark {
         method = &Benchmark::ZstdCompress;
       } else if (name == Slice("zstduncomp")) {
         method = &Benchmark::ZstdUncompress;
+      } else if (name == Slice("lz4comp")) {
+        method = &Benchmark::Lz4Compress;
+      } else if (name == Slice("lz4uncomp")) {
+        method = &Benchmark::Lz4Uncompress;
       } else if (name == Slice("heapprofile")) {
         HeapProfile();
       } else if (name == Slice("stats")) {
@@ -654,10 +1207,16 @@ class Benchmark {
 
       if (fresh_db) {
         if (FLAGS_use_existing_db) {
-          std::fprintf(stdout, "%-12s : skipped (--use_existing_db is true)\n",
+          std::fprintf(g_text_out,
+                       "%-12s : skipped (--use_existing_db is true)\n",
                        name.ToString().c_str());
           method = nullptr;
         } else {
+          if (tracing_) {
+            std::fprintf(stderr, "trace %s ends before %s\n", FLAGS_trace_file,
+                         name.ToString().c_str());
+            tracing_ = false;
+          }
           delete db_;
           db_ = nullptr;
           DestroyDB(FLAGS_db, Options());
@@ -665,13 +1224,221 @@ class Benchmark {
         }
       }
 
+      if (method != nullptr && !trace_started_ && FLAGS_trace_file != nullptr) {
+        Status s = db_->StartTrace(TraceOptions(), FLAGS_trace_file);
+        if (!s.ok()) {
+          std::fprintf(stderr, "trace error: %s\n", s.ToString().c_str());
+          std::exit(1);
+        }
+        trace_started_ = true;
+        tracing_ = true;
+      }
+
+      if (method == &Benchmark::RunWorkload) {
+        if (FLAGS_key_dist[0] != '\0') {
+          workload_.key_dist = g_key_dist;
+        }
+        key_chooser_.reset(new KeyChooser(workload_.key_dist, num_));
+        insert_count_.store(num_, std::memory_order_relaxed);
+      }
+
       if (method != nullptr) {
         RunBenchmark(num_threads, name, method);
       }
     }
+
+    if (statistics_ != nullptr) {
+      std::fprintf(g_text_out, "\nSTATISTICS:\n%s",
+                   statistics_->ToString().c_str());
+    }
+
+    if (g_output_format != kTextOutput) {
+      WriteResults();
+    }
   }
 
  private:
+  // Return the flags the benchmarks ran with, after defaults were applied.
+  static std::vector<std::pair<std::string, std::string>> EffectiveOptions() {
+    std::vector<std::pair<std::string, std::string>> options;
+    auto add = [&options](const char* name, double value) {
+      char buf[50];
+      std::snprintf(buf, sizeof(buf), "%g", value);
+      options.emplace_back(name, buf);
+    };
+    auto add_string = [&options](const char* name, const char* value) {
+      options.emplace_back(name, value != nullptr ? value : "");
+    };
+    add_string("benchmarks", FLAGS_benchmarks);
+    add_string("db", FLAGS_db);
+    add("num", FLAGS_num);
+    add("reads", FLAGS_reads < 0 ? FLAGS_num : FLAGS_reads);
+    add("threads", FLAGS_threads);
+    add("value_size", FLAGS_value_size);
+    add_string("value_size_dist", FLAGS_value_size_dist);
+    add("value_size_min", FLAGS_value_size_min);
+    add("value_size_max", FLAGS_value_size_max);
+    add("key_prefix", FLAGS_key_prefix);
+    add_string("key_dist", FLAGS_key_dist);
+    add("zipfian_constant", FLAGS_zipfian_constant);
+    add("hotspot_set_fraction", FLAGS_hotspot_set_fraction);
+    add("hotspot_op_fraction", FLAGS_hotspot_op_fraction);
+    add("read_percent", FLAGS_read_percent);
+    add("update_percent", FLAGS_update_percent);
+    add("insert_percent", FLAGS_insert_percent);
+    add("scan_percent", FLAGS_scan_percent);
+    add("rmw_percent", FLAGS_rmw_percent);
+    add("scan_length", FLAGS_scan_length);
+    add("duration", FLAGS_duration);
+    add("report_interval", FLAGS_report_interval);
+    add("compression_ratio", FLAGS_compression_ratio);
+    add("compression", FLAGS_compression);
+    add("zstd_compression_level", FLAGS_zstd_compression_level);
+    add("compression_threads", FLAGS_compression_threads);
+    add("write_buffer_size", FLAGS_write_buffer_size);
+    add("max_file_size", FLAGS_max_file_size);
+    add("block_size", FLAGS_block_size);
+    add("cache_size", FLAGS_cache_size);
+    add("open_files", FLAGS_open_files);
+    add("bloom_bits", FLAGS_bloom_bits);
+    add("use_existing_db", FLAGS_use_existing_db);
+    add("reuse_logs", FLAGS_reuse_logs);
+    add("table_preload_threads", FLAGS_table_preload_threads);
+    add("blob_value_threshold", FLAGS_blob_value_threshold);
+    add("compaction_priority", FLAGS_compaction_priority);
+    add("dynamic_level_bytes", FLAGS_dynamic_level_bytes);
+    add("compaction_style", FLAGS_compaction_style);
+    add("statistics", FLAGS_statistics);
+    add_string("trace_file", FLAGS_trace_file);
+    add_string("replay_file", FLAGS_replay_file);
+    add("replay_speed", FLAGS_replay_speed);
+    return options;
+  }
+
+  // Write results_, the options and the DB stats in --output_format.
+  void WriteResults() {
+    FILE* out = stdout;
+    if (FLAGS_output_file != nullptr) {
+      out = std::fopen(FLAGS_output_file, "w");
+      if (out == nullptr) {
+        std::fprintf(stderr, "cannot open %s\n", FLAGS_output_file);
+        std::exit(1);
+      }
+    }
+    std::string db_stats;
+    if (db_ == nullptr || !db_->GetProperty("leveldb.stats", &db_stats)) {
+      db_stats.clear();
+    }
+    if (g_output_format == kJsonOutput) {
+      WriteJson(out, db_stats);
+    } else {
+      WriteCsv(out, db_stats);
+    }
+    if (out == stdout) {
+      std::fflush(out);
+    } else {
+      std::fclose(out);
+    }
+  }
+
+  static void WriteJsonLatency(FILE* out, const LatencySummary& l) {
+    std::fprintf(out,
+                 "{\"count\": %.0f, \"average\": %.3f, \"p50\": %.3f, "
+                 "\"p90\": %.3f, \"p99\": %.3f, \"p99.9\": %.3f, "
+                 "\"p99.99\": %.3f, \"max\": %.3f}",
+                 l.count, l.average, l.p50, l.p90, l.p99, l.p999, l.p9999,
+                 l.max);
+  }
+
+  void WriteJson(FILE* out, const std::string& db_stats) {
+    std::fprintf(out, "{\n  \"version\": \"%d.%d\",\n  \"options\": {",
+                 kMajorVersion, kMinorVersion);
+    const auto options = EffectiveOptions();
+    for (size_t i = 0; i < options.size(); i++) {
+      std::fprintf(out, "%s\n    %s: %s", i > 0 ? "," : "",
+                   JsonString(options[i].first).c_str(),
+                   JsonString(options[i].second).c_str());
+    }
+    std::fprintf(out, "\n  },\n  \"benchmarks\": [");
+    for (size_t i = 0; i < results_.size(); i++) {
+      const BenchmarkResult& r = results_[i];
+      std::fprintf(out,
+                   "%s\n    {\"name\": %s, \"ops\": %lld, "
+                   "\"seconds\": %.3f, \"micros_per_op\": %.3f, "
+                   "\"ops_per_sec\": %.1f, \"mb_per_sec\": %.1f, "
+                   "\"message\": %s,\n     \"latency_micros\": ",
+                   i > 0 ? "," : "", JsonString(r.name).c_str(),
+                   static_cast<long long>(r.ops), r.seconds, r.micros_per_op,
+                   r.ops_per_sec, r.mb_per_sec, JsonString(r.message).c_str());
+      WriteJsonLatency(out, r.latency);
+      std::fprintf(out, ",\n     \"operations\": {");
+      for (size_t j = 0; j < r.op_latencies.size(); j++) {
+        std::fprintf(out, "%s\n       %s: ", j > 0 ? "," : "",
+                     JsonString(r.op_latencies[j].first).c_str());
+        WriteJsonLatency(out, r.op_latencies[j].second);
+      }
+      std::fprintf(out, "},\n     \"intervals\": [");
+      for (size_t j = 0; j < r.intervals.size(); j++) {
+        const IntervalResult& interval = r.intervals[j];
+        std::fprintf(out,
+                     "%s\n       {\"seconds\": %.3f, \"ops_per_sec\": %.1f, "
+                     "\"latency_micros\": ",
+                     j > 0 ? "," : "", interval.seconds, interval.ops_per_sec);
+        WriteJsonLatency(out, interval.latency);
+        std::fprintf(out, "}");
+      }
+      std::fprintf(out, "]}");
+    }
+    std::fprintf(out, "\n  ],\n  \"db_stats\": %s\n}\n",
+                 JsonString(db_stats).c_str());
+  }
+
+  // One row per benchmark, per operation type and per interval, preceded
+  // by the options and followed by the DB stats as "#" comment lines.
+  void WriteCsv(FILE* out, const std::string& db_stats) {
+    for (const auto& option : EffectiveOptions()) {
+      std::fprintf(out, "# %s=%s\n", option.first.c_str(),
+                   option.second.c_str());
+    }
+    std::fprintf(out,
+                 "benchmark,operation,interval_seconds,ops,seconds,"
+                 "micros_per_op,ops_per_sec,mb_per_sec,average,p50,p90,p99,"
+                 "p99.9,p99.99,max\n");
+    auto row = [out](const std::string& benchmark, const char* operation,
+                     const std::string& interval, const std::string& totals,
+                     const LatencySummary& l) {
+      std::fprintf(out, "%s,%s,%s,%s,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                   CsvString(benchmark).c_str(), operation, interval.c_str(),
+                   totals.c_str(), l.average, l.p50, l.p90, l.p99, l.p999,
+                   l.p9999, l.max);
+    };
+    char buf[200];
+    for (const BenchmarkResult& r : results_) {
+      std::snprintf(buf, sizeof(buf), "%lld,%.3f,%.3f,%.1f,%.1f",
+                    static_cast<long long>(r.ops), r.seconds, r.micros_per_op,
+                    r.ops_per_sec, r.mb_per_sec);
+      row(r.name, "all", "", buf, r.latency);
+      for (const auto& op : r.op_latencies) {
+        std::snprintf(buf, sizeof(buf), "%.0f,,,,", op.second.count);
+        row(r.name, op.first.c_str(), "", buf, op.second);
+      }
+      for (const IntervalResult& interval : r.intervals) {
+        std::snprintf(buf, sizeof(buf), "%.0f,,,%.1f,",
+                      interval.latency.count, interval.ops_per_sec);
+        row(r.name, "all", std::to_string(interval.seconds), buf,
+            interval.latency);
+      }
+    }
+    Slice stats(db_stats);
+    while (!stats.empty()) {
+      const char* eol = static_cast<const char*>(
+          memchr(stats.data(), '\n', stats.size()));
+      const size_t len = eol != nullptr ? eol - stats.data() : stats.size();
+      std::fprintf(out, "# %.*s\n", static_cast<int>(len), stats.data());
+      stats.remove_prefix(eol != nullptr ? len + 1 : len);
+    }
+  }
+
   struct ThreadArg {
     Benchmark* bm;
     SharedState* shared;
@@ -730,8 +1497,14 @@ class Benchmark {
       shared.cv.Wait();
     }
 
+    BenchmarkResult result;
     shared.start = true;
     shared.cv.SignalAll();
+    if (FLAGS_report_interval > 0) {
+      shared.mu.Unlock();
+      ReportIntervals(&shared, arg, n, name, &result.intervals);
+      shared.mu.Lock();
+    }
     while (shared.num_done < n) {
       shared.cv.Wait();
     }
@@ -740,11 +1513,13 @@ class Benchmark {
     for (int i = 1; i < n; i++) {
       arg[0].thread->stats.Merge(arg[i].thread->stats);
     }
-    arg[0].thread->stats.Report(name);
+    arg[0].thread->stats.Report(name, &result);
+    results_.push_back(std::move(result));
     if (FLAGS_comparisons) {
-      fprintf(stdout, "Comparisons: %zu\n", count_comparator_.comparisons());
+      fprintf(g_text_out, "Comparisons: %zu\n",
+              count_comparator_.comparisons());
       count_comparator_.reset();
-      fflush(stdout);
+      fflush(g_text_out);
     }
 
     for (int i = 0; i < n; i++) {
@@ -753,6 +1528,47 @@ class Benchmark {
     delete[] arg;
   }
 
+  // Print the throughput and latency of the operations finished in each
+  // --report_interval until all threads are done, and append them to
+  // *intervals.
+  void ReportIntervals(SharedState* shared, ThreadArg* arg, int n,
+                       const Slice& name,
+                       std::vector<IntervalResult>* intervals) {
+    const uint64_t interval = FLAGS_report_interval * uint64_t{1000000};
+    const uint64_t start = g_env->NowMicros();
+    uint64_t last = start;
+    while (true) {
+      {
+        MutexLock l(&shared->mu);
+        if (shared->num_done >= n) {
+          break;
+        }
+      }
+      const uint64_t now = g_env->NowMicros();
+      if (now < last + interval) {
+        g_env->SleepForMicroseconds(static_cast<int>(
+            std::min<uint64_t>(last + interval - now, 100000)));
+        continue;
+      }
+      HdrHistogram hist;
+      for (int i = 0; i < n; i++) {
+        arg[i].thread->stats.TakeInterval(&hist);
+      }
+      IntervalResult r;
+      r.seconds = (now - start) * 1e-6;
+      r.ops_per_sec = hist.Count() / ((now - last) * 1e-6);
+      r.latency = LatencySummary(hist);
+      intervals->push_back(r);
+      std::fprintf(g_text_out,
+                   "%-12s : %6.0f s %11.1f ops/sec; P50 %.1f P99 %.1f "
+                   "micros/op\n",
+                   name.ToString().c_str(), r.seconds, r.ops_per_sec,
+                   r.latency.p50, r.latency.p99);
+      std::fflush(g_text_out);
+      last = now;
+    }
+  }
+
   void Crc32c(ThreadState* thread) {
     // Checksum about 500MB of data total
     const int size = 4096;
@@ -799,6 +1615,14 @@ class Benchmark {
         &port::Zstd_Uncompress);
   }
 
+  void Lz4Compress(ThreadState* thread) {
+    Compress(thread, "lz4", &port::Lz4_Compress);
+  }
+
+  void Lz4Uncompress(ThreadState* thread) {
+    Uncompress(thread, "lz4", &port::Lz4_Compress, &port::Lz4_Uncompress);
+  }
+
   void Open() {
     assert(db_ == nullptr);
     Options options;
@@ -813,9 +1637,19 @@ class Benchmark {
     }
     options.max_open_files = FLAGS_open_files;
     options.filter_policy = filter_policy_;
+    options.statistics = statistics_;
     options.reuse_logs = FLAGS_reuse_logs;
     options.compression =
         FLAGS_compression ? kSnappyCompression : kNoCompression;
+    options.compression_threads = FLAGS_compression_threads;
+    options.table_preload_threads = FLAGS_table_preload_threads;
+    options.blob_value_threshold = FLAGS_blob_value_threshold;
+    options.compaction_priority =
+        static_cast<CompactionPriority>(FLAGS_compaction_priority);
+    options.level_compaction_dynamic_level_bytes = FLAGS_dynamic_level_bytes;
+    options.compaction_style =
+        static_cast<CompactionStyle>(FLAGS_compaction_style);
+    options.merge_operator = &merge_operator_;
     Status s = DB::Open(options, FLAGS_db, &db_);
     if (!s.ok()) {
       std::fprintf(stderr, "open error: %s\n", s.ToString().c_str());
@@ -852,8 +1686,9 @@ class Benchmark {
       for (int j = 0; j < entries_per_batch_; j++) {
         const int k = seq ? i + j : thread->rand.Uniform(FLAGS_num);
         key.Set(k);
-        batch.Put(key.slice(), gen.Generate(value_size_));
-        bytes += value_size_ + key.slice().size();
+        const int value_size = NextValueSize(&thread->rand);
+        batch.Put(key.slice(), gen.Generate(value_size));
+        bytes += value_size + key.slice().size();
         thread->stats.FinishedSingleOp();
       }
       s = db_->Write(write_options_, &batch);
@@ -997,6 +1832,50 @@ class Benchmark {
 
   void DeleteRandom(ThreadState* thread) { DoDelete(thread, false); }
 
+  // Increment a random counter by reading, adding and writing it back.
+  void UpdateRandom(ThreadState* thread) {
+    ReadOptions options;
+    std::string value;
+    std::string delta;
+    Status s;
+    KeyBuffer key;
+    for (int i = 0; i < num_; i++) {
+      const int k = thread->rand.Uniform(FLAGS_num);
+      key.Set(k);
+      uint64_t count = 0;
+      if (db_->Get(options, key.slice(), &value).ok() &&
+          value.size() == sizeof(count)) {
+        count = DecodeFixed64(value.data());
+      }
+      delta.clear();
+      PutFixed64(&delta, count + 1);
+      s = db_->Put(write_options_, key.slice(), delta);
+      if (!s.ok()) {
+        std::fprintf(stderr, "put error: %s\n", s.ToString().c_str());
+        std::exit(1);
+      }
+      thread->stats.FinishedSingleOp();
+    }
+  }
+
+  // Increment a random counter with a single Merge.
+  void MergeRandom(ThreadState* thread) {
+    std::string delta;
+    PutFixed64(&delta, 1);
+    Status s;
+    KeyBuffer key;
+    for (int i = 0; i < num_; i++) {
+      const int k = thread->rand.Uniform(FLAGS_num);
+      key.Set(k);
+      s = db_->Merge(write_options_, key.slice(), delta);
+      if (!s.ok()) {
+        std::fprintf(stderr, "merge error: %s\n", s.ToString().c_str());
+        std::exit(1);
+      }
+      thread->stats.FinishedSingleOp();
+    }
+  }
+
   void ReadWhileWriting(ThreadState* thread) {
     if (thread->tid > 0) {
       ReadRandom(thread);
@@ -1028,6 +1907,190 @@ class Benchmark {
     }
   }
 
+  // Return the size of the next value to write.
+  int NextValueSize(Random* rnd) const {
+    switch (value_size_dist_) {
+      case kUniformValueSize:
+        return FLAGS_value_size_min +
+               rnd->Uniform(FLAGS_value_size_max - FLAGS_value_size_min + 1);
+      case kExponentialValueSize: {
+        const double size = -value_size_ * std::log(NextDouble(rnd));
+        return std::max(FLAGS_value_size_min,
+                        std::min(FLAGS_value_size_max, static_cast<int>(size)));
+      }
+      case kFixedValueSize:
+      default:
+        return value_size_;
+    }
+  }
+
+  // Run the operations of workload_ until reads_ of them are done, or for
+  // --duration seconds.
+  void RunWorkload(ThreadState* thread) {
+    ReadOptions options;
+    RandomGenerator gen;
+    std::string value;
+    Status s;
+    KeyBuffer key;
+    int64_t bytes = 0;
+    int reads = 0;
+    int found = 0;
+    const uint64_t deadline =
+        FLAGS_duration > 0
+            ? g_env->NowMicros() + FLAGS_duration * uint64_t{1000000}
+            : 0;
+    for (int i = 0; deadline > 0 ? g_env->NowMicros() < deadline : i < reads_;
+         i++) {
+      int op = thread->rand.Uniform(100);
+      OpType type;
+      if ((op -= workload_.insert_percent) < 0) {
+        type = kOpInsert;
+        key.Set(insert_count_.fetch_add(1, std::memory_order_relaxed));
+        const int value_size = NextValueSize(&thread->rand);
+        s = db_->Put(write_options_, key.slice(), gen.Generate(value_size));
+        bytes += key.slice().size() + value_size;
+      } else {
+        key.Set(key_chooser_->Next(
+            &thread->rand, insert_count_.load(std::memory_order_relaxed)));
+        if ((op -= workload_.read_percent) < 0) {
+          type = kOpRead;
+          reads++;
+          if (db_->Get(options, key.slice(), &value).ok()) {
+            found++;
+            bytes += key.slice().size() + value.size();
+          }
+        } else if ((op -= workload_.update_percent) < 0) {
+          type = kOpUpdate;
+          const int value_size = NextValueSize(&thread->rand);
+          s = db_->Put(write_options_, key.slice(), gen.Generate(value_size));
+          bytes += key.slice().size() + value_size;
+        } else if ((op -= workload_.scan_percent) < 0) {
+          type = kOpScan;
+          const int length = 1 + thread->rand.Uniform(FLAGS_scan_length);
+          Iterator* iter = db_->NewIterator(options);
+          iter->Seek(key.slice());
+          for (int j = 0; j < length && iter->Valid(); j++) {
+            bytes += iter->key().size() + iter->value().size();
+            iter->Next();
+          }
+          delete iter;
+        } else {
+          type = kOpReadModifyWrite;
+          reads++;
+          if (db_->Get(options, key.slice(), &value).ok()) {
+            found++;
+            bytes += key.slice().size() + value.size();
+          }
+          const int value_size = NextValueSize(&thread->rand);
+          s = db_->Put(write_options_, key.slice(), gen.Generate(value_size));
+          bytes += key.slice().size() + value_size;
+        }
+      }
+      if (!s.ok()) {
+        std::fprintf(stderr, "put error: %s\n", s.ToString().c_str());
+        std::exit(1);
+      }
+      thread->stats.FinishedSingleOp(type);
+    }
+    thread->stats.AddBytes(bytes);
+    if (reads > 0) {
+      char msg[100];
+      std::snprintf(msg, sizeof(msg), "(%d of %d reads found)", found, reads);
+      thread->stats.AddMessage(msg);
+    }
+  }
+
+  // Re-issue the operations of --replay_file.  Thread i of n replays
+  // operations i, i + n, ... at their traced times divided by
+  // --replay_speed.
+  void Replay(ThreadState* thread) {
+    if (FLAGS_replay_file == nullptr) {
+      thread->stats.AddMessage("(--replay_file is not set)");
+      return;
+    }
+    TraceReader* reader;
+    Status s = TraceReader::Open(g_env, FLAGS_replay_file, &reader);
+    if (!s.ok()) {
+      std::fprintf(stderr, "replay error: %s\n", s.ToString().c_str());
+      std::exit(1);
+    }
+    int num_threads;
+    {
+      MutexLock l(&thread->shared->mu);
+      num_threads = thread->shared->total;
+    }
+
+    ReadOptions options;
+    WriteBatch batch;
+    std::string value;
+    int64_t bytes = 0;
+    int reads = 0;
+    int found = 0;
+    const uint64_t start = g_env->NowMicros();
+    TraceRecord record;
+    for (int64_t i = 0; reader->Read(&record); i++) {
+      if (i % num_threads != thread->tid) {
+        continue;
+      }
+      if (FLAGS_replay_speed > 0) {
+        const uint64_t due =
+            start + static_cast<uint64_t>(record.micros / FLAGS_replay_speed);
+        const uint64_t now = g_env->NowMicros();
+        if (due > now) {
+          g_env->SleepForMicroseconds(static_cast<int>(due - now));
+          thread->stats.SkipIdleTime();
+        }
+      }
+
+      OpType type;
+      if (record.type == kTraceWrite) {
+        type = kOpWrite;
+        WriteBatchInternal::SetContents(&batch, record.payload);
+        s = db_->Write(write_options_, &batch);
+        bytes += record.payload.size();
+      } else if (record.type == kTraceGet) {
+        type = kOpRead;
+        reads++;
+        if (db_->Get(options, record.payload, &value).ok()) {
+          found++;
+          bytes += record.payload.size() + value.size();
+        }
+      } else {
+        type = kOpSeek;
+        Iterator* iter = db_->NewIterator(options);
+        if (record.type == kTraceSeek) {
+          iter->Seek(record.payload);
+        } else if (record.type == kTraceSeekToFirst) {
+          iter->SeekToFirst();
+        } else {
+          iter->SeekToLast();
+        }
+        if (iter->Valid()) {
+          bytes += iter->key().size() + iter->value().size();
+        }
+        delete iter;
+      }
+      if (!s.ok()) {
+        std::fprintf(stderr, "write error: %s\n", s.ToString().c_str());
+        std::exit(1);
+      }
+      thread->stats.FinishedSingleOp(type);
+    }
+    if (!reader->status().ok()) {
+      std::fprintf(stderr, "replay error: %s\n",
+                   reader->status().ToString().c_str());
+      std::exit(1);
+    }
+    delete reader;
+
+    thread->stats.AddBytes(bytes);
+    if (reads > 0) {
+      char msg[100];
+      std::snprintf(msg, sizeof(msg), "(%d of %d reads found)", found, reads);
+      thread->stats.AddMessage(msg);
+    }
+  }
+
   void Compact(ThreadState* thread) { db_->CompactRange(nullptr, nullptr); }
 
   void PrintStats(const char* key) {
@@ -1035,7 +2098,7 @@ class Benchmark {
     if (!db_->GetProperty(key, &stats)) {
       stats = "(failed)";
     }
-    std::fprintf(stdout, "\n%s\n", stats.c_str());
+    std::fprintf(g_text_out, "\n%s\n", stats.c_str());
   }
 
   static void WriteToFile(void* arg, const char* buf, int n) {
@@ -1084,6 +2147,9 @@ int main(int argc, char** argv) {
     } else if (sscanf(argv[i], "--comparisons=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_comparisons = n;
+    } else if (sscanf(argv[i], "--statistics=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_statistics = n;
     } else if (sscanf(argv[i], "--use_existing_db=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_use_existing_db = n;
@@ -1093,6 +2159,72 @@ int main(int argc, char** argv) {
     } else if (sscanf(argv[i], "--compression=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_compression = n;
+    } else if (sscanf(argv[i], "--compression_threads=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_compression_threads = n;
+    } else if (sscanf(argv[i], "--table_preload_threads=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_table_preload_threads = n;
+    } else if (sscanf(argv[i], "--blob_value_threshold=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_blob_value_threshold = n;
+    } else if (sscanf(argv[i], "--compaction_priority=%d%c", &n, &junk) ==
+                   1 &&
+               (n >= 0 && n <= 2)) {
+      FLAGS_compaction_priority = n;
+    } else if (sscanf(argv[i], "--dynamic_level_bytes=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_dynamic_level_bytes = n;
+    } else if (sscanf(argv[i], "--compaction_style=%d%c", &n, &junk) == 1 &&
+               (n >= 0 && n <= 2)) {
+      FLAGS_compaction_style = n;
+    } else if (leveldb::Slice(argv[i]).starts_with("--value_size_dist=")) {
+      FLAGS_value_size_dist = argv[i] + strlen("--value_size_dist=");
+    } else if (sscanf(argv[i], "--value_size_min=%d%c", &n, &junk) == 1) {
+      FLAGS_value_size_min = n;
+    } else if (sscanf(argv[i], "--value_size_max=%d%c", &n, &junk) == 1) {
+      FLAGS_value_size_max = n;
+    } else if (leveldb::Slice(argv[i]).starts_with("--key_dist=")) {
+      FLAGS_key_dist = argv[i] + strlen("--key_dist=");
+    } else if (sscanf(argv[i], "--zipfian_constant=%lf%c", &d, &junk) == 1 &&
+               d > 0 && d < 1) {
+      FLAGS_zipfian_constant = d;
+    } else if (sscanf(argv[i], "--hotspot_set_fraction=%lf%c", &d, &junk) ==
+                   1 &&
+               d > 0 && d <= 1) {
+      FLAGS_hotspot_set_fraction = d;
+    } else if (sscanf(argv[i], "--hotspot_op_fraction=%lf%c", &d, &junk) ==
+                   1 &&
+               d >= 0 && d <= 1) {
+      FLAGS_hotspot_op_fraction = d;
+    } else if (sscanf(argv[i], "--read_percent=%d%c", &n, &junk) == 1) {
+      FLAGS_read_percent = n;
+    } else if (sscanf(argv[i], "--update_percent=%d%c", &n, &junk) == 1) {
+      FLAGS_update_percent = n;
+    } else if (sscanf(argv[i], "--insert_percent=%d%c", &n, &junk) == 1) {
+      FLAGS_insert_percent = n;
+    } else if (sscanf(argv[i], "--scan_percent=%d%c", &n, &junk) == 1) {
+      FLAGS_scan_percent = n;
+    } else if (sscanf(argv[i], "--rmw_percent=%d%c", &n, &junk) == 1) {
+      FLAGS_rmw_percent = n;
+    } else if (sscanf(argv[i], "--scan_length=%d%c", &n, &junk) == 1 &&
+               n > 0) {
+      FLAGS_scan_length = n;
+    } else if (leveldb::Slice(argv[i]).starts_with("--output_format=")) {
+      FLAGS_output_format = argv[i] + strlen("--output_format=");
+    } else if (strncmp(argv[i], "--trace_file=", 13) == 0) {
+      FLAGS_trace_file = argv[i] + 13;
+    } else if (strncmp(argv[i], "--replay_file=", 14) == 0) {
+      FLAGS_replay_file = argv[i] + 14;
+    } else if (sscanf(argv[i], "--replay_speed=%lf%c", &d, &junk) == 1 &&
+               d >= 0) {
+      FLAGS_replay_speed = d;
+    } else if (strncmp(argv[i], "--output_file=", 14) == 0) {
+      FLAGS_output_file = argv[i] + 14;
+    } else if (sscanf(argv[i], "--duration=%d%c", &n, &junk) == 1) {
+      FLAGS_duration = n;
+    } else if (sscanf(argv[i], "--report_interval=%d%c", &n, &junk) == 1) {
+      FLAGS_report_interval = n;
     } else if (sscanf(argv[i], "--num=%d%c", &n, &junk) == 1) {
       FLAGS_num = n;
     } else if (sscanf(argv[i], "--reads=%d%c", &n, &junk) == 1) {
@@ -1123,6 +2255,45 @@ int main(int argc, char** argv) {
     }
   }
 
+  if (!leveldb::ParseOutputFormat(FLAGS_output_format,
+                                  &leveldb::g_output_format)) {
+    std::fprintf(stderr, "Invalid --output_format '%s'\n",
+                 FLAGS_output_format);
+    std::exit(1);
+  }
+  if (leveldb::g_output_format != leveldb::kTextOutput &&
+      FLAGS_output_file == nullptr) {
+    // Keep stdout parseable.
+    leveldb::g_text_out = stderr;
+  }
+  if (!leveldb::ParseValueSizeDistribution(FLAGS_value_size_dist,
+                                           &leveldb::g_value_size_dist)) {
+    std::fprintf(stderr, "Invalid --value_size_dist '%s'\n",
+                 FLAGS_value_size_dist);
+    std::exit(1);
+  }
+  if (FLAGS_value_size_min < 0 || FLAGS_value_size_min > FLAGS_value_size_max ||
+      FLAGS_value_size_max >= 1048576) {
+    std::fprintf(stderr,
+                 "--value_size_min and --value_size_max must satisfy "
+                 "0 <= min <= max < 1048576\n");
+    std::exit(1);
+  }
+  if (FLAGS_key_dist[0] != '\0' &&
+      !leveldb::ParseKeyDistribution(FLAGS_key_dist, &leveldb::g_key_dist)) {
+    std::fprintf(stderr, "Invalid --key_dist '%s'\n", FLAGS_key_dist);
+    std::exit(1);
+  }
+  if (FLAGS_read_percent < 0 || FLAGS_update_percent < 0 ||
+      FLAGS_insert_percent < 0 || FLAGS_scan_percent < 0 ||
+      FLAGS_rmw_percent < 0 ||
+      FLAGS_read_percent + FLAGS_update_percent + FLAGS_insert_percent +
+              FLAGS_scan_percent + FLAGS_rmw_percent !=
+          100) {
+    std::fprintf(stderr, "The --*_percent flags must add up to 100\n");
+    std::exit(1);
+  }
+
   leveldb::g_env = leveldb::Env::Default();
 
   // Choose a location for the test database if none given with --db=<path>
@@ -0,0 +1,476 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Microbenchmarks for the data structures on the read and write paths.
+// Run with --benchmark_filter=<regex> to pick a subset.
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "db/skiplist.h"
+#include "leveldb/cache.h"
+#include "leveldb/comparator.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "table/block.h"
+#include "table/block_builder.h"
+#include "table/format.h"
+#include "table/merger.h"
+#include "util/arena.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+namespace {
+
+std::string MakeKey(uint64_t num) {
+  char buf[30];
+  std::snprintf(buf, sizeof(buf), "%016llu",
+                static_cast<unsigned long long>(num));
+  return std::string(buf);
+}
+
+// Keys first, first + step, first + 2*step, ... in sorted order.
+std::vector<std::string> SortedKeys(int n, int first = 0, int step = 1) {
+  std::vector<std::string> keys;
+  keys.reserve(n);
+  for (int i = 0; i < n; i++) {
+    keys.push_back(MakeKey(first + static_cast<uint64_t>(i) * step));
+  }
+  return keys;
+}
+
+// SkipList
+
+typedef uint64_t SkipListKey;
+
+struct SkipListComparator {
+  int operator()(const SkipListKey& a, const SkipListKey& b) const {
+    if (a < b) {
+      return -1;
+    } else if (a > b) {
+      return +1;
+    } else {
+      return 0;
+    }
+  }
+};
+
+typedef SkipList<SkipListKey, SkipListComparator> BenchSkipList;
+
+std::vector<SkipListKey> RandomSkipListKeys(int n) {
+  Random rnd(301);
+  std::vector<SkipListKey> keys(n);
+  for (int i = 0; i < n; i++) {
+    keys[i] = (static_cast<uint64_t>(rnd.Next()) << 32) | i;
+  }
+  return keys;
+}
+
+// Builds a list of range(0) random keys per iteration.
+void BM_SkipListInsert(benchmark::State& state) {
+  const std::vector<SkipListKey> keys = RandomSkipListKeys(state.range(0));
+  for (auto _ : state) {
+    Arena arena;
+    BenchSkipList list(SkipListComparator(), &arena);
+    for (SkipListKey key : keys) {
+      list.Insert(key);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_SkipListInsert)->Arg(1000)->Arg(100000);
+
+void BM_SkipListSeek(benchmark::State& state) {
+  const std::vector<SkipListKey> keys = RandomSkipListKeys(state.range(0));
+  Arena arena;
+  BenchSkipList list(SkipListComparator(), &arena);
+  for (SkipListKey key : keys) {
+    list.Insert(key);
+  }
+  BenchSkipList::Iterator iter(&list);
+  Random rnd(42);
+  for (auto _ : state) {
+    iter.Seek(keys[rnd.Uniform(keys.size())]);
+    SkipListKey key = iter.key();
+    benchmark::DoNotOptimize(key);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SkipListSeek)->Arg(1000)->Arg(100000)->Arg(1000000);
+
+// Arena
+
+// Allocations of range(0) bytes, in a fresh arena every 4096 of them.
+void BM_ArenaAllocate(benchmark::State& state) {
+  const size_t bytes = state.range(0);
+  Arena* arena = new Arena;
+  int allocated = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(arena->Allocate(bytes));
+    if (++allocated == 4096) {
+      delete arena;
+      arena = new Arena;
+      allocated = 0;
+    }
+  }
+  delete arena;
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ArenaAllocate)->Arg(16)->Arg(100)->Arg(1000)->Arg(5000);
+
+void BM_ArenaAllocateAligned(benchmark::State& state) {
+  const size_t bytes = state.range(0);
+  Arena* arena = new Arena;
+  int allocated = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(arena->AllocateAligned(bytes));
+    if (++allocated == 4096) {
+      delete arena;
+      arena = new Arena;
+      allocated = 0;
+    }
+  }
+  delete arena;
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ArenaAllocateAligned)->Arg(13)->Arg(100)->Arg(1000);
+
+// Block and BlockBuilder
+
+const int kValueSize = 100;
+
+// A block of the sorted "keys" with 100 byte values, as written to a table.
+class BenchBlock {
+ public:
+  explicit BenchBlock(const std::vector<std::string>& keys) : keys_(keys) {
+    options_.block_restart_interval = 16;
+    BlockBuilder builder(&options_);
+    const std::string value(kValueSize, 'x');
+    for (const std::string& key : keys_) {
+      builder.Add(key, value);
+    }
+    data_ = builder.Finish().ToString();
+    BlockContents contents;
+    contents.data = data_;
+    contents.cachable = false;
+    contents.heap_allocated = false;
+    block_ = new Block(contents);
+  }
+
+  BenchBlock(const BenchBlock&) = delete;
+  BenchBlock& operator=(const BenchBlock&) = delete;
+
+  ~BenchBlock() { delete block_; }
+
+  const std::vector<std::string>& keys() const { return keys_; }
+
+  Iterator* NewIterator() const {
+    return block_->NewIterator(BytewiseComparator());
+  }
+
+ private:
+  Options options_;
+  std::vector<std::string> keys_;
+  std::string data_;
+  Block* block_;
+};
+
+void BM_BlockBuilderAdd(benchmark::State& state) {
+  const std::vector<std::string> keys = SortedKeys(100000);
+  const std::string value(kValueSize, 'x');
+  Options options;
+  BlockBuilder builder(&options);
+  size_t i = 0;
+  for (auto _ : state) {
+    builder.Add(keys[i], value);
+    // Start a new block at the default block size, as TableBuilder does.
+    if (builder.CurrentSizeEstimate() >= options.block_size) {
+      benchmark::DoNotOptimize(builder.Finish());
+      builder.Reset();
+    }
+    if (++i == keys.size()) {
+      benchmark::DoNotOptimize(builder.Finish());
+      builder.Reset();
+      i = 0;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BlockBuilderAdd);
+
+void BM_BlockIterSeek(benchmark::State& state) {
+  BenchBlock block(SortedKeys(state.range(0)));
+  Iterator* iter = block.NewIterator();
+  Random rnd(42);
+  for (auto _ : state) {
+    iter->Seek(block.keys()[rnd.Uniform(block.keys().size())]);
+    benchmark::DoNotOptimize(iter->value());
+  }
+  delete iter;
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BlockIterSeek)->Arg(32)->Arg(256)->Arg(4096);
+
+void BM_BlockIterScan(benchmark::State& state) {
+  BenchBlock block(SortedKeys(state.range(0)));
+  Iterator* iter = block.NewIterator();
+  for (auto _ : state) {
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      benchmark::DoNotOptimize(iter->value());
+    }
+  }
+  delete iter;
+  state.SetItemsProcessed(state.iterations() * block.keys().size());
+}
+BENCHMARK(BM_BlockIterScan)->Arg(32)->Arg(256)->Arg(4096);
+
+// Bloom filter
+
+void BM_BloomFilterBuild(benchmark::State& state) {
+  const FilterPolicy* policy = NewBloomFilterPolicy(10);
+  const std::vector<std::string> keys = SortedKeys(state.range(0));
+  const std::vector<Slice> slices(keys.begin(), keys.end());
+  std::string filter;
+  for (auto _ : state) {
+    filter.clear();
+    policy->CreateFilter(slices.data(), slices.size(), &filter);
+    benchmark::DoNotOptimize(filter.data());
+  }
+  delete policy;
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_BloomFilterBuild)->Arg(100)->Arg(10000);
+
+// Probes alternate between keys in the filter and keys that are not.
+void BM_BloomFilterProbe(benchmark::State& state) {
+  const FilterPolicy* policy = NewBloomFilterPolicy(10);
+  const int n = state.range(0);
+  const std::vector<std::string> keys = SortedKeys(2 * n);
+  std::vector<Slice> present;
+  for (int i = 0; i < 2 * n; i += 2) {
+    present.push_back(keys[i]);
+  }
+  std::string filter;
+  policy->CreateFilter(present.data(), present.size(), &filter);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(policy->KeyMayMatch(keys[i], filter));
+    if (++i == keys.size()) {
+      i = 0;
+    }
+  }
+  delete policy;
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BloomFilterProbe)->Arg(100)->Arg(10000);
+
+// crc32c
+
+void BM_Crc32cExtend(benchmark::State& state) {
+  const std::string data(state.range(0), 'x');
+  uint32_t crc = 0;
+  for (auto _ : state) {
+    crc = crc32c::Extend(crc, data.data(), data.size());
+    benchmark::DoNotOptimize(crc);
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Crc32cExtend)->Arg(64)->Arg(4096)->Arg(65536);
+
+// Varint coding
+
+// Values with 1 to 10 byte encodings, cycled through by the benchmarks.
+std::vector<uint64_t> VarintValues() {
+  std::vector<uint64_t> values;
+  Random rnd(301);
+  for (int i = 0; i < 1024; i++) {
+    const int bits = rnd.Uniform(64) + 1;
+    const uint64_t value = (static_cast<uint64_t>(rnd.Next()) << 32) |
+                           rnd.Next();
+    values.push_back(bits == 64 ? value : value & ((uint64_t{1} << bits) - 1));
+  }
+  return values;
+}
+
+void BM_EncodeVarint32(benchmark::State& state) {
+  const std::vector<uint64_t> values = VarintValues();
+  char buf[5];
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        EncodeVarint32(buf, static_cast<uint32_t>(values[i])));
+    i = (i + 1) % values.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EncodeVarint32);
+
+void BM_EncodeVarint64(benchmark::State& state) {
+  const std::vector<uint64_t> values = VarintValues();
+  char buf[10];
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(EncodeVarint64(buf, values[i]));
+    i = (i + 1) % values.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EncodeVarint64);
+
+// Decodes a buffer of varints end to end per iteration.
+void BM_GetVarint32(benchmark::State& state) {
+  std::string encoded;
+  for (uint64_t value : VarintValues()) {
+    PutVarint32(&encoded, static_cast<uint32_t>(value));
+  }
+  size_t count = 0;
+  for (auto _ : state) {
+    Slice input(encoded);
+    uint32_t value;
+    count = 0;
+    while (GetVarint32(&input, &value)) {
+      benchmark::DoNotOptimize(value);
+      count++;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_GetVarint32);
+
+void BM_GetVarint64(benchmark::State& state) {
+  std::string encoded;
+  for (uint64_t value : VarintValues()) {
+    PutVarint64(&encoded, value);
+  }
+  size_t count = 0;
+  for (auto _ : state) {
+    Slice input(encoded);
+    uint64_t value;
+    count = 0;
+    while (GetVarint64(&input, &value)) {
+      benchmark::DoNotOptimize(value);
+      count++;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_GetVarint64);
+
+// ShardedLRUCache
+
+const int kCacheEntries = 10000;
+
+Cache* bench_cache = nullptr;
+
+void DeleteNothing(const Slice& /*key*/, void* /*value*/) {}
+
+// Lookups of resident entries from all threads at once, so that the shard
+// mutexes are contended as they are by concurrent readers of a table.
+void BM_CacheLookup(benchmark::State& state) {
+  if (state.thread_index() == 0) {
+    // Leave room for the entries to spread unevenly over the shards.
+    bench_cache = NewLRUCache(4 * kCacheEntries);
+    for (int i = 0; i < kCacheEntries; i++) {
+      bench_cache->Release(
+          bench_cache->Insert(MakeKey(i), nullptr, 1, &DeleteNothing));
+    }
+  }
+  Random rnd(1000 + state.thread_index());
+  std::vector<std::string> keys;
+  for (int i = 0; i < 1024; i++) {
+    keys.push_back(MakeKey(rnd.Uniform(kCacheEntries)));
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    Cache::Handle* handle = bench_cache->Lookup(keys[i]);
+    if (handle != nullptr) {
+      bench_cache->Release(handle);
+    }
+    i = (i + 1) % keys.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.thread_index() == 0) {
+    delete bench_cache;
+    bench_cache = nullptr;
+  }
+}
+BENCHMARK(BM_CacheLookup)->ThreadRange(1, 16)->UseRealTime();
+
+// MergingIterator
+
+const int kMergeEntriesPerChild = 256;
+
+// range(0) children whose keys interleave, as do those of the tables in
+// level 0.
+class MergeInput {
+ public:
+  explicit MergeInput(int n) {
+    for (int i = 0; i < n; i++) {
+      blocks_.push_back(
+          new BenchBlock(SortedKeys(kMergeEntriesPerChild, i, n)));
+    }
+  }
+
+  MergeInput(const MergeInput&) = delete;
+  MergeInput& operator=(const MergeInput&) = delete;
+
+  ~MergeInput() {
+    for (BenchBlock* block : blocks_) {
+      delete block;
+    }
+  }
+
+  int size() const { return blocks_.size() * kMergeEntriesPerChild; }
+
+  Iterator* NewIterator() const {
+    std::vector<Iterator*> children;
+    for (BenchBlock* block : blocks_) {
+      children.push_back(block->NewIterator());
+    }
+    return NewMergingIterator(BytewiseComparator(), children.data(),
+                              children.size());
+  }
+
+ private:
+  std::vector<BenchBlock*> blocks_;
+};
+
+void BM_MergingIteratorSeek(benchmark::State& state) {
+  MergeInput input(state.range(0));
+  Iterator* iter = input.NewIterator();
+  Random rnd(42);
+  for (auto _ : state) {
+    iter->Seek(MakeKey(rnd.Uniform(input.size())));
+    benchmark::DoNotOptimize(iter->value());
+  }
+  delete iter;
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MergingIteratorSeek)->RangeMultiplier(4)->Range(1, 64);
+
+void BM_MergingIteratorScan(benchmark::State& state) {
+  MergeInput input(state.range(0));
+  Iterator* iter = input.NewIterator();
+  for (auto _ : state) {
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      benchmark::DoNotOptimize(iter->value());
+    }
+  }
+  delete iter;
+  state.SetItemsProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_MergingIteratorScan)->RangeMultiplier(4)->Range(1, 64);
+
+}  // namespace
+
+}  // namespace leveldb
+
+BENCHMARK_MAIN();
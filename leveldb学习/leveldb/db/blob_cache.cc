@@ -0,0 +1,126 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/blob_cache.h"
+
+#include "db/filename.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+
+struct BlobFileAndSize {
+  RandomAccessFile* file;
+  uint64_t file_size;
+};
+
+static void DeleteEntry(const Slice& /*key*/, void* value) {
+  BlobFileAndSize* bf = reinterpret_cast<BlobFileAndSize*>(value);
+  delete bf->file;
+  delete bf;
+}
+
+BlobCache::BlobCache(const std::string& dbname, const Options& options,
+                     int entries)
+    : env_(options.env), dbname_(dbname), cache_(NewLRUCache(entries)) {}
+
+BlobCache::~BlobCache() { delete cache_; }
+
+Status BlobCache::FindFile(uint64_t file_number, Cache::Handle** handle) {
+  Status s;
+  char buf[sizeof(file_number)];
+  EncodeFixed64(buf, file_number);
+  Slice key(buf, sizeof(buf));
+  *handle = cache_->Lookup(key);
+  if (*handle == nullptr) {
+    const std::string fname = BlobFileName(dbname_, file_number);
+    uint64_t file_size = 0;
+    RandomAccessFile* file = nullptr;
+    s = env_->GetFileSize(fname, &file_size);
+    if (s.ok()) {
+      s = env_->NewRandomAccessFile(fname, &file);
+    }
+    if (s.ok()) {
+      BlobFileAndSize* bf = new BlobFileAndSize;
+      bf->file = file;
+      bf->file_size = file_size;
+      *handle = cache_->Insert(key, bf, 1, &DeleteEntry);
+    }
+    // We do not cache error results so that if the error is transient,
+    // or somebody repairs the file, we recover automatically.
+  }
+  return s;
+}
+
+Status BlobCache::Get(const ReadOptions& options, const BlobIndex& index,
+                      std::string* value) {
+  if (index.offset < kBlobRecordHeaderSize) {
+    return Status::Corruption("bad blob index");
+  }
+  Cache::Handle* handle = nullptr;
+  Status s = FindFile(index.file_number, &handle);
+  if (!s.ok()) {
+    return s;
+  }
+  const BlobFileAndSize* bf =
+      reinterpret_cast<BlobFileAndSize*>(cache_->Value(handle));
+  // Check the index before allocating room for the value, so that a
+  // corrupt size does not lead to a huge allocation.
+  if (index.size > bf->file_size ||
+      index.offset > bf->file_size - index.size) {
+    cache_->Release(handle);
+    return Status::Corruption("blob index past end of file");
+  }
+
+  // Read the record header along with the value, using *value as the
+  // scratch buffer.
+  const size_t n = static_cast<size_t>(index.size) + kBlobRecordHeaderSize;
+  value->resize(n);
+  Slice contents;
+  s = bf->file->Read(index.offset - kBlobRecordHeaderSize, n, &contents,
+                 &(*value)[0]);
+  cache_->Release(handle);
+  if (s.ok() && contents.size() != n) {
+    s = Status::Corruption("truncated blob read");
+  }
+  if (s.ok() && options.verify_checksums) {
+    const uint32_t crc = crc32c::Unmask(DecodeFixed32(contents.data()));
+    const uint32_t actual =
+        crc32c::Value(contents.data() + kBlobRecordHeaderSize, index.size);
+    if (actual != crc) {
+      s = Status::Corruption("blob checksum mismatch");
+    }
+  }
+  if (!s.ok()) {
+    value->clear();
+    return s;
+  }
+
+  if (contents.data() != value->data()) {
+    // File implementation gave us a pointer to some other data.
+    value->assign(contents.data() + kBlobRecordHeaderSize, index.size);
+  } else {
+    value->erase(0, kBlobRecordHeaderSize);
+  }
+  return s;
+}
+
+Status BlobCache::Get(const ReadOptions& options, const Slice& encoded_index,
+                      std::string* value) {
+  BlobIndex index;
+  Slice input = encoded_index;
+  if (!index.DecodeFrom(&input)) {
+    return Status::Corruption("bad blob index");
+  }
+  return Get(options, index, value);
+}
+
+void BlobCache::Evict(uint64_t file_number) {
+  char buf[sizeof(file_number)];
+  EncodeFixed64(buf, file_number);
+  cache_->Erase(Slice(buf, sizeof(buf)));
+}
+
+}  // namespace leveldb
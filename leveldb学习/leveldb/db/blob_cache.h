@@ -0,0 +1,53 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Thread-safe (provides internal synchronization)
+
+#ifndef STORAGE_LEVELDB_DB_BLOB_CACHE_H_
+#define STORAGE_LEVELDB_DB_BLOB_CACHE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "db/blob_file.h"
+#include "leveldb/cache.h"
+#include "leveldb/options.h"
+
+namespace leveldb {
+
+class Env;
+
+// Keeps recently used blob files open for reading values out of them.
+class BlobCache {
+ public:
+  BlobCache(const std::string& dbname, const Options& options, int entries);
+
+  BlobCache(const BlobCache&) = delete;
+  BlobCache& operator=(const BlobCache&) = delete;
+
+  ~BlobCache();
+
+  // Store the value located by "index" in *value.
+  Status Get(const ReadOptions& options, const BlobIndex& index,
+             std::string* value);
+
+  // Like Get(), for an index in the encoded form stored in tables.
+  // "encoded_index" may point into *value.
+  Status Get(const ReadOptions& options, const Slice& encoded_index,
+             std::string* value);
+
+  // Evict any entry for the specified file number
+  void Evict(uint64_t file_number);
+
+ private:
+  Status FindFile(uint64_t file_number, Cache::Handle**);
+
+  Env* const env_;
+  const std::string dbname_;
+  Cache* cache_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_BLOB_CACHE_H_
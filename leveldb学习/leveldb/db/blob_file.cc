@@ -0,0 +1,56 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/blob_file.h"
+
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+
+void BlobIndex::EncodeTo(std::string* dst) const {
+  PutVarint64(dst, file_number);
+  PutVarint64(dst, offset);
+  PutVarint64(dst, size);
+}
+
+bool BlobIndex::DecodeFrom(Slice* input) {
+  return GetVarint64(input, &file_number) && GetVarint64(input, &offset) &&
+         GetVarint64(input, &size) && file_number != 0;
+}
+
+BlobFileBuilder::BlobFileBuilder(WritableFile* file, uint64_t file_number)
+    : file_(file),
+      file_number_(file_number),
+      offset_(0),
+      num_entries_(0),
+      value_bytes_(0) {}
+
+void BlobFileBuilder::Add(const Slice& value, BlobIndex* index) {
+  char header[kBlobRecordHeaderSize];
+  EncodeFixed32(header,
+                crc32c::Mask(crc32c::Value(value.data(), value.size())));
+  if (status_.ok()) {
+    status_ = file_->Append(Slice(header, sizeof(header)));
+  }
+  if (status_.ok()) {
+    status_ = file_->Append(value);
+  }
+  index->file_number = file_number_;
+  index->offset = offset_ + kBlobRecordHeaderSize;
+  index->size = value.size();
+  offset_ += kBlobRecordHeaderSize + value.size();
+  num_entries_++;
+  value_bytes_ += value.size();
+}
+
+Status BlobFileBuilder::Finish() {
+  if (status_.ok()) {
+    status_ = file_->Flush();
+  }
+  return status_;
+}
+
+}  // namespace leveldb
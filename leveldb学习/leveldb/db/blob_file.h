@@ -0,0 +1,82 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Large values may be separated from their keys and stored in blob files
+// (see Options::blob_value_threshold).  A blob file is an append-only
+// sequence of records, one per value:
+//
+//    checksum: fixed32      // Masked crc32c of the value
+//    value:    char[size]
+//
+// The table entry for such a value has type kTypeBlobIndex and holds an
+// encoded BlobIndex that points at the value bytes of its record.
+
+#ifndef STORAGE_LEVELDB_DB_BLOB_FILE_H_
+#define STORAGE_LEVELDB_DB_BLOB_FILE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class WritableFile;
+
+// Size of the checksum that precedes every value in a blob file.
+static const size_t kBlobRecordHeaderSize = 4;
+
+// Location of a value in a blob file.
+struct BlobIndex {
+  BlobIndex() : file_number(0), offset(0), size(0) {}
+
+  void EncodeTo(std::string* dst) const;
+  bool DecodeFrom(Slice* input);
+
+  uint64_t file_number;
+  uint64_t offset;  // Offset of the value (past the record header)
+  uint64_t size;    // Size of the value
+};
+
+// BlobFileBuilder appends values to a blob file.  Like TableBuilder it
+// does not sync or close the file; that is up to the caller.
+class BlobFileBuilder {
+ public:
+  BlobFileBuilder(WritableFile* file, uint64_t file_number);
+
+  BlobFileBuilder(const BlobFileBuilder&) = delete;
+  BlobFileBuilder& operator=(const BlobFileBuilder&) = delete;
+
+  // Append "value" to the file and store its location in *index.
+  // REQUIRES: Finish() has not been called
+  void Add(const Slice& value, BlobIndex* index);
+
+  // Return non-ok iff some error has been detected.
+  Status status() const { return status_; }
+
+  // Flush buffered data to the file.
+  Status Finish();
+
+  // Number of calls to Add() so far.
+  uint64_t NumEntries() const { return num_entries_; }
+
+  // Total size of the values added so far, excluding record headers.
+  uint64_t ValueBytes() const { return value_bytes_; }
+
+  // Size of the file generated so far.
+  uint64_t FileSize() const { return offset_; }
+
+ private:
+  WritableFile* const file_;
+  const uint64_t file_number_;
+  uint64_t offset_;
+  uint64_t num_entries_;
+  uint64_t value_bytes_;
+  Status status_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_BLOB_FILE_H_
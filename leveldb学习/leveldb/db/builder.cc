@@ -4,8 +4,10 @@
 
 #include "db/builder.h"
 
+#include "db/blob_file.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "leveldb/db.h"
@@ -14,14 +16,79 @@
 
 namespace leveldb {
 
+TableStatsCollector::TableStatsCollector(const Options& options)
+    : trigger_(options.deletion_compaction_window > 0
+                   ? options.deletion_compaction_trigger
+                   : 0),
+      num_entries_(0),
+      num_deletions_(0),
+      largest_seqno_(0),
+      marked_(false),
+      window_(trigger_ > 0 ? options.deletion_compaction_window : 0, false),
+      window_pos_(0),
+      window_deletions_(0) {}
+
+void TableStatsCollector::Add(const Slice& key) {
+  ParsedInternalKey ikey;
+  const bool valid = ParseInternalKey(key, &ikey);
+  const bool deletion = valid && ikey.type == kTypeDeletion;
+  num_entries_++;
+  if (valid && ikey.sequence > largest_seqno_) {
+    largest_seqno_ = ikey.sequence;
+  }
+  if (deletion) {
+    num_deletions_++;
+  }
+  if (window_.empty()) {
+    return;
+  }
+  if (window_[window_pos_]) {
+    window_deletions_--;
+  }
+  window_[window_pos_] = deletion;
+  if (deletion) {
+    window_deletions_++;
+  }
+  window_pos_ = (window_pos_ + 1) % window_.size();
+  if (window_deletions_ >= trigger_) {
+    marked_ = true;
+  }
+}
+
+void TableStatsCollector::Reset() {
+  num_entries_ = 0;
+  num_deletions_ = 0;
+  largest_seqno_ = 0;
+  marked_ = false;
+  window_.assign(window_.size(), false);
+  window_pos_ = 0;
+  window_deletions_ = 0;
+}
+
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta) {
+                  TableCache* table_cache, Iterator* iter,
+                  Iterator* range_del_iter, FileMetaData* meta,
+                  BlobFileMetaData* blob) {
   Status s;
   meta->file_size = 0;
+  meta->has_range_tombstones = false;
+  const bool separate_values =
+      (blob != nullptr && options.blob_value_threshold > 0);
+  if (blob != nullptr) {
+    blob->total_bytes = 0;
+  }
   iter->SeekToFirst();
+  if (range_del_iter != nullptr) {
+    range_del_iter->SeekToFirst();
+  }
+  const bool has_range_tombstones =
+      (range_del_iter != nullptr && range_del_iter->Valid());
 
   std::string fname = TableFileName(dbname, meta->number);
-  if (iter->Valid()) {
+  WritableFile* blob_file = nullptr;
+  BlobFileBuilder* blob_builder = nullptr;
+  bool blob_file_created = false;
+  if (iter->Valid() || has_range_tombstones) {
     WritableFile* file;
     s = env->NewWritableFile(fname, &file);
     if (!s.ok()) {
@@ -29,18 +96,67 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
     }
 
     TableBuilder* builder = new TableBuilder(options, file);
-    meta->smallest.DecodeFrom(iter->key());
+    TableStatsCollector stats(options);
+    std::string blob_key, blob_index;
     Slice key;
     for (; iter->Valid(); iter->Next()) {
       key = iter->key();
-      builder->Add(key, iter->value());
+      Slice value = iter->value();
+      ParsedInternalKey ikey;
+      if (separate_values && value.size() >= options.blob_value_threshold &&
+          ParseInternalKey(key, &ikey) && ikey.type == kTypeValue) {
+        if (blob_builder == nullptr) {
+          s = env->NewWritableFile(BlobFileName(dbname, blob->number),
+                                   &blob_file);
+          if (!s.ok()) {
+            break;
+          }
+          blob_file_created = true;
+          blob_builder = new BlobFileBuilder(blob_file, blob->number);
+        }
+        BlobIndex index;
+        blob_builder->Add(value, &index);
+        blob_index.clear();
+        index.EncodeTo(&blob_index);
+        blob_key.clear();
+        AppendInternalKey(&blob_key, ParsedInternalKey(ikey.user_key,
+                                                       ikey.sequence,
+                                                       kTypeBlobIndex));
+        key = blob_key;
+        value = blob_index;
+      }
+      if (builder->NumEntries() == 0) {
+        meta->smallest.DecodeFrom(key);
+      }
+      builder->Add(key, value);
+      stats.Add(key);
     }
+    meta->num_entries = stats.num_entries();
+    meta->num_deletions = stats.num_deletions();
+    meta->largest_seqno = stats.largest_seqno();
+    meta->marked_for_compaction = stats.marked_for_compaction();
     if (!key.empty()) {
       meta->largest.DecodeFrom(key);
     }
 
+    if (s.ok() && has_range_tombstones) {
+      for (; range_del_iter->Valid(); range_del_iter->Next()) {
+        ExtendRangeForTombstone(options.comparator, range_del_iter->key(),
+                                range_del_iter->value(),
+                                !meta->has_range_tombstones && key.empty(),
+                                &meta->smallest, &meta->largest);
+        builder->AddRangeTombstone(range_del_iter->key(),
+                                   range_del_iter->value());
+        meta->has_range_tombstones = true;
+      }
+    }
+
     // Finish and check for builder errors
-    s = builder->Finish();
+    if (s.ok()) {
+      s = builder->Finish();
+    } else {
+      builder->Abandon();
+    }
     if (s.ok()) {
       meta->file_size = builder->FileSize();
       assert(meta->file_size > 0);
@@ -57,10 +173,28 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
     delete file;
     file = nullptr;
 
+    if (blob_builder != nullptr) {
+      if (s.ok()) {
+        s = blob_builder->Finish();
+      }
+      if (s.ok()) {
+        s = blob_file->Sync();
+      }
+      if (s.ok()) {
+        s = blob_file->Close();
+      }
+      if (s.ok()) {
+        blob->total_bytes = blob_builder->ValueBytes();
+      }
+      delete blob_builder;
+      delete blob_file;
+    }
+
     if (s.ok()) {
       // Verify that the table is usable
       Iterator* it = table_cache->NewIterator(ReadOptions(), meta->number,
-                                              meta->file_size);
+                                              meta->file_size,
+                                              /*global_seqno=*/0);
       s = it->status();
       delete it;
     }
@@ -70,11 +204,18 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
   if (!iter->status().ok()) {
     s = iter->status();
   }
+  if (range_del_iter != nullptr && !range_del_iter->status().ok()) {
+    s = range_del_iter->status();
+  }
 
   if (s.ok() && meta->file_size > 0) {
     // Keep it
   } else {
     env->RemoveFile(fname);
+    if (blob_file_created) {
+      env->RemoveFile(BlobFileName(dbname, blob->number));
+      blob->total_bytes = 0;
+    }
   }
   return s;
 }
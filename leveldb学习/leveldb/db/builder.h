@@ -5,25 +5,75 @@
 #ifndef STORAGE_LEVELDB_DB_BUILDER_H_
 #define STORAGE_LEVELDB_DB_BUILDER_H_
 
+#include <cstdint>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "leveldb/slice.h"
 #include "leveldb/status.h"
 
 namespace leveldb {
 
 struct Options;
 struct FileMetaData;
+struct BlobFileMetaData;
 
 class Env;
 class Iterator;
 class TableCache;
 class VersionEdit;
 
-// Build a Table file from the contents of *iter.  The generated file
+// Build a Table file from the contents of *iter and the range tombstones
+// yielded by *range_del_iter, which may be null.  The generated file
 // will be named according to meta->number.  On success, the rest of
 // *meta will be filled with metadata about the generated table.
-// If no data is present in *iter, meta->file_size will be set to
-// zero, and no Table file will be produced.
+// If no data is present in either iterator, meta->file_size will be set
+// to zero, and no Table file will be produced.
+//
+// If "blob" is non-null and options.blob_value_threshold is non-zero,
+// values of at least that size are stored in the blob file named
+// according to blob->number instead of the table.  blob->total_bytes is
+// set to the size of the values stored there; if it is zero, no blob
+// file was produced.
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta);
+                  TableCache* table_cache, Iterator* iter,
+                  Iterator* range_del_iter, FileMetaData* meta,
+                  BlobFileMetaData* blob);
+
+// Gathers the entry and deletion counts of a table file from the internal
+// keys added to it, and decides whether the deletions are dense enough to
+// compact the file on its own (see Options::deletion_compaction_trigger).
+class TableStatsCollector {
+ public:
+  explicit TableStatsCollector(const Options& options);
+
+  TableStatsCollector(const TableStatsCollector&) = delete;
+  TableStatsCollector& operator=(const TableStatsCollector&) = delete;
+
+  // Count the entry with internal key "key".
+  void Add(const Slice& key);
+
+  // Forget the entries added so far, to start on a new file.
+  void Reset();
+
+  uint64_t num_entries() const { return num_entries_; }
+  uint64_t num_deletions() const { return num_deletions_; }
+  SequenceNumber largest_seqno() const { return largest_seqno_; }
+  bool marked_for_compaction() const { return marked_; }
+
+ private:
+  const int trigger_;
+  uint64_t num_entries_;
+  uint64_t num_deletions_;
+  SequenceNumber largest_seqno_;
+  bool marked_;
+
+  // Whether each of the last window_.size() entries was a deletion, as a
+  // ring buffer, and the number of deletions among them
+  std::vector<bool> window_;
+  size_t window_pos_;
+  int window_deletions_;
+};
 
 }  // namespace leveldb
 
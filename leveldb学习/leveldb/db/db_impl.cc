@@ -8,10 +8,13 @@
 #include <atomic>
 #include <cstdint>
 #include <cstdio>
+#include <map>
 #include <set>
 #include <string>
 #include <vector>
 
+#include "db/blob_cache.h"
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_iter.h"
 #include "db/dbformat.h"
@@ -19,21 +22,27 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/merge_operator.h"
 #include "leveldb/status.h"
 #include "leveldb/table.h"
 #include "leveldb/table_builder.h"
 #include "port/port.h"
+#include "port/probes.h"
 #include "table/block.h"
 #include "table/merger.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/perf_context_imp.h"
+#include "util/stop_watch.h"
 
 namespace leveldb {
 
@@ -57,16 +66,32 @@ struct DBImpl::CompactionState {
     uint64_t number;
     uint64_t file_size;
     InternalKey smallest, largest;
+    bool has_range_tombstones;
+    uint64_t num_entries;
+    uint64_t num_deletions;
+    SequenceNumber largest_seqno;
+    bool marked_for_compaction;
   };
 
   Output* current_output() { return &outputs[outputs.size() - 1]; }
 
-  explicit CompactionState(Compaction* c)
+  CompactionState(Compaction* c, const Options& options)
       : compaction(c),
         smallest_snapshot(0),
+        newest_snapshot(0),
         outfile(nullptr),
         builder(nullptr),
-        total_bytes(0) {}
+        total_bytes(0),
+        blob_number(0),
+        blob_outfile(nullptr),
+        blob_builder(nullptr),
+        blob_bytes(0),
+        covering_tombstones(nullptr),
+        table_stats(options),
+        has_output_lower_bound(false),
+        close_output(false) {}
+
+  ~CompactionState() { delete covering_tombstones; }
 
   Compaction* const compaction;
 
@@ -76,6 +101,10 @@ struct DBImpl::CompactionState {
   // we can drop all entries for the same key with sequence numbers < S.
   SequenceNumber smallest_snapshot;
 
+  // Entries with larger sequence numbers are invisible to every snapshot.
+  // Zero if there are no snapshots.
+  SequenceNumber newest_snapshot;
+
   std::vector<Output> outputs;
 
   // State kept for output being generated
@@ -83,6 +112,45 @@ struct DBImpl::CompactionState {
   TableBuilder* builder;
 
   uint64_t total_bytes;
+
+  // Blob file receiving the values that this compaction moves out of
+  // tables, opened on first use.  blob_bytes is the size of the values in
+  // it once it is finished.
+  uint64_t blob_number;
+  WritableFile* blob_outfile;
+  BlobFileBuilder* blob_builder;
+  uint64_t blob_bytes;
+
+  // Bytes of values in input blob files that this compaction dropped or
+  // copied elsewhere, by blob file number
+  std::map<uint64_t, uint64_t> blob_garbage;
+
+  // Backing store for entries rewritten by RelocateValue()
+  std::string relocated_key;
+  std::string relocated_value;
+  std::string blob_index;
+
+  // Backing store for entries rewritten by FilterValue()
+  std::string filter_input;
+  std::string filtered_key;
+  std::string filtered_value;
+
+  // Range tombstones of the inputs that the outputs keep, and those that
+  // every snapshot sees (null if none), which delete older entries.
+  std::vector<RangeTombstone> range_tombstones;
+  RangeTombstoneSet* covering_tombstones;
+
+  // Counts the entries of the current output
+  TableStatsCollector table_stats;
+
+  // User key at which the current output's share of the key space
+  // starts, if it is not the first output
+  bool has_output_lower_bound;
+  std::string output_lower_bound;
+
+  // Set once the current output is large enough; it is finished before
+  // the next user key so that no user key spans two outputs.
+  bool close_output;
 };
 
 // Fix user-supplied options to be reasonable
@@ -118,9 +186,19 @@ Options SanitizeOptions(const std::string& dbname,
   return result;
 }
 
+static int BlobCacheSize(const Options& sanitized_options) {
+  // Blob files are far fewer than tables and only opened to read
+  // separated values, so a small share of open files is enough.  Without
+  // blob_value_threshold only blob files written earlier are read.
+  const int files = sanitized_options.max_open_files - kNumNonTableCacheFiles;
+  return sanitized_options.blob_value_threshold > 0 ? files / 5 : 4;
+}
+
 static int TableCacheSize(const Options& sanitized_options) {
-  // Reserve ten files or so for other uses and give the rest to TableCache.
-  return sanitized_options.max_open_files - kNumNonTableCacheFiles;
+  // Reserve ten files or so for other uses and some for BlobCache, and
+  // give the rest to TableCache.
+  return sanitized_options.max_open_files - kNumNonTableCacheFiles -
+         BlobCacheSize(sanitized_options);
 }
 
 DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
@@ -133,6 +211,7 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       owns_cache_(options_.block_cache != raw_options.block_cache),
       dbname_(dbname),
       table_cache_(new TableCache(dbname_, options_, TableCacheSize(options_))),
+      blob_cache_(new BlobCache(dbname_, options_, BlobCacheSize(options_))),
       db_lock_(nullptr),
       shutting_down_(false),
       background_work_finished_signal_(&mutex_),
@@ -146,8 +225,24 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       tmp_batch_(new WriteBatch),
       background_compaction_scheduled_(false),
       manual_compaction_(nullptr),
+      ingestion_in_progress_(false),
       versions_(new VersionSet(dbname_, &options_, table_cache_,
-                               &internal_comparator_)) {}
+                               &internal_comparator_)),
+      user_bytes_written_(0),
+      write_stall_condition_(kWriteStallNormal),
+      tracing_(false),
+      trace_writer_(nullptr) {
+  const std::vector<CompressionType>& per_level =
+      options_.compression_per_level;
+  if (!per_level.empty()) {
+    for (int level = 0; level < config::kNumLevels; level++) {
+      const size_t index =
+          std::min(static_cast<size_t>(level), per_level.size() - 1);
+      level_table_options_.push_back(options_);
+      level_table_options_.back().compression = per_level[index];
+    }
+  }
+}
 
 DBImpl::~DBImpl() {
   // Wait for background work to finish.
@@ -158,6 +253,8 @@ DBImpl::~DBImpl() {
   }
   mutex_.Unlock();
 
+  EndTrace();
+
   if (db_lock_ != nullptr) {
     env_->UnlockFile(db_lock_);
   }
@@ -169,6 +266,7 @@ DBImpl::~DBImpl() {
   delete log_;
   delete logfile_;
   delete table_cache_;
+  delete blob_cache_;
 
   if (owns_info_log_) {
     delete options_.info_log;
@@ -178,9 +276,33 @@ DBImpl::~DBImpl() {
   }
 }
 
+template <typename Info>
+void DBImpl::NotifyListeners(void (EventListener::*callback)(DB*,
+                                                             const Info&),
+                             const Info& info) {
+  mutex_.AssertHeld();
+  if (options_.listeners.empty()) {
+    return;
+  }
+  mutex_.Unlock();
+  NotifyListenersUnlocked(callback, info);
+  mutex_.Lock();
+}
+
+template <typename Info>
+void DBImpl::NotifyListenersUnlocked(
+    void (EventListener::*callback)(DB*, const Info&), const Info& info) {
+  for (EventListener* listener : options_.listeners) {
+    (listener->*callback)(this, info);
+  }
+}
+
 Status DBImpl::NewDB() {
   VersionEdit new_db;
   new_db.SetComparatorName(user_comparator()->Name());
+  if (options_.compaction_style != kCompactionStyleLevel) {
+    new_db.SetCompactionStyle(options_.compaction_style);
+  }
   new_db.SetLogNumber(0);
   new_db.SetNextFile(2);
   new_db.SetLastSequence(0);
@@ -254,6 +376,7 @@ void DBImpl::RemoveObsoleteFiles() {
           keep = (number >= versions_->ManifestFileNumber());
           break;
         case kTableFile:
+        case kBlobFile:
           keep = (live.find(number) != live.end());
           break;
         case kTempFile:
@@ -272,6 +395,8 @@ void DBImpl::RemoveObsoleteFiles() {
         files_to_delete.push_back(std::move(filename));
         if (type == kTableFile) {
           table_cache_->Evict(number);
+        } else if (type == kBlobFile) {
+          blob_cache_->Evict(number);
         }
         Log(options_.info_log, "Delete type=%d #%lld\n", static_cast<int>(type),
             static_cast<unsigned long long>(number));
@@ -284,11 +409,41 @@ void DBImpl::RemoveObsoleteFiles() {
   // are therefore safe to delete while allowing other threads to proceed.
   mutex_.Unlock();
   for (const std::string& filename : files_to_delete) {
-    env_->RemoveFile(dbname_ + "/" + filename);
+    const std::string fname = dbname_ + "/" + filename;
+    Status s = env_->RemoveFile(fname);
+    if (!options_.listeners.empty() &&
+        ParseFileName(filename, &number, &type) && type == kTableFile) {
+      TableFileDeletionInfo info;
+      info.db_name = dbname_;
+      info.file_path = fname;
+      info.file_number = number;
+      info.status = s;
+      NotifyListenersUnlocked(&EventListener::OnTableFileDeleted, info);
+    }
   }
   mutex_.Lock();
 }
 
+Status DBImpl::PreloadTables() {
+  mutex_.Lock();
+  Version* v = versions_->current();
+  v->Ref();
+  mutex_.Unlock();
+
+  const uint64_t start_micros = env_->NowMicros();
+  Status s = v->PreloadTables(options_.table_preload_levels,
+                              TableCacheSize(options_),
+                              options_.table_preload_threads);
+  Log(options_.info_log, "Preloaded tables in %llu microseconds: %s",
+      static_cast<unsigned long long>(env_->NowMicros() - start_micros),
+      s.ToString().c_str());
+
+  mutex_.Lock();
+  v->Unref();
+  mutex_.Unlock();
+  return s;
+}
+
 Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
   mutex_.AssertHeld();
 
@@ -455,7 +610,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
       compactions++;
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
+      status = WriteLevel0Table(mem, edit, nullptr, nullptr);
       mem->Unref();
       mem = nullptr;
       if (!status.ok()) {
@@ -494,7 +649,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     // mem did not get reused; compact it.
     if (status.ok()) {
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
+      status = WriteLevel0Table(mem, edit, nullptr, nullptr);
     }
     mem->Unref();
   }
@@ -503,28 +658,55 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
 }
 
 Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
-                                Version* base) {
+                                Version* base, FlushJobInfo* info) {
   mutex_.AssertHeld();
   const uint64_t start_micros = env_->NowMicros();
   FileMetaData meta;
   meta.number = versions_->NewFileNumber();
   pending_outputs_.insert(meta.number);
+  BlobFileMetaData blob;
+  if (options_.blob_value_threshold > 0) {
+    blob.number = versions_->NewFileNumber();
+    pending_outputs_.insert(blob.number);
+  }
   Iterator* iter = mem->NewIterator();
+  Iterator* range_del_iter = mem->NewRangeTombstoneIterator();
   Log(options_.info_log, "Level-0 table #%llu: started",
       (unsigned long long)meta.number);
 
   Status s;
   {
     mutex_.Unlock();
-    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    s = BuildTable(dbname_, env_, TableOptionsForLevel(0),
+                   table_cache_, iter, range_del_iter, &meta,
+                   blob.number != 0 ? &blob : nullptr);
+    // An empty memtable leaves no file behind.
+    if (!s.ok() || meta.file_size > 0) {
+      TableFileCreationInfo created;
+      created.db_name = dbname_;
+      created.file_path = TableFileName(dbname_, meta.number);
+      created.file_number = meta.number;
+      created.file_size = meta.file_size;
+      created.reason =
+          (info != nullptr ? kTableFileFromFlush : kTableFileFromRecovery);
+      created.status = s;
+      NotifyListenersUnlocked(&EventListener::OnTableFileCreated, created);
+    }
     mutex_.Lock();
   }
 
   Log(options_.info_log, "Level-0 table #%llu: %lld bytes %s",
       (unsigned long long)meta.number, (unsigned long long)meta.file_size,
       s.ToString().c_str());
+  if (blob.total_bytes > 0) {
+    Log(options_.info_log, "Level-0 blob file #%llu: %lld bytes of values",
+        (unsigned long long)blob.number,
+        (unsigned long long)blob.total_bytes);
+  }
   delete iter;
+  delete range_del_iter;
   pending_outputs_.erase(meta.number);
+  pending_outputs_.erase(blob.number);
 
   // Note that if file_size is zero, the file has been deleted and
   // should not be added to the manifest.
@@ -535,14 +717,26 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
     if (base != nullptr) {
       level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
     }
-    edit->AddFile(level, meta.number, meta.file_size, meta.smallest,
-                  meta.largest);
+    edit->AddFile(level, meta);
+    if (blob.total_bytes > 0) {
+      edit->AddBlobFile(blob.number, blob.total_bytes);
+    }
   }
 
   CompactionStats stats;
   stats.micros = env_->NowMicros() - start_micros;
-  stats.bytes_written = meta.file_size;
+  stats.bytes_written = meta.file_size + blob.total_bytes;
   stats_[level].Add(stats);
+  if (info != nullptr && s.ok() && meta.file_size > 0) {
+    info->file_number = meta.number;
+    info->file_path = TableFileName(dbname_, meta.number);
+    info->level = level;
+    info->file_size = meta.file_size;
+  }
+  if (options_.statistics != nullptr) {
+    options_.statistics->MeasureTime(kFlushMicros, stats.micros);
+    RecordTick(options_.statistics, kFlushBytesWritten, stats.bytes_written);
+  }
   return s;
 }
 
@@ -550,11 +744,17 @@ void DBImpl::CompactMemTable() {
   mutex_.AssertHeld();
   assert(imm_ != nullptr);
 
+  FlushJobInfo info;
+  info.db_name = dbname_;
+  NotifyListeners(&EventListener::OnFlushBegin, info);
+  LEVELDB_PROBE1(flush_begin, imm_->ApproximateMemoryUsage());
+  const uint64_t start_micros = env_->NowMicros();
+
   // Save the contents of the memtable as a new Table
   VersionEdit edit;
   Version* base = versions_->current();
   base->Ref();
-  Status s = WriteLevel0Table(imm_, &edit, base);
+  Status s = WriteLevel0Table(imm_, &edit, base, &info);
   base->Unref();
 
   if (s.ok() && shutting_down_.load(std::memory_order_acquire)) {
@@ -577,6 +777,11 @@ void DBImpl::CompactMemTable() {
   } else {
     RecordBackgroundError(s);
   }
+
+  LEVELDB_PROBE1(flush_end, s.ok());
+  info.micros = env_->NowMicros() - start_micros;
+  info.status = s;
+  NotifyListeners(&EventListener::OnFlushCompleted, info);
 }
 
 void DBImpl::CompactRange(const Slice* begin, const Slice* end) {
@@ -651,6 +856,308 @@ Status DBImpl::TEST_CompactMemTable() {
   return s;
 }
 
+namespace {
+
+// An SstFileWriter file being added by DBImpl::IngestExternalFiles().
+struct IngestedFile {
+  std::string source;
+  uint64_t file_size;
+  std::string smallest_user_key;
+  std::string largest_user_key;
+  ValueType smallest_type;
+  ValueType largest_type;
+  uint64_t number;
+  int level;
+};
+
+}  // namespace
+
+// Reads the size and key range of "file->source".  Fails unless the file
+// is a table written by SstFileWriter.
+static Status ReadIngestedFile(Env* env, const Options& options,
+                               IngestedFile* file) {
+  Status s = env->GetFileSize(file->source, &file->file_size);
+  RandomAccessFile* raf = nullptr;
+  if (s.ok()) {
+    s = env->NewRandomAccessFile(file->source, &raf);
+  }
+  Table* table = nullptr;
+  if (s.ok()) {
+    s = Table::Open(options, raf, file->file_size, &table);
+  }
+  if (s.ok()) {
+    ReadOptions read_options;
+    read_options.fill_cache = false;
+    Iterator* iter = table->NewIterator(read_options);
+    ParsedInternalKey smallest, largest;
+    bool valid = false;
+    iter->SeekToFirst();
+    if (iter->Valid() && ParseInternalKey(iter->key(), &smallest)) {
+      file->smallest_user_key = smallest.user_key.ToString();
+      file->smallest_type = smallest.type;
+      iter->SeekToLast();
+      if (iter->Valid() && ParseInternalKey(iter->key(), &largest)) {
+        file->largest_user_key = largest.user_key.ToString();
+        file->largest_type = largest.type;
+        valid = (smallest.sequence == 0 && largest.sequence == 0);
+      }
+    }
+    s = iter->status();
+    if (s.ok() && !valid) {
+      s = Status::InvalidArgument(file->source,
+                                  "not a table written by SstFileWriter");
+    }
+    delete iter;
+  }
+  delete table;
+  delete raf;
+  return s;
+}
+
+// Copies "src" to "target" and syncs the copy.
+static Status CopyFile(Env* env, const std::string& src,
+                       const std::string& target) {
+  SequentialFile* in;
+  Status s = env->NewSequentialFile(src, &in);
+  if (!s.ok()) {
+    return s;
+  }
+  WritableFile* out;
+  s = env->NewWritableFile(target, &out);
+  if (!s.ok()) {
+    delete in;
+    return s;
+  }
+  static const size_t kBufferSize = 1 << 20;
+  char* space = new char[kBufferSize];
+  while (s.ok()) {
+    Slice fragment;
+    s = in->Read(kBufferSize, &fragment, space);
+    if (!s.ok() || fragment.empty()) {
+      break;
+    }
+    s = out->Append(fragment);
+  }
+  delete[] space;
+  delete in;
+  if (s.ok()) {
+    s = out->Sync();
+  }
+  if (s.ok()) {
+    s = out->Close();
+  }
+  delete out;
+  if (!s.ok()) {
+    env->RemoveFile(target);
+  }
+  return s;
+}
+
+// Returns true if "mem" holds an entry for a user key in
+// [smallest_user_key,largest_user_key], or a range tombstone that
+// overlaps that range.
+static bool MemTableOverlaps(MemTable* mem, const Comparator* ucmp,
+                             const Slice& smallest_user_key,
+                             const Slice& largest_user_key) {
+  Iterator* iter = mem->NewIterator();
+  LookupKey lkey(smallest_user_key, kMaxSequenceNumber);
+  iter->Seek(lkey.internal_key());
+  bool overlaps =
+      iter->Valid() &&
+      ucmp->Compare(ExtractUserKey(iter->key()), largest_user_key) <= 0;
+  delete iter;
+
+  iter = mem->NewRangeTombstoneIterator();
+  for (iter->SeekToFirst(); iter->Valid() && !overlaps; iter->Next()) {
+    Slice begin = ExtractUserKey(iter->key());
+    if (ucmp->Compare(begin, largest_user_key) > 0) {
+      break;
+    }
+    overlaps = ucmp->Compare(smallest_user_key, iter->value()) < 0;
+  }
+  delete iter;
+  return overlaps;
+}
+
+Status DBImpl::StartTrace(const TraceOptions& options,
+                          const std::string& trace_path) {
+  MutexLock l(&trace_mutex_);
+  if (trace_writer_ != nullptr) {
+    return Status::InvalidArgument("a trace is already being taken");
+  }
+  Status s = TraceWriter::Create(env_, options, trace_path, &trace_writer_);
+  if (s.ok()) {
+    tracing_.store(true, std::memory_order_relaxed);
+  }
+  return s;
+}
+
+Status DBImpl::EndTrace() {
+  MutexLock l(&trace_mutex_);
+  if (trace_writer_ == nullptr) {
+    return Status::NotFound("no trace is being taken");
+  }
+  tracing_.store(false, std::memory_order_relaxed);
+  Status s = trace_writer_->Close();
+  delete trace_writer_;
+  trace_writer_ = nullptr;
+  return s;
+}
+
+void DBImpl::AddTraceRecord(TraceType type, const Slice& payload) {
+  MutexLock l(&trace_mutex_);
+  if (trace_writer_ != nullptr) {
+    trace_writer_->Add(type, payload);
+  }
+}
+
+Status DBImpl::IngestExternalFiles(const std::vector<std::string>& files) {
+  Status s;
+  std::vector<IngestedFile> ingested(files.size());
+  for (size_t i = 0; i < files.size() && s.ok(); i++) {
+    ingested[i].source = files[i];
+    s = ReadIngestedFile(env_, options_, &ingested[i]);
+  }
+  if (!s.ok() || ingested.empty()) {
+    return s;
+  }
+
+  const Comparator* ucmp = user_comparator();
+  std::sort(ingested.begin(), ingested.end(),
+            [ucmp](const IngestedFile& a, const IngestedFile& b) {
+              return ucmp->Compare(a.smallest_user_key, b.smallest_user_key) <
+                     0;
+            });
+  for (size_t i = 1; i < ingested.size(); i++) {
+    if (ucmp->Compare(ingested[i - 1].largest_user_key,
+                      ingested[i].smallest_user_key) >= 0) {
+      return Status::InvalidArgument("ingested files overlap",
+                                     ingested[i].source);
+    }
+  }
+
+  MutexLock l(&mutex_);
+  for (IngestedFile& f : ingested) {
+    f.number = versions_->NewFileNumber();
+    pending_outputs_.insert(f.number);
+  }
+
+  // Bring the files into the database directory.  Linking avoids
+  // rewriting the data but is not supported by every Env.
+  mutex_.Unlock();
+  for (const IngestedFile& f : ingested) {
+    const std::string fname = TableFileName(dbname_, f.number);
+    s = env_->LinkFile(f.source, fname);
+    if (!s.ok()) {
+      s = CopyFile(env_, f.source, fname);
+    }
+    if (!s.ok()) {
+      break;
+    }
+  }
+  mutex_.Lock();
+
+  // Take the head of the write queue so that no write is in flight while
+  // the memtables are checked and the sequence number is assigned.
+  Writer w(&mutex_);
+  writers_.push_back(&w);
+  while (&w != writers_.front()) {
+    w.cv.Wait();
+  }
+
+  // Entries in the memtables would be found before the ingested ones even
+  // though they are older, so flush any that overlap.
+  bool mem_overlaps = false;
+  bool imm_overlaps = false;
+  for (const IngestedFile& f : ingested) {
+    mem_overlaps = mem_overlaps || MemTableOverlaps(mem_, ucmp,
+                                                    f.smallest_user_key,
+                                                    f.largest_user_key);
+    imm_overlaps =
+        imm_overlaps || (imm_ != nullptr &&
+                         MemTableOverlaps(imm_, ucmp, f.smallest_user_key,
+                                          f.largest_user_key));
+  }
+  if (s.ok() && mem_overlaps) {
+    s = MakeRoomForWrite(/*force=*/true);
+  }
+  if (s.ok() && (mem_overlaps || imm_overlaps)) {
+    while (imm_ != nullptr && bg_error_.ok()) {
+      background_work_finished_signal_.Wait();
+    }
+    if (imm_ != nullptr) {
+      s = bg_error_;
+    }
+  }
+
+  // Later writes are newer than the ingested files, so the write queue
+  // can be released once their sequence number is taken.  Files flushed
+  // meanwhile get higher file numbers and so also sort as newer in
+  // level-0.
+  const SequenceNumber seq = versions_->LastSequence() + 1;
+  if (s.ok()) {
+    versions_->SetLastSequence(seq);
+  }
+  writers_.pop_front();
+  if (!writers_.empty()) {
+    writers_.front()->cv.Signal();
+  }
+
+  // Keep compactions and flushes from reshaping the levels while the
+  // files are placed and the manifest is written.  Writes go on, and at
+  // worst stall until the files are installed.
+  if (s.ok()) {
+    while (ingestion_in_progress_) {
+      background_work_finished_signal_.Wait();
+    }
+    ingestion_in_progress_ = true;
+    while (background_compaction_scheduled_) {
+      background_work_finished_signal_.Wait();
+    }
+    s = bg_error_;
+
+    if (s.ok()) {
+      VersionEdit edit;
+      Version* base = versions_->current();
+      for (IngestedFile& f : ingested) {
+        Slice smallest_user_key(f.smallest_user_key);
+        Slice largest_user_key(f.largest_user_key);
+        // Level-0 files are searched newest first, so an ingested file may
+        // always go there.  Otherwise sink it while no level at or above
+        // its destination holds keys in its range.
+        f.level = 0;
+        if (options_.compaction_style == kCompactionStyleLevel &&
+            !base->OverlapInLevel(0, &smallest_user_key, &largest_user_key)) {
+          while (f.level + 1 < config::kNumLevels &&
+                 !base->OverlapInLevel(f.level + 1, &smallest_user_key,
+                                       &largest_user_key)) {
+            f.level++;
+          }
+        }
+        edit.AddFile(f.level, f.number, f.file_size,
+                     InternalKey(smallest_user_key, seq, f.smallest_type),
+                     InternalKey(largest_user_key, seq, f.largest_type), seq);
+      }
+      s = versions_->LogAndApply(&edit, &mutex_);
+    }
+    ingestion_in_progress_ = false;
+    background_work_finished_signal_.SignalAll();
+    MaybeScheduleCompaction();
+  }
+
+  for (const IngestedFile& f : ingested) {
+    pending_outputs_.erase(f.number);
+    if (s.ok()) {
+      Log(options_.info_log, "Ingested %s as table #%llu@%d: %lld bytes",
+          f.source.c_str(), static_cast<unsigned long long>(f.number),
+          f.level, static_cast<long long>(f.file_size));
+    } else {
+      env_->RemoveFile(TableFileName(dbname_, f.number));
+    }
+  }
+  return s;
+}
+
 void DBImpl::RecordBackgroundError(const Status& s) {
   mutex_.AssertHeld();
   if (bg_error_.ok()) {
@@ -667,6 +1174,8 @@ void DBImpl::MaybeScheduleCompaction() {
     // DB is being deleted; no more background compactions
   } else if (!bg_error_.ok()) {
     // Already got an error; no more changes
+  } else if (ingestion_in_progress_) {
+    // IngestExternalFiles() reschedules once its files are installed
   } else if (imm_ == nullptr && manual_compaction_ == nullptr &&
              !versions_->NeedsCompaction()) {
     // No work to be done
@@ -726,31 +1235,74 @@ void DBImpl::BackgroundCompaction() {
     c = versions_->PickCompaction();
   }
 
+  const bool notify = (c != nullptr && !options_.listeners.empty());
+  CompactionJobInfo info;
+  const uint64_t start_micros = env_->NowMicros();
+  if (notify) {
+    info.db_name = dbname_;
+    info.level = c->level();
+    info.output_level = c->output_level();
+    for (int which = 0; which < 2; which++) {
+      for (int i = 0; i < c->num_input_files(which); i++) {
+        info.input_files.push_back(c->input(which, i)->number);
+      }
+    }
+    info.is_trivial_move = !is_manual && !c->IsDeletionOnly() &&
+                           c->IsTrivialMove();
+    NotifyListeners(&EventListener::OnCompactionBegin, info);
+  }
+
   Status status;
   if (c == nullptr) {
     // Nothing to do
+  } else if (c->IsDeletionOnly()) {
+    CompactionState* compact = new CompactionState(c, options_);
+    status = DeleteCompactionInputs(compact);
+    if (!status.ok()) {
+      RecordBackgroundError(status);
+    }
+    CleanupCompaction(compact);
+    c->ReleaseInputs();
+    RemoveObsoleteFiles();
   } else if (!is_manual && c->IsTrivialMove()) {
-    // Move file to next level
-    assert(c->num_input_files(0) == 1);
-    FileMetaData* f = c->input(0, 0);
-    c->edit()->RemoveFile(c->level(), f->number);
-    c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest,
-                       f->largest);
+    // Move files to next level
+    uint64_t bytes = 0;
+    for (int i = 0; i < c->num_input_files(0); i++) {
+      FileMetaData* f = c->input(0, i);
+      c->edit()->RemoveFile(c->level(), f->number);
+      c->edit()->AddFile(c->output_level(), *f);
+      bytes += f->file_size;
+    }
     status = versions_->LogAndApply(c->edit(), &mutex_);
     if (!status.ok()) {
       RecordBackgroundError(status);
     }
     VersionSet::LevelSummaryStorage tmp;
-    Log(options_.info_log, "Moved #%lld to level-%d %lld bytes %s: %s\n",
-        static_cast<unsigned long long>(f->number), c->level() + 1,
-        static_cast<unsigned long long>(f->file_size),
-        status.ToString().c_str(), versions_->LevelSummary(&tmp));
+    Log(options_.info_log, "Moved #%lld%s to level-%d %lld bytes %s: %s\n",
+        static_cast<unsigned long long>(c->input(0, 0)->number),
+        (c->num_input_files(0) > 1 ? " and more" : ""), c->output_level(),
+        static_cast<unsigned long long>(bytes), status.ToString().c_str(),
+        versions_->LevelSummary(&tmp));
+    if (notify) {
+      info.output_files = info.input_files;
+    }
   } else {
-    CompactionState* compact = new CompactionState(c);
+    CompactionState* compact = new CompactionState(c, options_);
     status = DoCompactionWork(compact);
     if (!status.ok()) {
       RecordBackgroundError(status);
     }
+    if (notify) {
+      for (const CompactionState::Output& out : compact->outputs) {
+        info.output_files.push_back(out.number);
+      }
+      for (int which = 0; which < 2; which++) {
+        for (int i = 0; i < c->num_input_files(which); i++) {
+          info.bytes_read += c->input(which, i)->file_size;
+        }
+      }
+      info.bytes_written = compact->total_bytes + compact->blob_bytes;
+    }
     CleanupCompaction(compact);
     c->ReleaseInputs();
     RemoveObsoleteFiles();
@@ -778,6 +1330,12 @@ void DBImpl::BackgroundCompaction() {
     }
     manual_compaction_ = nullptr;
   }
+
+  if (notify) {
+    info.micros = env_->NowMicros() - start_micros;
+    info.status = status;
+    NotifyListeners(&EventListener::OnCompactionCompleted, info);
+  }
 }
 
 void DBImpl::CleanupCompaction(CompactionState* compact) {
@@ -794,6 +1352,11 @@ void DBImpl::CleanupCompaction(CompactionState* compact) {
     const CompactionState::Output& out = compact->outputs[i];
     pending_outputs_.erase(out.number);
   }
+  delete compact->blob_builder;
+  delete compact->blob_outfile;
+  if (compact->blob_number != 0) {
+    pending_outputs_.erase(compact->blob_number);
+  }
   delete compact;
 }
 
@@ -803,12 +1366,23 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   uint64_t file_number;
   {
     mutex_.Lock();
-    file_number = versions_->NewFileNumber();
+    file_number = compact->compaction->output_file_number();
+    if (file_number == 0) {
+      file_number = versions_->NewFileNumber();
+    } else {
+      assert(compact->compaction->CanAddOutput(compact->outputs.size()));
+      file_number += compact->outputs.size();
+    }
     pending_outputs_.insert(file_number);
     CompactionState::Output out;
     out.number = file_number;
     out.smallest.Clear();
     out.largest.Clear();
+    out.has_range_tombstones = false;
+    out.num_entries = 0;
+    out.num_deletions = 0;
+    out.largest_seqno = 0;
+    out.marked_for_compaction = false;
     compact->outputs.push_back(out);
     mutex_.Unlock();
   }
@@ -817,11 +1391,61 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   std::string fname = TableFileName(dbname_, file_number);
   Status s = env_->NewWritableFile(fname, &compact->outfile);
   if (s.ok()) {
-    compact->builder = new TableBuilder(options_, compact->outfile);
+    compact->builder = new TableBuilder(
+        TableOptionsForLevel(compact->compaction->output_level()),
+        compact->outfile);
   }
   return s;
 }
 
+void DBImpl::AddOutputRangeTombstones(CompactionState* compact,
+                                      Iterator* input) {
+  const Comparator* ucmp = user_comparator();
+  const bool has_upper_bound = input->Valid() && input->key().size() >= 8;
+  const Slice upper_bound =
+      has_upper_bound ? ExtractUserKey(input->key()) : Slice();
+
+  // Clip each tombstone to [output_lower_bound, upper_bound)
+  std::vector<std::pair<std::string, Slice>> fragments;
+  for (const RangeTombstone& t : compact->range_tombstones) {
+    Slice begin = t.begin;
+    Slice end = t.end;
+    if (compact->has_output_lower_bound &&
+        ucmp->Compare(begin, compact->output_lower_bound) < 0) {
+      begin = compact->output_lower_bound;
+    }
+    if (has_upper_bound && ucmp->Compare(upper_bound, end) < 0) {
+      end = upper_bound;
+    }
+    if (ucmp->Compare(begin, end) < 0) {
+      std::string key;
+      AppendInternalKey(&key,
+                        ParsedInternalKey(begin, t.seq, kTypeRangeDeletion));
+      fragments.push_back(std::make_pair(key, end));
+    }
+  }
+  std::sort(fragments.begin(), fragments.end(),
+            [this](const std::pair<std::string, Slice>& a,
+                   const std::pair<std::string, Slice>& b) {
+              return internal_comparator_.Compare(a.first, b.first) < 0;
+            });
+
+  CompactionState::Output* out = compact->current_output();
+  for (const auto& fragment : fragments) {
+    ExtendRangeForTombstone(
+        &internal_comparator_, fragment.first, fragment.second,
+        compact->builder->NumEntries() == 0 && !out->has_range_tombstones,
+        &out->smallest, &out->largest);
+    compact->builder->AddRangeTombstone(fragment.first, fragment.second);
+    out->has_range_tombstones = true;
+  }
+
+  if (has_upper_bound) {
+    compact->has_output_lower_bound = true;
+    compact->output_lower_bound = upper_bound.ToString();
+  }
+}
+
 Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
                                           Iterator* input) {
   assert(compact != nullptr);
@@ -830,10 +1454,20 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
 
   const uint64_t output_number = compact->current_output()->number;
   assert(output_number != 0);
+  compact->close_output = false;
 
   // Check for iterator errors
   Status s = input->status();
   const uint64_t current_entries = compact->builder->NumEntries();
+  CompactionState::Output* out = compact->current_output();
+  out->num_entries = compact->table_stats.num_entries();
+  out->num_deletions = compact->table_stats.num_deletions();
+  out->largest_seqno = compact->table_stats.largest_seqno();
+  out->marked_for_compaction = compact->table_stats.marked_for_compaction();
+  compact->table_stats.Reset();
+  if (s.ok() && !compact->range_tombstones.empty()) {
+    AddOutputRangeTombstones(compact, input);
+  }
   if (s.ok()) {
     s = compact->builder->Finish();
   } else {
@@ -858,7 +1492,8 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   if (s.ok() && current_entries > 0) {
     // Verify that the table is usable
     Iterator* iter =
-        table_cache_->NewIterator(ReadOptions(), output_number, current_bytes);
+        table_cache_->NewIterator(ReadOptions(), output_number, current_bytes,
+                                  /*global_seqno=*/0);
     s = iter->status();
     delete iter;
     if (s.ok()) {
@@ -868,27 +1503,443 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
           (unsigned long long)current_bytes);
     }
   }
+
+  if (!options_.listeners.empty()) {
+    TableFileCreationInfo info;
+    info.db_name = dbname_;
+    info.file_path = TableFileName(dbname_, output_number);
+    info.file_number = output_number;
+    info.file_size = current_bytes;
+    info.reason = kTableFileFromCompaction;
+    info.status = s;
+    NotifyListenersUnlocked(&EventListener::OnTableFileCreated, info);
+  }
   return s;
 }
 
+Status DBImpl::OpenCompactionBlobFile(CompactionState* compact) {
+  assert(compact != nullptr);
+  assert(compact->blob_builder == nullptr);
+  {
+    mutex_.Lock();
+    compact->blob_number = versions_->NewFileNumber();
+    pending_outputs_.insert(compact->blob_number);
+    mutex_.Unlock();
+  }
+
+  Status s = env_->NewWritableFile(BlobFileName(dbname_, compact->blob_number),
+                                   &compact->blob_outfile);
+  if (s.ok()) {
+    compact->blob_builder =
+        new BlobFileBuilder(compact->blob_outfile, compact->blob_number);
+  }
+  return s;
+}
+
+Status DBImpl::FinishCompactionBlobFile(CompactionState* compact) {
+  assert(compact != nullptr);
+  assert(compact->blob_builder != nullptr);
+
+  Status s = compact->blob_builder->Finish();
+  if (s.ok()) {
+    s = compact->blob_outfile->Sync();
+  }
+  if (s.ok()) {
+    s = compact->blob_outfile->Close();
+  }
+  if (s.ok()) {
+    compact->blob_bytes = compact->blob_builder->ValueBytes();
+    Log(options_.info_log, "Generated blob file #%llu: %lld values, %lld bytes",
+        (unsigned long long)compact->blob_number,
+        (unsigned long long)compact->blob_builder->NumEntries(),
+        (unsigned long long)compact->blob_bytes);
+  }
+  delete compact->blob_builder;
+  compact->blob_builder = nullptr;
+  delete compact->blob_outfile;
+  compact->blob_outfile = nullptr;
+  return s;
+}
+
+Status DBImpl::RelocateValue(CompactionState* compact,
+                             const ParsedInternalKey& ikey, Slice* key,
+                             Slice* value) {
+  const size_t threshold = options_.blob_value_threshold;
+  if (ikey.type == kTypeBlobIndex) {
+    BlobIndex index;
+    Slice input = *value;
+    if (!index.DecodeFrom(&input)) {
+      return Status::Corruption("bad blob index for ", ikey.user_key);
+    }
+    if (!compact->compaction->ShouldRelocateBlob(index.file_number)) {
+      return Status::OK();
+    }
+    ReadOptions options;
+    options.verify_checksums = options_.paranoid_checks;
+    Status s = blob_cache_->Get(options, index, &compact->relocated_value);
+    if (!s.ok()) {
+      return s;
+    }
+    compact->blob_garbage[index.file_number] += index.size;
+    *value = compact->relocated_value;
+  } else if (ikey.type != kTypeValue || threshold == 0 ||
+             value->size() < threshold) {
+    return Status::OK();
+  }
+
+  ValueType type = kTypeValue;
+  if (threshold > 0 && value->size() >= threshold) {
+    if (compact->blob_builder == nullptr) {
+      Status s = OpenCompactionBlobFile(compact);
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    BlobIndex index;
+    compact->blob_builder->Add(*value, &index);
+    compact->blob_index.clear();
+    index.EncodeTo(&compact->blob_index);
+    *value = compact->blob_index;
+    type = kTypeBlobIndex;
+  }
+  compact->relocated_key.clear();
+  AppendInternalKey(&compact->relocated_key,
+                    ParsedInternalKey(ikey.user_key, ikey.sequence, type));
+  *key = compact->relocated_key;
+  return compact->blob_builder != nullptr ? compact->blob_builder->status()
+                                          : Status::OK();
+}
+
+Status DBImpl::FoldMergeOperands(CompactionState* compact, Iterator* input) {
+  // Newer entries for the key are gone, so every snapshot sees the
+  // operands and what they apply to.  The result replaces all of them.
+  const std::string user_key = ExtractUserKey(input->key()).ToString();
+  std::vector<std::string> keys;  // Of the operands, newest first
+  std::vector<std::string> operands;
+  std::string existing_value;
+  bool has_existing_value = false;
+  bool reached_bottom = false;  // Found what the operands apply to?
+  ParsedInternalKey ikey;
+  for (; input->Valid(); input->Next()) {
+    if (!ParseInternalKey(input->key(), &ikey) ||
+        user_comparator()->Compare(ikey.user_key, user_key) != 0) {
+      break;
+    }
+    if (reached_bottom || (compact->covering_tombstones != nullptr &&
+                           compact->covering_tombstones->MaxCoveringSeq(
+                               user_key) > ikey.sequence)) {
+      // Hidden by the result (or deleted by a range tombstone)
+      reached_bottom = true;
+      if (ikey.type == kTypeBlobIndex) {
+        CountBlobGarbage(compact, input->value());
+      }
+      continue;
+    }
+    switch (ikey.type) {
+      case kTypeMerge:
+        keys.push_back(input->key().ToString());
+        operands.push_back(input->value().ToString());
+        break;
+      case kTypeValue:
+        existing_value = input->value().ToString();
+        has_existing_value = true;
+        reached_bottom = true;
+        break;
+      case kTypeBlobIndex: {
+        ReadOptions options;
+        options.verify_checksums = options_.paranoid_checks;
+        Status s = blob_cache_->Get(options, input->value(), &existing_value);
+        if (!s.ok()) {
+          return s;
+        }
+        CountBlobGarbage(compact, input->value());
+        has_existing_value = true;
+        reached_bottom = true;
+        break;
+      }
+      case kTypeDeletion:
+      case kTypeRangeDeletion:
+        reached_bottom = true;
+        break;
+    }
+  }
+  if (!reached_bottom && compact->covering_tombstones != nullptr &&
+      compact->covering_tombstones->MaxCoveringSeq(user_key) != 0) {
+    // A range tombstone older than every operand deleted the value
+    reached_bottom = true;
+  }
+
+  if (reached_bottom ||
+      compact->compaction->IsBaseLevelForKey(Slice(user_key))) {
+    std::vector<Slice> ordered(operands.rbegin(), operands.rend());
+    const Slice existing(existing_value);
+    std::string result;
+    Status s = MergeValues(user_key, has_existing_value ? &existing : nullptr,
+                           ordered, &result);
+    if (!s.ok()) {
+      return s;
+    }
+    ParsedInternalKey newest;
+    ParseInternalKey(keys[0], &newest);
+    newest.type = kTypeValue;
+    std::string key;
+    AppendInternalKey(&key, newest);
+    Slice key_slice = key;
+    Slice value = result;
+    s = RelocateValue(compact, newest, &key_slice, &value);
+    if (!s.ok()) {
+      return s;
+    }
+    return AddCompactionOutput(compact, key_slice, value);
+  }
+
+  // Older entries for the key are outside this compaction.  Combine the
+  // operands into one if the merge operator allows.
+  std::string combined = operands.back();
+  std::string tmp;
+  size_t i = operands.size() - 1;
+  while (i > 0 && options_.merge_operator->PartialMerge(
+                      user_key, combined, operands[i - 1], &tmp)) {
+    combined.swap(tmp);
+    i--;
+  }
+  if (i == 0) {
+    return AddCompactionOutput(compact, keys[0], combined);
+  }
+  Status s;
+  for (size_t j = 0; j < operands.size() && s.ok(); j++) {
+    s = AddCompactionOutput(compact, keys[j], operands[j]);
+  }
+  return s;
+}
+
+Status DBImpl::FilterValue(CompactionState* compact, ParsedInternalKey* ikey,
+                           Slice* key, Slice* value, bool* drop) {
+  Slice existing = *value;
+  if (ikey->type == kTypeBlobIndex) {
+    ReadOptions options;
+    options.verify_checksums = options_.paranoid_checks;
+    Status s = blob_cache_->Get(options, *value, &compact->filter_input);
+    if (!s.ok()) {
+      return s;
+    }
+    existing = compact->filter_input;
+  }
+
+  compact->filtered_value.clear();
+  const CompactionFilter::Decision decision =
+      options_.compaction_filter->Filter(compact->compaction->output_level(),
+                                         ikey->user_key, existing,
+                                         &compact->filtered_value);
+  if (decision == CompactionFilter::kKeep) {
+    return Status::OK();
+  }
+
+  if (decision == CompactionFilter::kRemove &&
+      ikey->sequence <= compact->smallest_snapshot &&
+      compact->compaction->IsBaseLevelForKey(ikey->user_key)) {
+    // Older entries for the key are being dropped by this compaction, and
+    // none remain in higher levels, so there is nothing left to hide.
+    *drop = true;
+    return Status::OK();
+  }
+  if (ikey->type == kTypeBlobIndex) {
+    CountBlobGarbage(compact, *value);
+  }
+  if (decision == CompactionFilter::kRemove) {
+    ikey->type = kTypeDeletion;
+    *value = Slice();
+  } else {
+    ikey->type = kTypeValue;
+    *value = compact->filtered_value;
+  }
+  compact->filtered_key.clear();
+  AppendInternalKey(&compact->filtered_key, *ikey);
+  *key = compact->filtered_key;
+  return Status::OK();
+}
+
+void DBImpl::CountBlobGarbage(CompactionState* compact,
+                              const Slice& blob_index) {
+  BlobIndex index;
+  Slice input = blob_index;
+  if (index.DecodeFrom(&input)) {
+    compact->blob_garbage[index.file_number] += index.size;
+  }
+}
+
+Status DBImpl::AddCompactionOutput(CompactionState* compact, const Slice& key,
+                                   const Slice& value) {
+  // Open output file if necessary
+  if (compact->builder == nullptr) {
+    Status s = OpenCompactionOutputFile(compact);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  if (compact->builder->NumEntries() == 0) {
+    compact->current_output()->smallest.DecodeFrom(key);
+  }
+  compact->current_output()->largest.DecodeFrom(key);
+  compact->builder->Add(key, value);
+  compact->table_stats.Add(key);
+
+  // Close output file once it is big enough
+  if (compact->builder->FileSize() >=
+          compact->compaction->MaxOutputFileSize() &&
+      compact->compaction->CanAddOutput(compact->outputs.size())) {
+    compact->close_output = true;
+  }
+  return Status::OK();
+}
+
 Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   mutex_.AssertHeld();
   Log(options_.info_log, "Compacted %d@%d + %d@%d files => %lld bytes",
       compact->compaction->num_input_files(0), compact->compaction->level(),
-      compact->compaction->num_input_files(1), compact->compaction->level() + 1,
+      compact->compaction->num_input_files(1),
+      compact->compaction->output_level(),
       static_cast<long long>(compact->total_bytes));
 
   // Add compaction outputs
   compact->compaction->AddInputDeletions(compact->compaction->edit());
-  const int level = compact->compaction->level();
+  const int level = compact->compaction->output_level();
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     const CompactionState::Output& out = compact->outputs[i];
-    compact->compaction->edit()->AddFile(level + 1, out.number, out.file_size,
-                                         out.smallest, out.largest);
+    FileMetaData f;
+    f.number = out.number;
+    f.file_size = out.file_size;
+    f.smallest = out.smallest;
+    f.largest = out.largest;
+    f.has_range_tombstones = out.has_range_tombstones;
+    f.num_entries = out.num_entries;
+    f.num_deletions = out.num_deletions;
+    f.largest_seqno = out.largest_seqno;
+    f.marked_for_compaction = out.marked_for_compaction;
+    compact->compaction->edit()->AddFile(level, f);
+  }
+  if (compact->blob_bytes > 0) {
+    compact->compaction->edit()->AddBlobFile(compact->blob_number,
+                                             compact->blob_bytes);
+  }
+  for (const auto& kvp : compact->blob_garbage) {
+    compact->compaction->edit()->AddBlobGarbage(kvp.first, kvp.second);
   }
   return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
 }
 
+Status DBImpl::CollectRangeTombstones(CompactionState* compact) {
+  Compaction* const c = compact->compaction;
+  std::vector<RangeTombstone> tombstones[2];
+  Status s;
+  for (int which = 0; which < 2 && s.ok(); which++) {
+    for (int i = 0; i < c->num_input_files(which) && s.ok(); i++) {
+      FileMetaData* f = c->input(which, i);
+      if (!f->has_range_tombstones) {
+        continue;
+      }
+      Iterator* iter;
+      s = table_cache_->NewRangeTombstoneIterator(f->number, f->file_size,
+                                                  f->global_seqno, &iter);
+      if (s.ok() && iter != nullptr) {
+        s = ReadRangeTombstones(iter, &tombstones[which]);
+        delete iter;
+      }
+    }
+  }
+  if (!s.ok() || (tombstones[0].empty() && tombstones[1].empty())) {
+    return s;
+  }
+
+  compact->covering_tombstones =
+      new RangeTombstoneSet(user_comparator(), compact->smallest_snapshot);
+  for (int which = 0; which < 2; which++) {
+    for (const RangeTombstone& t : tombstones[which]) {
+      compact->covering_tombstones->Add(t);
+      // Like a deletion marker, a tombstone is obsolete once every
+      // snapshot sees it and no older data lies below the output level.
+      if (t.seq > compact->smallest_snapshot ||
+          !c->IsBaseLevelForRange(t.begin, t.end)) {
+        compact->range_tombstones.push_back(t);
+      }
+    }
+  }
+
+  // Entries in "level+1" are older than the tombstones of "level", so an
+  // input there that lies within such a tombstone seen by every snapshot
+  // holds nothing live, and is deleted without being read.
+  const Comparator* ucmp = user_comparator();
+  for (int i = 0; i < c->num_input_files(1); i++) {
+    FileMetaData* f = c->input(1, i);
+    for (const RangeTombstone& t : tombstones[0]) {
+      if (t.seq <= compact->smallest_snapshot &&
+          ucmp->Compare(t.begin, f->smallest.user_key()) <= 0 &&
+          ucmp->Compare(f->largest.user_key(), t.end) < 0) {
+        Log(options_.info_log,
+            "Dropping #%llu@%d: covered by a range tombstone",
+            static_cast<unsigned long long>(f->number), c->output_level());
+        c->MarkCoveredInput(f);
+        break;
+      }
+    }
+  }
+  return s;
+}
+
+Status DBImpl::CountCoveredBlobGarbage(CompactionState* compact) {
+  Compaction* const c = compact->compaction;
+  ReadOptions options;
+  options.fill_cache = false;
+  Status s;
+  for (int which = 0; which < 2; which++) {
+    for (int i = 0; i < c->num_input_files(which) && s.ok(); i++) {
+      FileMetaData* f = c->input(which, i);
+      if (!c->IsDeletionOnly() && !c->IsCoveredInput(f)) {
+        continue;
+      }
+      Iterator* iter = table_cache_->NewIterator(
+          options, f->number, f->file_size, f->global_seqno);
+      for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        ParsedInternalKey ikey;
+        if (ParseInternalKey(iter->key(), &ikey) &&
+            ikey.type == kTypeBlobIndex) {
+          CountBlobGarbage(compact, iter->value());
+        }
+      }
+      s = iter->status();
+      delete iter;
+    }
+  }
+  return s;
+}
+
+Status DBImpl::DeleteCompactionInputs(CompactionState* compact) {
+  mutex_.AssertHeld();
+  Compaction* const c = compact->compaction;
+  Status s;
+  if (versions_->current()->NumBlobFiles() > 0) {
+    mutex_.Unlock();
+    s = CountCoveredBlobGarbage(compact);
+    mutex_.Lock();
+  }
+  if (s.ok()) {
+    c->AddInputDeletions(c->edit());
+    for (const auto& kvp : compact->blob_garbage) {
+      c->edit()->AddBlobGarbage(kvp.first, kvp.second);
+    }
+    s = versions_->LogAndApply(c->edit(), &mutex_);
+  }
+  uint64_t bytes = 0;
+  for (int i = 0; i < c->num_input_files(0); i++) {
+    bytes += c->input(0, i)->file_size;
+  }
+  VersionSet::LevelSummaryStorage tmp;
+  Log(options_.info_log, "Deleted %d@%d files (%lld bytes) %s: %s\n",
+      c->num_input_files(0), c->level(), static_cast<long long>(bytes),
+      s.ToString().c_str(), versions_->LevelSummary(&tmp));
+  return s;
+}
+
 Status DBImpl::DoCompactionWork(CompactionState* compact) {
   const uint64_t start_micros = env_->NowMicros();
   int64_t imm_micros = 0;  // Micros spent doing imm_ compactions
@@ -896,7 +1947,11 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   Log(options_.info_log, "Compacting %d@%d + %d@%d files",
       compact->compaction->num_input_files(0), compact->compaction->level(),
       compact->compaction->num_input_files(1),
-      compact->compaction->level() + 1);
+      compact->compaction->output_level());
+  LEVELDB_PROBE3(compaction_begin, compact->compaction->level(),
+                 compact->compaction->output_level(),
+                 compact->compaction->num_input_files(0) +
+                     compact->compaction->num_input_files(1));
 
   assert(versions_->NumLevelFiles(compact->compaction->level()) > 0);
   assert(compact->builder == nullptr);
@@ -905,15 +1960,28 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     compact->smallest_snapshot = versions_->LastSequence();
   } else {
     compact->smallest_snapshot = snapshots_.oldest()->sequence_number();
+    compact->newest_snapshot = snapshots_.newest()->sequence_number();
   }
 
+  const bool has_blob_files = versions_->current()->NumBlobFiles() > 0;
+
+  // The input files are fixed by the compaction, so their range
+  // tombstones are read without the mutex.  The input iterator is built
+  // afterwards since it skips the inputs they cover.
+  mutex_.Unlock();
+  Status status = CollectRangeTombstones(compact);
+  mutex_.Lock();
   Iterator* input = versions_->MakeInputIterator(compact->compaction);
 
   // Release mutex while we're actually doing the compaction work
   mutex_.Unlock();
 
-  input->SeekToFirst();
-  Status status;
+  if (status.ok() && has_blob_files) {
+    status = CountCoveredBlobGarbage(compact);
+  }
+  if (status.ok()) {
+    input->SeekToFirst();
+  }
   ParsedInternalKey ikey;
   std::string current_user_key;
   bool has_current_user_key = false;
@@ -934,7 +2002,15 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 
     Slice key = input->key();
     if (compact->compaction->ShouldStopBefore(key) &&
-        compact->builder != nullptr) {
+        compact->builder != nullptr &&
+        compact->compaction->CanAddOutput(compact->outputs.size())) {
+      compact->close_output = true;
+    }
+    if (compact->close_output &&
+        (key.size() < 8 ||
+         user_comparator()->Compare(
+             ExtractUserKey(key),
+             compact->current_output()->largest.user_key()) != 0)) {
       status = FinishCompactionOutputFile(compact, input);
       if (!status.ok()) {
         break;
@@ -943,7 +2019,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 
     // Handle key/value, add to state, etc.
     bool drop = false;
-    if (!ParseInternalKey(key, &ikey)) {
+    const bool valid_key = ParseInternalKey(key, &ikey);
+    if (!valid_key) {
       // Do not hide error keys
       current_user_key.clear();
       has_current_user_key = false;
@@ -972,6 +2049,11 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         //     few iterations of this loop (by rule (A) above).
         // Therefore this deletion marker is obsolete and can be dropped.
         drop = true;
+      } else if (compact->covering_tombstones != nullptr &&
+                 compact->covering_tombstones->MaxCoveringSeq(
+                     ikey.user_key) > ikey.sequence) {
+        // Deleted by a range tombstone that every snapshot sees
+        drop = true;
       }
 
       last_sequence_for_key = ikey.sequence;
@@ -986,28 +2068,41 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         (int)last_sequence_for_key, (int)compact->smallest_snapshot);
 #endif
 
-    if (!drop) {
-      // Open output file if necessary
-      if (compact->builder == nullptr) {
-        status = OpenCompactionOutputFile(compact);
-        if (!status.ok()) {
-          break;
-        }
+    if (!drop && valid_key && ikey.type == kTypeMerge &&
+        ikey.sequence <= compact->smallest_snapshot &&
+        options_.merge_operator != nullptr) {
+      status = FoldMergeOperands(compact, input);
+      if (!status.ok()) {
+        break;
       }
-      if (compact->builder->NumEntries() == 0) {
-        compact->current_output()->smallest.DecodeFrom(key);
+      continue;  // "input" is at the next user key
+    }
+
+    Slice value = input->value();
+    if (!drop && valid_key && options_.compaction_filter != nullptr &&
+        ikey.sequence > compact->newest_snapshot &&
+        (ikey.type == kTypeValue || ikey.type == kTypeBlobIndex)) {
+      status = FilterValue(compact, &ikey, &key, &value, &drop);
+      if (!status.ok()) {
+        break;
       }
-      compact->current_output()->largest.DecodeFrom(key);
-      compact->builder->Add(key, input->value());
+    }
 
-      // Close output file if it is big enough
-      if (compact->builder->FileSize() >=
-          compact->compaction->MaxOutputFileSize()) {
-        status = FinishCompactionOutputFile(compact, input);
+    if (drop) {
+      if (ikey.type == kTypeBlobIndex) {
+        CountBlobGarbage(compact, input->value());
+      }
+    } else {
+      if (valid_key) {
+        status = RelocateValue(compact, ikey, &key, &value);
         if (!status.ok()) {
           break;
         }
       }
+      status = AddCompactionOutput(compact, key, value);
+      if (!status.ok()) {
+        break;
+      }
     }
 
     input->Next();
@@ -1016,9 +2111,23 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   if (status.ok() && shutting_down_.load(std::memory_order_acquire)) {
     status = Status::IOError("Deleting DB during compaction");
   }
+  if (status.ok() && compact->builder == nullptr) {
+    // Range tombstones past the last output key need an output of their
+    // own, which may hold nothing else.
+    for (const RangeTombstone& t : compact->range_tombstones) {
+      if (!compact->has_output_lower_bound ||
+          user_comparator()->Compare(compact->output_lower_bound, t.end) < 0) {
+        status = OpenCompactionOutputFile(compact);
+        break;
+      }
+    }
+  }
   if (status.ok() && compact->builder != nullptr) {
     status = FinishCompactionOutputFile(compact, input);
   }
+  if (status.ok() && compact->blob_builder != nullptr) {
+    status = FinishCompactionBlobFile(compact);
+  }
   if (status.ok()) {
     status = input->status();
   }
@@ -1035,9 +2144,16 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     stats.bytes_written += compact->outputs[i].file_size;
   }
+  stats.bytes_written += compact->blob_bytes;
 
   mutex_.Lock();
-  stats_[compact->compaction->level() + 1].Add(stats);
+  stats_[compact->compaction->output_level()].Add(stats);
+  if (options_.statistics != nullptr) {
+    options_.statistics->MeasureTime(kCompactionMicros, stats.micros);
+    RecordTick(options_.statistics, kCompactionBytesRead, stats.bytes_read);
+    RecordTick(options_.statistics, kCompactionBytesWritten,
+               stats.bytes_written);
+  }
 
   if (status.ok()) {
     status = InstallCompactionResults(compact);
@@ -1045,6 +2161,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   if (!status.ok()) {
     RecordBackgroundError(status);
   }
+  LEVELDB_PROBE3(compaction_end, compact->compaction->level(),
+                 stats.bytes_written, status.ok());
   VersionSet::LevelSummaryStorage tmp;
   Log(options_.info_log, "compacted to: %s", versions_->LevelSummary(&tmp));
   return status;
@@ -1076,7 +2194,8 @@ static void CleanupIteratorState(void* arg1, void* arg2) {
 
 Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
                                       SequenceNumber* latest_snapshot,
-                                      uint32_t* seed) {
+                                      uint32_t* seed,
+                                      RangeTombstoneSet** range_tombstones) {
   mutex_.Lock();
   *latest_snapshot = versions_->LastSequence();
 
@@ -1096,8 +2215,43 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
   IterState* cleanup = new IterState(&mutex_, mem_, imm_, versions_->current());
   internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, nullptr);
 
+  MemTable* const mem = mem_;
+  MemTable* const imm = imm_;
+  Version* const current = versions_->current();
   *seed = ++seed_;
   mutex_.Unlock();
+
+  if (range_tombstones != nullptr) {
+    // Tables may have to be opened to read their tombstones, so this is
+    // done without the mutex.  internal_iter keeps the sources alive.
+    const SequenceNumber snapshot =
+        (options.snapshot != nullptr
+             ? static_cast<const SnapshotImpl*>(options.snapshot)
+                   ->sequence_number()
+             : *latest_snapshot);
+    RangeTombstoneSet* tombstones =
+        new RangeTombstoneSet(user_comparator(), snapshot);
+    Iterator* iter = mem->NewRangeTombstoneIterator();
+    Status s = tombstones->AddAll(iter);
+    delete iter;
+    if (s.ok() && imm != nullptr) {
+      iter = imm->NewRangeTombstoneIterator();
+      s = tombstones->AddAll(iter);
+      delete iter;
+    }
+    if (s.ok()) {
+      s = current->AddRangeTombstones(tombstones);
+    }
+    if (!s.ok() || tombstones->empty()) {
+      delete tombstones;
+      tombstones = nullptr;
+    }
+    *range_tombstones = tombstones;
+    if (!s.ok()) {
+      delete internal_iter;
+      return NewErrorIterator(s);
+    }
+  }
   return internal_iter;
 }
 
@@ -1114,8 +2268,13 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
 
 Status DBImpl::Get(const ReadOptions& options, const Slice& key,
                    std::string* value) {
+  Trace(kTraceGet, key);
+  LEVELDB_PROBE2(get_start, key.data(), key.size());
+  StopWatch timer(env_, options_.statistics, kGetMicros);
   Status s;
+  PerfTimer lock_timer(&PerfContext::db_mutex_lock_nanos);
   MutexLock l(&mutex_);
+  lock_timer.Stop();
   SequenceNumber snapshot;
   if (options.snapshot != nullptr) {
     snapshot =
@@ -1139,14 +2298,36 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
     mutex_.Unlock();
     // First look in the memtable, then in the immutable memtable (if any).
     LookupKey lkey(key, snapshot);
-    if (mem->Get(lkey, value, &s)) {
-      // Done
-    } else if (imm != nullptr && imm->Get(lkey, value, &s)) {
-      // Done
-    } else {
-      s = current->Get(options, lkey, value, &stats);
+    std::vector<std::string> merge_operands;  // Newest first
+    PerfTimer memtable_timer(&PerfContext::get_from_memtable_nanos);
+    PerfCounterAdd(&PerfContext::get_from_memtable_count);
+    bool done = mem->Get(lkey, value, &s, &merge_operands);
+    if (!done && imm != nullptr) {
+      PerfCounterAdd(&PerfContext::get_from_memtable_count);
+      done = imm->Get(lkey, value, &s, &merge_operands);
+    }
+    memtable_timer.Stop();
+    if (!done) {
+      PerfTimer files_timer(&PerfContext::get_from_output_files_nanos);
+      bool is_blob_index;
+      s = current->Get(options, lkey, value, &is_blob_index, &merge_operands,
+                       &stats);
       have_stat_update = true;
+      if (s.ok() && is_blob_index) {
+        s = blob_cache_->Get(options, Slice(*value), value);
+      }
     }
+    if (!merge_operands.empty() && (s.ok() || s.IsNotFound())) {
+      std::vector<Slice> operands(merge_operands.rbegin(),
+                                  merge_operands.rend());
+      std::string existing_value;
+      if (s.ok()) {
+        existing_value.swap(*value);
+      }
+      const Slice existing(existing_value);
+      s = MergeValues(key, s.ok() ? &existing : nullptr, operands, value);
+    }
+    PerfTimer relock_timer(&PerfContext::db_mutex_lock_nanos);
     mutex_.Lock();
   }
 
@@ -1156,19 +2337,46 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
   mem->Unref();
   if (imm != nullptr) imm->Unref();
   current->Unref();
+  RecordTick(options_.statistics, kKeysRead);
+  if (s.ok()) {
+    RecordTick(options_.statistics, kBytesRead, value->size());
+  }
+  LEVELDB_PROBE1(get_end, s.ok());
   return s;
 }
 
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
   SequenceNumber latest_snapshot;
   uint32_t seed;
-  Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed);
-  return NewDBIterator(this, user_comparator(), iter,
+  RangeTombstoneSet* range_tombstones;
+  Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed,
+                                       &range_tombstones);
+  return NewDBIterator(this, options, user_comparator(), iter,
                        (options.snapshot != nullptr
                             ? static_cast<const SnapshotImpl*>(options.snapshot)
                                   ->sequence_number()
                             : latest_snapshot),
-                       seed);
+                       seed, range_tombstones);
+}
+
+Status DBImpl::ReadBlob(const ReadOptions& options, const Slice& blob_index,
+                        std::string* value) {
+  return blob_cache_->Get(options, blob_index, value);
+}
+
+Status DBImpl::MergeValues(const Slice& user_key, const Slice* existing_value,
+                           const std::vector<Slice>& operands,
+                           std::string* result) const {
+  if (options_.merge_operator == nullptr) {
+    return Status::NotSupported("merge operands need a merge operator",
+                                user_key);
+  }
+  result->clear();
+  if (!options_.merge_operator->FullMerge(user_key, existing_value, operands,
+                                          result)) {
+    return Status::Corruption("merge operator failed for ", user_key);
+  }
+  return Status::OK();
 }
 
 void DBImpl::RecordReadSample(Slice key) {
@@ -1197,7 +2405,21 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
   return DB::Delete(options, key);
 }
 
+Status DBImpl::Merge(const WriteOptions& options, const Slice& key,
+                     const Slice& value) {
+  if (options_.merge_operator == nullptr) {
+    return Status::InvalidArgument("Merge requires Options::merge_operator");
+  }
+  return DB::Merge(options, key, value);
+}
+
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
+  if (updates != nullptr) {
+    Trace(kTraceWrite, WriteBatchInternal::Contents(updates));
+  }
+  // A null batch only makes room, for a compaction.
+  StopWatch timer(env_, updates != nullptr ? options_.statistics : nullptr,
+                  kWriteMicros);
   Writer w(&mutex_);
   w.batch = updates;
   w.sync = options.sync;
@@ -1227,18 +2449,36 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     // into mem_.
     {
       mutex_.Unlock();
-      status = log_->AddRecord(WriteBatchInternal::Contents(write_batch));
+      PerfTimer wal_timer(&PerfContext::write_wal_nanos);
+      const Slice record = WriteBatchInternal::Contents(write_batch);
+      {
+        IOStatsTimer io_timer(&IOStatsContext::write_nanos);
+        LEVELDB_PROBE1(wal_append_start, record.size());
+        status = log_->AddRecord(record);
+        LEVELDB_PROBE1(wal_append_end, status.ok());
+      }
+      IOStatsAdd(&IOStatsContext::bytes_written, record.size());
       bool sync_error = false;
       if (status.ok() && options.sync) {
+        IOStatsTimer io_timer(&IOStatsContext::fsync_nanos);
+        LEVELDB_PROBE(wal_sync_start);
         status = logfile_->Sync();
+        LEVELDB_PROBE1(wal_sync_end, status.ok());
         if (!status.ok()) {
           sync_error = true;
         }
       }
+      wal_timer.Stop();
       if (status.ok()) {
+        PerfTimer memtable_timer(&PerfContext::write_memtable_nanos);
         status = WriteBatchInternal::InsertInto(write_batch, mem_);
       }
       mutex_.Lock();
+      user_bytes_written_ += WriteBatchInternal::ByteSize(write_batch);
+      RecordTick(options_.statistics, kKeysWritten,
+                 WriteBatchInternal::Count(write_batch));
+      RecordTick(options_.statistics, kBytesWritten,
+                 WriteBatchInternal::ByteSize(write_batch));
       if (sync_error) {
         // The state of the log file is indeterminate: the log record we
         // just added may or may not show up when the DB is re-opened.
@@ -1299,22 +2539,26 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
       break;
     }
 
-    if (w->batch != nullptr) {
-      size += WriteBatchInternal::ByteSize(w->batch);
-      if (size > max_size) {
-        // Do not make batch too big
-        break;
-      }
+    if (w->batch == nullptr) {
+      // Memtable switches and file ingestion must reach the head of the
+      // queue themselves.
+      break;
+    }
 
-      // Append to *result
-      if (result == first->batch) {
-        // Switch to temporary batch instead of disturbing caller's batch
-        result = tmp_batch_;
-        assert(WriteBatchInternal::Count(result) == 0);
-        WriteBatchInternal::Append(result, first->batch);
-      }
-      WriteBatchInternal::Append(result, w->batch);
+    size += WriteBatchInternal::ByteSize(w->batch);
+    if (size > max_size) {
+      // Do not make batch too big
+      break;
+    }
+
+    // Append to *result
+    if (result == first->batch) {
+      // Switch to temporary batch instead of disturbing caller's batch
+      result = tmp_batch_;
+      assert(WriteBatchInternal::Count(result) == 0);
+      WriteBatchInternal::Append(result, first->batch);
     }
+    WriteBatchInternal::Append(result, w->batch);
     *last_writer = w;
   }
   return result;
@@ -1322,41 +2566,94 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
 
 // REQUIRES: mutex_ is held
 // REQUIRES: this thread is currently at the front of the writer queue
+void DBImpl::WaitForStall() {
+  mutex_.AssertHeld();
+  if (options_.statistics == nullptr) {
+    background_work_finished_signal_.Wait();
+    return;
+  }
+  const uint64_t start_micros = env_->NowMicros();
+  background_work_finished_signal_.Wait();
+  RecordTick(options_.statistics, kStallMicros,
+             env_->NowMicros() - start_micros);
+}
+
+bool DBImpl::UpdateWriteStallCondition(WriteStallCondition condition) {
+  mutex_.AssertHeld();
+  if (condition == write_stall_condition_) {
+    return false;
+  }
+  WriteStallInfo info;
+  info.db_name = dbname_;
+  info.condition = condition;
+  info.previous_condition = write_stall_condition_;
+  if (write_stall_condition_ == kWriteStallNormal) {
+    LEVELDB_PROBE1(write_stall_begin, static_cast<int>(condition));
+  } else if (condition == kWriteStallNormal) {
+    LEVELDB_PROBE1(write_stall_end, static_cast<int>(write_stall_condition_));
+  }
+  write_stall_condition_ = condition;
+  if (options_.listeners.empty()) {
+    return false;
+  }
+  NotifyListeners(&EventListener::OnStallConditionsChanged, info);
+  return true;
+}
+
 Status DBImpl::MakeRoomForWrite(bool force) {
   mutex_.AssertHeld();
   assert(!writers_.empty());
   bool allow_delay = !force;
+  // FIFO databases keep all of their files in level-0 by design.
+  const bool fifo = (options_.compaction_style == kCompactionStyleFIFO);
   Status s;
   while (true) {
     if (!bg_error_.ok()) {
       // Yield previous error
       s = bg_error_;
       break;
-    } else if (allow_delay && versions_->NumLevelFiles(0) >=
-                                  config::kL0_SlowdownWritesTrigger) {
+    } else if (allow_delay && !fifo &&
+               versions_->NumLevelFiles(0) >=
+                   config::kL0_SlowdownWritesTrigger) {
       // We are getting close to hitting a hard limit on the number of
       // L0 files.  Rather than delaying a single write by several
       // seconds when we hit the hard limit, start delaying each
       // individual write by 1ms to reduce latency variance.  Also,
       // this delay hands over some CPU to the compaction thread in
       // case it is sharing the same core as the writer.
+      UpdateWriteStallCondition(kWriteStallDelayed);
       mutex_.Unlock();
       env_->SleepForMicroseconds(1000);
       allow_delay = false;  // Do not delay a single write more than once
       mutex_.Lock();
+      RecordTick(options_.statistics, kStallMicros, 1000);
     } else if (!force &&
                (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
       // There is room in current memtable
+      const bool slowed_down =
+          !fifo &&
+          versions_->NumLevelFiles(0) >= config::kL0_SlowdownWritesTrigger;
+      if (UpdateWriteStallCondition(slowed_down ? kWriteStallDelayed
+                                                : kWriteStallNormal)) {
+        continue;
+      }
       break;
     } else if (imm_ != nullptr) {
       // We have filled up the current memtable, but the previous
       // one is still being compacted, so we wait.
+      if (UpdateWriteStallCondition(kWriteStallStopped)) {
+        continue;
+      }
       Log(options_.info_log, "Current memtable full; waiting...\n");
-      background_work_finished_signal_.Wait();
-    } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
+      WaitForStall();
+    } else if (!fifo &&
+               versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
       // There are too many level-0 files.
+      if (UpdateWriteStallCondition(kWriteStallStopped)) {
+        continue;
+      }
       Log(options_.info_log, "Too many L0 files; waiting...\n");
-      background_work_finished_signal_.Wait();
+      WaitForStall();
     } else {
       // Attempt to switch to a new memtable and trigger compaction of old
       assert(versions_->PrevLogNumber() == 0);
@@ -1391,6 +2688,8 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       has_imm_.store(true, std::memory_order_release);
       mem_ = new MemTable(internal_comparator_);
       mem_->Ref();
+      LEVELDB_PROBE2(memtable_switch, new_log_number,
+                     imm_->ApproximateMemoryUsage());
       force = false;  // Do not force another compaction if have room
       MaybeScheduleCompaction();
     }
@@ -1398,15 +2697,123 @@ Status DBImpl::MakeRoomForWrite(bool force) {
   return s;
 }
 
+Status DBImpl::GetMemoryUsage(MemoryUsage* usage) {
+  *usage = MemoryUsage();
+  usage->levels.resize(config::kNumLevels);
+
+  mutex_.Lock();
+  if (mem_ != nullptr) {
+    usage->mem_table_usage = mem_->ApproximateMemoryUsage();
+  }
+  if (imm_ != nullptr) {
+    usage->imm_mem_table_usage = imm_->ApproximateMemoryUsage();
+  }
+  Version* current = versions_->current();
+  current->Ref();
+  mutex_.Unlock();
+
+  current->AddMemoryUsage(usage->levels.data());
+  usage->block_cache_usage = options_.block_cache->TotalCharge();
+  usage->block_cache_pinned_usage = options_.block_cache->TotalPinnedCharge();
+
+  mutex_.Lock();
+  current->Unref();
+  mutex_.Unlock();
+  return Status::OK();
+}
+
+bool DBImpl::GetMemoryUsageProperty(const Slice& name, std::string* value) {
+  Slice in = name;
+  int level = -1;
+  if (in.starts_with("block-cache-usage-at-level")) {
+    in.remove_prefix(strlen("block-cache-usage-at-level"));
+    uint64_t n;
+    if (!ConsumeDecimalNumber(&in, &n) || !in.empty() ||
+        n >= config::kNumLevels) {
+      return false;
+    }
+    level = static_cast<int>(n);
+  } else if (in != "memory-usage" && in != "block-cache-usage" &&
+             in != "block-cache-pinned-usage" && in != "mem-table-usage" &&
+             in != "imm-mem-table-usage" && in != "table-readers-usage" &&
+             in != "read-amplification") {
+    return false;
+  }
+
+  MemoryUsage usage;
+  GetMemoryUsage(&usage);
+  uint64_t table_readers = 0;
+  int read_amplification = 0;
+  for (const MemoryUsage::Level& l : usage.levels) {
+    table_readers += l.index_usage + l.filter_usage;
+    read_amplification += l.read_amplification;
+  }
+
+  uint64_t result;
+  if (level >= 0) {
+    result = usage.levels[level].block_cache_usage;
+  } else if (in == "block-cache-usage") {
+    result = usage.block_cache_usage;
+  } else if (in == "block-cache-pinned-usage") {
+    result = usage.block_cache_pinned_usage;
+  } else if (in == "mem-table-usage") {
+    result = usage.mem_table_usage;
+  } else if (in == "imm-mem-table-usage") {
+    result = usage.imm_mem_table_usage;
+  } else if (in == "table-readers-usage") {
+    result = table_readers;
+  } else if (in == "read-amplification") {
+    result = read_amplification;
+  } else {
+    char buf[200];
+    std::snprintf(buf, sizeof(buf),
+                  "                    Memory(KB)\n"
+                  "Level  Files ReadAmp BlockCache    Index   Filter\n"
+                  "-------------------------------------------------\n");
+    value->append(buf);
+    for (size_t i = 0; i < usage.levels.size(); i++) {
+      const MemoryUsage::Level& l = usage.levels[i];
+      if (l.num_files > 0) {
+        std::snprintf(buf, sizeof(buf), "%3d %8d %7d %10.0f %8.0f %8.0f\n",
+                      static_cast<int>(i), l.num_files, l.read_amplification,
+                      l.block_cache_usage / 1024.0, l.index_usage / 1024.0,
+                      l.filter_usage / 1024.0);
+        value->append(buf);
+      }
+    }
+    std::snprintf(buf, sizeof(buf),
+                  "Read amplification: %d\n"
+                  "Table readers: %.0f KB\n"
+                  "Memtables: %.0f KB active, %.0f KB immutable\n"
+                  "Block cache: %.0f KB, %.0f KB pinned\n",
+                  read_amplification, table_readers / 1024.0,
+                  usage.mem_table_usage / 1024.0,
+                  usage.imm_mem_table_usage / 1024.0,
+                  usage.block_cache_usage / 1024.0,
+                  usage.block_cache_pinned_usage / 1024.0);
+    value->append(buf);
+    return true;
+  }
+  char buf[50];
+  std::snprintf(buf, sizeof(buf), "%llu",
+                static_cast<unsigned long long>(result));
+  value->append(buf);
+  return true;
+}
+
 bool DBImpl::GetProperty(const Slice& property, std::string* value) {
   value->clear();
 
-  MutexLock l(&mutex_);
   Slice in = property;
   Slice prefix("leveldb.");
   if (!in.starts_with(prefix)) return false;
   in.remove_prefix(prefix.size());
 
+  if (GetMemoryUsageProperty(in, value)) {
+    return true;
+  }
+
+  MutexLock l(&mutex_);
   if (in.starts_with("num-files-at-level")) {
     in.remove_prefix(strlen("num-files-at-level"));
     uint64_t level;
@@ -1427,6 +2834,7 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
                   "Level  Files Size(MB) Time(sec) Read(MB) Write(MB)\n"
                   "--------------------------------------------------\n");
     value->append(buf);
+    int64_t total_bytes_written = 0;
     for (int level = 0; level < config::kNumLevels; level++) {
       int files = versions_->NumLevelFiles(level);
       if (stats_[level].micros > 0 || files > 0) {
@@ -1437,6 +2845,13 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
                       stats_[level].bytes_written / 1048576.0);
         value->append(buf);
       }
+      total_bytes_written += stats_[level].bytes_written;
+    }
+    if (user_bytes_written_ > 0) {
+      std::snprintf(buf, sizeof(buf), "Write amplification: %.2f\n",
+                    static_cast<double>(total_bytes_written) /
+                        user_bytes_written_);
+      value->append(buf);
     }
     return true;
   } else if (in == "sstables") {
@@ -1492,6 +2907,35 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   return Write(opt, &batch);
 }
 
+Status DB::DeleteRange(const WriteOptions& opt, const Slice& begin_key,
+                       const Slice& end_key) {
+  WriteBatch batch;
+  batch.DeleteRange(begin_key, end_key);
+  return Write(opt, &batch);
+}
+
+Status DB::Merge(const WriteOptions& opt, const Slice& key,
+                 const Slice& value) {
+  WriteBatch batch;
+  batch.Merge(key, value);
+  return Write(opt, &batch);
+}
+
+Status DB::IngestExternalFiles(const std::vector<std::string>& /*files*/) {
+  return Status::NotSupported("IngestExternalFiles");
+}
+
+Status DB::StartTrace(const TraceOptions& /*options*/,
+                      const std::string& /*trace_path*/) {
+  return Status::NotSupported("StartTrace");
+}
+
+Status DB::EndTrace() { return Status::NotSupported("EndTrace"); }
+
+Status DB::GetMemoryUsage(MemoryUsage* /*usage*/) {
+  return Status::NotSupported("GetMemoryUsage");
+}
+
 DB::~DB() = default;
 
 Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
@@ -1528,6 +2972,13 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
     impl->MaybeScheduleCompaction();
   }
   impl->mutex_.Unlock();
+  if (s.ok() && options.table_preload_threads > 0) {
+    s = impl->PreloadTables();
+    if (!s.ok() && !options.paranoid_checks) {
+      // The table is opened again, and the error reported, on first use.
+      s = Status::OK();
+    }
+  }
   if (s.ok()) {
     assert(impl->mem_ != nullptr);
     *dbptr = impl;
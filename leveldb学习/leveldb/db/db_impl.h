@@ -9,18 +9,23 @@
 #include <deque>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
 #include "db/log_writer.h"
 #include "db/snapshot.h"
+#include "db/trace.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/listener.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
 
 namespace leveldb {
 
+class BlobCache;
 class MemTable;
+class RangeTombstoneSet;
 class TableCache;
 class Version;
 class VersionEdit;
@@ -39,6 +44,8 @@ class DBImpl : public DB {
   Status Put(const WriteOptions&, const Slice& key,
              const Slice& value) override;
   Status Delete(const WriteOptions&, const Slice& key) override;
+  Status Merge(const WriteOptions&, const Slice& key,
+               const Slice& value) override;
   Status Write(const WriteOptions& options, WriteBatch* updates) override;
   Status Get(const ReadOptions& options, const Slice& key,
              std::string* value) override;
@@ -48,6 +55,11 @@ class DBImpl : public DB {
   bool GetProperty(const Slice& property, std::string* value) override;
   void GetApproximateSizes(const Range* range, int n, uint64_t* sizes) override;
   void CompactRange(const Slice* begin, const Slice* end) override;
+  Status IngestExternalFiles(const std::vector<std::string>& files) override;
+  Status StartTrace(const TraceOptions& options,
+                    const std::string& trace_path) override;
+  Status EndTrace() override;
+  Status GetMemoryUsage(MemoryUsage* usage) override;
 
   // Extra methods (for testing) that are not in the public DB interface
 
@@ -66,11 +78,32 @@ class DBImpl : public DB {
   // file at a level >= 1.
   int64_t TEST_MaxNextLevelOverlappingBytes();
 
+  const Options& options() const { return options_; }
+
   // Record a sample of bytes read at the specified internal key.
   // Samples are taken approximately once every config::kReadBytesPeriod
   // bytes.
   void RecordReadSample(Slice key);
 
+  // Store in *value the value stored in a blob file that the encoded
+  // BlobIndex "blob_index" refers to.
+  Status ReadBlob(const ReadOptions& options, const Slice& blob_index,
+                  std::string* value);
+
+  // Store in *result the value of "user_key" that results from applying
+  // the merge "operands" (oldest first) to "existing_value", which is
+  // nullptr if the key has no value.
+  Status MergeValues(const Slice& user_key, const Slice* existing_value,
+                     const std::vector<Slice>& operands,
+                     std::string* result) const;
+
+  // Record an operation in the trace started by StartTrace(), if any.
+  void Trace(TraceType type, const Slice& payload) {
+    if (tracing_.load(std::memory_order_relaxed)) {
+      AddTraceRecord(type, payload);
+    }
+  }
+
  private:
   friend class DB;
   struct CompactionState;
@@ -101,9 +134,12 @@ class DBImpl : public DB {
     int64_t bytes_written;
   };
 
+  // If "range_tombstones" is non-null, also stores in it the range
+  // tombstones visible to the read, or nullptr if there are none.
   Iterator* NewInternalIterator(const ReadOptions&,
                                 SequenceNumber* latest_snapshot,
-                                uint32_t* seed);
+                                uint32_t* seed,
+                                RangeTombstoneSet** range_tombstones = nullptr);
 
   Status NewDB();
 
@@ -115,9 +151,20 @@ class DBImpl : public DB {
 
   void MaybeIgnoreError(Status* s) const;
 
+  void AddTraceRecord(TraceType type, const Slice& payload);
+
+  // GetProperty() for the properties computed from GetMemoryUsage(), which
+  // are read without holding mutex_ for long.  "name" has no "leveldb."
+  // prefix.  Returns false for other properties.
+  bool GetMemoryUsageProperty(const Slice& name, std::string* value);
+
   // Delete any unneeded files and stale in-memory entries.
   void RemoveObsoleteFiles() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Open the tables of the current version ahead of the first reads (see
+  // Options::table_preload_threads).
+  Status PreloadTables() LOCKS_EXCLUDED(mutex_);
+
   // Compact the in-memory write buffer to disk.  Switches to a new
   // log-file/memtable and writes a new descriptor iff successful.
   // Errors are recorded in bg_error_.
@@ -127,16 +174,38 @@ class DBImpl : public DB {
                         VersionEdit* edit, SequenceNumber* max_sequence)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
-      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Writes "mem" to a level-0 table.  "info" is filled in for the flush
+  // listeners when the table is written for a memtable compaction; it is
+  // null for tables written by recovery.
+  Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base,
+                          FlushJobInfo* info) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   Status MakeRoomForWrite(bool force /* compact even if there is room? */)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Wait for background work while writes are stalled, counting the time
+  // spent waiting in kStallMicros.
+  void WaitForStall() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Records the condition under which writes are stalled, and tells the
+  // listeners if it changed.  Returns true if mutex_ was released to do
+  // so, in which case the state that led to "condition" may be stale.
+  bool UpdateWriteStallCondition(WriteStallCondition condition)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   WriteBatch* BuildBatchGroup(Writer** last_writer)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   void RecordBackgroundError(const Status& s);
 
+  // Calls "callback" on every listener with "info", releasing mutex_
+  // meanwhile.
+  template <typename Info>
+  void NotifyListeners(void (EventListener::*callback)(DB*, const Info&),
+                       const Info& info) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Like NotifyListeners(), for callers that do not hold mutex_.
+  template <typename Info>
+  void NotifyListenersUnlocked(void (EventListener::*callback)(DB*,
+                                                               const Info&),
+                               const Info& info) LOCKS_EXCLUDED(mutex_);
+
   void MaybeScheduleCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   static void BGWork(void* db);
   void BackgroundCall();
@@ -146,8 +215,51 @@ class DBImpl : public DB {
   Status DoCompactionWork(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Reads the range tombstones of the compaction inputs, picks those the
+  // outputs must keep, and marks the "output_level" inputs that are
+  // deleted entirely so that they are not read.
+  Status CollectRangeTombstones(CompactionState* compact)
+      LOCKS_EXCLUDED(mutex_);
+  // Records the values of blob files that inputs deleted without being
+  // read refer to as garbage.
+  Status CountCoveredBlobGarbage(CompactionState* compact);
+  // Implements a compaction that only deletes its inputs.
+  Status DeleteCompactionInputs(CompactionState* compact)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   Status OpenCompactionOutputFile(CompactionState* compact);
+  // Adds to the current output the parts of the kept range tombstones
+  // that fall in its share of the key space, which ends where the next
+  // output starts: at the user key "input" is positioned at.
+  void AddOutputRangeTombstones(CompactionState* compact, Iterator* input);
   Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
+  Status OpenCompactionBlobFile(CompactionState* compact);
+  Status FinishCompactionBlobFile(CompactionState* compact);
+
+  // Moves the value of the entry "*key" => "*value" being compacted into or
+  // out of a blob file if needed: large values are separated, and values
+  // in blob files being garbage collected are copied to a new blob file
+  // (or back into the table when they are no longer large).  On return
+  // *key and *value describe the entry to write and may point into
+  // *compact.
+  Status RelocateValue(CompactionState* compact, const ParsedInternalKey& ikey,
+                       Slice* key, Slice* value);
+  // Combines the merge operand "input" is positioned at with the older
+  // entries for its user key, all of which every snapshot sees, and adds
+  // the result to the output.  Leaves "input" at the next user key.
+  Status FoldMergeOperands(CompactionState* compact, Iterator* input);
+  // Passes the value entry "*ikey" => "*value", which no snapshot sees,
+  // to Options::compaction_filter.  Sets *drop if the entry should be
+  // dropped, or else rewrites *ikey, *key and *value to what should be
+  // written in its place, which may point into *compact.
+  Status FilterValue(CompactionState* compact, ParsedInternalKey* ikey,
+                     Slice* key, Slice* value, bool* drop);
+  // Records the value that the encoded BlobIndex "blob_index" refers to
+  // as garbage.
+  void CountBlobGarbage(CompactionState* compact, const Slice& blob_index);
+  // Adds "key" => "value" to the current output, opening one if needed.
+  Status AddCompactionOutput(CompactionState* compact, const Slice& key,
+                             const Slice& value);
   Status InstallCompactionResults(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
@@ -155,6 +267,13 @@ class DBImpl : public DB {
     return internal_comparator_.user_comparator();
   }
 
+  // Returns the options for tables written to "level", which only differ
+  // from options_ in their compression.
+  const Options& TableOptionsForLevel(int level) const {
+    return level_table_options_.empty() ? options_
+                                        : level_table_options_[level];
+  }
+
   // Constant after construction
   Env* const env_;
   const InternalKeyComparator internal_comparator_;
@@ -164,8 +283,13 @@ class DBImpl : public DB {
   const bool owns_cache_;
   const std::string dbname_;
 
-  // table_cache_ provides its own synchronization
+  // Per-level copies of options_ with compression_per_level applied.
+  // Empty if compression_per_level is.
+  std::vector<Options> level_table_options_;
+
+  // table_cache_ and blob_cache_ provide their own synchronization
   TableCache* const table_cache_;
+  BlobCache* const blob_cache_;
 
   // Lock over the persistent DB state.  Non-null iff successfully acquired.
   FileLock* db_lock_;
@@ -197,12 +321,29 @@ class DBImpl : public DB {
 
   ManualCompaction* manual_compaction_ GUARDED_BY(mutex_);
 
+  // Is IngestExternalFiles() installing files?  No background work is
+  // scheduled meanwhile.
+  bool ingestion_in_progress_ GUARDED_BY(mutex_);
+
   VersionSet* const versions_ GUARDED_BY(mutex_);
 
   // Have we encountered a background error in paranoid mode?
   Status bg_error_ GUARDED_BY(mutex_);
 
   CompactionStats stats_[config::kNumLevels] GUARDED_BY(mutex_);
+
+  // Bytes of write batches applied since the database was opened, the
+  // base for the write amplification reported by the "stats" property
+  uint64_t user_bytes_written_ GUARDED_BY(mutex_);
+
+  // The condition under which writes were last stalled
+  WriteStallCondition write_stall_condition_ GUARDED_BY(mutex_);
+
+  // The trace being taken, if any.  trace_mutex_ is separate from mutex_
+  // so that reads do not take mutex_ a second time to record themselves.
+  port::Mutex trace_mutex_;
+  std::atomic<bool> tracing_;
+  TraceWriter* trace_writer_ GUARDED_BY(trace_mutex_);
 };
 
 // Sanitize db options.  The caller should delete result.info_log if
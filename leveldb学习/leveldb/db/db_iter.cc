@@ -4,15 +4,20 @@
 
 #include "db/db_iter.h"
 
+#include <algorithm>
+
 #include "db/db_impl.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/range_del.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "port/port.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/perf_context_imp.h"
 #include "util/random.h"
+#include "util/stop_watch.h"
 
 namespace leveldb {
 
@@ -45,35 +50,54 @@ class DBIter : public Iterator {
   //     just before all entries whose user key == this->key().
   enum Direction { kForward, kReverse };
 
-  DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
-         uint32_t seed)
+  DBIter(DBImpl* db, const ReadOptions& options, const Comparator* cmp,
+         Iterator* iter, SequenceNumber s, uint32_t seed,
+         RangeTombstoneSet* range_tombstones)
       : db_(db),
         user_comparator_(cmp),
         iter_(iter),
         sequence_(s),
+        range_tombstones_(range_tombstones),
         direction_(kForward),
+        value_type_(kTypeValue),
         valid_(false),
         rnd_(seed),
-        bytes_until_read_sampling_(RandomCompactionPeriod()) {}
+        bytes_until_read_sampling_(RandomCompactionPeriod()) {
+    blob_options_.verify_checksums = options.verify_checksums;
+    blob_options_.fill_cache = options.fill_cache;
+  }
 
   DBIter(const DBIter&) = delete;
   DBIter& operator=(const DBIter&) = delete;
 
-  ~DBIter() override { delete iter_; }
+  ~DBIter() override {
+    delete iter_;
+    delete range_tombstones_;
+  }
   bool Valid() const override { return valid_; }
   Slice key() const override {
     assert(valid_);
-    return (direction_ == kForward) ? ExtractUserKey(iter_->key()) : saved_key_;
+    return (direction_ == kForward && value_type_ != kTypeMerge)
+               ? ExtractUserKey(iter_->key())
+               : saved_key_;
   }
   Slice value() const override {
     assert(valid_);
-    return (direction_ == kForward) ? iter_->value() : saved_value_;
+    Slice raw_value = (direction_ == kForward && value_type_ != kTypeMerge)
+                          ? iter_->value()
+                          : saved_value_;
+    if (value_type_ == kTypeBlobIndex) {
+      return ReadBlobValue(raw_value);
+    }
+    return raw_value;
   }
   Status status() const override {
-    if (status_.ok()) {
-      return iter_->status();
-    } else {
+    if (!status_.ok()) {
       return status_;
+    } else if (!blob_status_.ok()) {
+      return blob_status_;
+    } else {
+      return iter_->status();
     }
   }
 
@@ -88,6 +112,25 @@ class DBIter : public Iterator {
   void FindPrevUserEntry();
   bool ParseKey(ParsedInternalKey* key);
 
+  // Applies the merge operands for saved_key_, starting at the one iter_ is
+  // positioned at, and leaves iter_ after the entries for saved_key_.
+  void MergeValuesNewToOld();
+
+  // Stores in saved_value_ the result of applying merge_operands_ (oldest
+  // first) to the raw value of type "existing_type" in saved_value_.
+  // Returns false on error.
+  bool ApplyMergeOperands(ValueType existing_type);
+
+  // Returns true if a range tombstone hides the entry "ikey".
+  bool IsCovered(const ParsedInternalKey& ikey) {
+    return range_tombstones_ != nullptr &&
+           range_tombstones_->MaxCoveringSeq(ikey.user_key) > ikey.sequence;
+  }
+
+  // Returns the value that "blob_index" refers to.  The result stays
+  // valid until the iterator is moved to an entry with a different blob.
+  Slice ReadBlobValue(const Slice& blob_index) const;
+
   inline void SaveKey(const Slice& k, std::string* dst) {
     dst->assign(k.data(), k.size());
   }
@@ -110,15 +153,44 @@ class DBIter : public Iterator {
   const Comparator* const user_comparator_;
   Iterator* const iter_;
   SequenceNumber const sequence_;
+  RangeTombstoneSet* const range_tombstones_;  // Null if there are none
   Status status_;
   std::string saved_key_;    // == current key when direction_==kReverse
   std::string saved_value_;  // == current raw value when direction_==kReverse
   Direction direction_;
+  // Type of the current entry's raw value.  kTypeMerge means that the
+  // current entry is the result of applying merge operands, held in
+  // saved_key_ and saved_value_ in both directions.
+  ValueType value_type_;
+  std::vector<std::string> merge_operands_;  // Scratch space for merging
+
+  ReadOptions blob_options_;  // Used to read values stored in blob files
+
+  // Blob value most recently read, and the index it was read from
+  mutable std::string blob_index_;
+  mutable std::string blob_value_;
+  mutable Status blob_status_;
+
   bool valid_;
   Random rnd_;
   size_t bytes_until_read_sampling_;
 };
 
+Slice DBIter::ReadBlobValue(const Slice& blob_index) const {
+  if (blob_index != Slice(blob_index_)) {
+    blob_index_.assign(blob_index.data(), blob_index.size());
+    Status s = db_->ReadBlob(blob_options_, blob_index, &blob_value_);
+    if (!s.ok()) {
+      blob_index_.clear();
+      blob_value_.clear();
+      if (blob_status_.ok()) {
+        blob_status_ = s;
+      }
+    }
+  }
+  return blob_value_;
+}
+
 inline bool DBIter::ParseKey(ParsedInternalKey* ikey) {
   Slice k = iter_->key();
 
@@ -157,6 +229,14 @@ void DBIter::Next() {
       return;
     }
     // saved_key_ already contains the key to skip past.
+  } else if (value_type_ == kTypeMerge) {
+    // iter_ is already past the entries for this->key(), which is in
+    // saved_key_.
+    if (!iter_->Valid()) {
+      valid_ = false;
+      saved_key_.clear();
+      return;
+    }
   } else {
     // Store in saved_key_ the current key so we skip it below.
     SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
@@ -187,19 +267,44 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
           // they are hidden by this deletion.
           SaveKey(ikey.user_key, skip);
           skipping = true;
+          PerfCounterAdd(&PerfContext::internal_delete_skipped_count);
           break;
         case kTypeValue:
+        case kTypeBlobIndex:
           if (skipping &&
               user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
             // Entry hidden
+          } else if (IsCovered(ikey)) {
+            // Hidden by a range tombstone, like every older entry for
+            // this key.
+            SaveKey(ikey.user_key, skip);
+            skipping = true;
           } else {
             valid_ = true;
+            value_type_ = ikey.type;
             saved_key_.clear();
             return;
           }
           break;
+        case kTypeMerge:
+          if (skipping &&
+              user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
+            // Entry hidden
+          } else if (IsCovered(ikey)) {
+            SaveKey(ikey.user_key, skip);
+            skipping = true;
+          } else {
+            SaveKey(ikey.user_key, &saved_key_);
+            MergeValuesNewToOld();
+            return;
+          }
+          break;
+        case kTypeRangeDeletion:
+          // Range tombstones are not part of the internal iterator.
+          break;
       }
     }
+    PerfCounterAdd(&PerfContext::internal_key_skipped_count);
     iter_->Next();
   } while (iter_->Valid());
   saved_key_.clear();
@@ -212,10 +317,19 @@ void DBIter::Prev() {
   if (direction_ == kForward) {  // Switch directions?
     // iter_ is pointing at the current entry.  Scan backwards until
     // the key changes so we can use the normal reverse scanning code.
-    assert(iter_->Valid());  // Otherwise valid_ would have been false
-    SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
-    while (true) {
+    if (value_type_ == kTypeMerge) {
+      // iter_ is past the entries for this->key(), which is in saved_key_.
+      if (iter_->Valid()) {
+        iter_->Prev();
+      } else {
+        iter_->SeekToLast();
+      }
+    } else {
+      assert(iter_->Valid());  // Otherwise valid_ would have been false
+      SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
       iter_->Prev();
+    }
+    while (true) {
       if (!iter_->Valid()) {
         valid_ = false;
         saved_key_.clear();
@@ -226,6 +340,7 @@ void DBIter::Prev() {
           0) {
         break;
       }
+      iter_->Prev();
     }
     direction_ = kReverse;
   }
@@ -237,6 +352,7 @@ void DBIter::FindPrevUserEntry() {
   assert(direction_ == kReverse);
 
   ValueType value_type = kTypeDeletion;
+  ValueType existing_type = kTypeDeletion;  // What merge operands apply to
   if (iter_->Valid()) {
     do {
       ParsedInternalKey ikey;
@@ -246,8 +362,18 @@ void DBIter::FindPrevUserEntry() {
           // We encountered a non-deleted value in entries for previous keys,
           break;
         }
-        value_type = ikey.type;
-        if (value_type == kTypeDeletion) {
+        const ValueType type = IsCovered(ikey) ? kTypeDeletion : ikey.type;
+        if (type == kTypeMerge) {
+          if (value_type != kTypeMerge) {
+            // The operands apply to the older entry in saved_value_, if any
+            existing_type = value_type;
+            merge_operands_.clear();
+          }
+          SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+          Slice operand = iter_->value();
+          merge_operands_.emplace_back(operand.data(), operand.size());
+        } else if (type == kTypeDeletion) {
+          PerfCounterAdd(&PerfContext::internal_delete_skipped_count);
           saved_key_.clear();
           ClearSavedValue();
         } else {
@@ -259,6 +385,7 @@ void DBIter::FindPrevUserEntry() {
           SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
           saved_value_.assign(raw_value.data(), raw_value.size());
         }
+        value_type = type;
       }
       iter_->Prev();
     } while (iter_->Valid());
@@ -271,17 +398,91 @@ void DBIter::FindPrevUserEntry() {
     ClearSavedValue();
     direction_ = kForward;
   } else {
-    valid_ = true;
+    valid_ = value_type != kTypeMerge || ApplyMergeOperands(existing_type);
+    value_type_ = value_type;
   }
 }
 
+void DBIter::MergeValuesNewToOld() {
+  merge_operands_.clear();
+  Slice operand = iter_->value();
+  merge_operands_.emplace_back(operand.data(), operand.size());
+  ClearSavedValue();
+  ValueType existing_type = kTypeDeletion;
+  bool reached_bottom = false;  // Found what the operands apply to?
+  for (iter_->Next(); iter_->Valid(); iter_->Next()) {
+    ParsedInternalKey ikey;
+    if (!ParseKey(&ikey)) {
+      continue;
+    }
+    if (user_comparator_->Compare(ikey.user_key, saved_key_) != 0) {
+      break;
+    }
+    if (reached_bottom || ikey.sequence > sequence_) {
+      continue;
+    }
+    if (IsCovered(ikey)) {
+      reached_bottom = true;
+      continue;
+    }
+    switch (ikey.type) {
+      case kTypeMerge:
+        operand = iter_->value();
+        merge_operands_.emplace_back(operand.data(), operand.size());
+        break;
+      case kTypeValue:
+      case kTypeBlobIndex:
+        saved_value_.assign(iter_->value().data(), iter_->value().size());
+        existing_type = ikey.type;
+        reached_bottom = true;
+        break;
+      case kTypeDeletion:
+      case kTypeRangeDeletion:
+        reached_bottom = true;
+        break;
+    }
+  }
+  std::reverse(merge_operands_.begin(), merge_operands_.end());
+  valid_ = ApplyMergeOperands(existing_type);
+  value_type_ = kTypeMerge;
+}
+
+bool DBIter::ApplyMergeOperands(ValueType existing_type) {
+  std::string existing_value;
+  if (existing_type == kTypeValue) {
+    existing_value.swap(saved_value_);
+  } else if (existing_type == kTypeBlobIndex) {
+    Status s = db_->ReadBlob(blob_options_, saved_value_, &existing_value);
+    if (!s.ok()) {
+      status_ = s;
+      return false;
+    }
+  }
+  const Slice existing(existing_value);
+  std::vector<Slice> operands(merge_operands_.begin(), merge_operands_.end());
+  Status s = db_->MergeValues(
+      saved_key_, existing_type == kTypeDeletion ? nullptr : &existing,
+      operands, &saved_value_);
+  merge_operands_.clear();
+  if (!s.ok()) {
+    status_ = s;
+    return false;
+  }
+  return true;
+}
+
 void DBIter::Seek(const Slice& target) {
+  db_->Trace(kTraceSeek, target);
+  StopWatch timer(db_->options().env, db_->options().statistics, kSeekMicros);
   direction_ = kForward;
   ClearSavedValue();
   saved_key_.clear();
   AppendInternalKey(&saved_key_,
                     ParsedInternalKey(target, sequence_, kValueTypeForSeek));
-  iter_->Seek(saved_key_);
+  {
+    PerfTimer seek_timer(&PerfContext::seek_internal_seek_nanos);
+    iter_->Seek(saved_key_);
+  }
   if (iter_->Valid()) {
     FindNextUserEntry(false, &saved_key_ /* temporary storage */);
   } else {
@@ -290,6 +491,7 @@ void DBIter::Seek(const Slice& target) {
 }
 
 void DBIter::SeekToFirst() {
+  db_->Trace(kTraceSeekToFirst, Slice());
   direction_ = kForward;
   ClearSavedValue();
   iter_->SeekToFirst();
@@ -301,6 +503,7 @@ void DBIter::SeekToFirst() {
 }
 
 void DBIter::SeekToLast() {
+  db_->Trace(kTraceSeekToLast, Slice());
   direction_ = kReverse;
   ClearSavedValue();
   iter_->SeekToLast();
@@ -309,10 +512,12 @@ void DBIter::SeekToLast() {
 
 }  // anonymous namespace
 
-Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
+Iterator* NewDBIterator(DBImpl* db, const ReadOptions& options,
+                        const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed) {
-  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+                        uint32_t seed, RangeTombstoneSet* range_tombstones) {
+  return new DBIter(db, options, user_key_comparator, internal_iter, sequence,
+                    seed, range_tombstones);
 }
 
 }  // namespace leveldb
@@ -13,13 +13,18 @@
 namespace leveldb {
 
 class DBImpl;
+class RangeTombstoneSet;
 
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
-Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
+// into appropriate user keys.  Values stored in blob files are read
+// from "db" using "options".  Entries hidden by "range_tombstones" are
+// skipped; the iterator takes ownership of it, and it may be null.
+Iterator* NewDBIterator(DBImpl* db, const ReadOptions& options,
+                        const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed);
+                        uint32_t seed,
+                        RangeTombstoneSet* range_tombstones = nullptr);
 
 }  // namespace leveldb
 
@@ -6,19 +6,31 @@
 
 #include <atomic>
 #include <cinttypes>
+#include <cstring>
+#include <memory>
+#include <set>
 #include <string>
+#include <thread>
 
 #include "gtest/gtest.h"
 #include "db/db_impl.h"
 #include "db/filename.h"
+#include "db/trace.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
 #include "leveldb/cache.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/listener.h"
+#include "leveldb/merge_operator.h"
+#include "leveldb/perf_context.h"
+#include "leveldb/sst_file_writer.h"
+#include "leveldb/statistics.h"
 #include "leveldb/table.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
+#include "util/coding.h"
 #include "util/hash.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
@@ -351,6 +363,10 @@ class DBTest : public testing::Test {
 
   Status Delete(const std::string& k) { return db_->Delete(WriteOptions(), k); }
 
+  Status DeleteRange(const std::string& begin, const std::string& end) {
+    return db_->DeleteRange(WriteOptions(), begin, end);
+  }
+
   std::string Get(const std::string& k, const Snapshot* snapshot = nullptr) {
     ReadOptions options;
     options.snapshot = snapshot;
@@ -420,6 +436,15 @@ class DBTest : public testing::Test {
             case kTypeDeletion:
               result += "DEL";
               break;
+            case kTypeBlobIndex:
+              result += "BLOB";
+              break;
+            case kTypeRangeDeletion:
+              result += "RANGEDEL";
+              break;
+            case kTypeMerge:
+              result += "MERGE " + iter->value().ToString();
+              break;
           }
         }
         iter->Next();
@@ -542,6 +567,21 @@ class DBTest : public testing::Test {
     return false;
   }
 
+  // Returns the numbers of the blob files in the database directory.
+  std::set<uint64_t> BlobFiles() {
+    std::vector<std::string> filenames;
+    EXPECT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+    std::set<uint64_t> result;
+    uint64_t number;
+    FileType type;
+    for (size_t i = 0; i < filenames.size(); i++) {
+      if (ParseFileName(filenames[i], &number, &type) && type == kBlobFile) {
+        result.insert(number);
+      }
+    }
+    return result;
+  }
+
   // Returns number of files renamed.
   int RenameLDBToSST() {
     std::vector<std::string> filenames;
@@ -1154,6 +1194,282 @@ TEST_F(DBTest, CompactionsGenerateMultipleFiles) {
   }
 }
 
+TEST_F(DBTest, CompressionPerLevel) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000000;  // Large write buffer
+  options.compression_per_level = {kNoCompression, kZstdCompression};
+  Reopen(&options);
+
+  Random rnd(301);
+  std::vector<std::string> values;
+  for (int i = 0; i < 100; i++) {
+    std::string value;
+    test::CompressibleString(&rnd, 0.25, 10000, &value);
+    values.push_back(value);
+    ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+  }
+
+  // Reopening moves updates to level-0, which is stored uncompressed.
+  Reopen(&options);
+  ASSERT_EQ(1, NumTableFilesAtLevel(0));
+  const uint64_t level0_size = Size("", Key(100));
+  ASSERT_GE(level0_size, 100 * 10000);
+
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  ASSERT_GT(NumTableFilesAtLevel(1), 0);
+  std::string compressed;
+  if (port::Zstd_Compress(/*level=*/1, values[0].data(), values[0].size(),
+                          &compressed)) {
+    ASSERT_LT(Size("", Key(100)), level0_size / 2);
+  }
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+}
+
+// Writes "entries" to the external table "fname".  A null value adds a
+// deletion.
+static Status WriteExternalFile(
+    const Options& options, const std::string& fname,
+    const std::vector<std::pair<std::string, const char*>>& entries) {
+  SstFileWriter writer(options);
+  Status s = writer.Open(fname);
+  for (size_t i = 0; s.ok() && i < entries.size(); i++) {
+    if (entries[i].second == nullptr) {
+      s = writer.Delete(entries[i].first);
+    } else {
+      s = writer.Put(entries[i].first, entries[i].second);
+    }
+  }
+  if (s.ok()) {
+    s = writer.Finish();
+  }
+  return s;
+}
+
+TEST_F(DBTest, IngestExternalFiles) {
+  do {
+    Options options = CurrentOptions();
+    const std::string file1 = dbname_ + "_ext1.sst";
+    const std::string file2 = dbname_ + "_ext2.sst";
+    ASSERT_LEVELDB_OK(
+        WriteExternalFile(options, file1, {{"a", "va"}, {"b", "vb"}}));
+    ASSERT_LEVELDB_OK(
+        WriteExternalFile(options, file2, {{"x", "vx"}, {"y", "vy"}}));
+
+    ASSERT_LEVELDB_OK(db_->IngestExternalFiles({file2, file1}));
+    env_->RemoveFile(file1);
+    env_->RemoveFile(file2);
+
+    // Nothing else overlaps, so both files sink to the last level.
+    ASSERT_EQ(2, NumTableFilesAtLevel(config::kNumLevels - 1));
+    ASSERT_EQ("va", Get("a"));
+    ASSERT_EQ("vy", Get("y"));
+    ASSERT_EQ("NOT_FOUND", Get("c"));
+    ASSERT_EQ("(a->va)(b->vb)(x->vx)(y->vy)", Contents());
+
+    Reopen();
+    ASSERT_EQ("va", Get("a"));
+    ASSERT_EQ("vx", Get("x"));
+  } while (ChangeOptions());
+}
+
+TEST_F(DBTest, IngestExternalFilesOverwrites) {
+  ASSERT_LEVELDB_OK(Put("k1", "old1"));
+  ASSERT_LEVELDB_OK(Put("k2", "old2"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_LEVELDB_OK(Put("k3", "old3"));  // Left in the memtable
+  const Snapshot* snapshot = db_->GetSnapshot();
+
+  const std::string file = dbname_ + "_ext.sst";
+  ASSERT_LEVELDB_OK(
+      WriteExternalFile(CurrentOptions(), file,
+                        {{"k1", "new1"}, {"k2", nullptr}, {"k3", "new3"}}));
+  ASSERT_LEVELDB_OK(db_->IngestExternalFiles({file}));
+  env_->RemoveFile(file);
+
+  ASSERT_EQ("new1", Get("k1"));
+  ASSERT_EQ("NOT_FOUND", Get("k2"));
+  ASSERT_EQ("new3", Get("k3"));
+  ASSERT_EQ("(k1->new1)(k3->new3)", Contents());
+  ASSERT_EQ("old1", Get("k1", snapshot));
+  ASSERT_EQ("old2", Get("k2", snapshot));
+  ASSERT_EQ("old3", Get("k3", snapshot));
+
+  // Later writes are newer than the ingested entries.
+  ASSERT_LEVELDB_OK(Put("k1", "newer1"));
+  ASSERT_EQ("newer1", Get("k1"));
+
+  db_->ReleaseSnapshot(snapshot);
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("newer1", Get("k1"));
+  ASSERT_EQ("NOT_FOUND", Get("k2"));
+  ASSERT_EQ("new3", Get("k3"));
+  Reopen();
+  ASSERT_EQ("(k1->newer1)(k3->new3)", Contents());
+}
+
+TEST_F(DBTest, IngestExternalFilesErrors) {
+  Options options = CurrentOptions();
+  const std::string file1 = dbname_ + "_ext1.sst";
+  const std::string file2 = dbname_ + "_ext2.sst";
+
+  SstFileWriter writer(options);
+  ASSERT_LEVELDB_OK(writer.Open(file1));
+  ASSERT_LEVELDB_OK(writer.Put("b", "v"));
+  ASSERT_TRUE(writer.Put("a", "v").IsInvalidArgument());
+  ASSERT_TRUE(writer.Put("b", "v").IsInvalidArgument());
+  ASSERT_LEVELDB_OK(writer.Put("c", "v"));
+  ASSERT_LEVELDB_OK(writer.Finish());
+  ASSERT_TRUE(writer.Finish().IsInvalidArgument());
+
+  ASSERT_LEVELDB_OK(WriteExternalFile(options, file2, {{"c", "v"}}));
+  ASSERT_TRUE(db_->IngestExternalFiles({file1, file2}).IsInvalidArgument());
+  ASSERT_FALSE(db_->IngestExternalFiles({dbname_ + "_missing.sst"}).ok());
+  ASSERT_EQ("NOT_FOUND", Get("b"));
+  ASSERT_EQ(0, TotalTableFiles());
+  env_->RemoveFile(file1);
+  env_->RemoveFile(file2);
+}
+
+TEST_F(DBTest, BlobValues) {
+  Options options = CurrentOptions();
+  options.blob_value_threshold = 1000;
+  Reopen(&options);
+
+  Random rnd(301);
+  const std::string big1 = RandomString(&rnd, 5000);
+  const std::string big2 = RandomString(&rnd, 1000);
+  ASSERT_LEVELDB_OK(Put("a", "small"));
+  ASSERT_LEVELDB_OK(Put("b", big1));
+  ASSERT_LEVELDB_OK(Put("c", big2));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(1, BlobFiles().size());
+  ASSERT_EQ("[ small ]", AllEntriesFor("a"));
+  ASSERT_EQ("[ BLOB ]", AllEntriesFor("b"));
+  ASSERT_EQ("[ BLOB ]", AllEntriesFor("c"));
+
+  ASSERT_EQ("small", Get("a"));
+  ASSERT_EQ(big1, Get("b"));
+  ASSERT_EQ(big2, Get("c"));
+  ASSERT_EQ("(a->small)(b->" + big1 + ")(c->" + big2 + ")", Contents());
+
+  // Compactions move only the references.
+  db_->CompactRange(nullptr, nullptr);
+  Reopen(&options);
+  ASSERT_EQ(1, BlobFiles().size());
+  ASSERT_EQ(big1, Get("b"));
+  ASSERT_EQ("(a->small)(b->" + big1 + ")(c->" + big2 + ")", Contents());
+
+  // Separated values stay readable when separation is turned off.
+  options.blob_value_threshold = 0;
+  Reopen(&options);
+  ASSERT_EQ(big1, Get("b"));
+  ASSERT_EQ(big2, Get("c"));
+}
+
+TEST_F(DBTest, BlobGarbageCollection) {
+  Options options = CurrentOptions();
+  options.blob_value_threshold = 1000;
+  options.blob_garbage_collection_ratio = 0.5;
+  Reopen(&options);
+
+  // Pushes everything down to the last level, merging with what is there.
+  auto compact_all = [this]() {
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    for (int level = 0; level < config::kNumLevels - 1; level++) {
+      dbfull()->TEST_CompactRange(level, nullptr, nullptr);
+    }
+  };
+
+  Random rnd(301);
+  std::vector<std::string> values;
+  for (int i = 0; i < 10; i++) {
+    values.push_back(RandomString(&rnd, 2000));
+    ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  const Snapshot* snapshot = db_->GetSnapshot();
+  const std::vector<std::string> old_values = values;
+  for (int i = 0; i < 10; i++) {
+    values[i] = RandomString(&rnd, 2000);
+    ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  const std::set<uint64_t> initial_blob_files = BlobFiles();
+  ASSERT_EQ(2, initial_blob_files.size());
+  const uint64_t first_blob_file = *initial_blob_files.begin();
+  const uint64_t second_blob_file = *initial_blob_files.rbegin();
+
+  // The snapshot keeps the overwritten values alive.
+  compact_all();
+  ASSERT_EQ(initial_blob_files, BlobFiles());
+  ASSERT_EQ(old_values[3], Get(Key(3), snapshot));
+  db_->ReleaseSnapshot(snapshot);
+
+  // Dropping the overwritten values leaves the first blob file entirely
+  // garbage, and overwriting most values of the second one makes it a
+  // garbage collection candidate.
+  for (int i = 0; i < 6; i++) {
+    values[i] = RandomString(&rnd, 2000);
+    ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+  }
+  compact_all();
+  std::set<uint64_t> blob_files = BlobFiles();
+  ASSERT_EQ(2, blob_files.size());
+  ASSERT_EQ(0, blob_files.count(first_blob_file));
+  ASSERT_EQ(1, blob_files.count(second_blob_file));
+
+  // The next compaction copies the remaining values out of it.
+  Reopen(&options);
+  values[9] = "small";
+  ASSERT_LEVELDB_OK(Put(Key(9), values[9]));
+  compact_all();
+  blob_files = BlobFiles();
+  ASSERT_EQ(2, blob_files.size());
+  ASSERT_EQ(0, blob_files.count(second_blob_file));
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+  Reopen(&options);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+}
+
+TEST_F(DBTest, BlobFilesAfterRepair) {
+  Options options = CurrentOptions();
+  options.blob_value_threshold = 1000;
+  Reopen(&options);
+
+  Random rnd(301);
+  const std::string big1 = RandomString(&rnd, 5000);
+  const std::string big2 = RandomString(&rnd, 3000);
+  ASSERT_LEVELDB_OK(Put("a", big1));
+  ASSERT_LEVELDB_OK(Put("b", big2));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(1, BlobFiles().size());
+
+  Close();
+  ASSERT_LEVELDB_OK(RepairDB(dbname_, options));
+  Reopen(&options);
+  ASSERT_EQ(1, BlobFiles().size());
+  ASSERT_EQ(big1, Get("a"));
+  ASSERT_EQ(big2, Get("b"));
+
+  // Once the references are compacted away the repaired blob file is all
+  // garbage and gets deleted.
+  ASSERT_LEVELDB_OK(Put("a", "small"));
+  ASSERT_LEVELDB_OK(Put("b", "small"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, nullptr, nullptr);
+  }
+  ASSERT_EQ(0, BlobFiles().size());
+  ASSERT_EQ("small", Get("a"));
+}
+
 TEST_F(DBTest, RepeatedWritesToSameKey) {
   Options options = CurrentOptions();
   options.env = env_;
@@ -1463,109 +1779,618 @@ TEST_F(DBTest, DeletionMarkers2) {
   ASSERT_EQ(AllEntriesFor("foo"), "[ ]");
 }
 
-TEST_F(DBTest, OverlapInLevel0) {
+TEST_F(DBTest, DeleteRange) {
   do {
-    ASSERT_EQ(config::kMaxMemCompactLevel, 2) << "Fix test to match config";
-
-    // Fill levels 1 and 2 to disable the pushing of new memtables to levels >
-    // 0.
-    ASSERT_LEVELDB_OK(Put("100", "v100"));
-    ASSERT_LEVELDB_OK(Put("999", "v999"));
-    dbfull()->TEST_CompactMemTable();
-    ASSERT_LEVELDB_OK(Delete("100"));
-    ASSERT_LEVELDB_OK(Delete("999"));
-    dbfull()->TEST_CompactMemTable();
-    ASSERT_EQ("0,1,1", FilesPerLevel());
-
-    // Make files spanning the following ranges in level-0:
-    //  files[0]  200 .. 900
-    //  files[1]  300 .. 500
-    // Note that files are sorted by smallest key.
-    ASSERT_LEVELDB_OK(Put("300", "v300"));
-    ASSERT_LEVELDB_OK(Put("500", "v500"));
-    dbfull()->TEST_CompactMemTable();
-    ASSERT_LEVELDB_OK(Put("200", "v200"));
-    ASSERT_LEVELDB_OK(Put("600", "v600"));
-    ASSERT_LEVELDB_OK(Put("900", "v900"));
-    dbfull()->TEST_CompactMemTable();
-    ASSERT_EQ("2,1,1", FilesPerLevel());
-
-    // Compact away the placeholder files we created initially
-    dbfull()->TEST_CompactRange(1, nullptr, nullptr);
-    dbfull()->TEST_CompactRange(2, nullptr, nullptr);
-    ASSERT_EQ("2", FilesPerLevel());
+    ASSERT_LEVELDB_OK(Put("a", "va"));
+    ASSERT_LEVELDB_OK(Put("b", "vb"));
+    ASSERT_LEVELDB_OK(Put("c", "vc"));
+    ASSERT_LEVELDB_OK(Put("d", "vd"));
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_LEVELDB_OK(DeleteRange("b", "d"));
+    ASSERT_LEVELDB_OK(DeleteRange("z", "a"));  // Empty range
+    ASSERT_LEVELDB_OK(Put("c", "vc2"));
+
+    for (int i = 0; i < 3; i++) {
+      ASSERT_EQ("va", Get("a"));
+      ASSERT_EQ("NOT_FOUND", Get("b"));
+      ASSERT_EQ("vc2", Get("c"));
+      ASSERT_EQ("vd", Get("d"));
+      ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+      ASSERT_EQ("vb", Get("b", snapshot));
+      ASSERT_EQ("vc", Get("c", snapshot));
+      if (i == 0) {
+        ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+      } else if (i == 1) {
+        db_->CompactRange(nullptr, nullptr);
+      }
+    }
 
-    // Do a memtable compaction.  Before bug-fix, the compaction would
-    // not detect the overlap with level-0 files and would incorrectly place
-    // the deletion in a deeper level.
-    ASSERT_LEVELDB_OK(Delete("600"));
-    dbfull()->TEST_CompactMemTable();
-    ASSERT_EQ("3", FilesPerLevel());
-    ASSERT_EQ("NOT_FOUND", Get("600"));
+    db_->ReleaseSnapshot(snapshot);
+    Reopen();
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
   } while (ChangeOptions());
 }
 
-TEST_F(DBTest, L0_CompactionBug_Issue44_a) {
-  Reopen();
-  ASSERT_LEVELDB_OK(Put("b", "v"));
-  Reopen();
-  ASSERT_LEVELDB_OK(Delete("b"));
-  ASSERT_LEVELDB_OK(Delete("a"));
-  Reopen();
-  ASSERT_LEVELDB_OK(Delete("a"));
-  Reopen();
-  ASSERT_LEVELDB_OK(Put("a", "v"));
-  Reopen();
-  Reopen();
-  ASSERT_EQ("(a->v)", Contents());
-  DelayMilliseconds(1000);  // Wait for compaction to finish
-  ASSERT_EQ("(a->v)", Contents());
+TEST_F(DBTest, DeleteRangeOverlappingTombstones) {
+  ASSERT_LEVELDB_OK(Put("a", "va"));
+  ASSERT_LEVELDB_OK(Put("c", "vc"));
+  ASSERT_LEVELDB_OK(Put("e", "ve"));
+  const Snapshot* s1 = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(DeleteRange("b", "d"));
+  ASSERT_LEVELDB_OK(Put("c", "vc2"));
+  const Snapshot* s2 = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(DeleteRange("a", "f"));
+  ASSERT_LEVELDB_OK(Put("e", "ve2"));
+  ASSERT_LEVELDB_OK(DeleteRange("c", "d"));
+
+  // Once from the memtable, once from a table.
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ("va", Get("a", s1));
+    ASSERT_EQ("vc", Get("c", s1));
+    ASSERT_EQ("ve", Get("e", s1));
+    ASSERT_EQ("va", Get("a", s2));
+    ASSERT_EQ("vc2", Get("c", s2));
+    ASSERT_EQ("ve", Get("e", s2));
+    ASSERT_EQ("NOT_FOUND", Get("a"));
+    ASSERT_EQ("NOT_FOUND", Get("c"));
+    ASSERT_EQ("ve2", Get("e"));
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  }
+  db_->ReleaseSnapshot(s1);
+  db_->ReleaseSnapshot(s2);
 }
 
-TEST_F(DBTest, L0_CompactionBug_Issue44_b) {
-  Reopen();
-  Put("", "");
-  Reopen();
-  Delete("e");
-  Put("", "");
-  Reopen();
-  Put("c", "cv");
-  Reopen();
-  Put("", "");
-  Reopen();
-  Put("", "");
-  DelayMilliseconds(1000);  // Wait for compaction to finish
-  Reopen();
-  Put("d", "dv");
-  Reopen();
-  Put("", "");
-  Reopen();
-  Delete("d");
-  Delete("b");
-  Reopen();
-  ASSERT_EQ("(->)(c->cv)", Contents());
-  DelayMilliseconds(1000);  // Wait for compaction to finish
-  ASSERT_EQ("(->)(c->cv)", Contents());
+TEST_F(DBTest, DeleteRangeAcrossLevels) {
+  // Values in the last level, deleted by a tombstone in a newer file.
+  for (int i = 0; i < 100; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), "v" + Key(i)));
+  }
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_LEVELDB_OK(DeleteRange(Key(10), Key(90)));
+  ASSERT_LEVELDB_OK(Put(Key(50), "new"));
+
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ("v" + Key(9), Get(Key(9)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(10)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(89)));
+    ASSERT_EQ("new", Get(Key(50)));
+    ASSERT_EQ("v" + Key(90), Get(Key(90)));
+
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      count++;
+    }
+    ASSERT_EQ(21, count);
+    iter->Seek(Key(20));
+    ASSERT_EQ(Key(50) + "->new", IterStatus(iter));
+    iter->Prev();
+    ASSERT_EQ(Key(9) + "->v" + Key(9), IterStatus(iter));
+    iter->Next();
+    ASSERT_EQ(Key(50) + "->new", IterStatus(iter));
+    iter->Next();
+    ASSERT_EQ(Key(90) + "->v" + Key(90), IterStatus(iter));
+    delete iter;
+
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  }
+
+  // Compacting everything drops the deleted entries and the tombstone.
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("[ v" + Key(9) + " ]", AllEntriesFor(Key(9)));
+  ASSERT_EQ("[ ]", AllEntriesFor(Key(10)));
+  ASSERT_EQ("[ new ]", AllEntriesFor(Key(50)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(10)));
 }
 
-TEST_F(DBTest, Fflush_Issue474) {
-  static const int kNum = 100000;
-  Random rnd(test::RandomSeed());
-  for (int i = 0; i < kNum; i++) {
-    std::fflush(nullptr);
-    ASSERT_LEVELDB_OK(Put(RandomKey(&rnd), RandomString(&rnd, 100)));
+TEST_F(DBTest, DeleteRangeDropsCoveredFiles) {
+  Options options = CurrentOptions();
+  options.max_file_size = 1 << 20;  // Smallest allowed
+  Reopen(&options);
+
+  // Write everything twice so that compactions merge instead of moving
+  // the memtable's single file down.
+  Random rnd(301);
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < 300; i++) {
+      ASSERT_LEVELDB_OK(Put(Key(i), RandomString(&rnd, 10000)));
+    }
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
   }
+  db_->CompactRange(nullptr, nullptr);
+  const int files = TotalTableFiles();
+  ASSERT_GT(files, 1);
+
+  ASSERT_LEVELDB_OK(DeleteRange(Key(0), Key(300)));
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(0, TotalTableFiles());
+  ASSERT_EQ("", Contents());
+  ASSERT_EQ("NOT_FOUND", Get(Key(100)));
 }
 
-TEST_F(DBTest, ComparatorCheck) {
-  class NewComparator : public Comparator {
-   public:
-    const char* Name() const override { return "leveldb.NewComparator"; }
-    int Compare(const Slice& a, const Slice& b) const override {
-      return BytewiseComparator()->Compare(a, b);
+namespace {
+
+// Appends operands to the value, separated by commas.
+class AppendOperator : public MergeOperator {
+ public:
+  const char* Name() const override { return "AppendOperator"; }
+
+  bool FullMerge(const Slice& key, const Slice* existing_value,
+                 const std::vector<Slice>& operands,
+                 std::string* new_value) const override {
+    if (existing_value != nullptr) {
+      new_value->assign(existing_value->data(), existing_value->size());
     }
-    void FindShortestSeparator(std::string* s, const Slice& l) const override {
-      BytewiseComparator()->FindShortestSeparator(s, l);
+    for (const Slice& operand : operands) {
+      if (!new_value->empty()) {
+        new_value->push_back(',');
+      }
+      new_value->append(operand.data(), operand.size());
+    }
+    return true;
+  }
+
+  bool PartialMerge(const Slice& key, const Slice& older_operand,
+                    const Slice& newer_operand,
+                    std::string* new_value) const override {
+    *new_value = older_operand.ToString() + "," + newer_operand.ToString();
+    return true;
+  }
+};
+
+}  // namespace
+
+TEST_F(DBTest, Merge) {
+  AppendOperator append;
+  do {
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    options.merge_operator = &append;
+    DestroyAndReopen(&options);
+
+    ASSERT_LEVELDB_OK(Put("a", "x"));
+    ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "a", "y"));
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "a", "z"));
+    ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "b", "p"));
+    ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "c", "q"));
+    ASSERT_LEVELDB_OK(Delete("c"));
+    ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "c", "r"));
+    ASSERT_LEVELDB_OK(Put("d", "v"));
+
+    for (int i = 0; i < 3; i++) {
+      ASSERT_EQ("x,y,z", Get("a"));
+      ASSERT_EQ("p", Get("b"));
+      ASSERT_EQ("r", Get("c"));
+      ASSERT_EQ("x,y", Get("a", snapshot));
+      ASSERT_EQ("NOT_FOUND", Get("b", snapshot));
+      ASSERT_EQ("(a->x,y,z)(b->p)(c->r)(d->v)", Contents());
+
+      // Switch directions on merged entries
+      Iterator* iter = db_->NewIterator(ReadOptions());
+      iter->Seek("b");
+      ASSERT_EQ("b->p", IterStatus(iter));
+      iter->Prev();
+      ASSERT_EQ("a->x,y,z", IterStatus(iter));
+      iter->Next();
+      ASSERT_EQ("b->p", IterStatus(iter));
+      iter->Next();
+      ASSERT_EQ("c->r", IterStatus(iter));
+      iter->Prev();
+      ASSERT_EQ("b->p", IterStatus(iter));
+      delete iter;
+
+      if (i == 0) {
+        ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+      } else if (i == 1) {
+        db_->CompactRange(nullptr, nullptr);
+      }
+    }
+    db_->ReleaseSnapshot(snapshot);
+  } while (ChangeOptions());
+}
+
+TEST_F(DBTest, MergeRequiresOperator) {
+  ASSERT_TRUE(db_->Merge(WriteOptions(), "a", "b").IsInvalidArgument());
+
+  // Operands written by a batch cannot be read without one.
+  WriteBatch batch;
+  batch.Merge("a", "b");
+  ASSERT_LEVELDB_OK(db_->Write(WriteOptions(), &batch));
+  std::string value;
+  ASSERT_TRUE(db_->Get(ReadOptions(), "a", &value).IsNotSupportedError());
+}
+
+TEST_F(DBTest, MergeCompaction) {
+  AppendOperator append;
+  Options options = CurrentOptions();
+  options.merge_operator = &append;
+  Reopen(&options);
+
+  ASSERT_LEVELDB_OK(Put("foo", "v1"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  const int last = config::kMaxMemCompactLevel;
+  ASSERT_EQ(NumTableFilesAtLevel(last), 1);  // foo => v1 is now in last level
+
+  // Place a table at level last-1 to prevent merging with preceding mutation
+  ASSERT_LEVELDB_OK(Put("a", "begin"));
+  ASSERT_LEVELDB_OK(Put("z", "end"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(NumTableFilesAtLevel(last), 1);
+  ASSERT_EQ(NumTableFilesAtLevel(last - 1), 1);
+
+  ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "foo", "v2"));
+  ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "foo", "v3"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());  // Moves to level last-2
+  ASSERT_EQ(AllEntriesFor("foo"), "[ MERGE v3, MERGE v2, v1 ]");
+  dbfull()->TEST_CompactRange(last - 2, nullptr, nullptr);
+  // The value is in a level that is not being compacted, so the operands
+  // are combined into one.
+  ASSERT_EQ(AllEntriesFor("foo"), "[ MERGE v2,v3, v1 ]");
+  ASSERT_EQ("v1,v2,v3", Get("foo"));
+  dbfull()->TEST_CompactRange(last - 1, nullptr, nullptr);
+  // Merging last-1 w/ last applies the operand to the value.
+  ASSERT_EQ(AllEntriesFor("foo"), "[ v1,v2,v3 ]");
+  ASSERT_EQ("v1,v2,v3", Get("foo"));
+}
+
+namespace {
+
+// Removes keys that start with "drop" and upper-cases the values of keys
+// that start with "upper".
+class PrefixFilter : public CompactionFilter {
+ public:
+  const char* Name() const override { return "PrefixFilter"; }
+
+  Decision Filter(int level, const Slice& key, const Slice& existing_value,
+                  std::string* new_value) const override {
+    if (key.starts_with("drop")) {
+      return kRemove;
+    }
+    if (key.starts_with("upper")) {
+      for (size_t i = 0; i < existing_value.size(); i++) {
+        new_value->push_back(toupper(existing_value[i]));
+      }
+      return kChangeValue;
+    }
+    return kKeep;
+  }
+};
+
+std::string TTLValue(const std::string& value, uint64_t write_time) {
+  std::string result = value;
+  PutFixed64(&result, write_time);
+  return result;
+}
+
+}  // namespace
+
+TEST_F(DBTest, CompactionFilter) {
+  PrefixFilter filter;
+  Options options = CurrentOptions();
+  options.compaction_filter = &filter;
+  Reopen(&options);
+
+  ASSERT_LEVELDB_OK(Put("drop1", "v1"));
+  ASSERT_LEVELDB_OK(Put("keep1", "v1"));
+  ASSERT_LEVELDB_OK(Put("upper1", "v1"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  const int last = config::kMaxMemCompactLevel;
+  ASSERT_EQ(NumTableFilesAtLevel(last), 1);
+  // Flushing the memtable does not invoke the filter
+  ASSERT_EQ("v1", Get("drop1"));
+
+  dbfull()->TEST_CompactRange(last, nullptr, nullptr);
+  ASSERT_EQ("NOT_FOUND", Get("drop1"));
+  ASSERT_EQ(AllEntriesFor("drop1"), "[ ]");
+  ASSERT_EQ("v1", Get("keep1"));
+  ASSERT_EQ("V1", Get("upper1"));
+
+  // Values that a snapshot sees are left alone
+  ASSERT_LEVELDB_OK(Put("drop2", "v2"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->TEST_CompactRange(last, nullptr, nullptr);
+  ASSERT_EQ("v2", Get("drop2"));
+  ASSERT_EQ("v2", Get("drop2", snapshot));
+  db_->ReleaseSnapshot(snapshot);
+  dbfull()->TEST_CompactRange(last + 1, nullptr, nullptr);
+  ASSERT_EQ("NOT_FOUND", Get("drop2"));
+  Close();
+}
+
+TEST_F(DBTest, CompactionFilterHidesOlderValues) {
+  PrefixFilter filter;
+  Options options = CurrentOptions();
+  options.compaction_filter = &filter;
+  Reopen(&options);
+
+  ASSERT_LEVELDB_OK(Put("drop", "v1"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  const int last = config::kMaxMemCompactLevel;
+  ASSERT_EQ(NumTableFilesAtLevel(last), 1);  // drop => v1 is now in last level
+
+  // Place a table at level last-1 to prevent merging with preceding mutation
+  ASSERT_LEVELDB_OK(Put("a", "begin"));
+  ASSERT_LEVELDB_OK(Put("z", "end"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(NumTableFilesAtLevel(last - 1), 1);
+
+  ASSERT_LEVELDB_OK(Put("drop", "v2"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());  // Moves to level last-2
+  dbfull()->TEST_CompactRange(last - 2, nullptr, nullptr);
+  // The removed value becomes a deletion marker that hides v1.
+  ASSERT_EQ(AllEntriesFor("drop"), "[ DEL, v1 ]");
+  ASSERT_EQ("NOT_FOUND", Get("drop"));
+  dbfull()->TEST_CompactRange(last - 1, nullptr, nullptr);
+  ASSERT_EQ(AllEntriesFor("drop"), "[ ]");
+  Close();
+}
+
+TEST_F(DBTest, TTLCompactionFilter) {
+  const CompactionFilter* filter = NewTTLCompactionFilter(env_, 3600);
+  Options options = CurrentOptions();
+  options.compaction_filter = filter;
+  Reopen(&options);
+
+  const uint64_t now = env_->NowMicros() / 1000000;
+  ASSERT_LEVELDB_OK(Put("expired", TTLValue("v1", now - 7200)));
+  ASSERT_LEVELDB_OK(Put("live", TTLValue("v2", now)));
+  ASSERT_LEVELDB_OK(Put("short", "v3"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(TTLValue("v1", now - 7200), Get("expired"));
+
+  dbfull()->TEST_CompactRange(config::kMaxMemCompactLevel, nullptr, nullptr);
+  ASSERT_EQ("NOT_FOUND", Get("expired"));
+  ASSERT_EQ(TTLValue("v2", now), Get("live"));
+  ASSERT_EQ("v3", Get("short"));
+
+  Close();
+  delete filter;
+}
+
+TEST_F(DBTest, DeletionTriggeredCompaction) {
+  for (bool enabled : {false, true}) {
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    if (enabled) {
+      options.deletion_compaction_window = 100;
+      options.deletion_compaction_trigger = 50;
+    }
+    DestroyAndReopen(&options);
+
+    const int kNum = 1000;
+    for (int i = 0; i < kNum; i++) {
+      ASSERT_LEVELDB_OK(Put(Key(i), "v"));
+    }
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    ASSERT_EQ("0,0,1", FilesPerLevel());
+
+    // Level 1 is far from full, so only the deletions can trigger a
+    // compaction of the table holding them.
+    for (int i = 0; i < kNum; i++) {
+      ASSERT_LEVELDB_OK(Delete(Key(i)));
+    }
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    const std::string expected = enabled ? "" : "0,1,1";
+    for (int i = 0; i < 100 && FilesPerLevel() != expected; i++) {
+      DelayMilliseconds(10);
+    }
+    ASSERT_EQ(expected, FilesPerLevel());
+    ASSERT_EQ("", Contents());
+  }
+}
+
+TEST_F(DBTest, CompactionPriorities) {
+  for (CompactionPriority priority :
+       {kRoundRobinCompaction, kMinOverlappingRatioCompaction,
+        kOldestLargestSeqFirstCompaction}) {
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    options.write_buffer_size = 10000;
+    options.compaction_priority = priority;
+    DestroyAndReopen(&options);
+
+    Random rnd(301);
+    std::map<std::string, std::string> model;
+    for (int i = 0; i < 5000; i++) {
+      const std::string key = Key(rnd.Uniform(1000));
+      const std::string value = RandomString(&rnd, 100);
+      ASSERT_LEVELDB_OK(Put(key, value));
+      model[key] = value;
+    }
+    ASSERT_GT(NumTableFilesAtLevel(1) + NumTableFilesAtLevel(2), 0);
+    for (const auto& kvp : model) {
+      ASSERT_EQ(kvp.second, Get(kvp.first));
+    }
+    std::string stats;
+    ASSERT_TRUE(db_->GetProperty("leveldb.stats", &stats));
+    ASSERT_NE(stats.find("Write amplification"), std::string::npos) << stats;
+  }
+}
+
+TEST_F(DBTest, UniversalCompaction) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.write_buffer_size = 10000;
+  options.compaction_style = kCompactionStyleUniversal;
+  DestroyAndReopen(&options);
+
+  Random rnd(301);
+  std::map<std::string, std::string> model;
+  for (int i = 0; i < 5000; i++) {
+    const std::string key = Key(rnd.Uniform(1000));
+    if (rnd.OneIn(10)) {
+      ASSERT_LEVELDB_OK(Delete(key));
+      model.erase(key);
+    } else {
+      const std::string value = RandomString(&rnd, 100);
+      ASSERT_LEVELDB_OK(Put(key, value));
+      model[key] = value;
+    }
+  }
+
+  // The sorted runs are the level-0 files and the last level.
+  for (int level = 1; level < config::kNumLevels - 1; level++) {
+    ASSERT_EQ(0, NumTableFilesAtLevel(level));
+  }
+  ASSERT_GT(NumTableFilesAtLevel(config::kNumLevels - 1), 0);
+  ASSERT_LE(NumTableFilesAtLevel(0), config::kL0_StopWritesTrigger);
+  for (int i = 0; i < 1000; i++) {
+    auto it = model.find(Key(i));
+    ASSERT_EQ(it == model.end() ? "NOT_FOUND" : it->second, Get(Key(i)));
+  }
+
+  // A manual compaction merges all of the runs.
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  Reopen(&options);
+  for (int i = 0; i < 1000; i++) {
+    auto it = model.find(Key(i));
+    ASSERT_EQ(it == model.end() ? "NOT_FOUND" : it->second, Get(Key(i)));
+  }
+
+  // The style is part of the database.
+  options.compaction_style = kCompactionStyleLevel;
+  ASSERT_TRUE(TryReopen(&options).IsInvalidArgument());
+}
+
+TEST_F(DBTest, FIFOCompaction) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.write_buffer_size = 10000;
+  options.compaction_style = kCompactionStyleFIFO;
+  options.fifo_max_table_files_size = 200000;
+  DestroyAndReopen(&options);
+
+  Random rnd(301);
+  const int kNum = 4000;
+  std::string last_value;
+  for (int i = 0; i < kNum; i++) {
+    last_value = RandomString(&rnd, 100);
+    ASSERT_LEVELDB_OK(Put(Key(i), last_value));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  // Runs after any compaction scheduled by the flush.
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+
+  // The oldest files were deleted, and the others kept in level-0.
+  ASSERT_EQ("NOT_FOUND", Get(Key(0)));
+  ASSERT_EQ(last_value, Get(Key(kNum - 1)));
+  ASSERT_GT(NumTableFilesAtLevel(0), 1);
+  ASSERT_EQ(NumTableFilesAtLevel(0), TotalTableFiles());
+  ASSERT_LE(Size("", Key(kNum)), 2 * options.fifo_max_table_files_size);
+
+  Reopen(&options);
+  ASSERT_EQ(last_value, Get(Key(kNum - 1)));
+  options.compaction_style = kCompactionStyleUniversal;
+  ASSERT_TRUE(TryReopen(&options).IsInvalidArgument());
+}
+
+TEST_F(DBTest, OverlapInLevel0) {
+  do {
+    ASSERT_EQ(config::kMaxMemCompactLevel, 2) << "Fix test to match config";
+
+    // Fill levels 1 and 2 to disable the pushing of new memtables to levels >
+    // 0.
+    ASSERT_LEVELDB_OK(Put("100", "v100"));
+    ASSERT_LEVELDB_OK(Put("999", "v999"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_LEVELDB_OK(Delete("100"));
+    ASSERT_LEVELDB_OK(Delete("999"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("0,1,1", FilesPerLevel());
+
+    // Make files spanning the following ranges in level-0:
+    //  files[0]  200 .. 900
+    //  files[1]  300 .. 500
+    // Note that files are sorted by smallest key.
+    ASSERT_LEVELDB_OK(Put("300", "v300"));
+    ASSERT_LEVELDB_OK(Put("500", "v500"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_LEVELDB_OK(Put("200", "v200"));
+    ASSERT_LEVELDB_OK(Put("600", "v600"));
+    ASSERT_LEVELDB_OK(Put("900", "v900"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("2,1,1", FilesPerLevel());
+
+    // Compact away the placeholder files we created initially
+    dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+    dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+    ASSERT_EQ("2", FilesPerLevel());
+
+    // Do a memtable compaction.  Before bug-fix, the compaction would
+    // not detect the overlap with level-0 files and would incorrectly place
+    // the deletion in a deeper level.
+    ASSERT_LEVELDB_OK(Delete("600"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("3", FilesPerLevel());
+    ASSERT_EQ("NOT_FOUND", Get("600"));
+  } while (ChangeOptions());
+}
+
+TEST_F(DBTest, L0_CompactionBug_Issue44_a) {
+  Reopen();
+  ASSERT_LEVELDB_OK(Put("b", "v"));
+  Reopen();
+  ASSERT_LEVELDB_OK(Delete("b"));
+  ASSERT_LEVELDB_OK(Delete("a"));
+  Reopen();
+  ASSERT_LEVELDB_OK(Delete("a"));
+  Reopen();
+  ASSERT_LEVELDB_OK(Put("a", "v"));
+  Reopen();
+  Reopen();
+  ASSERT_EQ("(a->v)", Contents());
+  DelayMilliseconds(1000);  // Wait for compaction to finish
+  ASSERT_EQ("(a->v)", Contents());
+}
+
+TEST_F(DBTest, L0_CompactionBug_Issue44_b) {
+  Reopen();
+  Put("", "");
+  Reopen();
+  Delete("e");
+  Put("", "");
+  Reopen();
+  Put("c", "cv");
+  Reopen();
+  Put("", "");
+  Reopen();
+  Put("", "");
+  DelayMilliseconds(1000);  // Wait for compaction to finish
+  Reopen();
+  Put("d", "dv");
+  Reopen();
+  Put("", "");
+  Reopen();
+  Delete("d");
+  Delete("b");
+  Reopen();
+  ASSERT_EQ("(->)(c->cv)", Contents());
+  DelayMilliseconds(1000);  // Wait for compaction to finish
+  ASSERT_EQ("(->)(c->cv)", Contents());
+}
+
+TEST_F(DBTest, Fflush_Issue474) {
+  static const int kNum = 100000;
+  Random rnd(test::RandomSeed());
+  for (int i = 0; i < kNum; i++) {
+    std::fflush(nullptr);
+    ASSERT_LEVELDB_OK(Put(RandomKey(&rnd), RandomString(&rnd, 100)));
+  }
+}
+
+TEST_F(DBTest, ComparatorCheck) {
+  class NewComparator : public Comparator {
+   public:
+    const char* Name() const override { return "leveldb.NewComparator"; }
+    int Compare(const Slice& a, const Slice& b) const override {
+      return BytewiseComparator()->Compare(a, b);
+    }
+    void FindShortestSeparator(std::string* s, const Slice& l) const override {
+      BytewiseComparator()->FindShortestSeparator(s, l);
     }
     void FindShortSuccessor(std::string* key) const override {
       BytewiseComparator()->FindShortSuccessor(key);
@@ -1886,6 +2711,43 @@ TEST_F(DBTest, ManifestWriteError) {
   }
 }
 
+TEST_F(DBTest, ManifestRollover) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.max_manifest_file_size = 1;  // Start a new MANIFEST on every edit
+  DestroyAndReopen(&options);
+
+  std::string current;
+  ASSERT_LEVELDB_OK(ReadFileToString(env_, CurrentFileName(dbname_), &current));
+  for (int i = 0; i < 5; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), "v"));
+    dbfull()->TEST_CompactMemTable();
+    std::string next;
+    ASSERT_LEVELDB_OK(ReadFileToString(env_, CurrentFileName(dbname_), &next));
+    ASSERT_NE(current, next);
+    current = next;
+  }
+
+  // The old MANIFEST files are gone.
+  std::vector<std::string> filenames;
+  ASSERT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+  int manifests = 0;
+  uint64_t number;
+  FileType type;
+  for (const std::string& filename : filenames) {
+    if (ParseFileName(filename, &number, &type) && type == kDescriptorFile) {
+      manifests++;
+    }
+  }
+  ASSERT_EQ(1, manifests);
+
+  Reopen(&options);
+  ASSERT_EQ(5, TotalTableFiles());
+  for (int i = 0; i < 5; i++) {
+    ASSERT_EQ("v", Get(Key(i)));
+  }
+}
+
 TEST_F(DBTest, MissingSSTFile) {
   ASSERT_LEVELDB_OK(Put("foo", "bar"));
   ASSERT_EQ("bar", Get("foo"));
@@ -1903,6 +2765,551 @@ TEST_F(DBTest, MissingSSTFile) {
   ASSERT_TRUE(s.ToString().find("issing") != std::string::npos) << s.ToString();
 }
 
+TEST_F(DBTest, PreloadTables) {
+  for (int i = 0; i < 10; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), "v"));
+    dbfull()->TEST_CompactMemTable();
+  }
+
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.table_preload_threads = 4;
+  env_->count_random_reads_ = true;
+  Reopen(&options);
+
+  // Only the data blocks are left to read.
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ("v", Get(Key(i)));
+  }
+  ASSERT_EQ(10, env_->random_read_counter_.Read());
+}
+
+TEST_F(DBTest, PreloadTablesFindsCorruptTable) {
+  ASSERT_LEVELDB_OK(Put("foo", "bar"));
+  dbfull()->TEST_CompactMemTable();
+  Close();
+
+  // Overwrite the table with garbage of the same size.
+  std::vector<std::string> filenames;
+  ASSERT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+  uint64_t number;
+  FileType type;
+  for (const std::string& filename : filenames) {
+    if (ParseFileName(filename, &number, &type) && type == kTableFile) {
+      const std::string fname = TableFileName(dbname_, number);
+      uint64_t size;
+      ASSERT_LEVELDB_OK(env_->GetFileSize(fname, &size));
+      ASSERT_LEVELDB_OK(
+          WriteStringToFile(env_, std::string(size, 'x'), fname));
+    }
+  }
+
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.table_preload_threads = 2;
+  options.paranoid_checks = true;
+  Status s = TryReopen(&options);
+  ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+
+  // Without paranoid checks the error only shows up on use.
+  options.paranoid_checks = false;
+  ASSERT_LEVELDB_OK(TryReopen(&options));
+  std::string value;
+  ASSERT_TRUE(db_->Get(ReadOptions(), "foo", &value).IsCorruption());
+}
+
+namespace {
+
+class RecordingListener : public EventListener {
+ public:
+  void OnFlushBegin(DB* db, const FlushJobInfo& info) override {
+    MutexLock l(&mu_);
+    flushes_begun_++;
+  }
+
+  void OnFlushCompleted(DB* db, const FlushJobInfo& info) override {
+    MutexLock l(&mu_);
+    flushes_.push_back(info);
+  }
+
+  void OnCompactionBegin(DB* db, const CompactionJobInfo& info) override {
+    MutexLock l(&mu_);
+    compactions_begun_++;
+  }
+
+  void OnCompactionCompleted(DB* db, const CompactionJobInfo& info) override {
+    MutexLock l(&mu_);
+    compactions_.push_back(info);
+  }
+
+  void OnStallConditionsChanged(DB* db, const WriteStallInfo& info) override {
+    MutexLock l(&mu_);
+    stalls_.push_back(info);
+  }
+
+  void OnTableFileCreated(DB* db, const TableFileCreationInfo& info) override {
+    MutexLock l(&mu_);
+    created_.push_back(info);
+  }
+
+  void OnTableFileDeleted(DB* db, const TableFileDeletionInfo& info) override {
+    MutexLock l(&mu_);
+    deleted_.push_back(info);
+  }
+
+  port::Mutex mu_;
+  int flushes_begun_ GUARDED_BY(mu_) = 0;
+  std::vector<FlushJobInfo> flushes_ GUARDED_BY(mu_);
+  int compactions_begun_ GUARDED_BY(mu_) = 0;
+  std::vector<CompactionJobInfo> compactions_ GUARDED_BY(mu_);
+  std::vector<WriteStallInfo> stalls_ GUARDED_BY(mu_);
+  std::vector<TableFileCreationInfo> created_ GUARDED_BY(mu_);
+  std::vector<TableFileDeletionInfo> deleted_ GUARDED_BY(mu_);
+};
+
+}  // namespace
+
+TEST_F(DBTest, ListenerFlushAndCompaction) {
+  RecordingListener listener;
+  Options options = CurrentOptions();
+  options.listeners.push_back(&listener);
+  Reopen(&options);
+
+  for (int i = 0; i < 3; i++) {
+    ASSERT_LEVELDB_OK(Put("a", "v"));
+    ASSERT_LEVELDB_OK(Put("z", "v"));
+    dbfull()->TEST_CompactMemTable();
+  }
+  {
+    MutexLock l(&listener.mu_);
+    ASSERT_EQ(3, listener.flushes_begun_);
+    ASSERT_EQ(3, listener.flushes_.size());
+    ASSERT_EQ(3, listener.created_.size());
+    for (int i = 0; i < 3; i++) {
+      const FlushJobInfo& flush = listener.flushes_[i];
+      ASSERT_LEVELDB_OK(flush.status);
+      ASSERT_EQ(dbname_, flush.db_name);
+      ASSERT_NE(0, flush.file_number);
+      ASSERT_GT(flush.file_size, 0);
+      ASSERT_EQ(TableFileName(dbname_, flush.file_number), flush.file_path);
+      ASSERT_EQ(flush.file_number, listener.created_[i].file_number);
+      ASSERT_EQ(kTableFileFromFlush, listener.created_[i].reason);
+    }
+  }
+
+  db_->CompactRange(nullptr, nullptr);
+  {
+    MutexLock l(&listener.mu_);
+    ASSERT_GE(listener.compactions_.size(), 1);
+    ASSERT_EQ(listener.compactions_begun_, listener.compactions_.size());
+    std::set<uint64_t> inputs;
+    std::set<uint64_t> outputs;
+    bool rewrote = false;
+    for (const CompactionJobInfo& compaction : listener.compactions_) {
+      ASSERT_LEVELDB_OK(compaction.status);
+      ASSERT_FALSE(compaction.input_files.empty());
+      inputs.insert(compaction.input_files.begin(),
+                    compaction.input_files.end());
+      outputs.insert(compaction.output_files.begin(),
+                     compaction.output_files.end());
+      if (!compaction.is_trivial_move) {
+        rewrote = true;
+        ASSERT_GT(compaction.bytes_read, 0);
+        ASSERT_GT(compaction.bytes_written, 0);
+      }
+    }
+    ASSERT_TRUE(rewrote);
+    // Every table written by a compaction was announced, and every table
+    // deleted was a compaction input.
+    for (const TableFileCreationInfo& created : listener.created_) {
+      if (created.reason == kTableFileFromCompaction) {
+        ASSERT_EQ(1, outputs.count(created.file_number));
+      }
+    }
+    ASSERT_FALSE(listener.deleted_.empty());
+    for (const TableFileDeletionInfo& deleted : listener.deleted_) {
+      ASSERT_LEVELDB_OK(deleted.status);
+      ASSERT_EQ(1, inputs.count(deleted.file_number));
+    }
+  }
+
+  // The listener must outlive the database.
+  Close();
+}
+
+TEST_F(DBTest, ListenerWriteStall) {
+  RecordingListener listener;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.write_buffer_size = 64 << 10;
+  options.listeners.push_back(&listener);
+  Reopen(&options);
+
+  // Hold up the memtable compaction so that writes fill the next memtable
+  // and stop.
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+  std::thread writer([this]() {
+    for (int i = 0; i < 20; i++) {
+      ASSERT_LEVELDB_OK(Put(Key(i), std::string(10000, 'x')));
+    }
+  });
+  bool stopped = false;
+  for (int i = 0; i < 1000 && !stopped; i++) {
+    DelayMilliseconds(10);
+    MutexLock l(&listener.mu_);
+    stopped = !listener.stalls_.empty() &&
+              listener.stalls_.back().condition == kWriteStallStopped;
+  }
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  writer.join();
+  ASSERT_TRUE(stopped);
+
+  ASSERT_LEVELDB_OK(Put("k", "v"));
+  {
+    MutexLock l(&listener.mu_);
+    ASSERT_EQ(kWriteStallNormal, listener.stalls_.back().condition);
+    ASSERT_EQ(kWriteStallStopped, listener.stalls_.back().previous_condition);
+    ASSERT_EQ(dbname_, listener.stalls_.back().db_name);
+  }
+
+  Close();
+}
+
+TEST_F(DBTest, Statistics) {
+  std::unique_ptr<Statistics> stats(NewStatistics());
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.statistics = stats.get();
+  Reopen(&options);
+
+  for (int i = 0; i < 10; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), "value"));
+  }
+  ASSERT_EQ(10, stats->GetTickerCount(kKeysWritten));
+  ASSERT_GT(stats->GetTickerCount(kBytesWritten), 10 * 5);
+  HistogramData data;
+  stats->GetHistogramData(kWriteMicros, &data);
+  ASSERT_EQ(10, data.count);
+
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_GT(stats->GetTickerCount(kFlushBytesWritten), 0);
+  stats->GetHistogramData(kFlushMicros, &data);
+  ASSERT_EQ(1, data.count);
+
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ("value", Get(Key(i)));
+  }
+  ASSERT_EQ("NOT_FOUND", Get("missing"));
+  ASSERT_EQ(11, stats->GetTickerCount(kKeysRead));
+  ASSERT_EQ(10 * 5, stats->GetTickerCount(kBytesRead));
+  stats->GetHistogramData(kGetMicros, &data);
+  ASSERT_EQ(11, data.count);
+  ASSERT_EQ(1, stats->GetTickerCount(kTableCacheMiss));
+  ASSERT_EQ(10, stats->GetTickerCount(kTableCacheHit));
+  // Blocks that are read in place from a memory-mapped file are not
+  // cached, so only the total is known.
+  ASSERT_EQ(10, stats->GetTickerCount(kBlockCacheDataHit) +
+                    stats->GetTickerCount(kBlockCacheDataMiss));
+
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->Seek(Key(5));
+  ASSERT_TRUE(iter->Valid());
+  delete iter;
+  stats->GetHistogramData(kSeekMicros, &data);
+  ASSERT_EQ(1, data.count);
+
+  // The statistics must outlive the database.
+  Close();
+}
+
+TEST_F(DBTest, PerfContext) {
+  std::unique_ptr<const FilterPolicy> filter(NewBloomFilterPolicy(10));
+  Options options = CurrentOptions();
+  options.filter_policy = filter.get();
+  Reopen(&options);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), "value"));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  PerfContext* perf = GetPerfContext();
+  IOStatsContext* iostats = GetIOStatsContext();
+  SetPerfLevel(kPerfEnableTime);
+  perf->Reset();
+  iostats->Reset();
+  ASSERT_EQ("value", Get(Key(5)));
+  ASSERT_EQ(1, perf->get_from_memtable_count);
+  ASSERT_EQ(1, perf->get_from_table_count);
+  ASSERT_EQ(1, perf->bloom_sst_hit_count);
+  ASSERT_EQ(1, perf->block_read_count + perf->block_cache_hit_count);
+  ASSERT_GT(perf->get_from_output_files_nanos, 0);
+  ASSERT_NE(std::string::npos,
+            perf->ToString().find("get_from_table_count = 1"));
+
+  perf->Reset();
+  ASSERT_EQ("NOT_FOUND", Get(Key(5) + "x"));
+  ASSERT_EQ(1, perf->bloom_sst_miss_count);
+  ASSERT_EQ(0, perf->block_read_count + perf->block_cache_hit_count);
+
+  perf->Reset();
+  ASSERT_LEVELDB_OK(Delete(Key(2)));
+  ASSERT_GT(perf->write_wal_nanos, 0);
+  ASSERT_GT(iostats->bytes_written, 0);
+
+  // Moving from Key(1) to Key(3) passes over the deletion and the value it
+  // hides.
+  perf->Reset();
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->Seek(Key(1));
+  ASSERT_EQ(Key(1), iter->key().ToString());
+  iter->Next();
+  ASSERT_EQ(Key(3), iter->key().ToString());
+  delete iter;
+  ASSERT_EQ(1, perf->internal_delete_skipped_count);
+  ASSERT_EQ(2, perf->internal_key_skipped_count);
+  ASSERT_GT(perf->seek_internal_seek_nanos, 0);
+
+  // Counting leaves the clock alone.
+  SetPerfLevel(kPerfEnableCount);
+  perf->Reset();
+  ASSERT_EQ("value", Get(Key(7)));
+  ASSERT_EQ(1, perf->get_from_table_count);
+  ASSERT_EQ(0, perf->get_from_output_files_nanos);
+
+  // Each thread has its own context.
+  std::thread thread([this]() {
+    SetPerfLevel(kPerfEnableCount);
+    ASSERT_EQ("value", Get(Key(8)));
+    ASSERT_EQ(1, GetPerfContext()->get_from_table_count);
+  });
+  thread.join();
+  ASSERT_EQ(1, perf->get_from_table_count);
+
+  SetPerfLevel(kPerfDisable);
+  perf->Reset();
+  iostats->Reset();
+  ASSERT_EQ("value", Get(Key(9)));
+  ASSERT_EQ("", perf->ToString(true));
+  ASSERT_EQ("", iostats->ToString(true));
+}
+
+TEST_F(DBTest, Trace) {
+  const std::string trace = testing::TempDir() + "db_test_trace";
+  ASSERT_TRUE(db_->EndTrace().IsNotFound());
+  ASSERT_LEVELDB_OK(Put("a", "va"));  // Not traced
+  ASSERT_LEVELDB_OK(db_->StartTrace(TraceOptions(), trace));
+  ASSERT_TRUE(db_->StartTrace(TraceOptions(), trace).IsInvalidArgument());
+  ASSERT_LEVELDB_OK(Put("b", "vb"));
+  ASSERT_EQ("va", Get("a"));
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->Seek("b");
+  iter->SeekToFirst();
+  iter->SeekToLast();
+  delete iter;
+  ASSERT_LEVELDB_OK(db_->EndTrace());
+  ASSERT_EQ("vb", Get("b"));  // Not traced
+
+  TraceReader* reader;
+  ASSERT_LEVELDB_OK(TraceReader::Open(env_, trace, &reader));
+  std::vector<TraceRecord> records;
+  TraceRecord record;
+  while (reader->Read(&record)) {
+    records.push_back(record);
+  }
+  ASSERT_LEVELDB_OK(reader->status());
+  delete reader;
+
+  ASSERT_EQ(5, records.size());
+  ASSERT_EQ(kTraceWrite, records[0].type);
+  WriteBatch batch;
+  WriteBatchInternal::SetContents(&batch, records[0].payload);
+  ASSERT_EQ(1, WriteBatchInternal::Count(&batch));
+  ASSERT_EQ(kTraceGet, records[1].type);
+  ASSERT_EQ("a", records[1].payload);
+  ASSERT_EQ(kTraceSeek, records[2].type);
+  ASSERT_EQ("b", records[2].payload);
+  ASSERT_EQ(kTraceSeekToFirst, records[3].type);
+  ASSERT_EQ(kTraceSeekToLast, records[4].type);
+  for (size_t i = 1; i < records.size(); i++) {
+    ASSERT_LE(records[i - 1].micros, records[i].micros);
+  }
+
+  // A trace cut short ends at its last whole record.
+  uint64_t size;
+  ASSERT_LEVELDB_OK(env_->GetFileSize(trace, &size));
+  std::string contents;
+  ASSERT_LEVELDB_OK(ReadFileToString(env_, trace, &contents));
+  ASSERT_LEVELDB_OK(
+      WriteStringToFile(env_, Slice(contents.data(), size - 1), trace));
+  ASSERT_LEVELDB_OK(TraceReader::Open(env_, trace, &reader));
+  int count = 0;
+  while (reader->Read(&record)) {
+    count++;
+  }
+  ASSERT_LEVELDB_OK(reader->status());
+  ASSERT_EQ(4, count);
+  delete reader;
+
+  ASSERT_LEVELDB_OK(WriteStringToFile(env_, "not a trace", trace));
+  ASSERT_TRUE(TraceReader::Open(env_, trace, &reader).IsCorruption());
+  env_->RemoveFile(trace);
+}
+
+TEST_F(DBTest, TraceSamplingAndSizeLimit) {
+  const std::string trace = testing::TempDir() + "db_test_trace";
+  TraceOptions trace_options;
+  trace_options.sampling_frequency = 10;
+  ASSERT_LEVELDB_OK(db_->StartTrace(trace_options, trace));
+  for (int i = 0; i < 100; i++) {
+    Get(Key(i));
+  }
+  ASSERT_LEVELDB_OK(db_->EndTrace());
+
+  TraceReader* reader;
+  TraceRecord record;
+  ASSERT_LEVELDB_OK(TraceReader::Open(env_, trace, &reader));
+  int count = 0;
+  while (reader->Read(&record)) {
+    ASSERT_EQ(Key(count * 10), record.payload);
+    count++;
+  }
+  ASSERT_EQ(10, count);
+  delete reader;
+
+  // Recording stops before the file outgrows the limit.
+  trace_options = TraceOptions();
+  trace_options.max_trace_file_size = 1000;
+  ASSERT_LEVELDB_OK(db_->StartTrace(trace_options, trace));
+  for (int i = 0; i < 100; i++) {
+    Get(Key(i));
+  }
+  ASSERT_LEVELDB_OK(db_->EndTrace());
+  uint64_t size;
+  ASSERT_LEVELDB_OK(env_->GetFileSize(trace, &size));
+  ASSERT_LE(size, 1000);
+  ASSERT_LEVELDB_OK(TraceReader::Open(env_, trace, &reader));
+  count = 0;
+  while (reader->Read(&record)) {
+    ASSERT_EQ(Key(count), record.payload);
+    count++;
+  }
+  ASSERT_GT(count, 10);
+  ASSERT_LT(count, 100);
+  delete reader;
+  env_->RemoveFile(trace);
+}
+
+// Returns the data of random reads in the caller's buffer, as files that
+// are not mapped into memory do, so that the blocks of uncompressed tables
+// are put in the block cache.
+class CopyingReadEnv : public EnvWrapper {
+ public:
+  explicit CopyingReadEnv(Env* target) : EnvWrapper(target) {}
+
+  Status NewRandomAccessFile(const std::string& f,
+                             RandomAccessFile** r) override {
+    class CopyingFile : public RandomAccessFile {
+     public:
+      explicit CopyingFile(RandomAccessFile* target) : target_(target) {}
+      ~CopyingFile() override { delete target_; }
+      Status Read(uint64_t offset, size_t n, Slice* result,
+                  char* scratch) const override {
+        Status s = target_->Read(offset, n, result, scratch);
+        if (s.ok() && result->data() != scratch) {
+          std::memcpy(scratch, result->data(), result->size());
+          *result = Slice(scratch, result->size());
+        }
+        return s;
+      }
+
+     private:
+      RandomAccessFile* const target_;
+    };
+
+    Status s = target()->NewRandomAccessFile(f, r);
+    if (s.ok()) {
+      *r = new CopyingFile(*r);
+    }
+    return s;
+  }
+};
+
+TEST_F(DBTest, GetMemoryUsage) {
+  CopyingReadEnv env(env_);
+  Options options = CurrentOptions();
+  options.env = &env;
+  options.create_if_missing = true;
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.block_cache = NewLRUCache(1 << 20);
+  options.compression = kNoCompression;
+  DestroyAndReopen(&options);
+
+  for (int i = 0; i < 100; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), std::string(1000, 'v')));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_LEVELDB_OK(Put("foo", "v1"));
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(std::string(1000, 'v'), Get(Key(i)));
+  }
+
+  MemoryUsage usage;
+  ASSERT_LEVELDB_OK(db_->GetMemoryUsage(&usage));
+  ASSERT_EQ(static_cast<size_t>(config::kNumLevels), usage.levels.size());
+  int files = 0;
+  int read_amplification = 0;
+  uint64_t block_cache = 0;
+  for (const MemoryUsage::Level& level : usage.levels) {
+    files += level.num_files;
+    read_amplification += level.read_amplification;
+    block_cache += level.block_cache_usage;
+    if (level.num_files > 0) {
+      ASSERT_GT(level.index_usage, 0);
+      ASSERT_GT(level.filter_usage, 0);
+    }
+  }
+  ASSERT_EQ(1, files);
+  ASSERT_EQ(1, read_amplification);
+  ASSERT_GT(usage.mem_table_usage, 0);
+  ASSERT_EQ(0, usage.imm_mem_table_usage);
+  // The cache holds every block of the only table.
+  ASSERT_GE(block_cache, 100 * 1000);
+  ASSERT_EQ(usage.block_cache_usage, block_cache);
+  ASSERT_EQ(0, usage.block_cache_pinned_usage);
+
+  // An iterator pins the block it is positioned in.
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->Seek(Key(50));
+  ASSERT_LEVELDB_OK(db_->GetMemoryUsage(&usage));
+  ASSERT_GT(usage.block_cache_pinned_usage, 0);
+  delete iter;
+
+  std::string value;
+  ASSERT_TRUE(db_->GetProperty("leveldb.block-cache-usage", &value));
+  ASSERT_EQ(std::to_string(block_cache), value);
+  ASSERT_TRUE(db_->GetProperty("leveldb.block-cache-pinned-usage", &value));
+  ASSERT_EQ("0", value);
+  ASSERT_TRUE(db_->GetProperty("leveldb.read-amplification", &value));
+  ASSERT_EQ("1", value);
+  for (int level = 0; level < config::kNumLevels; level++) {
+    ASSERT_TRUE(db_->GetProperty(
+        "leveldb.block-cache-usage-at-level" + NumberToString(level), &value));
+    ASSERT_EQ(std::to_string(usage.levels[level].block_cache_usage), value);
+  }
+  ASSERT_FALSE(db_->GetProperty("leveldb.block-cache-usage-at-level7", &value));
+  ASSERT_TRUE(db_->GetProperty("leveldb.mem-table-usage", &value));
+  ASSERT_EQ(std::to_string(usage.mem_table_usage), value);
+  ASSERT_TRUE(db_->GetProperty("leveldb.table-readers-usage", &value));
+  ASSERT_GT(std::stoull(value), 0);
+  ASSERT_TRUE(db_->GetProperty("leveldb.memory-usage", &value));
+  ASSERT_NE(std::string::npos, value.find("Block cache:"));
+
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
 TEST_F(DBTest, StillReadSST) {
   ASSERT_LEVELDB_OK(Put("foo", "bar"));
   ASSERT_EQ("bar", Get("foo"));
@@ -2153,6 +3560,12 @@ class ModelDB : public DB {
         (*map_)[key.ToString()] = value.ToString();
       }
       void Delete(const Slice& key) override { map_->erase(key.ToString()); }
+      void DeleteRange(const Slice& begin, const Slice& end) override {
+        if (begin.compare(end) < 0) {
+          map_->erase(map_->lower_bound(begin.ToString()),
+                      map_->lower_bound(end.ToString()));
+        }
+      }
     };
     Handler handler;
     handler.map_ = &map_;
@@ -2310,11 +3723,17 @@ TEST_F(DBTest, Randomized) {
         ASSERT_LEVELDB_OK(model.Put(WriteOptions(), k, v));
         ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), k, v));
 
-      } else if (p < 90) {  // Delete
+      } else if (p < 88) {  // Delete
         k = RandomKey(&rnd);
         ASSERT_LEVELDB_OK(model.Delete(WriteOptions(), k));
         ASSERT_LEVELDB_OK(db_->Delete(WriteOptions(), k));
 
+      } else if (p < 90) {  // DeleteRange
+        k = RandomKey(&rnd);
+        v = RandomKey(&rnd);
+        ASSERT_LEVELDB_OK(model.DeleteRange(WriteOptions(), k, v));
+        ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), k, v));
+
       } else {  // Multi-element batch
         WriteBatch b;
         const int num = rnd.Uniform(8);
@@ -4,10 +4,12 @@
 
 #include "db/memtable.h"
 #include "db/dbformat.h"
+#include "db/range_del.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "util/coding.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
@@ -19,7 +21,12 @@ static Slice GetLengthPrefixedSlice(const char* data) {
 }
 
 MemTable::MemTable(const InternalKeyComparator& comparator)
-    : comparator_(comparator), refs_(0), table_(comparator_, &arena_) {}
+    : comparator_(comparator),
+      refs_(0),
+      table_(comparator_, &arena_),
+      range_del_table_(comparator_, &arena_),
+      num_range_tombstones_(0),
+      num_fragmented_tombstones_(0) {}
 
 MemTable::~MemTable() { assert(refs_ == 0); }
 
@@ -73,6 +80,10 @@ class MemTableIterator : public Iterator {
 
 Iterator* MemTable::NewIterator() { return new MemTableIterator(&table_); }
 
+Iterator* MemTable::NewRangeTombstoneIterator() {
+  return new MemTableIterator(&range_del_table_);
+}
+
 void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
                    const Slice& value) {
   // Format of an entry is concatenation of:
@@ -81,6 +92,10 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
   //  tag          : uint64((sequence << 8) | type)
   //  value_size   : varint32 of value.size()
   //  value bytes  : char[value.size()]
+  if (type == kTypeRangeDeletion &&
+      comparator_.comparator.user_comparator()->Compare(key, value) >= 0) {
+    return;  // Empty range
+  }
   size_t key_size = key.size();
   size_t val_size = value.size();
   size_t internal_key_size = key_size + 8;
@@ -96,14 +111,48 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
   p = EncodeVarint32(p, val_size);
   std::memcpy(p, value.data(), val_size);
   assert(p + val_size == buf + encoded_len);
-  table_.Insert(buf);
+  if (type == kTypeRangeDeletion) {
+    range_del_table_.Insert(buf);
+    num_range_tombstones_.fetch_add(1, std::memory_order_release);
+  } else {
+    table_.Insert(buf);
+  }
+}
+
+std::shared_ptr<const FragmentedRangeTombstones>
+MemTable::FragmentedTombstones() {
+  const size_t num_tombstones =
+      num_range_tombstones_.load(std::memory_order_acquire);
+  MutexLock l(&tombstones_mutex_);
+  if (fragmented_tombstones_ == nullptr ||
+      num_fragmented_tombstones_ < num_tombstones) {
+    // Tombstones added meanwhile may be read as well; like all others they
+    // only apply to lookups at or after their sequence number.
+    std::vector<RangeTombstone> tombstones;
+    MemTableIterator iter(&range_del_table_);
+    ReadRangeTombstones(&iter, &tombstones);
+    fragmented_tombstones_ = std::make_shared<FragmentedRangeTombstones>(
+        comparator_.comparator.user_comparator(), tombstones);
+    num_fragmented_tombstones_ = tombstones.size();
+  }
+  return fragmented_tombstones_;
 }
 
-bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
+bool MemTable::Get(const LookupKey& key, std::string* value, Status* s,
+                   std::vector<std::string>* merge_operands) {
+  // Every entry in this memtable that is older than a covering tombstone
+  // is deleted, and so is everything in older memtables and tables.
+  SequenceNumber tombstone_seq = 0;
+  if (num_range_tombstones_.load(std::memory_order_acquire) > 0) {
+    const Slice internal_key = key.internal_key();
+    tombstone_seq = FragmentedTombstones()->MaxCoveringSeq(
+        key.user_key(),
+        DecodeFixed64(internal_key.data() + internal_key.size() - 8) >> 8);
+  }
+
   Slice memkey = key.memtable_key();
   Table::Iterator iter(&table_);
-  iter.Seek(memkey.data());
-  if (iter.Valid()) {
+  for (iter.Seek(memkey.data()); iter.Valid(); iter.Next()) {
     // entry format is:
     //    klength  varint32
     //    userkey  char[klength]
@@ -117,21 +166,42 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
     uint32_t key_length;
     const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length);
     if (comparator_.comparator.user_comparator()->Compare(
-            Slice(key_ptr, key_length - 8), key.user_key()) == 0) {
-      // Correct user key
-      const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
-      switch (static_cast<ValueType>(tag & 0xff)) {
-        case kTypeValue: {
-          Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
-          value->assign(v.data(), v.size());
-          return true;
-        }
-        case kTypeDeletion:
-          *s = Status::NotFound(Slice());
-          return true;
+            Slice(key_ptr, key_length - 8), key.user_key()) != 0) {
+      break;
+    }
+    // Correct user key
+    const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+    if ((tag >> 8) < tombstone_seq) {
+      break;
+    }
+    switch (static_cast<ValueType>(tag & 0xff)) {
+      case kTypeValue: {
+        Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+        value->assign(v.data(), v.size());
+        return true;
+      }
+      case kTypeDeletion:
+        *s = Status::NotFound(Slice());
+        return true;
+      case kTypeMerge: {
+        // Keep looking for the entry the operand applies to
+        Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+        merge_operands->push_back(v.ToString());
+        break;
       }
+      case kTypeBlobIndex:
+      case kTypeRangeDeletion:
+        // Neither is stored in table_: values are only separated into blob
+        // files when the memtable is flushed, and range tombstones are kept
+        // in range_del_table_.
+        assert(false);
+        break;
     }
   }
+  if (tombstone_seq != 0) {
+    *s = Status::NotFound(Slice());
+    return true;
+  }
   return false;
 }
 
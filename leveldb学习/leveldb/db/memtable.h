@@ -5,15 +5,21 @@
 #ifndef STORAGE_LEVELDB_DB_MEMTABLE_H_
 #define STORAGE_LEVELDB_DB_MEMTABLE_H_
 
+#include <atomic>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
 #include "db/skiplist.h"
 #include "leveldb/db.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
 #include "util/arena.h"
 
 namespace leveldb {
 
+class FragmentedRangeTombstones;
 class InternalKeyComparator;
 class MemTableIterator;
 
@@ -50,17 +56,27 @@ class MemTable {
   // db/format.{h,cc} module.
   Iterator* NewIterator();
 
+  // Return an iterator over the range tombstones in the memtable, keyed
+  // by the internal key of each tombstone's begin key and yielding its
+  // end key.  Same lifetime requirements as NewIterator().
+  Iterator* NewRangeTombstoneIterator();
+
   // Add an entry into memtable that maps key to value at the
   // specified sequence number and with the specified type.
-  // Typically value will be empty if type==kTypeDeletion.
+  // Typically value will be empty if type==kTypeDeletion.  If
+  // type==kTypeRangeDeletion, value is the end of the deleted range.
   void Add(SequenceNumber seq, ValueType type, const Slice& key,
            const Slice& value);
 
   // If memtable contains a value for key, store it in *value and return true.
-  // If memtable contains a deletion for key, store a NotFound() error
-  // in *status and return true.
+  // If memtable contains a deletion for key, or a range tombstone that
+  // covers it, store a NotFound() error in *status and return true.
   // Else, return false.
-  bool Get(const LookupKey& key, std::string* value, Status* s);
+  //
+  // Merge operands newer than the value or deletion are appended to
+  // *merge_operands, newest first; the caller applies them.
+  bool Get(const LookupKey& key, std::string* value, Status* s,
+           std::vector<std::string>* merge_operands);
 
  private:
   friend class MemTableIterator;
@@ -76,10 +92,21 @@ class MemTable {
 
   ~MemTable();  // Private since only Unref() should be used to delete it
 
+  // Return the fragmented form of range_del_table_, rebuilt if tombstones
+  // have been added since it was last built.
+  std::shared_ptr<const FragmentedRangeTombstones> FragmentedTombstones();
+
   KeyComparator comparator_;
   int refs_;
   Arena arena_;
   Table table_;
+  Table range_del_table_;  // Range tombstones, kept out of table_
+  std::atomic<size_t> num_range_tombstones_;  // Entries in range_del_table_
+
+  port::Mutex tombstones_mutex_;
+  std::shared_ptr<const FragmentedRangeTombstones> fragmented_tombstones_
+      GUARDED_BY(tombstones_mutex_);
+  size_t num_fragmented_tombstones_ GUARDED_BY(tombstones_mutex_);
 };
 
 }  // namespace leveldb
@@ -0,0 +1,223 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/range_del.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+
+namespace leveldb {
+
+namespace {
+
+struct UserKeyLess {
+  const Comparator* ucmp;
+  bool operator()(const std::string& a, const std::string& b) const {
+    return ucmp->Compare(a, b) < 0;
+  }
+};
+
+// Set *boundaries to the distinct begin and end keys of "tombstones" in
+// order, splitting the key space into fragments, where fragment i spans
+// [(*boundaries)[i], (*boundaries)[i + 1]).  Set (*covering)[i] to the
+// sequence numbers of the tombstones covering fragment i.
+void FragmentTombstones(const Comparator* ucmp,
+                        const std::vector<RangeTombstone>& tombstones,
+                        std::vector<std::string>* boundaries,
+                        std::vector<std::vector<SequenceNumber>>* covering) {
+  const UserKeyLess less = {ucmp};
+
+  boundaries->clear();
+  for (size_t i = 0; i < tombstones.size(); i++) {
+    boundaries->push_back(tombstones[i].begin);
+    boundaries->push_back(tombstones[i].end);
+  }
+  std::sort(boundaries->begin(), boundaries->end(), less);
+  boundaries->erase(
+      std::unique(boundaries->begin(), boundaries->end(),
+                  [ucmp](const std::string& a, const std::string& b) {
+                    return ucmp->Compare(a, b) == 0;
+                  }),
+      boundaries->end());
+
+  covering->assign(boundaries->size(), std::vector<SequenceNumber>());
+  for (size_t i = 0; i < tombstones.size(); i++) {
+    const RangeTombstone& t = tombstones[i];
+    size_t lo = std::lower_bound(boundaries->begin(), boundaries->end(),
+                                 t.begin, less) -
+                boundaries->begin();
+    size_t hi = std::lower_bound(boundaries->begin(), boundaries->end(),
+                                 t.end, less) -
+                boundaries->begin();
+    for (size_t j = lo; j < hi; j++) {
+      (*covering)[j].push_back(t.seq);
+    }
+  }
+}
+
+}  // namespace
+
+Status ReadRangeTombstones(Iterator* iter,
+                           std::vector<RangeTombstone>* tombstones) {
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ParsedInternalKey ikey;
+    if (!ParseInternalKey(iter->key(), &ikey) ||
+        ikey.type != kTypeRangeDeletion) {
+      return Status::Corruption("bad range tombstone");
+    }
+    tombstones->push_back(
+        RangeTombstone(ikey.user_key, iter->value(), ikey.sequence));
+  }
+  return iter->status();
+}
+
+void ExtendRangeForTombstone(const Comparator* icmp, const Slice& begin,
+                             const Slice& end, bool empty,
+                             InternalKey* smallest, InternalKey* largest) {
+  const InternalKey limit(end, kMaxSequenceNumber, kTypeRangeDeletion);
+  if (empty || icmp->Compare(begin, smallest->Encode()) < 0) {
+    smallest->DecodeFrom(begin);
+  }
+  if (empty || icmp->Compare(limit.Encode(), largest->Encode()) > 0) {
+    *largest = limit;
+  }
+}
+
+RangeTombstoneSet::RangeTombstoneSet(const Comparator* user_comparator,
+                                     SequenceNumber snapshot)
+    : ucmp_(user_comparator), snapshot_(snapshot), fragments_valid_(true) {}
+
+void RangeTombstoneSet::Add(const RangeTombstone& t) {
+  if (t.seq <= snapshot_ && ucmp_->Compare(t.begin, t.end) < 0) {
+    tombstones_.push_back(t);
+    fragments_valid_ = false;
+  }
+}
+
+Status RangeTombstoneSet::AddAll(Iterator* iter) {
+  std::vector<RangeTombstone> tombstones;
+  Status s = ReadRangeTombstones(iter, &tombstones);
+  for (size_t i = 0; i < tombstones.size(); i++) {
+    Add(tombstones[i]);
+  }
+  return s;
+}
+
+void RangeTombstoneSet::AddFragments(
+    const FragmentedRangeTombstones& fragments, SequenceNumber global_seqno) {
+  std::vector<RangeTombstone> tombstones;
+  if (global_seqno == 0) {
+    fragments.GetFragments(snapshot_, &tombstones);
+  } else if (global_seqno <= snapshot_) {
+    fragments.GetFragments(kMaxSequenceNumber, &tombstones);
+  }
+  for (size_t i = 0; i < tombstones.size(); i++) {
+    if (global_seqno != 0) {
+      tombstones[i].seq = global_seqno;
+    }
+    Add(tombstones[i]);
+  }
+}
+
+void RangeTombstoneSet::BuildFragments() {
+  std::vector<std::vector<SequenceNumber>> covering;
+  FragmentTombstones(ucmp_, tombstones_, &boundaries_, &covering);
+  seqs_.assign(boundaries_.size(), 0);
+  for (size_t j = 0; j < covering.size(); j++) {
+    for (SequenceNumber seq : covering[j]) {
+      seqs_[j] = std::max(seqs_[j], seq);
+    }
+  }
+  fragments_valid_ = true;
+}
+
+SequenceNumber RangeTombstoneSet::MaxCoveringSeq(const Slice& user_key) {
+  if (tombstones_.empty()) {
+    return 0;
+  }
+  if (!fragments_valid_) {
+    BuildFragments();
+  }
+  // Find the last boundary at or before "user_key".
+  size_t left = 0;
+  size_t right = boundaries_.size();
+  while (left < right) {
+    size_t mid = (left + right) / 2;
+    if (ucmp_->Compare(boundaries_[mid], user_key) <= 0) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return left == 0 ? 0 : seqs_[left - 1];
+}
+
+FragmentedRangeTombstones::FragmentedRangeTombstones(
+    const Comparator* user_comparator,
+    const std::vector<RangeTombstone>& tombstones)
+    : ucmp_(user_comparator) {
+  std::vector<std::vector<SequenceNumber>> covering;
+  FragmentTombstones(ucmp_, tombstones, &boundaries_, &covering);
+  for (size_t j = 0; j < covering.size(); j++) {
+    seq_starts_.push_back(seqs_.size());
+    std::sort(covering[j].begin(), covering[j].end(),
+              std::greater<SequenceNumber>());
+    seqs_.insert(seqs_.end(), covering[j].begin(), covering[j].end());
+  }
+  seq_starts_.push_back(seqs_.size());
+}
+
+size_t FragmentedRangeTombstones::FindFragment(const Slice& user_key) const {
+  // Find the last boundary at or before "user_key".
+  size_t left = 0;
+  size_t right = boundaries_.size();
+  while (left < right) {
+    size_t mid = (left + right) / 2;
+    if (ucmp_->Compare(boundaries_[mid], user_key) <= 0) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return left == 0 ? boundaries_.size() : left - 1;
+}
+
+SequenceNumber FragmentedRangeTombstones::MaxCoveringSeq(
+    const Slice& user_key, SequenceNumber snapshot) const {
+  const size_t fragment = FindFragment(user_key);
+  if (fragment == boundaries_.size()) {
+    return 0;
+  }
+  const auto begin = seqs_.begin() + seq_starts_[fragment];
+  const auto end = seqs_.begin() + seq_starts_[fragment + 1];
+  // The first sequence number no larger than the snapshot.
+  const auto it =
+      std::lower_bound(begin, end, snapshot, std::greater<SequenceNumber>());
+  return it == end ? 0 : *it;
+}
+
+bool FragmentedRangeTombstones::Covers(const Slice& user_key) const {
+  const size_t fragment = FindFragment(user_key);
+  return fragment != boundaries_.size() &&
+         seq_starts_[fragment] < seq_starts_[fragment + 1];
+}
+
+void FragmentedRangeTombstones::GetFragments(
+    SequenceNumber snapshot, std::vector<RangeTombstone>* tombstones) const {
+  for (size_t i = 0; i + 1 < boundaries_.size(); i++) {
+    const auto begin = seqs_.begin() + seq_starts_[i];
+    const auto end = seqs_.begin() + seq_starts_[i + 1];
+    const auto it =
+        std::lower_bound(begin, end, snapshot, std::greater<SequenceNumber>());
+    if (it != end) {
+      tombstones->push_back(
+          RangeTombstone(boundaries_[i], boundaries_[i + 1], *it));
+    }
+  }
+}
+
+}  // namespace leveldb
@@ -0,0 +1,147 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// DB::DeleteRange(begin, end) writes a single range tombstone: an entry of
+// type kTypeRangeDeletion whose user key is "begin" and whose value is
+// "end".  It hides every entry for a user key in [begin, end) that has a
+// smaller sequence number.
+//
+// Memtables keep range tombstones apart from point entries and tables
+// store them in a meta block, so reads that do not touch a tombstone never
+// pay for it.  The key range of a table file includes its tombstones; the
+// exclusive end of a tombstone is represented by the sentinel internal key
+// (end, kMaxSequenceNumber, kTypeRangeDeletion), which sorts before every
+// real entry for "end".
+
+#ifndef STORAGE_LEVELDB_DB_RANGE_DEL_H_
+#define STORAGE_LEVELDB_DB_RANGE_DEL_H_
+
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Comparator;
+class FragmentedRangeTombstones;
+class Iterator;
+
+struct RangeTombstone {
+  RangeTombstone() : seq(0) {}
+  RangeTombstone(const Slice& b, const Slice& e, SequenceNumber s)
+      : begin(b.ToString()), end(e.ToString()), seq(s) {}
+
+  std::string begin;  // Included in the range
+  std::string end;    // Not included in the range
+  SequenceNumber seq;
+};
+
+// Parse the tombstones yielded by "iter" (internal key of the begin key
+// => end key) and append them to *tombstones.
+Status ReadRangeTombstones(Iterator* iter,
+                           std::vector<RangeTombstone>* tombstones);
+
+// Extend the key range [*smallest, *largest] of a table file, ordered by
+// the internal key comparator "icmp", to span the range tombstone whose
+// internal key is "begin" and whose end key is "end".  If "empty" is true
+// the file has no keys yet, and the range is set to the tombstone's.
+void ExtendRangeForTombstone(const Comparator* icmp, const Slice& begin,
+                             const Slice& end, bool empty,
+                             InternalKey* smallest, InternalKey* largest);
+
+// Answers MaxCoveringTombstoneSeq() for many keys against the tombstones
+// of several sources.  The tombstones visible at the snapshot are
+// flattened into non-overlapping fragments, so each lookup is a binary
+// search.
+//
+// Not thread-safe.
+class RangeTombstoneSet {
+ public:
+  RangeTombstoneSet(const Comparator* user_comparator,
+                    SequenceNumber snapshot);
+
+  RangeTombstoneSet(const RangeTombstoneSet&) = delete;
+  RangeTombstoneSet& operator=(const RangeTombstoneSet&) = delete;
+
+  // Add "t" unless it is newer than the snapshot or covers no keys.
+  void Add(const RangeTombstone& t);
+
+  // Add the tombstones yielded by "iter".  Does not take ownership.
+  Status AddAll(Iterator* iter);
+
+  // Add the tombstones of "fragments".  If "global_seqno" is non-zero, it
+  // is the sequence number of all of them (see FileMetaData::global_seqno).
+  void AddFragments(const FragmentedRangeTombstones& fragments,
+                    SequenceNumber global_seqno);
+
+  bool empty() const { return tombstones_.empty(); }
+
+  // Return the largest sequence number of an added tombstone that covers
+  // "user_key", or zero if none does.
+  SequenceNumber MaxCoveringSeq(const Slice& user_key);
+
+ private:
+  void BuildFragments();
+
+  const Comparator* const ucmp_;
+  const SequenceNumber snapshot_;
+  std::vector<RangeTombstone> tombstones_;
+
+  // Fragment i spans [boundaries_[i], boundaries_[i + 1]) and is covered
+  // by tombstones up to sequence number seqs_[i] (zero when uncovered).
+  // Rebuilt on lookup after tombstones have been added.
+  bool fragments_valid_;
+  std::vector<std::string> boundaries_;
+  std::vector<SequenceNumber> seqs_;
+};
+
+// The tombstones of a memtable or table, split into non-overlapping
+// fragments that each list the sequence numbers of the tombstones covering
+// them, so that point lookups at any snapshot are a binary search.
+//
+// Immutable, and so safe to use from several threads.
+class FragmentedRangeTombstones {
+ public:
+  FragmentedRangeTombstones(const Comparator* user_comparator,
+                            const std::vector<RangeTombstone>& tombstones);
+
+  FragmentedRangeTombstones(const FragmentedRangeTombstones&) = delete;
+  FragmentedRangeTombstones& operator=(const FragmentedRangeTombstones&) =
+      delete;
+
+  // Return the largest sequence number no larger than "snapshot" of a
+  // tombstone that covers "user_key", or zero if none does.
+  SequenceNumber MaxCoveringSeq(const Slice& user_key,
+                                SequenceNumber snapshot) const;
+
+  // Return true iff some tombstone covers "user_key".
+  bool Covers(const Slice& user_key) const;
+
+  // Append to *tombstones one tombstone for each fragment covered by a
+  // tombstone no newer than "snapshot", with the largest such sequence
+  // number.
+  void GetFragments(SequenceNumber snapshot,
+                    std::vector<RangeTombstone>* tombstones) const;
+
+ private:
+  // Return the fragment that holds "user_key", or boundaries_.size() if
+  // it lies before the first one.
+  size_t FindFragment(const Slice& user_key) const;
+
+  const Comparator* const ucmp_;
+
+  // Fragment i spans [boundaries_[i], boundaries_[i + 1]).  The sequence
+  // numbers of the tombstones covering it, newest first, are
+  // seqs_[seq_starts_[i], seq_starts_[i + 1]).
+  std::vector<std::string> boundaries_;
+  std::vector<size_t> seq_starts_;
+  std::vector<SequenceNumber> seqs_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_RANGE_DEL_H_
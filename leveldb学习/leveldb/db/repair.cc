@@ -24,10 +24,14 @@
 //   Store per-table metadata (smallest, largest, largest-seq#, ...)
 //   in the table's meta section to speed up ScanTable.
 
+#include <map>
+
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_impl.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/range_del.h"
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
@@ -93,6 +97,8 @@ class Repairer {
   struct TableInfo {
     FileMetaData meta;
     SequenceNumber max_sequence;
+    // Size of the separated values the table refers to, per blob file.
+    std::map<uint64_t, uint64_t> blob_bytes;
   };
 
   Status FindFiles() {
@@ -119,6 +125,8 @@ class Repairer {
             logs_.push_back(number);
           } else if (type == kTableFile) {
             table_numbers_.push_back(number);
+          } else if (type == kBlobFile) {
+            blob_numbers_.push_back(number);
           } else {
             // Ignore other files
           }
@@ -203,7 +211,10 @@ class Repairer {
     FileMetaData meta;
     meta.number = next_file_number_++;
     Iterator* iter = mem->NewIterator();
-    status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    Iterator* range_del_iter = mem->NewRangeTombstoneIterator();
+    status = BuildTable(dbname_, env_, options_, table_cache_, iter,
+                        range_del_iter, &meta, /*blob=*/nullptr);
+    delete range_del_iter;
     delete iter;
     mem->Unref();
     mem = nullptr;
@@ -229,7 +240,8 @@ class Repairer {
     // on checksum verification.
     ReadOptions r;
     r.verify_checksums = options_.paranoid_checks;
-    return table_cache_->NewIterator(r, meta.number, meta.file_size);
+    return table_cache_->NewIterator(r, meta.number, meta.file_size,
+                                     meta.global_seqno);
   }
 
   void ScanTable(uint64_t number) {
@@ -276,11 +288,35 @@ class Repairer {
       if (parsed.sequence > t.max_sequence) {
         t.max_sequence = parsed.sequence;
       }
+      if (parsed.type == kTypeBlobIndex) {
+        Slice input = iter->value();
+        BlobIndex index;
+        if (index.DecodeFrom(&input)) {
+          t.blob_bytes[index.file_number] += index.size;
+        }
+      }
     }
     if (!iter->status().ok()) {
       status = iter->status();
     }
     delete iter;
+
+    // The key range also spans the table's range tombstones.
+    std::vector<RangeTombstone> tombstones;
+    if (status.ok()) {
+      status = ReadTableRangeTombstones(t.meta, &tombstones);
+    }
+    for (size_t i = 0; i < tombstones.size(); i++) {
+      const RangeTombstone& tombstone = tombstones[i];
+      InternalKey begin(tombstone.begin, tombstone.seq, kTypeRangeDeletion);
+      ExtendRangeForTombstone(&icmp_, begin.Encode(), tombstone.end, empty,
+                              &t.meta.smallest, &t.meta.largest);
+      empty = false;
+      t.meta.has_range_tombstones = true;
+      if (tombstone.seq > t.max_sequence) {
+        t.max_sequence = tombstone.seq;
+      }
+    }
     Log(options_.info_log, "Table #%llu: %d entries %s",
         (unsigned long long)t.meta.number, counter, status.ToString().c_str());
 
@@ -291,6 +327,18 @@ class Repairer {
     }
   }
 
+  Status ReadTableRangeTombstones(const FileMetaData& meta,
+                                  std::vector<RangeTombstone>* tombstones) {
+    Iterator* iter;
+    Status s = table_cache_->NewRangeTombstoneIterator(
+        meta.number, meta.file_size, meta.global_seqno, &iter);
+    if (s.ok() && iter != nullptr) {
+      s = ReadRangeTombstones(iter, tombstones);
+      delete iter;
+    }
+    return s;
+  }
+
   void RepairTable(const std::string& src, TableInfo t) {
     // We will copy src contents to a new table and then rename the
     // new table over the source.
@@ -361,6 +409,9 @@ class Repairer {
     }
 
     edit_.SetComparatorName(icmp_.user_comparator()->Name());
+    if (options_.compaction_style != kCompactionStyleLevel) {
+      edit_.SetCompactionStyle(options_.compaction_style);
+    }
     edit_.SetLogNumber(0);
     edit_.SetNextFile(next_file_number_);
     edit_.SetLastSequence(max_sequence);
@@ -368,8 +419,24 @@ class Repairer {
     for (size_t i = 0; i < tables_.size(); i++) {
       // TODO(opt): separate out into multiple levels
       const TableInfo& t = tables_[i];
-      edit_.AddFile(0, t.meta.number, t.meta.file_size, t.meta.smallest,
-                    t.meta.largest);
+      edit_.AddFile(0, t.meta);
+    }
+
+    // Count only the values the recovered tables still refer to as the
+    // contents of each blob file, so that the file is collected once
+    // those references are dropped.  Blob files that no table refers to
+    // are left out and deleted as obsolete when the database is opened.
+    std::map<uint64_t, uint64_t> blob_bytes;
+    for (size_t i = 0; i < tables_.size(); i++) {
+      for (const auto& kvp : tables_[i].blob_bytes) {
+        blob_bytes[kvp.first] += kvp.second;
+      }
+    }
+    for (size_t i = 0; i < blob_numbers_.size(); i++) {
+      auto it = blob_bytes.find(blob_numbers_[i]);
+      if (it != blob_bytes.end() && it->second > 0) {
+        edit_.AddBlobFile(it->first, it->second);
+      }
     }
 
     // std::fprintf(stderr,
@@ -437,6 +504,7 @@ class Repairer {
 
   std::vector<std::string> manifests_;
   std::vector<uint64_t> table_numbers_;
+  std::vector<uint64_t> blob_numbers_;
   std::vector<uint64_t> logs_;
   std::vector<TableInfo> tables_;
   uint64_t next_file_number_;
@@ -0,0 +1,137 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/sst_file_writer.h"
+
+#include "db/dbformat.h"
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
+#include "leveldb/table_builder.h"
+
+namespace leveldb {
+
+struct SstFileWriter::Rep {
+  explicit Rep(const Options& opt)
+      : options(opt),
+        icmp(opt.comparator),
+        ipolicy(opt.filter_policy),
+        file(nullptr),
+        builder(nullptr),
+        file_size(0) {
+    // Tables hold internal keys, exactly as if built by a memtable flush.
+    options.comparator = &icmp;
+    options.filter_policy =
+        (opt.filter_policy != nullptr) ? &ipolicy : nullptr;
+  }
+
+  Options options;
+  const InternalKeyComparator icmp;
+  const InternalFilterPolicy ipolicy;
+  std::string fname;
+  WritableFile* file;
+  TableBuilder* builder;
+  std::string last_key;  // Last user key added
+  uint64_t file_size;    // Size of the last finished file
+};
+
+SstFileWriter::SstFileWriter(const Options& options)
+    : rep_(new Rep(options)) {}
+
+SstFileWriter::~SstFileWriter() {
+  if (rep_->builder != nullptr) {
+    Abandon();
+  }
+  delete rep_;
+}
+
+Status SstFileWriter::Open(const std::string& fname) {
+  Rep* r = rep_;
+  assert(r->builder == nullptr);
+  Status s = r->options.env->NewWritableFile(fname, &r->file);
+  if (!s.ok()) {
+    return s;
+  }
+  r->fname = fname;
+  r->builder = new TableBuilder(r->options, r->file);
+  r->last_key.clear();
+  r->file_size = 0;
+  return s;
+}
+
+Status SstFileWriter::Put(const Slice& key, const Slice& value) {
+  return Add(key, value, /*is_deletion=*/false);
+}
+
+Status SstFileWriter::Delete(const Slice& key) {
+  return Add(key, Slice(), /*is_deletion=*/true);
+}
+
+Status SstFileWriter::Add(const Slice& key, const Slice& value,
+                          bool is_deletion) {
+  Rep* r = rep_;
+  if (r->builder == nullptr) {
+    return Status::InvalidArgument("no file is open");
+  }
+  if (r->builder->NumEntries() > 0 &&
+      r->icmp.user_comparator()->Compare(key, r->last_key) <= 0) {
+    return Status::InvalidArgument("keys must be added in increasing order",
+                                   key);
+  }
+
+  // Every entry is stored with sequence number zero.  The database
+  // assigns the file a global sequence number when it is ingested.
+  std::string ikey;
+  AppendInternalKey(&ikey,
+                    ParsedInternalKey(key, 0,
+                                      is_deletion ? kTypeDeletion
+                                                  : kTypeValue));
+  r->builder->Add(ikey, value);
+  r->last_key.assign(key.data(), key.size());
+  return r->builder->status();
+}
+
+Status SstFileWriter::Finish() {
+  Rep* r = rep_;
+  if (r->builder == nullptr) {
+    return Status::InvalidArgument("no file is open");
+  }
+  if (r->builder->NumEntries() == 0) {
+    Abandon();
+    return Status::InvalidArgument("cannot create an empty table");
+  }
+
+  Status s = r->builder->Finish();
+  r->file_size = r->builder->FileSize();
+  if (s.ok()) {
+    s = r->file->Sync();
+  }
+  if (s.ok()) {
+    s = r->file->Close();
+  }
+  delete r->builder;
+  r->builder = nullptr;
+  delete r->file;
+  r->file = nullptr;
+  if (!s.ok()) {
+    r->options.env->RemoveFile(r->fname);
+  }
+  return s;
+}
+
+uint64_t SstFileWriter::FileSize() const {
+  return rep_->builder != nullptr ? rep_->builder->FileSize()
+                                  : rep_->file_size;
+}
+
+void SstFileWriter::Abandon() {
+  Rep* r = rep_;
+  r->builder->Abandon();
+  delete r->builder;
+  r->builder = nullptr;
+  delete r->file;  // Will auto-close
+  r->file = nullptr;
+  r->options.env->RemoveFile(r->fname);
+}
+
+}  // namespace leveldb
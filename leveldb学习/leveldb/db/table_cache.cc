@@ -5,19 +5,37 @@
 #include "db/table_cache.h"
 
 #include "db/filename.h"
+#include "db/range_del.h"
 #include "leveldb/env.h"
 #include "leveldb/table.h"
+#include "port/probes.h"
 #include "util/coding.h"
+#include "util/mutexlock.h"
+#include "util/perf_context_imp.h"
+#include "util/stop_watch.h"
 
 namespace leveldb {
 
 struct TableAndFile {
   RandomAccessFile* file;
   Table* table;
+  TableCache* owner;
+  // The range tombstones of the table, or null if it has none.
+  FragmentedRangeTombstones* tombstones;
 };
 
-static void DeleteEntry(const Slice& key, void* value) {
+void TableCache::DeleteEntry(const Slice& key, void* value) {
   TableAndFile* tf = reinterpret_cast<TableAndFile*>(value);
+  {
+    TableCache* owner = tf->owner;
+    MutexLock l(&owner->open_mutex_);
+    // A racing FindTable() may have replaced this entry.
+    auto it = owner->open_tables_.find(DecodeFixed64(key.data()));
+    if (it != owner->open_tables_.end() && it->second == tf->table) {
+      owner->open_tables_.erase(it);
+    }
+  }
+  delete tf->tombstones;
   delete tf->table;
   delete tf->file;
   delete tf;
@@ -29,6 +47,102 @@ static void UnrefEntry(void* arg1, void* arg2) {
   cache->Release(h);
 }
 
+// Rewrites the sequence number of an internal key to "global_seqno".
+// Keys that do not parse are left alone so that readers report them.
+static void ApplyGlobalSeqno(const Slice& key, SequenceNumber global_seqno,
+                             std::string* result) {
+  ParsedInternalKey parsed;
+  result->clear();
+  if (ParseInternalKey(key, &parsed)) {
+    parsed.sequence = global_seqno;
+    AppendInternalKey(result, parsed);
+  } else {
+    result->assign(key.data(), key.size());
+  }
+}
+
+namespace {
+
+// Iterates over an ingested table, whose keys are all stored with sequence
+// number zero, as if they carried the table's global sequence number.
+class GlobalSeqnoIterator : public Iterator {
+ public:
+  GlobalSeqnoIterator(const Comparator* icmp, Iterator* iter,
+                      SequenceNumber global_seqno)
+      : icmp_(icmp), iter_(iter), global_seqno_(global_seqno) {}
+
+  ~GlobalSeqnoIterator() override { delete iter_; }
+
+  bool Valid() const override { return iter_->Valid(); }
+  void SeekToFirst() override {
+    iter_->SeekToFirst();
+    Update();
+  }
+  void SeekToLast() override {
+    iter_->SeekToLast();
+    Update();
+  }
+  void Seek(const Slice& target) override {
+    iter_->Seek(target);
+    Update();
+    // The stored entry for target's user key always sorts at or after
+    // target, but with the global sequence number applied it sorts before
+    // target when it is newer.  Each user key appears only once per table.
+    if (Valid() && icmp_->Compare(key(), target) < 0) {
+      Next();
+    }
+  }
+  void Next() override {
+    iter_->Next();
+    Update();
+  }
+  void Prev() override {
+    iter_->Prev();
+    Update();
+  }
+  Slice key() const override {
+    assert(Valid());
+    return key_;
+  }
+  Slice value() const override { return iter_->value(); }
+  Status status() const override { return iter_->status(); }
+
+ private:
+  void Update() {
+    if (iter_->Valid()) {
+      ApplyGlobalSeqno(iter_->key(), global_seqno_, &key_);
+    }
+  }
+
+  const Comparator* const icmp_;
+  Iterator* const iter_;
+  const SequenceNumber global_seqno_;
+  std::string key_;
+};
+
+// Forwards a lookup result from an ingested table with the global sequence
+// number applied.
+struct GlobalSeqnoSaver {
+  void* arg;
+  void (*handle_result)(void*, const Slice&, const Slice&);
+  SequenceNumber global_seqno;
+  SequenceNumber lookup_seqno;
+};
+
+}  // namespace
+
+static void SaveWithGlobalSeqno(void* arg, const Slice& k, const Slice& v) {
+  GlobalSeqnoSaver* saver = reinterpret_cast<GlobalSeqnoSaver*>(arg);
+  if (saver->global_seqno > saver->lookup_seqno) {
+    // The entry is newer than the lookup.  The next entry in the table has
+    // a different user key, so the table holds nothing for the lookup.
+    return;
+  }
+  std::string key;
+  ApplyGlobalSeqno(k, saver->global_seqno, &key);
+  (*saver->handle_result)(saver->arg, key, v);
+}
+
 TableCache::TableCache(const std::string& dbname, const Options& options,
                        int entries)
     : env_(options.env),
@@ -45,7 +159,12 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
   EncodeFixed64(buf, file_number);
   Slice key(buf, sizeof(buf));
   *handle = cache_->Lookup(key);
-  if (*handle == nullptr) {
+  if (*handle != nullptr) {
+    RecordTick(options_.statistics, kTableCacheHit);
+    LEVELDB_PROBE1(table_cache_hit, file_number);
+  } else {
+    RecordTick(options_.statistics, kTableCacheMiss);
+    LEVELDB_PROBE1(table_cache_miss, file_number);
     std::string fname = TableFileName(dbname_, file_number);
     RandomAccessFile* file = nullptr;
     Table* table = nullptr;
@@ -60,6 +179,28 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
       s = Table::Open(options_, file, file_size, &table);
     }
 
+    // Tables are immutable, so their tombstones are fragmented once for
+    // all point lookups.
+    FragmentedRangeTombstones* tombstones = nullptr;
+    if (s.ok()) {
+      Iterator* iter = table->NewRangeTombstoneIterator();
+      if (iter != nullptr) {
+        std::vector<RangeTombstone> list;
+        s = ReadRangeTombstones(iter, &list);
+        delete iter;
+        if (s.ok()) {
+          // Tables of the DB are ordered by its InternalKeyComparator.
+          const Comparator* ucmp =
+              static_cast<const InternalKeyComparator*>(options_.comparator)
+                  ->user_comparator();
+          tombstones = new FragmentedRangeTombstones(ucmp, list);
+        } else {
+          delete table;
+          table = nullptr;
+        }
+      }
+    }
+
     if (!s.ok()) {
       assert(table == nullptr);
       delete file;
@@ -69,6 +210,12 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
       TableAndFile* tf = new TableAndFile;
       tf->file = file;
       tf->table = table;
+      tf->owner = this;
+      tf->tombstones = tombstones;
+      {
+        MutexLock l(&open_mutex_);
+        open_tables_[file_number] = table;
+      }
       *handle = cache_->Insert(key, tf, 1, &DeleteEntry);
     }
   }
@@ -77,6 +224,7 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
 
 Iterator* TableCache::NewIterator(const ReadOptions& options,
                                   uint64_t file_number, uint64_t file_size,
+                                  SequenceNumber global_seqno,
                                   Table** tableptr) {
   if (tableptr != nullptr) {
     *tableptr = nullptr;
@@ -91,26 +239,122 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
   Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
   Iterator* result = table->NewIterator(options);
   result->RegisterCleanup(&UnrefEntry, cache_, handle);
+  if (global_seqno != 0) {
+    result = new GlobalSeqnoIterator(options_.comparator, result, global_seqno);
+  }
   if (tableptr != nullptr) {
     *tableptr = table;
   }
   return result;
 }
 
+Status TableCache::NewRangeTombstoneIterator(uint64_t file_number,
+                                             uint64_t file_size,
+                                             SequenceNumber global_seqno,
+                                             Iterator** iter) {
+  *iter = nullptr;
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (!s.ok()) {
+    return s;
+  }
+
+  Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+  Iterator* result = table->NewRangeTombstoneIterator();
+  if (result == nullptr) {
+    cache_->Release(handle);
+    return s;
+  }
+  result->RegisterCleanup(&UnrefEntry, cache_, handle);
+  if (global_seqno != 0) {
+    result = new GlobalSeqnoIterator(options_.comparator, result, global_seqno);
+  }
+  *iter = result;
+  return s;
+}
+
+Status TableCache::AddRangeTombstones(uint64_t file_number,
+                                      uint64_t file_size,
+                                      SequenceNumber global_seqno,
+                                      RangeTombstoneSet* tombstones) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
+    TableAndFile* tf = reinterpret_cast<TableAndFile*>(cache_->Value(handle));
+    if (tf->tombstones != nullptr) {
+      tombstones->AddFragments(*tf->tombstones, global_seqno);
+    }
+    cache_->Release(handle);
+  }
+  return s;
+}
+
 Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
-                       uint64_t file_size, const Slice& k, void* arg,
+                       uint64_t file_size, SequenceNumber global_seqno,
+                       const Slice& k, void* arg,
                        void (*handle_result)(void*, const Slice&,
-                                             const Slice&)) {
+                                             const Slice&),
+                       SequenceNumber* tombstone_seq) {
   Cache::Handle* handle = nullptr;
+  PerfTimer find_timer(&PerfContext::find_table_nanos);
   Status s = FindTable(file_number, file_size, &handle);
+  find_timer.Stop();
   if (s.ok()) {
-    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-    s = t->InternalGet(options, k, arg, handle_result);
+    TableAndFile* tf = reinterpret_cast<TableAndFile*>(cache_->Value(handle));
+    Table* t = tf->table;
+    if (tombstone_seq != nullptr) {
+      *tombstone_seq = 0;
+      if (tf->tombstones != nullptr) {
+        const Slice user_key = ExtractUserKey(k);
+        const SequenceNumber snapshot =
+            DecodeFixed64(k.data() + k.size() - 8) >> 8;
+        if (global_seqno == 0) {
+          *tombstone_seq = tf->tombstones->MaxCoveringSeq(user_key, snapshot);
+        } else if (global_seqno <= snapshot &&
+                   tf->tombstones->Covers(user_key)) {
+          // Every tombstone of an ingested table has its global sequence
+          // number.
+          *tombstone_seq = global_seqno;
+        }
+      }
+    }
+    if (global_seqno == 0) {
+      s = t->InternalGet(options, k, arg, handle_result);
+    } else {
+      GlobalSeqnoSaver saver;
+      saver.arg = arg;
+      saver.handle_result = handle_result;
+      saver.global_seqno = global_seqno;
+      assert(k.size() >= 8);
+      saver.lookup_seqno = DecodeFixed64(k.data() + k.size() - 8) >> 8;
+      s = t->InternalGet(options, k, &saver, &SaveWithGlobalSeqno);
+    }
     cache_->Release(handle);
   }
   return s;
 }
 
+Status TableCache::Preload(uint64_t file_number, uint64_t file_size) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+void TableCache::AddMemoryUsage(uint64_t file_number,
+                                MemoryUsage::Level* usage) {
+  MutexLock l(&open_mutex_);
+  auto it = open_tables_.find(file_number);
+  if (it != open_tables_.end()) {
+    const Table* table = it->second;
+    usage->block_cache_usage += table->BlockCacheUsage();
+    usage->index_usage += table->IndexMemoryUsage();
+    usage->filter_usage += table->FilterMemoryUsage();
+  }
+}
+
 void TableCache::Evict(uint64_t file_number) {
   char buf[sizeof(file_number)];
   EncodeFixed64(buf, file_number);
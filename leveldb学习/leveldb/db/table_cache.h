@@ -8,16 +8,20 @@
 #define STORAGE_LEVELDB_DB_TABLE_CACHE_H_
 
 #include <cstdint>
+#include <map>
 #include <string>
 
 #include "db/dbformat.h"
 #include "leveldb/cache.h"
+#include "leveldb/db.h"
 #include "leveldb/table.h"
 #include "port/port.h"
+#include "port/thread_annotations.h"
 
 namespace leveldb {
 
 class Env;
+class RangeTombstoneSet;
 
 class TableCache {
  public:
@@ -29,31 +33,67 @@ class TableCache {
   ~TableCache();
 
   // Return an iterator for the specified file number (the corresponding
-  // file length must be exactly "file_size" bytes).  If "tableptr" is
+  // file length must be exactly "file_size" bytes).  If "global_seqno" is
+  // non-zero, the keys of the file are reported with that sequence number
+  // (see FileMetaData::global_seqno).  If "tableptr" is
   // non-null, also sets "*tableptr" to point to the Table object
   // underlying the returned iterator, or to nullptr if no Table object
   // underlies the returned iterator.  The returned "*tableptr" object is owned
   // by the cache and should not be deleted, and is valid for as long as the
   // returned iterator is live.
   Iterator* NewIterator(const ReadOptions& options, uint64_t file_number,
-                        uint64_t file_size, Table** tableptr = nullptr);
+                        uint64_t file_size, SequenceNumber global_seqno,
+                        Table** tableptr = nullptr);
+
+  // Store in *iter an iterator over the range tombstones of the specified
+  // file (see NewIterator()), or nullptr if the file has none.
+  Status NewRangeTombstoneIterator(uint64_t file_number, uint64_t file_size,
+                                   SequenceNumber global_seqno,
+                                   Iterator** iter);
+
+  // Add the range tombstones of the specified file (see NewIterator()) to
+  // *tombstones.  They are read from the tombstone block when the file is
+  // opened, not on every call.
+  Status AddRangeTombstones(uint64_t file_number, uint64_t file_size,
+                            SequenceNumber global_seqno,
+                            RangeTombstoneSet* tombstones);
 
   // If a seek to internal key "k" in specified file finds an entry,
-  // call (*handle_result)(arg, found_key, found_value).
+  // call (*handle_result)(arg, found_key, found_value).  If
+  // "tombstone_seq" is non-null, also store in it the largest sequence
+  // number no larger than that of "k" of a range tombstone in the file
+  // that covers the user key of "k", or zero if none does.
   Status Get(const ReadOptions& options, uint64_t file_number,
-             uint64_t file_size, const Slice& k, void* arg,
-             void (*handle_result)(void*, const Slice&, const Slice&));
+             uint64_t file_size, SequenceNumber global_seqno, const Slice& k,
+             void* arg,
+             void (*handle_result)(void*, const Slice&, const Slice&),
+             SequenceNumber* tombstone_seq = nullptr);
+
+  // Open the specified file (see NewIterator()) and keep it in the cache,
+  // so that later accesses need not read its footer, index and filter.
+  Status Preload(uint64_t file_number, uint64_t file_size);
+
+  // If the specified file is open, add the memory held by its table to
+  // *usage.  Does not open the file or affect which tables are evicted.
+  void AddMemoryUsage(uint64_t file_number, MemoryUsage::Level* usage);
 
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
 
  private:
+  static void DeleteEntry(const Slice& key, void* value);
+
   Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
 
   Env* const env_;
   const std::string dbname_;
   const Options& options_;
   Cache* cache_;
+
+  // The tables in cache_, by file number, so that AddMemoryUsage() can
+  // visit them without a Lookup(), which would refresh their recency.
+  port::Mutex open_mutex_;
+  std::map<uint64_t, const Table*> open_tables_ GUARDED_BY(open_mutex_);
 };
 
 }  // namespace leveldb
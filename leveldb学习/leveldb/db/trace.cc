@@ -0,0 +1,199 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/trace.h"
+
+#include <algorithm>
+
+#include "leveldb/env.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+namespace {
+
+const uint64_t kTraceMagic = 0x65636172746c646cull;  // "ldltrace"
+const uint32_t kTraceVersion = 1;
+
+// Upper bound on the encoded size of a record before its payload.
+const size_t kMaxRecordHeader = 10 + 1 + 5;
+
+}  // namespace
+
+Status TraceWriter::Create(Env* env, const TraceOptions& options,
+                           const std::string& path, TraceWriter** result) {
+  *result = nullptr;
+  WritableFile* file;
+  Status s = env->NewWritableFile(path, &file);
+  if (!s.ok()) {
+    return s;
+  }
+  const uint64_t start_micros = env->NowMicros();
+  std::string header;
+  PutFixed64(&header, kTraceMagic);
+  PutVarint32(&header, kTraceVersion);
+  PutFixed64(&header, start_micros);
+  s = file->Append(header);
+  if (s.ok()) {
+    s = file->Flush();
+  }
+  if (!s.ok()) {
+    delete file;
+    env->RemoveFile(path);
+    return s;
+  }
+  *result = new TraceWriter(env, options, file, start_micros);
+  (*result)->file_size_ = header.size();
+  return s;
+}
+
+TraceWriter::TraceWriter(Env* env, const TraceOptions& options,
+                         WritableFile* file, uint64_t start_micros)
+    : env_(env),
+      options_(options),
+      file_(file),
+      last_micros_(start_micros),
+      file_size_(0),
+      operations_(0) {}
+
+TraceWriter::~TraceWriter() { Close(); }
+
+void TraceWriter::Add(TraceType type, const Slice& payload) {
+  if (file_ == nullptr || !status_.ok()) {
+    return;
+  }
+  const uint64_t sampling = std::max<uint64_t>(options_.sampling_frequency, 1);
+  if (operations_++ % sampling != 0) {
+    return;
+  }
+
+  // The clock may step backwards; keep the deltas non-negative.
+  const uint64_t now = std::max(env_->NowMicros(), last_micros_);
+  record_.clear();
+  PutVarint64(&record_, now - last_micros_);
+  record_.push_back(static_cast<char>(type));
+  PutLengthPrefixedSlice(&record_, payload);
+  if (file_size_ + record_.size() > options_.max_trace_file_size) {
+    // Stop here rather than leave gaps in the trace.
+    Close();
+    return;
+  }
+  status_ = file_->Append(record_);
+  file_size_ += record_.size();
+  last_micros_ = now;
+}
+
+Status TraceWriter::Close() {
+  if (file_ != nullptr) {
+    Status s = file_->Close();
+    if (status_.ok()) {
+      status_ = s;
+    }
+    delete file_;
+    file_ = nullptr;
+  }
+  return status_;
+}
+
+Status TraceReader::Open(Env* env, const std::string& path,
+                         TraceReader** result) {
+  *result = nullptr;
+  SequentialFile* file;
+  Status s = env->NewSequentialFile(path, &file);
+  if (!s.ok()) {
+    return s;
+  }
+  TraceReader* reader = new TraceReader(file);
+  uint64_t magic = 0;
+  uint32_t version = 0;
+  if (!reader->Fill(8 + 5 + 8)) {
+    s = reader->status_;
+  } else {
+    Slice input = reader->unread();
+    if (input.size() >= 8) {
+      magic = DecodeFixed64(input.data());
+      input.remove_prefix(8);
+    }
+    if (magic != kTraceMagic || !GetVarint32(&input, &version) ||
+        input.size() < 8) {
+      s = Status::Corruption(path, "not a trace file");
+    } else if (version != kTraceVersion) {
+      s = Status::NotSupported(path, "unknown trace file version");
+    } else {
+      reader->start_micros_ = DecodeFixed64(input.data());
+      input.remove_prefix(8);
+      reader->pos_ = input.data() - reader->buffer_.data();
+    }
+  }
+  if (!s.ok()) {
+    delete reader;
+    return s;
+  }
+  *result = reader;
+  return s;
+}
+
+TraceReader::TraceReader(SequentialFile* file)
+    : file_(file), pos_(0), eof_(false), start_micros_(0), micros_(0) {}
+
+TraceReader::~TraceReader() { delete file_; }
+
+bool TraceReader::Fill(size_t n) {
+  if (buffer_.size() - pos_ >= n || eof_) {
+    return true;
+  }
+  buffer_.erase(0, pos_);
+  pos_ = 0;
+  const size_t kChunk = 65536;
+  std::string scratch;
+  while (buffer_.size() < n && !eof_) {
+    scratch.resize(std::max(kChunk, n - buffer_.size()));
+    Slice fragment;
+    status_ = file_->Read(scratch.size(), &fragment, &scratch[0]);
+    if (!status_.ok()) {
+      return false;
+    }
+    if (fragment.empty()) {
+      eof_ = true;
+    }
+    buffer_.append(fragment.data(), fragment.size());
+  }
+  return true;
+}
+
+bool TraceReader::Read(TraceRecord* record) {
+  if (!status_.ok() || !Fill(kMaxRecordHeader)) {
+    return false;
+  }
+  Slice input = unread();
+  uint64_t delta;
+  uint32_t length;
+  if (input.empty() || !GetVarint64(&input, &delta) || input.empty()) {
+    return false;
+  }
+  const uint8_t type = input[0];
+  input.remove_prefix(1);
+  if (!GetVarint32(&input, &length)) {
+    return false;
+  }
+  if (type < kTraceWrite || type > kTraceSeekToLast) {
+    status_ = Status::Corruption("unknown trace record type");
+    return false;
+  }
+  const size_t header = input.data() - unread().data();
+  if (!Fill(header + length)) {
+    return false;
+  }
+  if (unread().size() < header + length) {
+    return false;  // Truncated record at the end
+  }
+  micros_ += delta;
+  record->micros = micros_;
+  record->type = static_cast<TraceType>(type);
+  record->payload.assign(unread().data() + header, length);
+  pos_ += header + length;
+  return true;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,123 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A trace file, written by DB::StartTrace(), holds the operations done
+// through a DB in the order they were started:
+//
+//    header: magic (fixed64), version (varint32), start time (fixed64
+//            microseconds since the epoch)
+//    record*: micros since the previous record (varint64), type (byte),
+//             payload length (varint32), payload
+//
+// The payload is the key of a read or seek, or the contents of the
+// WriteBatch of a write.
+
+#ifndef STORAGE_LEVELDB_DB_TRACE_H_
+#define STORAGE_LEVELDB_DB_TRACE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Env;
+class SequentialFile;
+class WritableFile;
+
+enum TraceType : uint8_t {
+  kTraceWrite = 1,
+  kTraceGet = 2,
+  kTraceSeek = 3,  // Iterator::Seek() of an iterator from DB::NewIterator()
+  kTraceSeekToFirst = 4,
+  kTraceSeekToLast = 5,
+};
+
+struct TraceRecord {
+  uint64_t micros;  // When the operation started, since the trace began
+  TraceType type;
+  std::string payload;
+};
+
+// Appends records to a new trace file.  Not thread-safe.
+class TraceWriter {
+ public:
+  // Create the file "path" and write its header.
+  static Status Create(Env* env, const TraceOptions& options,
+                       const std::string& path, TraceWriter** result);
+
+  TraceWriter(const TraceWriter&) = delete;
+  TraceWriter& operator=(const TraceWriter&) = delete;
+
+  // Closes the file if Close() was not called.
+  ~TraceWriter();
+
+  // Record an operation starting now, subject to the sampling frequency
+  // and the file size limit of the TraceOptions.
+  void Add(TraceType type, const Slice& payload);
+
+  // Return the first error writing the file.
+  Status Close();
+
+ private:
+  TraceWriter(Env* env, const TraceOptions& options, WritableFile* file,
+              uint64_t start_micros);
+
+  Env* const env_;
+  const TraceOptions options_;
+  WritableFile* file_;
+  uint64_t last_micros_;
+  uint64_t file_size_;
+  uint64_t operations_;  // Seen by Add(), recorded or not
+  std::string record_;   // Reused to encode records
+  Status status_;
+};
+
+// Reads the records of a trace file in order.
+class TraceReader {
+ public:
+  static Status Open(Env* env, const std::string& path, TraceReader** result);
+
+  TraceReader(const TraceReader&) = delete;
+  TraceReader& operator=(const TraceReader&) = delete;
+
+  ~TraceReader();
+
+  // Microseconds since the epoch when the trace was started.
+  uint64_t start_micros() const { return start_micros_; }
+
+  // Store the next record in *record and return true, or return false at
+  // the end of the trace or on error.  A trace cut short, by a crash for
+  // instance, ends at its last whole record.
+  bool Read(TraceRecord* record);
+
+  // Return the error that stopped Read(), if any.
+  Status status() const { return status_; }
+
+ private:
+  explicit TraceReader(SequentialFile* file);
+
+  // Make sure that at least "n" unread bytes are buffered, unless the file
+  // ends first.  Returns false on a read error.
+  bool Fill(size_t n);
+
+  Slice unread() const {
+    return Slice(buffer_.data() + pos_, buffer_.size() - pos_);
+  }
+
+  SequentialFile* const file_;
+  std::string buffer_;
+  size_t pos_;
+  bool eof_;
+  uint64_t start_micros_;
+  uint64_t micros_;
+  Status status_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_TRACE_H_
@@ -20,7 +20,13 @@ enum Tag {
   kDeletedFile = 6,
   kNewFile = 7,
   // 8 was used for large value refs
-  kPrevLogNumber = 9
+  kPrevLogNumber = 9,
+  kIngestedFile = 10,
+  kNewBlobFile = 11,
+  kBlobGarbage = 12,
+  kRangeTombstoneFile = 13,
+  kFileStats = 14,
+  kCompactionStyle = 15
 };
 
 void VersionEdit::Clear() {
@@ -29,14 +35,18 @@ void VersionEdit::Clear() {
   prev_log_number_ = 0;
   last_sequence_ = 0;
   next_file_number_ = 0;
+  compaction_style_ = 0;
   has_comparator_ = false;
   has_log_number_ = false;
   has_prev_log_number_ = false;
   has_next_file_number_ = false;
   has_last_sequence_ = false;
+  has_compaction_style_ = false;
   compact_pointers_.clear();
   deleted_files_.clear();
   new_files_.clear();
+  new_blob_files_.clear();
+  blob_garbage_.clear();
 }
 
 void VersionEdit::EncodeTo(std::string* dst) const {
@@ -60,6 +70,10 @@ void VersionEdit::EncodeTo(std::string* dst) const {
     PutVarint32(dst, kLastSequence);
     PutVarint64(dst, last_sequence_);
   }
+  if (has_compaction_style_) {
+    PutVarint32(dst, kCompactionStyle);
+    PutVarint32(dst, compaction_style_);
+  }
 
   for (size_t i = 0; i < compact_pointers_.size(); i++) {
     PutVarint32(dst, kCompactPointer);
@@ -75,12 +89,44 @@ void VersionEdit::EncodeTo(std::string* dst) const {
 
   for (size_t i = 0; i < new_files_.size(); i++) {
     const FileMetaData& f = new_files_[i].second;
-    PutVarint32(dst, kNewFile);
+    // Plain files keep the original encoding so that older releases can
+    // still read manifests of databases that never ingested a file.
+    PutVarint32(dst, f.global_seqno == 0 ? kNewFile : kIngestedFile);
     PutVarint32(dst, new_files_[i].first);  // level
     PutVarint64(dst, f.number);
     PutVarint64(dst, f.file_size);
     PutLengthPrefixedSlice(dst, f.smallest.Encode());
     PutLengthPrefixedSlice(dst, f.largest.Encode());
+    if (f.global_seqno != 0) {
+      PutVarint64(dst, f.global_seqno);
+    }
+    if (f.has_range_tombstones) {
+      // Marks the file just added.
+      PutVarint32(dst, kRangeTombstoneFile);
+      PutVarint32(dst, new_files_[i].first);  // level
+      PutVarint64(dst, f.number);
+    }
+    if (f.num_entries != 0) {
+      PutVarint32(dst, kFileStats);
+      PutVarint32(dst, new_files_[i].first);  // level
+      PutVarint64(dst, f.number);
+      PutVarint64(dst, f.num_entries);
+      PutVarint64(dst, f.num_deletions);
+      PutVarint64(dst, f.largest_seqno);
+      PutVarint32(dst, f.marked_for_compaction ? 1 : 0);
+    }
+  }
+
+  for (size_t i = 0; i < new_blob_files_.size(); i++) {
+    PutVarint32(dst, kNewBlobFile);
+    PutVarint64(dst, new_blob_files_[i].number);
+    PutVarint64(dst, new_blob_files_[i].total_bytes);
+  }
+
+  for (size_t i = 0; i < blob_garbage_.size(); i++) {
+    PutVarint32(dst, kBlobGarbage);
+    PutVarint64(dst, blob_garbage_[i].first);   // file number
+    PutVarint64(dst, blob_garbage_[i].second);  // bytes
   }
 }
 
@@ -113,6 +159,10 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
   int level;
   uint64_t number;
   FileMetaData f;
+  BlobFileMetaData blob;
+  uint64_t bytes;
+  uint32_t marked;
+  uint32_t style;
   Slice str;
   InternalKey key;
 
@@ -159,6 +209,15 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         }
         break;
 
+      case kCompactionStyle:
+        if (GetVarint32(&input, &style)) {
+          compaction_style_ = style;
+          has_compaction_style_ = true;
+        } else {
+          msg = "compaction style";
+        }
+        break;
+
       case kCompactPointer:
         if (GetLevel(&input, &level) && GetInternalKey(&input, &key)) {
           compact_pointers_.push_back(std::make_pair(level, key));
@@ -186,6 +245,60 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         }
         break;
 
+      case kIngestedFile:
+        if (GetLevel(&input, &level) && GetVarint64(&input, &f.number) &&
+            GetVarint64(&input, &f.file_size) &&
+            GetInternalKey(&input, &f.smallest) &&
+            GetInternalKey(&input, &f.largest) &&
+            GetVarint64(&input, &f.global_seqno) && f.global_seqno != 0) {
+          new_files_.push_back(std::make_pair(level, f));
+          f.global_seqno = 0;
+        } else {
+          msg = "ingested-file entry";
+        }
+        break;
+
+      case kRangeTombstoneFile:
+        if (GetLevel(&input, &level) && GetVarint64(&input, &number) &&
+            !new_files_.empty() && new_files_.back().first == level &&
+            new_files_.back().second.number == number) {
+          new_files_.back().second.has_range_tombstones = true;
+        } else {
+          msg = "range-tombstone-file entry";
+        }
+        break;
+
+      case kFileStats:
+        if (GetLevel(&input, &level) && GetVarint64(&input, &number) &&
+            !new_files_.empty() && new_files_.back().first == level &&
+            new_files_.back().second.number == number &&
+            GetVarint64(&input, &new_files_.back().second.num_entries) &&
+            GetVarint64(&input, &new_files_.back().second.num_deletions) &&
+            GetVarint64(&input, &new_files_.back().second.largest_seqno) &&
+            GetVarint32(&input, &marked)) {
+          new_files_.back().second.marked_for_compaction = (marked != 0);
+        } else {
+          msg = "file-stats entry";
+        }
+        break;
+
+      case kNewBlobFile:
+        if (GetVarint64(&input, &blob.number) &&
+            GetVarint64(&input, &blob.total_bytes)) {
+          new_blob_files_.push_back(blob);
+        } else {
+          msg = "new-blob-file entry";
+        }
+        break;
+
+      case kBlobGarbage:
+        if (GetVarint64(&input, &number) && GetVarint64(&input, &bytes)) {
+          blob_garbage_.push_back(std::make_pair(number, bytes));
+        } else {
+          msg = "blob-garbage entry";
+        }
+        break;
+
       default:
         msg = "unknown tag";
         break;
@@ -226,6 +339,10 @@ std::string VersionEdit::DebugString() const {
     r.append("\n  LastSeq: ");
     AppendNumberTo(&r, last_sequence_);
   }
+  if (has_compaction_style_) {
+    r.append("\n  CompactionStyle: ");
+    AppendNumberTo(&r, compaction_style_);
+  }
   for (size_t i = 0; i < compact_pointers_.size(); i++) {
     r.append("\n  CompactPointer: ");
     AppendNumberTo(&r, compact_pointers_[i].first);
@@ -250,6 +367,34 @@ std::string VersionEdit::DebugString() const {
     r.append(f.smallest.DebugString());
     r.append(" .. ");
     r.append(f.largest.DebugString());
+    if (f.global_seqno != 0) {
+      r.append(" @ ");
+      AppendNumberTo(&r, f.global_seqno);
+    }
+    if (f.has_range_tombstones) {
+      r.append(" (range tombstones)");
+    }
+    if (f.num_entries != 0) {
+      r.append(" entries=");
+      AppendNumberTo(&r, f.num_entries);
+      r.append(" deletions=");
+      AppendNumberTo(&r, f.num_deletions);
+      if (f.marked_for_compaction) {
+        r.append(" (marked for compaction)");
+      }
+    }
+  }
+  for (size_t i = 0; i < new_blob_files_.size(); i++) {
+    r.append("\n  AddBlobFile: ");
+    AppendNumberTo(&r, new_blob_files_[i].number);
+    r.append(" ");
+    AppendNumberTo(&r, new_blob_files_[i].total_bytes);
+  }
+  for (size_t i = 0; i < blob_garbage_.size(); i++) {
+    r.append("\n  BlobGarbage: ");
+    AppendNumberTo(&r, blob_garbage_[i].first);
+    r.append(" ");
+    AppendNumberTo(&r, blob_garbage_[i].second);
   }
   r.append("\n}\n");
   return r;
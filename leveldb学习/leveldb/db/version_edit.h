@@ -16,7 +16,16 @@ namespace leveldb {
 class VersionSet;
 
 struct FileMetaData {
-  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) {}
+  FileMetaData()
+      : refs(0),
+        allowed_seeks(1 << 30),
+        file_size(0),
+        global_seqno(0),
+        has_range_tombstones(false),
+        num_entries(0),
+        num_deletions(0),
+        largest_seqno(0),
+        marked_for_compaction(false) {}
 
   int refs;
   int allowed_seeks;  // Seeks allowed until compaction
@@ -24,6 +33,35 @@ struct FileMetaData {
   uint64_t file_size;    // File size in bytes
   InternalKey smallest;  // Smallest internal key served by table
   InternalKey largest;   // Largest internal key served by table
+
+  // If non-zero, the table was ingested from an SstFileWriter file whose
+  // keys are all stored with sequence number zero, and every key it
+  // serves carries this sequence number instead.
+  SequenceNumber global_seqno;
+
+  // True if the table holds range tombstones.  Its key range then also
+  // spans the ranges they delete (see range_del.h).
+  bool has_range_tombstones;
+
+  // Number of entries and of deletion markers in the table, or zero if
+  // unknown (e.g. for tables written by older releases).
+  uint64_t num_entries;
+  uint64_t num_deletions;
+
+  // Largest sequence number stored in the table, or zero if unknown.
+  SequenceNumber largest_seqno;
+
+  // True if the deletion markers in the table are dense enough that it
+  // should be compacted even if its level is not full.
+  bool marked_for_compaction;
+};
+
+struct BlobFileMetaData {
+  BlobFileMetaData() : number(0), total_bytes(0), garbage_bytes(0) {}
+
+  uint64_t number;
+  uint64_t total_bytes;    // Size of all values stored in the file
+  uint64_t garbage_bytes;  // Size of the values no table refers to any more
 };
 
 class VersionEdit {
@@ -53,6 +91,10 @@ class VersionEdit {
     has_last_sequence_ = true;
     last_sequence_ = seq;
   }
+  void SetCompactionStyle(int style) {
+    has_compaction_style_ = true;
+    compaction_style_ = style;
+  }
   void SetCompactPointer(int level, const InternalKey& key) {
     compact_pointers_.push_back(std::make_pair(level, key));
   }
@@ -61,20 +103,49 @@ class VersionEdit {
   // REQUIRES: This version has not been saved (see VersionSet::SaveTo)
   // REQUIRES: "smallest" and "largest" are smallest and largest keys in file
   void AddFile(int level, uint64_t file, uint64_t file_size,
-               const InternalKey& smallest, const InternalKey& largest) {
+               const InternalKey& smallest, const InternalKey& largest,
+               SequenceNumber global_seqno = 0) {
     FileMetaData f;
     f.number = file;
     f.file_size = file_size;
     f.smallest = smallest;
     f.largest = largest;
+    f.global_seqno = global_seqno;
     new_files_.push_back(std::make_pair(level, f));
   }
 
+  // Add the file described by "f" at the specified level.
+  void AddFile(int level, const FileMetaData& f) {
+    AddFile(level, f.number, f.file_size, f.smallest, f.largest,
+            f.global_seqno);
+    FileMetaData& added = new_files_.back().second;
+    added.has_range_tombstones = f.has_range_tombstones;
+    added.num_entries = f.num_entries;
+    added.num_deletions = f.num_deletions;
+    added.largest_seqno = f.largest_seqno;
+    added.marked_for_compaction = f.marked_for_compaction;
+  }
+
   // Delete the specified "file" from the specified "level".
   void RemoveFile(int level, uint64_t file) {
     deleted_files_.insert(std::make_pair(level, file));
   }
 
+  // Add the blob file with the specified number, holding "total_bytes"
+  // bytes of values.
+  void AddBlobFile(uint64_t file, uint64_t total_bytes) {
+    BlobFileMetaData f;
+    f.number = file;
+    f.total_bytes = total_bytes;
+    new_blob_files_.push_back(f);
+  }
+
+  // Record that "bytes" more bytes of values in blob file "file" are no
+  // longer referenced.  The file is dropped once all of it is garbage.
+  void AddBlobGarbage(uint64_t file, uint64_t bytes) {
+    blob_garbage_.push_back(std::make_pair(file, bytes));
+  }
+
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(const Slice& src);
 
@@ -90,15 +161,19 @@ class VersionEdit {
   uint64_t prev_log_number_;
   uint64_t next_file_number_;
   SequenceNumber last_sequence_;
+  int compaction_style_;
   bool has_comparator_;
   bool has_log_number_;
   bool has_prev_log_number_;
   bool has_next_file_number_;
   bool has_last_sequence_;
+  bool has_compaction_style_;
 
   std::vector<std::pair<int, InternalKey>> compact_pointers_;
   DeletedFileSet deleted_files_;
   std::vector<std::pair<int, FileMetaData>> new_files_;
+  std::vector<BlobFileMetaData> new_blob_files_;
+  std::vector<std::pair<uint64_t, uint64_t>> blob_garbage_;
 };
 
 }  // namespace leveldb
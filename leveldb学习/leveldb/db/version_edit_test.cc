@@ -27,13 +27,31 @@ TEST(VersionEditTest, EncodeDecode) {
     edit.AddFile(3, kBig + 300 + i, kBig + 400 + i,
                  InternalKey("foo", kBig + 500 + i, kTypeValue),
                  InternalKey("zoo", kBig + 600 + i, kTypeDeletion));
+    edit.AddFile(5, kBig + 310 + i, kBig + 410 + i,
+                 InternalKey("bar", kBig + 510 + i, kTypeValue),
+                 InternalKey("baz", kBig + 510 + i, kTypeValue),
+                 /*global_seqno=*/kBig + 510 + i);
+    FileMetaData f;
+    f.number = kBig + 320 + i;
+    f.file_size = kBig + 420 + i;
+    f.smallest = InternalKey("cat", kBig + 520 + i, kTypeRangeDeletion);
+    f.largest = InternalKey("dog", kMaxSequenceNumber, kTypeRangeDeletion);
+    f.has_range_tombstones = true;
+    f.num_entries = kBig + 530 + i;
+    f.num_deletions = kBig + 540 + i;
+    f.largest_seqno = kBig + 550 + i;
+    f.marked_for_compaction = (i % 2 == 0);
+    edit.AddFile(6, f);
     edit.RemoveFile(4, kBig + 700 + i);
+    edit.AddBlobFile(kBig + 800 + i, kBig + 810 + i);
+    edit.AddBlobGarbage(kBig + 820 + i, kBig + 830 + i);
     edit.SetCompactPointer(i, InternalKey("x", kBig + 900 + i, kTypeValue));
   }
 
   edit.SetComparatorName("foo");
   edit.SetLogNumber(kBig + 100);
   edit.SetNextFile(kBig + 200);
+  edit.SetCompactionStyle(2);
   edit.SetLastSequence(kBig + 1000);
   TestEncodeDecode(edit);
 }
@@ -5,12 +5,16 @@
 #include "db/version_set.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cstdio>
+#include <limits>
+#include <thread>
 
 #include "db/filename.h"
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "leveldb/env.h"
 #include "leveldb/table_builder.h"
@@ -18,6 +22,8 @@
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
 #include "util/logging.h"
+#include "util/mutexlock.h"
+#include "util/perf_context_imp.h"
 
 namespace leveldb {
 
@@ -38,6 +44,10 @@ static int64_t ExpandedCompactionByteSizeLimit(const Options* options) {
   return 25 * TargetFileSize(options);
 }
 
+// Minimum number of level-0 files that an intra-level-0 compaction merges,
+// so that it makes a dent in the number of level-0 files.
+static const size_t kMinFilesForIntraL0Compaction = 4;
+
 static double MaxBytesForLevel(const Options* options, int level) {
   // Note: the result for level zero is not really used since we set
   // the level-0 compaction threshold based on number of files.
@@ -51,6 +61,30 @@ static double MaxBytesForLevel(const Options* options, int level) {
   return result;
 }
 
+void ComputeMaxBytesForLevels(const Options& options,
+                              const int64_t* level_bytes, double* max_bytes) {
+  for (int level = 0; level < config::kNumLevels; level++) {
+    max_bytes[level] = MaxBytesForLevel(&options, level);
+  }
+  if (!options.level_compaction_dynamic_level_bytes) {
+    return;
+  }
+
+  // Size each level above the deepest non-empty one at a tenth of the
+  // level below, starting from the actual size of that deepest level, so
+  // that the levels keep a 10x shape however large the database grows.
+  // No level gets a smaller limit than level-1 has by default.
+  int last = config::kNumLevels - 1;
+  while (last > 1 && level_bytes[last] == 0) {
+    last--;
+  }
+  double limit = static_cast<double>(level_bytes[last]);
+  for (int level = last - 1; level >= 1; level--) {
+    limit /= 10;
+    max_bytes[level] = std::max(limit, MaxBytesForLevel(&options, 1));
+  }
+}
+
 static uint64_t MaxFileSizeForLevel(const Options* options, int level) {
   // We could vary per level to reduce number of files?
   return TargetFileSize(options);
@@ -194,6 +228,7 @@ class Version::LevelFileNumIterator : public Iterator {
     assert(Valid());
     EncodeFixed64(value_buf_, (*flist_)[index_]->number);
     EncodeFixed64(value_buf_ + 8, (*flist_)[index_]->file_size);
+    EncodeFixed64(value_buf_ + 16, (*flist_)[index_]->global_seqno);
     return Slice(value_buf_, sizeof(value_buf_));
   }
   Status status() const override { return Status::OK(); }
@@ -203,19 +238,21 @@ class Version::LevelFileNumIterator : public Iterator {
   const std::vector<FileMetaData*>* const flist_;
   uint32_t index_;
 
-  // Backing store for value().  Holds the file number and size.
-  mutable char value_buf_[16];
+  // Backing store for value().  Holds the file number, size and global
+  // sequence number.
+  mutable char value_buf_[24];
 };
 
 static Iterator* GetFileIterator(void* arg, const ReadOptions& options,
                                  const Slice& file_value) {
   TableCache* cache = reinterpret_cast<TableCache*>(arg);
-  if (file_value.size() != 16) {
+  if (file_value.size() != 24) {
     return NewErrorIterator(
         Status::Corruption("FileReader invoked with unexpected value"));
   } else {
     return cache->NewIterator(options, DecodeFixed64(file_value.data()),
-                              DecodeFixed64(file_value.data() + 8));
+                              DecodeFixed64(file_value.data() + 8),
+                              DecodeFixed64(file_value.data() + 16));
   }
 }
 
@@ -231,7 +268,8 @@ void Version::AddIterators(const ReadOptions& options,
   // Merge all level zero files together since they may overlap
   for (size_t i = 0; i < files_[0].size(); i++) {
     iters->push_back(vset_->table_cache_->NewIterator(
-        options, files_[0][i]->number, files_[0][i]->file_size));
+        options, files_[0][i]->number, files_[0][i]->file_size,
+        files_[0][i]->global_seqno));
   }
 
   // For levels > 0, we can use a concatenating iterator that sequentially
@@ -244,6 +282,76 @@ void Version::AddIterators(const ReadOptions& options,
   }
 }
 
+void Version::AddMemoryUsage(MemoryUsage::Level* levels) {
+  for (int level = 0; level < config::kNumLevels; level++) {
+    MemoryUsage::Level* usage = &levels[level];
+    const int num_files = files_[level].size();
+    usage->num_files += num_files;
+    usage->read_amplification +=
+        (level == 0) ? num_files : std::min(num_files, 1);
+    for (FileMetaData* f : files_[level]) {
+      vset_->table_cache_->AddMemoryUsage(f->number, usage);
+    }
+  }
+}
+
+Status Version::PreloadTables(int num_levels, int max_tables,
+                              int num_threads) {
+  std::vector<FileMetaData*> files;
+  for (int level = 0; level < std::min(num_levels, config::kNumLevels);
+       level++) {
+    for (FileMetaData* f : files_[level]) {
+      if (files.size() >= static_cast<size_t>(max_tables)) {
+        break;
+      }
+      files.push_back(f);
+    }
+  }
+
+  // Each thread opens the next table that no other thread has claimed.
+  std::atomic<size_t> next(0);
+  port::Mutex mu;
+  Status result;
+  auto preload = [&]() {
+    for (size_t i = next.fetch_add(1); i < files.size();
+         i = next.fetch_add(1)) {
+      Status s =
+          vset_->table_cache_->Preload(files[i]->number, files[i]->file_size);
+      if (!s.ok()) {
+        MutexLock l(&mu);
+        if (result.ok()) {
+          result = s;
+        }
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_threads && static_cast<size_t>(i) < files.size();
+       i++) {
+    threads.emplace_back(preload);
+  }
+  preload();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return result;
+}
+
+Status Version::AddRangeTombstones(RangeTombstoneSet* tombstones) {
+  Status s;
+  for (int level = 0; level < config::kNumLevels && s.ok(); level++) {
+    for (size_t i = 0; i < files_[level].size() && s.ok(); i++) {
+      FileMetaData* f = files_[level][i];
+      if (!f->has_range_tombstones) {
+        continue;
+      }
+      s = vset_->table_cache_->AddRangeTombstones(
+          f->number, f->file_size, f->global_seqno, tombstones);
+    }
+  }
+  return s;
+}
+
 // Callback from TableCache::Get()
 namespace {
 enum SaverState {
@@ -251,12 +359,16 @@ enum SaverState {
   kFound,
   kDeleted,
   kCorrupt,
+  kMerge,
 };
 struct Saver {
   SaverState state;
   const Comparator* ucmp;
   Slice user_key;
+  SequenceNumber sequence;  // Of the entry found or deleted
   std::string* value;
+  bool* is_blob_index;
+  std::vector<std::string>* merge_operands;
 };
 }  // namespace
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
@@ -266,9 +378,21 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
     s->state = kCorrupt;
   } else {
     if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
-      s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
+      switch (parsed_key.type) {
+        case kTypeDeletion:
+          s->state = kDeleted;
+          break;
+        case kTypeMerge:
+          s->state = kMerge;
+          break;
+        default:
+          s->state = kFound;
+          break;
+      }
+      s->sequence = parsed_key.sequence;
       if (s->state == kFound) {
         s->value->assign(v.data(), v.size());
+        *s->is_blob_index = (parsed_key.type == kTypeBlobIndex);
       }
     }
   }
@@ -322,7 +446,10 @@ void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
 }
 
 Status Version::Get(const ReadOptions& options, const LookupKey& k,
-                    std::string* value, GetStats* stats) {
+                    std::string* value, bool* is_blob_index,
+                    std::vector<std::string>* merge_operands,
+                    GetStats* stats) {
+  *is_blob_index = false;
   stats->seek_file = nullptr;
   stats->seek_file_level = -1;
 
@@ -338,6 +465,38 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
     Status s;
     bool found;
 
+    // Collects the merge operands in "f" for the key, starting at the one
+    // TableCache::Get() found, and sets saver.state from the entry below
+    // them.  Entries older than "tombstone_seq" are deleted.
+    Status CollectMergeOperands(FileMetaData* f,
+                                SequenceNumber tombstone_seq) {
+      Iterator* iter = vset->table_cache_->NewIterator(
+          *options, f->number, f->file_size, f->global_seqno);
+      saver.state = kNotFound;
+      for (iter->Seek(ikey); iter->Valid() && saver.state == kNotFound;
+           iter->Next()) {
+        ParsedInternalKey parsed_key;
+        if (!ParseInternalKey(iter->key(), &parsed_key)) {
+          saver.state = kCorrupt;
+        } else if (saver.ucmp->Compare(parsed_key.user_key,
+                                       saver.user_key) != 0) {
+          break;
+        } else if (parsed_key.sequence < tombstone_seq) {
+          saver.state = kDeleted;
+        } else if (parsed_key.type == kTypeMerge) {
+          saver.merge_operands->push_back(iter->value().ToString());
+        } else {
+          SaveValue(&saver, iter->key(), iter->value());
+        }
+      }
+      Status status = iter->status();
+      delete iter;
+      if (saver.state == kNotFound && tombstone_seq != 0) {
+        saver.state = kDeleted;
+      }
+      return status;
+    }
+
     static bool Match(void* arg, int level, FileMetaData* f) {
       State* state = reinterpret_cast<State*>(arg);
 
@@ -351,13 +510,31 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
       state->last_file_read = f;
       state->last_file_read_level = level;
 
-      state->s = state->vset->table_cache_->Get(*state->options, f->number,
-                                                f->file_size, state->ikey,
-                                                &state->saver, SaveValue);
+      // A tombstone covering the key hides the file's older entries for
+      // it, as well as everything in older files.
+      SequenceNumber tombstone_seq = 0;
+      PerfCounterAdd(&PerfContext::get_from_table_count);
+      state->s = state->vset->table_cache_->Get(
+          *state->options, f->number, f->file_size, f->global_seqno,
+          state->ikey, &state->saver, SaveValue,
+          f->has_range_tombstones ? &tombstone_seq : nullptr);
       if (!state->s.ok()) {
         state->found = true;
         return false;
       }
+      if (tombstone_seq != 0 &&
+          (state->saver.state == kNotFound ||
+           ((state->saver.state == kFound || state->saver.state == kMerge) &&
+            state->saver.sequence < tombstone_seq))) {
+        state->saver.state = kDeleted;
+      }
+      if (state->saver.state == kMerge) {
+        state->s = state->CollectMergeOperands(f, tombstone_seq);
+        if (!state->s.ok()) {
+          state->found = true;
+          return false;
+        }
+      }
       switch (state->saver.state) {
         case kNotFound:
           return true;  // Keep searching in other files
@@ -371,6 +548,8 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
               Status::Corruption("corrupted key for ", state->saver.user_key);
           state->found = true;
           return false;
+        case kMerge:
+          break;  // Not reached: resolved by CollectMergeOperands()
       }
 
       // Not reached. Added to avoid false compilation warnings of
@@ -393,6 +572,8 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
   state.saver.ucmp = vset_->icmp_.user_comparator();
   state.saver.user_key = k.user_key();
   state.saver.value = value;
+  state.saver.is_blob_index = is_blob_index;
+  state.saver.merge_operands = merge_operands;
 
   ForEachOverlapping(state.saver.user_key, state.ikey, &state, &State::Match);
 
@@ -401,7 +582,9 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
 
 bool Version::UpdateStats(const GetStats& stats) {
   FileMetaData* f = stats.seek_file;
-  if (f != nullptr) {
+  // Only the leveled style compacts single files to cut down on seeks.
+  if (f != nullptr &&
+      vset_->options_->compaction_style == kCompactionStyleLevel) {
     f->allowed_seeks--;
     if (f->allowed_seeks <= 0 && file_to_compact_ == nullptr) {
       file_to_compact_ = f;
@@ -470,7 +653,9 @@ bool Version::OverlapInLevel(int level, const Slice* smallest_user_key,
 int Version::PickLevelForMemTableOutput(const Slice& smallest_user_key,
                                         const Slice& largest_user_key) {
   int level = 0;
-  if (!OverlapInLevel(0, &smallest_user_key, &largest_user_key)) {
+  // Other styles keep every new file in level-0.
+  if (vset_->options_->compaction_style == kCompactionStyleLevel &&
+      !OverlapInLevel(0, &smallest_user_key, &largest_user_key)) {
     // Push to next level if there is no overlap in next level,
     // and the #bytes overlapping in the level after that are limited.
     InternalKey start(smallest_user_key, kMaxSequenceNumber, kValueTypeForSeek);
@@ -587,15 +772,18 @@ class VersionSet::Builder {
   struct LevelState {
     std::set<uint64_t> deleted_files;
     FileSet* added_files;
+    std::map<uint64_t, FileMetaData*> added_by_number;
   };
 
   VersionSet* vset_;
   Version* base_;
   LevelState levels_[config::kNumLevels];
+  std::map<uint64_t, BlobFileMetaData> blob_files_;
 
  public:
   // Initialize a builder with the files from *base and other info from *vset
-  Builder(VersionSet* vset, Version* base) : vset_(vset), base_(base) {
+  Builder(VersionSet* vset, Version* base)
+      : vset_(vset), base_(base), blob_files_(base->blob_files_) {
     base_->Ref();
     BySmallestKey cmp;
     cmp.internal_comparator = &vset_->icmp_;
@@ -639,6 +827,21 @@ class VersionSet::Builder {
       const int level = deleted_file_set_kvp.first;
       const uint64_t number = deleted_file_set_kvp.second;
       levels_[level].deleted_files.insert(number);
+
+      // Forget files added by earlier edits as soon as they are deleted,
+      // so that replaying a long MANIFEST only keeps the live files around.
+      LevelState& state = levels_[level];
+      std::map<uint64_t, FileMetaData*>::iterator it =
+          state.added_by_number.find(number);
+      if (it != state.added_by_number.end()) {
+        FileMetaData* f = it->second;
+        state.added_by_number.erase(it);
+        state.added_files->erase(f);
+        f->refs--;
+        if (f->refs <= 0) {
+          delete f;
+        }
+      }
     }
 
     // Add new files
@@ -663,8 +866,32 @@ class VersionSet::Builder {
       f->allowed_seeks = static_cast<int>((f->file_size / 16384U));
       if (f->allowed_seeks < 100) f->allowed_seeks = 100;
 
-      levels_[level].deleted_files.erase(f->number);
-      levels_[level].added_files->insert(f);
+      LevelState& state = levels_[level];
+      state.deleted_files.erase(f->number);
+      std::map<uint64_t, FileMetaData*>::iterator it =
+          state.added_by_number.find(f->number);
+      if (it != state.added_by_number.end()) {
+        // Added twice without a deletion in between; keep the latest.
+        state.added_files->erase(it->second);
+        if (--it->second->refs <= 0) {
+          delete it->second;
+        }
+      }
+      state.added_by_number[f->number] = f;
+      state.added_files->insert(f);
+    }
+
+    // Add new blob files and account for their garbage
+    for (size_t i = 0; i < edit->new_blob_files_.size(); i++) {
+      const BlobFileMetaData& f = edit->new_blob_files_[i];
+      blob_files_[f.number] = f;
+    }
+    for (size_t i = 0; i < edit->blob_garbage_.size(); i++) {
+      std::map<uint64_t, BlobFileMetaData>::iterator it =
+          blob_files_.find(edit->blob_garbage_[i].first);
+      if (it != blob_files_.end()) {
+        it->second.garbage_bytes += edit->blob_garbage_[i].second;
+      }
     }
   }
 
@@ -712,6 +939,15 @@ class VersionSet::Builder {
       }
 #endif
     }
+
+    // Drop blob files once none of their values are referenced any more.
+    // Older versions still list them, so they stay live until those
+    // versions are released.
+    for (const auto& kvp : blob_files_) {
+      if (kvp.second.garbage_bytes < kvp.second.total_bytes) {
+        v->blob_files_.insert(kvp);
+      }
+    }
   }
 
   void MaybeAddFile(Version* v, int level, FileMetaData* f) {
@@ -745,6 +981,7 @@ VersionSet::VersionSet(const std::string& dbname, const Options* options,
       prev_log_number_(0),
       descriptor_file_(nullptr),
       descriptor_log_(nullptr),
+      descriptor_size_(0),
       dummy_versions_(this),
       current_(nullptr) {
   AppendVersion(new Version(this));
@@ -786,6 +1023,17 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
     edit->SetPrevLogNumber(prev_log_number_);
   }
 
+  // Start a new descriptor log file on the first call (when opening the
+  // database), or once the current one has grown too large, so that
+  // Recover() does not have to replay a long history of edits.
+  uint64_t new_manifest_number = 0;
+  if (descriptor_log_ == nullptr) {
+    assert(descriptor_file_ == nullptr);
+    new_manifest_number = manifest_file_number_;
+  } else if (descriptor_size_ >= options_->max_manifest_file_size) {
+    new_manifest_number = NewFileNumber();
+  }
+
   edit->SetNextFile(next_file_number_);
   edit->SetLastSequence(last_sequence_);
 
@@ -797,62 +1045,88 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
   }
   Finalize(v);
 
-  // Initialize new descriptor log file if necessary by creating
-  // a temporary file that contains a snapshot of the current version.
+  // A new descriptor log file starts with a snapshot of the current
+  // version.  Only the snapshot is built while holding *mu; the file is
+  // written with *mu unlocked, so writers are not held up.
   std::string new_manifest_file;
-  Status s;
-  if (descriptor_log_ == nullptr) {
-    // No reason to unlock *mu here since we only hit this path in the
-    // first call to LogAndApply (when opening the database).
-    assert(descriptor_file_ == nullptr);
-    new_manifest_file = DescriptorFileName(dbname_, manifest_file_number_);
-    s = env_->NewWritableFile(new_manifest_file, &descriptor_file_);
-    if (s.ok()) {
-      descriptor_log_ = new log::Writer(descriptor_file_);
-      s = WriteSnapshot(descriptor_log_);
-    }
+  std::string snapshot;
+  if (new_manifest_number != 0) {
+    new_manifest_file = DescriptorFileName(dbname_, new_manifest_number);
+    EncodeSnapshot(&snapshot);
   }
 
+  std::string record;
+  edit->EncodeTo(&record);
+
   // Unlock during expensive MANIFEST log write
+  Status s;
+  WritableFile* file = descriptor_file_;
+  log::Writer* log = descriptor_log_;
   {
     mu->Unlock();
 
+    if (!new_manifest_file.empty()) {
+      s = env_->NewWritableFile(new_manifest_file, &file);
+      if (s.ok()) {
+        log = new log::Writer(file);
+        s = log->AddRecord(snapshot);
+      } else {
+        file = nullptr;
+        log = nullptr;
+      }
+    }
+
     // Write new record to MANIFEST log
     if (s.ok()) {
-      std::string record;
-      edit->EncodeTo(&record);
-      s = descriptor_log_->AddRecord(record);
+      s = log->AddRecord(record);
       if (s.ok()) {
-        s = descriptor_file_->Sync();
-      }
-      if (!s.ok()) {
-        Log(options_->info_log, "MANIFEST write: %s\n", s.ToString().c_str());
+        s = file->Sync();
       }
     }
+    if (!s.ok()) {
+      Log(options_->info_log, "MANIFEST write: %s\n", s.ToString().c_str());
+    }
 
     // If we just created a new descriptor file, install it by writing a
     // new CURRENT file that points to it.
     if (s.ok() && !new_manifest_file.empty()) {
-      s = SetCurrentFile(env_, dbname_, manifest_file_number_);
+      s = SetCurrentFile(env_, dbname_, new_manifest_number);
     }
 
     mu->Lock();
   }
 
+  if (!new_manifest_file.empty()) {
+    if (s.ok()) {
+      // Switch to the new descriptor log file.  The old one is removed
+      // along with other obsolete files.
+      if (descriptor_log_ != nullptr) {
+        Log(options_->info_log, "Rolled over MANIFEST of %llu bytes to #%llu",
+            static_cast<unsigned long long>(descriptor_size_),
+            static_cast<unsigned long long>(new_manifest_number));
+      }
+      delete descriptor_log_;
+      delete descriptor_file_;
+      descriptor_log_ = log;
+      descriptor_file_ = file;
+      descriptor_size_ = snapshot.size();
+      manifest_file_number_ = new_manifest_number;
+    } else {
+      // Keep using the old descriptor log file, if any.
+      delete log;
+      delete file;
+      env_->RemoveFile(new_manifest_file);
+    }
+  }
+
   // Install the new version
   if (s.ok()) {
+    descriptor_size_ += record.size();
     AppendVersion(v);
     log_number_ = edit->log_number_;
     prev_log_number_ = edit->prev_log_number_;
   } else {
     delete v;
-    if (!new_manifest_file.empty()) {
-      delete descriptor_log_;
-      delete descriptor_file_;
-      descriptor_log_ = nullptr;
-      descriptor_file_ = nullptr;
-      env_->RemoveFile(new_manifest_file);
-    }
   }
 
   return s;
@@ -896,6 +1170,7 @@ Status VersionSet::Recover(bool* save_manifest) {
   uint64_t last_sequence = 0;
   uint64_t log_number = 0;
   uint64_t prev_log_number = 0;
+  int compaction_style = kCompactionStyleLevel;
   Builder builder(this, current_);
   int read_records = 0;
 
@@ -942,6 +1217,10 @@ Status VersionSet::Recover(bool* save_manifest) {
         last_sequence = edit.last_sequence_;
         have_last_sequence = true;
       }
+
+      if (edit.has_compaction_style_) {
+        compaction_style = edit.compaction_style_;
+      }
     }
   }
   delete file;
@@ -954,6 +1233,11 @@ Status VersionSet::Recover(bool* save_manifest) {
       s = Status::Corruption("no meta-lognumber entry in descriptor");
     } else if (!have_last_sequence) {
       s = Status::Corruption("no last-sequence-number entry in descriptor");
+    } else if (compaction_style != options_->compaction_style) {
+      // The styles lay out files differently, so one cannot take over
+      // the files of another.
+      s = Status::InvalidArgument(
+          "compaction style does not match the style of the database");
     }
 
     if (!have_prev_log_number) {
@@ -1018,6 +1302,7 @@ bool VersionSet::ReuseManifest(const std::string& dscname,
 
   Log(options_->info_log, "Reusing MANIFEST %s\n", dscname.c_str());
   descriptor_log_ = new log::Writer(descriptor_file_, manifest_size);
+  descriptor_size_ = manifest_size;
   manifest_file_number_ = manifest_number;
   return true;
 }
@@ -1028,11 +1313,92 @@ void VersionSet::MarkFileNumberUsed(uint64_t number) {
   }
 }
 
+// Return how many of the newest sorted runs a universal compaction should
+// merge, or zero if none should be merged yet.  The sorted runs are the
+// level-0 files "level0", newest first, followed by the last level.  Only
+// the newest runs are ever merged, so that an output in level-0, which
+// takes a new file number, is still newer than all of the runs left out.
+static int UniversalRunsToCompact(
+    const Options* options, const std::vector<FileMetaData*>& level0,
+    const std::vector<FileMetaData*>& last_level) {
+  std::vector<uint64_t> run_bytes;
+  for (FileMetaData* f : level0) {
+    run_bytes.push_back(f->file_size);
+  }
+  if (!last_level.empty()) {
+    run_bytes.push_back(TotalFileSize(last_level));
+  }
+  const int num_runs = run_bytes.size();
+  if (num_runs < config::kL0_CompactionTrigger) {
+    return 0;
+  }
+
+  // Merge all of the runs if the newer runs take too much space next to
+  // the oldest one, which normally holds most of the data.
+  uint64_t newer_bytes = 0;
+  for (int i = 0; i + 1 < num_runs; i++) {
+    newer_bytes += run_bytes[i];
+  }
+  if (newer_bytes * 100 >= options->universal_max_size_amplification_percent *
+                               run_bytes[num_runs - 1]) {
+    return num_runs;
+  }
+
+  // Otherwise merge the newest runs while the next one is not much larger
+  // than the runs picked so far.
+  uint64_t picked_bytes = run_bytes[0];
+  int count = 1;
+  while (count < num_runs &&
+         picked_bytes * (100 + options->universal_size_ratio) / 100 >=
+             run_bytes[count]) {
+    picked_bytes += run_bytes[count];
+    count++;
+  }
+  if (count >= 2) {
+    return count;
+  }
+
+  // No runs are similar in size.  Merging runs of different sizes
+  // rewrites the larger ones over and over, so wait until the runs are
+  // about to slow down writes before bringing their number back under
+  // the trigger.
+  if (num_runs >= config::kL0_SlowdownWritesTrigger) {
+    return num_runs - config::kL0_CompactionTrigger + 2;
+  }
+  return 0;
+}
+
 void VersionSet::Finalize(Version* v) {
+  if (options_->compaction_style == kCompactionStyleUniversal) {
+    std::vector<FileMetaData*> level0 = v->files_[0];
+    std::sort(level0.begin(), level0.end(), NewestFirst);
+    v->compaction_level_ = 0;
+    v->compaction_score_ =
+        (UniversalRunsToCompact(options_, level0,
+                                v->files_[config::kNumLevels - 1]) > 0
+             ? 1
+             : 0);
+    return;
+  } else if (options_->compaction_style == kCompactionStyleFIFO) {
+    const uint64_t limit = options_->fifo_max_table_files_size;
+    const uint64_t total = TotalFileSize(v->files_[0]);
+    v->compaction_level_ = 0;
+    v->compaction_score_ =
+        (total > limit ? static_cast<double>(total) / limit : 0);
+    return;
+  }
+
   // Precomputed best level for next compaction
   int best_level = -1;
   double best_score = -1;
 
+  int64_t level_bytes[config::kNumLevels];
+  for (int level = 0; level < config::kNumLevels; level++) {
+    level_bytes[level] = TotalFileSize(v->files_[level]);
+  }
+  double max_bytes[config::kNumLevels];
+  ComputeMaxBytesForLevels(*options_, level_bytes, max_bytes);
+
   for (int level = 0; level < config::kNumLevels - 1; level++) {
     double score;
     if (level == 0) {
@@ -1051,9 +1417,7 @@ void VersionSet::Finalize(Version* v) {
               static_cast<double>(config::kL0_CompactionTrigger);
     } else {
       // Compute the ratio of current size to size limit.
-      const uint64_t level_bytes = TotalFileSize(v->files_[level]);
-      score =
-          static_cast<double>(level_bytes) / MaxBytesForLevel(options_, level);
+      score = static_cast<double>(level_bytes[level]) / max_bytes[level];
     }
 
     if (score > best_score) {
@@ -1064,14 +1428,28 @@ void VersionSet::Finalize(Version* v) {
 
   v->compaction_level_ = best_level;
   v->compaction_score_ = best_score;
+
+  // Files in the last level have nowhere to be compacted to
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    for (FileMetaData* f : v->files_[level]) {
+      if (f->marked_for_compaction) {
+        v->file_marked_for_compaction_ = f;
+        v->file_marked_for_compaction_level_ = level;
+        return;
+      }
+    }
+  }
 }
 
-Status VersionSet::WriteSnapshot(log::Writer* log) {
+void VersionSet::EncodeSnapshot(std::string* record) {
   // TODO: Break up into multiple records to reduce memory usage on recovery?
 
   // Save metadata
   VersionEdit edit;
   edit.SetComparatorName(icmp_.user_comparator()->Name());
+  if (options_->compaction_style != kCompactionStyleLevel) {
+    edit.SetCompactionStyle(options_->compaction_style);
+  }
 
   // Save compaction pointers
   for (int level = 0; level < config::kNumLevels; level++) {
@@ -1087,13 +1465,20 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
     const std::vector<FileMetaData*>& files = current_->files_[level];
     for (size_t i = 0; i < files.size(); i++) {
       const FileMetaData* f = files[i];
-      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+      edit.AddFile(level, *f);
     }
   }
 
-  std::string record;
-  edit.EncodeTo(&record);
-  return log->AddRecord(record);
+  // Save blob files
+  for (const auto& kvp : current_->blob_files_) {
+    const BlobFileMetaData& f = kvp.second;
+    edit.AddBlobFile(f.number, f.total_bytes);
+    if (f.garbage_bytes > 0) {
+      edit.AddBlobGarbage(f.number, f.garbage_bytes);
+    }
+  }
+
+  edit.EncodeTo(record);
 }
 
 int VersionSet::NumLevelFiles(int level) const {
@@ -1135,7 +1520,8 @@ uint64_t VersionSet::ApproximateOffsetOf(Version* v, const InternalKey& ikey) {
         // approximate offset of "ikey" within the table.
         Table* tableptr;
         Iterator* iter = table_cache_->NewIterator(
-            ReadOptions(), files[i]->number, files[i]->file_size, &tableptr);
+            ReadOptions(), files[i]->number, files[i]->file_size,
+            files[i]->global_seqno, &tableptr);
         if (tableptr != nullptr) {
           result += tableptr->ApproximateOffsetOf(ikey.Encode());
         }
@@ -1155,6 +1541,9 @@ void VersionSet::AddLiveFiles(std::set<uint64_t>* live) {
         live->insert(files[i]->number);
       }
     }
+    for (const auto& kvp : v->blob_files_) {
+      live->insert(kvp.first);
+    }
   }
 }
 
@@ -1229,17 +1618,29 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
   int num = 0;
   for (int which = 0; which < 2; which++) {
     if (!c->inputs_[which].empty()) {
-      if (c->level() + which == 0) {
+      if ((which == 0 ? c->level() : c->output_level()) == 0) {
         const std::vector<FileMetaData*>& files = c->inputs_[which];
         for (size_t i = 0; i < files.size(); i++) {
-          list[num++] = table_cache_->NewIterator(options, files[i]->number,
-                                                  files[i]->file_size);
+          list[num++] =
+              table_cache_->NewIterator(options, files[i]->number,
+                                        files[i]->file_size,
+                                        files[i]->global_seqno);
         }
       } else {
+        const std::vector<FileMetaData*>* files = &c->inputs_[which];
+        if (which == 1 && !c->covered_inputs_.empty()) {
+          c->uncovered_inputs_.clear();
+          for (FileMetaData* f : c->inputs_[which]) {
+            if (!c->IsCoveredInput(f)) {
+              c->uncovered_inputs_.push_back(f);
+            }
+          }
+          files = &c->uncovered_inputs_;
+        }
         // Create concatenating iterator for the files from this level
         list[num++] = NewTwoLevelIterator(
-            new Version::LevelFileNumIterator(icmp_, &c->inputs_[which]),
-            &GetFileIterator, table_cache_, options);
+            new Version::LevelFileNumIterator(icmp_, files), &GetFileIterator,
+            table_cache_, options);
       }
     }
   }
@@ -1250,36 +1651,37 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
 }
 
 Compaction* VersionSet::PickCompaction() {
+  if (options_->compaction_style == kCompactionStyleUniversal) {
+    return PickUniversalCompaction();
+  } else if (options_->compaction_style == kCompactionStyleFIFO) {
+    return PickFIFOCompaction();
+  }
+
   Compaction* c;
   int level;
 
   // We prefer compactions triggered by too much data in a level over
-  // the compactions triggered by seeks.
+  // the compactions triggered by seeks, and those over the compactions
+  // triggered by deletions.
   const bool size_compaction = (current_->compaction_score_ >= 1);
   const bool seek_compaction = (current_->file_to_compact_ != nullptr);
+  const bool deletion_compaction =
+      (current_->file_marked_for_compaction_ != nullptr);
   if (size_compaction) {
     level = current_->compaction_level_;
     assert(level >= 0);
     assert(level + 1 < config::kNumLevels);
     c = new Compaction(options_, level);
-
-    // Pick the first file that comes after compact_pointer_[level]
-    for (size_t i = 0; i < current_->files_[level].size(); i++) {
-      FileMetaData* f = current_->files_[level][i];
-      if (compact_pointer_[level].empty() ||
-          icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) > 0) {
-        c->inputs_[0].push_back(f);
-        break;
-      }
-    }
-    if (c->inputs_[0].empty()) {
-      // Wrap-around to the beginning of the key space
-      c->inputs_[0].push_back(current_->files_[level][0]);
-    }
+    c->inputs_[0].push_back(PickFileToCompact(level));
   } else if (seek_compaction) {
     level = current_->file_to_compact_level_;
     c = new Compaction(options_, level);
     c->inputs_[0].push_back(current_->file_to_compact_);
+  } else if (deletion_compaction) {
+    level = current_->file_marked_for_compaction_level_;
+    c = new Compaction(options_, level);
+    c->inputs_[0].push_back(current_->file_marked_for_compaction_);
+    c->purges_deletions_ = true;
   } else {
     return nullptr;
   }
@@ -1296,13 +1698,70 @@ Compaction* VersionSet::PickCompaction() {
     // which will include the picked file.
     current_->GetOverlappingInputs(0, &smallest, &largest, &c->inputs_[0]);
     assert(!c->inputs_[0].empty());
+
+    if (size_compaction) {
+      Compaction* intra = PickIntraL0Compaction(c->inputs_[0]);
+      if (intra != nullptr) {
+        delete c;
+        return intra;
+      }
+    }
   }
 
+  if (size_compaction) {
+    AddTrivialMoveInputs(c);
+  }
   SetupOtherInputs(c);
 
   return c;
 }
 
+FileMetaData* VersionSet::PickFileToCompact(int level) {
+  const std::vector<FileMetaData*>& files = current_->files_[level];
+  assert(!files.empty());
+  FileMetaData* best = nullptr;
+  // Level-0 compactions take in every file that overlaps the picked one,
+  // so a smarter pick buys little there; they always go round-robin.
+  if (level == 0 || options_->compaction_priority == kRoundRobinCompaction) {
+    // Pick the first file that comes after compact_pointer_[level]
+    for (size_t i = 0; i < files.size(); i++) {
+      FileMetaData* f = files[i];
+      if (compact_pointer_[level].empty() ||
+          icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) > 0) {
+        return f;
+      }
+    }
+    // Wrap-around to the beginning of the key space
+    return files[0];
+  } else if (options_->compaction_priority == kMinOverlappingRatioCompaction) {
+    double best_ratio = 0;
+    std::vector<FileMetaData*> overlaps;
+    for (FileMetaData* f : files) {
+      current_->GetOverlappingInputs(level + 1, &f->smallest, &f->largest,
+                                     &overlaps);
+      const double ratio = static_cast<double>(TotalFileSize(overlaps)) /
+                           std::max<uint64_t>(f->file_size, 1);
+      if (best == nullptr || ratio < best_ratio) {
+        best = f;
+        best_ratio = ratio;
+      }
+    }
+  } else {
+    // Ingested tables store one sequence number for all of their entries.
+    // Files of unknown age come first, so they gain stats when rewritten.
+    SequenceNumber best_seqno = 0;
+    for (FileMetaData* f : files) {
+      const SequenceNumber seqno =
+          f->global_seqno != 0 ? f->global_seqno : f->largest_seqno;
+      if (best == nullptr || seqno < best_seqno) {
+        best = f;
+        best_seqno = seqno;
+      }
+    }
+  }
+  return best;
+}
+
 // Finds the largest key in a vector of files. Returns true if files is not
 // empty.
 bool FindLargestKey(const InternalKeyComparator& icmp,
@@ -1382,6 +1841,140 @@ void AddBoundaryInputs(const InternalKeyComparator& icmp,
   }
 }
 
+Compaction* VersionSet::PickIntraL0Compaction(
+    const std::vector<FileMetaData*>& inputs) {
+  // Only worth it when writes are about to slow down, and merging level-0
+  // into level-1 would mostly rewrite level-1 data, so it would take a
+  // while before the number of level-0 files drops.
+  if (current_->files_[0].size() < config::kL0_SlowdownWritesTrigger) {
+    return nullptr;
+  }
+  InternalKey smallest, largest;
+  GetRange(inputs, &smallest, &largest);
+  std::vector<FileMetaData*> overlaps;
+  current_->GetOverlappingInputs(1, &smallest, &largest, &overlaps);
+  if (TotalFileSize(overlaps) <= TotalFileSize(inputs)) {
+    return nullptr;
+  }
+
+  // Merge the newest files, which were flushed recently and are small,
+  // with each other instead.
+  std::vector<FileMetaData*> files = current_->files_[0];
+  std::sort(files.begin(), files.end(), NewestFirst);
+  const uint64_t limit = ExpandedCompactionByteSizeLimit(options_);
+  uint64_t total = 0;
+  size_t count = 0;
+  while (count < files.size() && total + files[count]->file_size <= limit) {
+    total += files[count]->file_size;
+    count++;
+  }
+  if (count < kMinFilesForIntraL0Compaction) {
+    return nullptr;
+  }
+  files.resize(count);
+  return MergeNewestLevel0Files(files);
+}
+
+Compaction* VersionSet::MergeNewestLevel0Files(
+    const std::vector<FileMetaData*>& files) {
+  Compaction* c = new Compaction(options_, 0);
+  c->output_level_ = 0;
+  // Level-0 files are ordered by number, so the outputs take numbers
+  // reserved now, below those of files flushed while the compaction runs.
+  // The merged output is no larger than the inputs; should it still need
+  // more files than reserved, the last one grows past the size limit.
+  c->num_reserved_outputs_ =
+      TotalFileSize(files) / c->max_output_file_size_ + 2;
+  c->output_file_number_ = NewFileNumber();
+  for (uint64_t i = 1; i < c->num_reserved_outputs_; i++) {
+    NewFileNumber();
+  }
+  c->inputs_[0] = files;
+  c->input_version_ = current_;
+  c->input_version_->Ref();
+  return c;
+}
+
+void VersionSet::AddTrivialMoveInputs(Compaction* c) {
+  const int level = c->level();
+  std::vector<FileMetaData*>& inputs = c->inputs_[0];
+  const std::vector<FileMetaData*>& files = current_->files_[level];
+  const Comparator* user_cmp = icmp_.user_comparator();
+  // Level-0 inputs can only move if they overlap no other level-0 file.
+  if (level == 0 && inputs.size() != 1) {
+    return;
+  }
+  AddBoundaryInputs(icmp_, files, &inputs);
+  InternalKey smallest, largest;
+  GetRange(inputs, &smallest, &largest);
+  Slice smallest_user_key = smallest.user_key();
+  Slice largest_user_key = largest.user_key();
+  if (current_->OverlapInLevel(level + 1, &smallest_user_key,
+                               &largest_user_key)) {
+    return;
+  }
+
+  // Add the files that follow the inputs in key order while they can move
+  // as well: they overlap nothing in the next level (nor other level-0
+  // files), share no user key with a file left behind, and the files
+  // moved together do not overlap too much grandparent data.  Every
+  // level-0 file that moves makes reads cheaper and writes less likely
+  // to stall; files of other levels only move while their level is still
+  // too large.
+  double excess_bytes = 0;
+  if (level > 0) {
+    int64_t level_bytes[config::kNumLevels];
+    for (int i = 0; i < config::kNumLevels; i++) {
+      level_bytes[i] = TotalFileSize(current_->files_[i]);
+    }
+    double max_bytes[config::kNumLevels];
+    ComputeMaxBytesForLevels(*options_, level_bytes, max_bytes);
+    excess_bytes = level_bytes[level] - max_bytes[level];
+  }
+  size_t next = 0;
+  for (size_t i = 0; i < files.size(); i++) {
+    if (std::find(inputs.begin(), inputs.end(), files[i]) != inputs.end()) {
+      next = i + 1;
+    }
+  }
+  const uint64_t limit = ExpandedCompactionByteSizeLimit(options_);
+  uint64_t total = TotalFileSize(inputs);
+  std::vector<FileMetaData*> overlaps;
+  for (; next < files.size(); next++) {
+    FileMetaData* f = files[next];
+    if (level > 0 && total >= excess_bytes) {
+      break;
+    }
+    if (total + f->file_size > limit) {
+      break;
+    }
+    Slice f_smallest = f->smallest.user_key();
+    Slice f_largest = f->largest.user_key();
+    if (current_->OverlapInLevel(level + 1, &f_smallest, &f_largest)) {
+      break;
+    }
+    if (level == 0) {
+      current_->GetOverlappingInputs(0, &f->smallest, &f->largest, &overlaps);
+      if (overlaps.size() != 1) {
+        break;
+      }
+    } else if (next + 1 < files.size() &&
+               user_cmp->Compare(f_largest,
+                                 files[next + 1]->smallest.user_key()) == 0) {
+      break;
+    }
+    if (level + 2 < config::kNumLevels) {
+      current_->GetOverlappingInputs(level + 2, &smallest, &f->largest,
+                                     &overlaps);
+      if (TotalFileSize(overlaps) > MaxGrandParentOverlapBytes(options_)) {
+        break;
+      }
+    }
+    inputs.push_back(f);
+    total += f->file_size;
+  }
+}
+
 void VersionSet::SetupOtherInputs(Compaction* c) {
   const int level = c->level();
   InternalKey smallest, largest;
@@ -1447,6 +2040,16 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
 
 Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
                                      const InternalKey* end) {
+  if (options_->compaction_style == kCompactionStyleUniversal) {
+    // Every sorted run may span the whole key space, so compacting any
+    // range means merging all of them.
+    return (level == 0 ? FullCompaction() : nullptr);
+  } else if (options_->compaction_style == kCompactionStyleFIFO) {
+    // Files are never merged, only the oldest ones over the size limit
+    // dropped.
+    return (level == 0 ? PickFIFOCompaction() : nullptr);
+  }
+
   std::vector<FileMetaData*> inputs;
   current_->GetOverlappingInputs(level, begin, end, &inputs);
   if (inputs.empty()) {
@@ -1478,9 +2081,74 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
   return c;
 }
 
+Compaction* VersionSet::PickUniversalCompaction() {
+  if (current_->compaction_score_ < 1) {
+    return nullptr;
+  }
+
+  const int last = config::kNumLevels - 1;
+  std::vector<FileMetaData*> files = current_->files_[0];
+  std::sort(files.begin(), files.end(), NewestFirst);
+  const int count =
+      UniversalRunsToCompact(options_, files, current_->files_[last]);
+  assert(count >= 2);
+  const int num_runs = files.size() + (current_->files_[last].empty() ? 0 : 1);
+  if (count == num_runs) {
+    // The oldest run is picked as well, so write to the last level.
+    return FullCompaction();
+  }
+  files.resize(count);
+  return MergeNewestLevel0Files(files);
+}
+
+Compaction* VersionSet::PickFIFOCompaction() {
+  if (current_->compaction_score_ < 1) {
+    return nullptr;
+  }
+
+  std::vector<FileMetaData*> files = current_->files_[0];
+  std::sort(files.begin(), files.end(), NewestFirst);
+  uint64_t total = TotalFileSize(files);
+  Compaction* c = new Compaction(options_, 0);
+  c->deletion_only_ = true;
+  while (total > options_->fifo_max_table_files_size && !files.empty()) {
+    c->inputs_[0].push_back(files.back());
+    total -= files.back()->file_size;
+    files.pop_back();
+  }
+  assert(!c->inputs_[0].empty());
+  c->input_version_ = current_;
+  c->input_version_->Ref();
+  return c;
+}
+
+Compaction* VersionSet::FullCompaction() {
+  if (current_->files_[0].empty()) {
+    return nullptr;
+  }
+
+  const int last = config::kNumLevels - 1;
+  Compaction* c = new Compaction(options_, 0);
+  c->output_level_ = last;
+  c->max_output_file_size_ = MaxFileSizeForLevel(options_, last);
+  c->inputs_[0] = current_->files_[0];
+  InternalKey smallest, largest;
+  GetRange(c->inputs_[0], &smallest, &largest);
+  current_->GetOverlappingInputs(last, &smallest, &largest, &c->inputs_[1]);
+  c->input_version_ = current_;
+  c->input_version_->Ref();
+  return c;
+}
+
 Compaction::Compaction(const Options* options, int level)
     : level_(level),
+      output_level_(level + 1),
       max_output_file_size_(MaxFileSizeForLevel(options, level)),
+      output_file_number_(0),
+      num_reserved_outputs_(0),
+      purges_deletions_(false),
+      deletion_only_(false),
+      blob_garbage_collection_ratio_(options->blob_garbage_collection_ratio),
       input_version_(nullptr),
       grandparent_index_(0),
       seen_key_(false),
@@ -1498,10 +2166,28 @@ Compaction::~Compaction() {
 
 bool Compaction::IsTrivialMove() const {
   const VersionSet* vset = input_version_->vset_;
+  if (level_ == 0 && num_input_files(0) > 1) {
+    // Level-0 files that overlap each other have to be merged.
+    std::vector<FileMetaData*> files = inputs_[0];
+    std::sort(files.begin(), files.end(),
+              [vset](FileMetaData* a, FileMetaData* b) {
+                return vset->icmp_.Compare(a->smallest, b->smallest) < 0;
+              });
+    const Comparator* user_cmp = vset->icmp_.user_comparator();
+    for (size_t i = 1; i < files.size(); i++) {
+      if (user_cmp->Compare(files[i - 1]->largest.user_key(),
+                            files[i]->smallest.user_key()) >= 0) {
+        return false;
+      }
+    }
+  }
   // Avoid a move if there is lots of overlapping grandparent data.
   // Otherwise, the move could create a parent file that will require
   // a very expensive merge later on.
-  return (num_input_files(0) == 1 && num_input_files(1) == 0 &&
+  //
+  // A file compacted for its deletions is rewritten so they are purged.
+  return (!purges_deletions_ && !deletion_only_ && output_level_ != level_ &&
+          num_input_files(1) == 0 &&
           TotalFileSize(grandparents_) <=
               MaxGrandParentOverlapBytes(vset->options_));
 }
@@ -1509,15 +2195,31 @@ bool Compaction::IsTrivialMove() const {
 void Compaction::AddInputDeletions(VersionEdit* edit) {
   for (int which = 0; which < 2; which++) {
     for (size_t i = 0; i < inputs_[which].size(); i++) {
-      edit->RemoveFile(level_ + which, inputs_[which][i]->number);
+      edit->RemoveFile(which == 0 ? level_ : output_level_,
+                       inputs_[which][i]->number);
     }
   }
 }
 
+bool Compaction::ShouldRelocateBlob(uint64_t number) const {
+  std::map<uint64_t, BlobFileMetaData>::const_iterator it =
+      input_version_->blob_files_.find(number);
+  if (it == input_version_->blob_files_.end()) {
+    return false;
+  }
+  const BlobFileMetaData& f = it->second;
+  return static_cast<double>(f.garbage_bytes) >=
+         blob_garbage_collection_ratio_ * static_cast<double>(f.total_bytes);
+}
+
 bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
   // Maybe use binary search to find right entry instead of linear search?
   const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
-  for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
+  if (output_level_ == 0) {
+    // Older level-0 files that are not inputs may hold the key.
+    return false;
+  }
+  for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++) {
     const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
     while (level_ptrs_[lvl] < files.size()) {
       FileMetaData* f = files[level_ptrs_[lvl]];
@@ -1535,6 +2237,20 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
   return true;
 }
 
+bool Compaction::IsBaseLevelForRange(const Slice& begin, const Slice& end) {
+  // "end" is excluded from the range, but treating it as included only
+  // makes the answer more conservative.
+  if (output_level_ == 0) {
+    return false;
+  }
+  for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++) {
+    if (input_version_->OverlapInLevel(lvl, &begin, &end)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool Compaction::ShouldStopBefore(const Slice& internal_key) {
   const VersionSet* vset = input_version_->vset_;
   // Scan to find earliest grandparent file that contains key.
@@ -21,6 +21,7 @@
 
 #include "db/dbformat.h"
 #include "db/version_edit.h"
+#include "leveldb/db.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
 
@@ -33,6 +34,7 @@ class Writer;
 class Compaction;
 class Iterator;
 class MemTable;
+class RangeTombstoneSet;
 class TableBuilder;
 class TableCache;
 class Version;
@@ -57,6 +59,13 @@ bool SomeFileOverlapsRange(const InternalKeyComparator& icmp,
                            const Slice* smallest_user_key,
                            const Slice* largest_user_key);
 
+// Store in max_bytes[level] the number of bytes above which a compaction
+// of "level" (>= 1) is needed, given the number of bytes level_bytes[i]
+// in each level i.  Both arrays have config::kNumLevels entries; the
+// results for level 0 are not used.
+void ComputeMaxBytesForLevels(const Options& options,
+                              const int64_t* level_bytes, double* max_bytes);
+
 class Version {
  public:
   struct GetStats {
@@ -69,10 +78,25 @@ class Version {
   // REQUIRES: This version has been saved (see VersionSet::SaveTo)
   void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
 
+  // Add the range tombstones of this Version's tables to *tombstones.
+  // May read the tables, so should be called without the DB mutex.
+  // REQUIRES: The caller holds a reference to this version.
+  Status AddRangeTombstones(RangeTombstoneSet* tombstones);
+
+  // Load up to "max_tables" tables of the first "num_levels" levels into
+  // the table cache, lower levels first, using "num_threads" threads.
+  // Returns the first error encountered, after trying every table.
+  // REQUIRES: The caller holds a reference to this version.
+  Status PreloadTables(int num_levels, int max_tables, int num_threads);
+
   // Lookup the value for key.  If found, store it in *val and
-  // return OK.  Else return a non-OK status.  Fills *stats.
+  // return OK.  Else return a non-OK status.  Fills *stats.  Sets
+  // *is_blob_index to true iff *val is an encoded BlobIndex for a value
+  // stored in a blob file.  Merge operands newer than the value are
+  // appended to *merge_operands, newest first.
   // REQUIRES: lock is not held
   Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
+             bool* is_blob_index, std::vector<std::string>* merge_operands,
              GetStats* stats);
 
   // Adds "stats" into the current state.  Returns true if a new
@@ -111,6 +135,13 @@ class Version {
 
   int NumFiles(int level) const { return files_[level].size(); }
 
+  // Add the files of each level, and the memory held by those whose
+  // tables are open, to levels[0, config::kNumLevels).
+  // REQUIRES: The caller holds a reference to this version.
+  void AddMemoryUsage(MemoryUsage::Level* levels);
+
+  int NumBlobFiles() const { return blob_files_.size(); }
+
   // Return a human readable string that describes this version's contents.
   std::string DebugString() const;
 
@@ -127,6 +158,8 @@ class Version {
         refs_(0),
         file_to_compact_(nullptr),
         file_to_compact_level_(-1),
+        file_marked_for_compaction_(nullptr),
+        file_marked_for_compaction_level_(-1),
         compaction_score_(-1),
         compaction_level_(-1) {}
 
@@ -153,10 +186,18 @@ class Version {
   // List of files per level
   std::vector<FileMetaData*> files_[config::kNumLevels];
 
+  // Blob files that tables of this version may refer to, by file number
+  std::map<uint64_t, BlobFileMetaData> blob_files_;
+
   // Next file to compact based on seek stats.
   FileMetaData* file_to_compact_;
   int file_to_compact_level_;
 
+  // Next file to compact because of its deletions.  Initialized by
+  // Finalize().
+  FileMetaData* file_marked_for_compaction_;
+  int file_marked_for_compaction_level_;
+
   // Level that should be compacted next and its compaction score.
   // Score < 1 means compaction is not strictly needed.  These fields
   // are initialized by Finalize().
@@ -251,7 +292,8 @@ class VersionSet {
   // Returns true iff some level needs a compaction.
   bool NeedsCompaction() const {
     Version* v = current_;
-    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr);
+    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr) ||
+           (v->file_marked_for_compaction_ != nullptr);
   }
 
   // Add all files listed in any live version to *live.
@@ -288,8 +330,37 @@ class VersionSet {
 
   void SetupOtherInputs(Compaction* c);
 
-  // Save current contents to *log
-  Status WriteSnapshot(log::Writer* log);
+  // Return the file of "level" (>= 1) that a size compaction should start
+  // from, according to options_->compaction_priority.
+  FileMetaData* PickFileToCompact(int level);
+
+  // Pick a compaction of the newest sorted runs, for
+  // kCompactionStyleUniversal.
+  Compaction* PickUniversalCompaction();
+
+  // Pick the oldest level-0 files to delete, for kCompactionStyleFIFO.
+  Compaction* PickFIFOCompaction();
+
+  // Return a compaction of every level-0 file into the last level, or
+  // nullptr if level-0 is empty.
+  Compaction* FullCompaction();
+
+  // Return a compaction that merges the newest level-0 files with each
+  // other, if writes are about to slow down and a compaction of "inputs"
+  // into level-1 would take long.  Otherwise return nullptr.
+  Compaction* PickIntraL0Compaction(const std::vector<FileMetaData*>& inputs);
+
+  // Return a compaction that merges "files", the newest level-0 files,
+  // into a single new level-0 file.
+  Compaction* MergeNewestLevel0Files(const std::vector<FileMetaData*>& files);
+
+  // If the inputs of "c" overlap nothing in the next level, add the files
+  // next to them that can move to the next level in the same edit.
+  void AddTrivialMoveInputs(Compaction* c);
+
+  // Encode the current contents into *record, as the first record of a
+  // new MANIFEST.
+  void EncodeSnapshot(std::string* record);
 
   void AppendVersion(Version* v);
 
@@ -307,6 +378,7 @@ class VersionSet {
   // Opened lazily
   WritableFile* descriptor_file_;
   log::Writer* descriptor_log_;
+  uint64_t descriptor_size_;  // Bytes of records written to descriptor_log_
   Version dummy_versions_;  // Head of circular doubly-linked list of versions.
   Version* current_;        // == dummy_versions_.prev_
 
@@ -321,9 +393,30 @@ class Compaction {
   ~Compaction();
 
   // Return the level that is being compacted.  Inputs from "level"
-  // and "level+1" will be merged to produce a set of "level+1" files.
+  // and "output_level" will be merged to produce a set of "output_level"
+  // files.
   int level() const { return level_; }
 
+  // Return the level that the compaction writes to.  This is "level+1"
+  // except for kCompactionStyleUniversal, which merges level-0 files
+  // into either level-0 or the last level.
+  int output_level() const { return output_level_; }
+
+  // If nonzero, the first of the numbers that the output files take in
+  // order.  Reserved when the compaction is picked, so that level-0
+  // outputs sort before every level-0 file flushed while it runs.
+  uint64_t output_file_number() const { return output_file_number_; }
+
+  // Can another output file be started after "num_outputs" of them?
+  // False once the reserved file numbers are used up.
+  bool CanAddOutput(size_t num_outputs) const {
+    return output_file_number_ == 0 || num_outputs < num_reserved_outputs_;
+  }
+
+  // Is this a compaction that just deletes its input files, without
+  // reading them or writing any output?
+  bool IsDeletionOnly() const { return deletion_only_; }
+
   // Return the object that holds the edits to the descriptor done
   // by this compaction.
   VersionEdit* edit() { return &edit_; }
@@ -331,28 +424,46 @@ class Compaction {
   // "which" must be either 0 or 1
   int num_input_files(int which) const { return inputs_[which].size(); }
 
-  // Return the ith input file at "level()+which" ("which" must be 0 or 1).
+  // Return the ith input file of "level()" if "which" is 0, or of
+  // "output_level()" if "which" is 1.
   FileMetaData* input(int which, int i) const { return inputs_[which][i]; }
 
   // Maximum size of files to build during this compaction.
   uint64_t MaxOutputFileSize() const { return max_output_file_size_; }
 
   // Is this a trivial compaction that can be implemented by just
-  // moving a single input file to the next level (no merging or splitting)
+  // moving the input files to the next level (no merging or splitting)
   bool IsTrivialMove() const;
 
   // Add all inputs to this compaction as delete operations to *edit.
   void AddInputDeletions(VersionEdit* edit);
 
   // Returns true if the information we have available guarantees that
-  // the compaction is producing data in "level+1" for which no data exists
-  // in levels greater than "level+1".
+  // the compaction is producing data in "output_level" for which no data
+  // exists in levels greater than "output_level", nor in level-0 files
+  // that are not inputs.
   bool IsBaseLevelForKey(const Slice& user_key);
 
+  // Like IsBaseLevelForKey(), for every key in [begin, end).
+  bool IsBaseLevelForRange(const Slice& begin, const Slice& end);
+
+  // Mark input file "f" of "output_level" as wholly deleted by range
+  // tombstones of the "level" inputs.  The input iterator skips it, and
+  // AddInputDeletions() still removes it.
+  void MarkCoveredInput(FileMetaData* f) { covered_inputs_.insert(f->number); }
+
+  bool IsCoveredInput(const FileMetaData* f) const {
+    return covered_inputs_.count(f->number) != 0;
+  }
+
   // Returns true iff we should stop building the current output
   // before processing "internal_key".
   bool ShouldStopBefore(const Slice& internal_key);
 
+  // Returns true iff values stored in blob file "number" should be copied
+  // out of it, because enough of the file is garbage to collect it.
+  bool ShouldRelocateBlob(uint64_t number) const;
+
   // Release the input version for the compaction, once the compaction
   // is successful.
   void ReleaseInputs();
@@ -364,13 +475,24 @@ class Compaction {
   Compaction(const Options* options, int level);
 
   int level_;
+  int output_level_;
   uint64_t max_output_file_size_;
+  uint64_t output_file_number_;
+  uint64_t num_reserved_outputs_;  // From output_file_number_ on
+  bool purges_deletions_;  // Picked for the deletions of its input
+  bool deletion_only_;
+  double blob_garbage_collection_ratio_;
   Version* input_version_;
   VersionEdit edit_;
 
-  // Each compaction reads inputs from "level_" and "level_+1"
+  // Each compaction reads inputs from "level_" and "output_level_"
   std::vector<FileMetaData*> inputs_[2];  // The two sets of inputs
 
+  // Numbers of "output_level_" inputs deleted without being read, and the
+  // remaining "output_level_" inputs that the input iterator reads instead
+  std::set<uint64_t> covered_inputs_;
+  std::vector<FileMetaData*> uncovered_inputs_;
+
   // State used to check for number of overlapping grandparent files
   // (parent == level_ + 1, grandparent == level_ + 2)
   std::vector<FileMetaData*> grandparents_;
@@ -384,7 +506,7 @@ class Compaction {
   // level_ptrs_ holds indices into input_version_->levels_: our state
   // is that we are positioned at one of the file ranges for each
   // higher level than the ones involved in this compaction (i.e. for
-  // all L >= level_ + 2).
+  // all L > output_level_).
   size_t level_ptrs_[config::kNumLevels];
 };
 
@@ -4,8 +4,12 @@
 
 #include "db/version_set.h"
 
+#include "db/table_cache.h"
 #include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/db.h"
 #include "util/logging.h"
+#include "util/mutexlock.h"
 #include "util/testutil.h"
 
 namespace leveldb {
@@ -328,4 +332,160 @@ TEST_F(AddBoundaryInputsTest, TestDisjoinFilePointers) {
   ASSERT_EQ(f3, compaction_files_[2]);
 }
 
+class PickCompactionTest : public testing::Test {
+ public:
+  PickCompactionTest()
+      : env_(NewMemEnv(Env::Default())), icmp_(BytewiseComparator()) {
+    options_.env = env_;
+    options_.create_if_missing = true;
+    table_cache_ = new TableCache("/pick", options_, 100);
+    vset_ = new VersionSet("/pick", &options_, table_cache_, &icmp_);
+  }
+
+  void SetUp() override {
+    // Create an empty database to recover the version set from.
+    DB* db;
+    ASSERT_LEVELDB_OK(DB::Open(options_, "/pick", &db));
+    delete db;
+    bool save_manifest;
+    ASSERT_LEVELDB_OK(vset_->Recover(&save_manifest));
+  }
+
+  ~PickCompactionTest() {
+    delete vset_;
+    delete table_cache_;
+    delete env_;
+  }
+
+  // Add a file of "bytes" bytes covering [smallest, largest] to "level".
+  // Files added later are newer.
+  void Add(int level, const char* smallest, const char* largest,
+           uint64_t bytes) {
+    MutexLock l(&mu_);
+    VersionEdit edit;
+    edit.AddFile(level, vset_->NewFileNumber(), bytes,
+                 InternalKey(smallest, 100, kTypeValue),
+                 InternalKey(largest, 100, kTypeValue));
+    ASSERT_LEVELDB_OK(vset_->LogAndApply(&edit, &mu_));
+  }
+
+  Compaction* Pick() {
+    MutexLock l(&mu_);
+    return vset_->PickCompaction();
+  }
+
+ private:
+  Env* env_;
+  Options options_;
+  InternalKeyComparator icmp_;
+  TableCache* table_cache_;
+  VersionSet* vset_;
+  port::Mutex mu_;
+};
+
+TEST_F(PickCompactionTest, MovesDisjointLevel0Files) {
+  Add(0, "a", "b", 1 << 20);
+  Add(0, "c", "d", 1 << 20);
+  Add(0, "e", "f", 1 << 20);
+  Add(0, "g", "h", 1 << 20);
+  Compaction* c = Pick();
+  ASSERT_TRUE(c != nullptr);
+  ASSERT_EQ(1, c->output_level());
+  ASSERT_EQ(4, c->num_input_files(0));
+  ASSERT_TRUE(c->IsTrivialMove());
+  delete c;
+}
+
+TEST_F(PickCompactionTest, MergesOverlappingLevel0Files) {
+  Add(0, "a", "d", 1 << 20);
+  Add(0, "c", "f", 1 << 20);
+  Add(0, "e", "h", 1 << 20);
+  Add(0, "x", "y", 1 << 20);
+  Compaction* c = Pick();
+  ASSERT_TRUE(c != nullptr);
+  ASSERT_EQ(1, c->output_level());
+  ASSERT_EQ(3, c->num_input_files(0));
+  ASSERT_FALSE(c->IsTrivialMove());
+  delete c;
+}
+
+TEST_F(PickCompactionTest, MovesLevelFilesOnlyWhileLevelIsTooLarge) {
+  // Level-1 holds 20MB against a 10MB limit, so half of it moves.
+  const char* keys[] = {"a", "b", "c", "d", "e", "f", "g", "h", "i", "j"};
+  for (const char* key : keys) {
+    Add(1, key, key, 2 << 20);
+  }
+  Compaction* c = Pick();
+  ASSERT_TRUE(c != nullptr);
+  ASSERT_EQ(1, c->level());
+  ASSERT_EQ(2, c->output_level());
+  ASSERT_EQ(5, c->num_input_files(0));
+  ASSERT_TRUE(c->IsTrivialMove());
+  delete c;
+}
+
+TEST_F(PickCompactionTest, IntraLevel0) {
+  // Level-1 holds more data than the level-0 files it overlaps.
+  Add(1, "a", "c", 2 << 20);
+  Add(1, "d", "f", 2 << 20);
+  Add(1, "g", "i", 2 << 20);
+  Add(1, "j", "z", 2 << 20);
+  for (int i = 0; i < config::kL0_SlowdownWritesTrigger - 1; i++) {
+    Add(0, "b", "y", 512 << 10);
+  }
+
+  // Below the slowdown trigger, level-0 is merged into level-1.
+  Compaction* c = Pick();
+  ASSERT_TRUE(c != nullptr);
+  ASSERT_EQ(1, c->output_level());
+  delete c;
+
+  // At the trigger, the level-0 files are merged with each other.
+  Add(0, "b", "y", 512 << 10);
+  c = Pick();
+  ASSERT_TRUE(c != nullptr);
+  ASSERT_EQ(0, c->level());
+  ASSERT_EQ(0, c->output_level());
+  ASSERT_EQ(config::kL0_SlowdownWritesTrigger, c->num_input_files(0));
+  ASSERT_EQ(0, c->num_input_files(1));
+  ASSERT_FALSE(c->IsTrivialMove());
+  delete c;
+}
+
+TEST(ComputeMaxBytesForLevelsTest, Static) {
+  Options options;
+  int64_t level_bytes[config::kNumLevels] = {0};
+  level_bytes[6] = 2000LL << 30;
+  double max_bytes[config::kNumLevels];
+  ComputeMaxBytesForLevels(options, level_bytes, max_bytes);
+  ASSERT_EQ(10. * 1048576, max_bytes[1]);
+  ASSERT_EQ(100. * 1048576, max_bytes[2]);
+  ASSERT_EQ(100000. * 1048576, max_bytes[5]);
+}
+
+TEST(ComputeMaxBytesForLevelsTest, Dynamic) {
+  Options options;
+  options.level_compaction_dynamic_level_bytes = true;
+  int64_t level_bytes[config::kNumLevels] = {0};
+  double max_bytes[config::kNumLevels];
+
+  // The limits above the last level follow its size.
+  level_bytes[6] = 2000LL << 30;
+  ComputeMaxBytesForLevels(options, level_bytes, max_bytes);
+  ASSERT_EQ(200. * (1 << 30), max_bytes[5]);
+  ASSERT_EQ(20. * (1 << 30), max_bytes[4]);
+  ASSERT_EQ(2. * (1 << 30), max_bytes[3]);
+  ASSERT_EQ(0.2 * (1 << 30), max_bytes[2]);
+  ASSERT_EQ(0.02 * (1 << 30), max_bytes[1]);
+
+  // The deepest non-empty level keeps its own limit, and no level gets
+  // less than 10MB.
+  level_bytes[6] = 0;
+  level_bytes[3] = 500LL << 20;
+  ComputeMaxBytesForLevels(options, level_bytes, max_bytes);
+  ASSERT_EQ(1000. * 1048576, max_bytes[3]);
+  ASSERT_EQ(50. * 1048576, max_bytes[2]);
+  ASSERT_EQ(10. * 1048576, max_bytes[1]);
+}
+
 }  // namespace leveldb
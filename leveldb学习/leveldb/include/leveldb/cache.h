@@ -96,6 +96,11 @@ class LEVELDB_EXPORT Cache {
   // Return an estimate of the combined charges of all elements stored in the
   // cache.
   virtual size_t TotalCharge() const = 0;
+
+  // Return an estimate of the combined charges of the elements that have
+  // handles outstanding, and so cannot be evicted.  The default
+  // implementation returns 0.
+  virtual size_t TotalPinnedCharge() const { return 0; }
 };
 
 }  // namespace leveldb
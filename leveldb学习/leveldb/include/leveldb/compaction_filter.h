@@ -0,0 +1,69 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A CompactionFilter lets an application drop or rewrite values while
+// compactions copy them, e.g. to expire old data without scanning for it
+// and deleting it.  A database may be configured with a filter by setting
+// Options::compaction_filter.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+#define STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class Env;
+class Slice;
+
+class LEVELDB_EXPORT CompactionFilter {
+ public:
+  enum Decision {
+    kKeep,         // Keep the value unchanged
+    kRemove,       // Delete the key
+    kChangeValue,  // Replace the value with *new_value
+  };
+
+  virtual ~CompactionFilter();
+
+  // The name of the filter, used in logs and tools.
+  virtual const char* Name() const = 0;
+
+  // Decide what to do with "existing_value", a value of "key".  "level"
+  // is the level that the compaction writes to.
+  //
+  // Only values written after every live snapshot was taken are passed to
+  // the filter, so snapshots never see its effects.  Removing a value
+  // also hides the older values of its key.  Deletions and merge operands
+  // are not passed to the filter.
+  //
+  // May be called concurrently from multiple threads.
+  virtual Decision Filter(int level, const Slice& key,
+                          const Slice& existing_value,
+                          std::string* new_value) const = 0;
+};
+
+// The number of bytes of the timestamp suffix used by the filter returned
+// by NewTTLCompactionFilter().
+static const size_t kTTLTimestampSize = 8;
+
+// Return a new filter that removes values written more than "ttl_seconds"
+// seconds ago, according to env->NowMicros().  Each value must end with its
+// write time in seconds since the epoch, encoded as a 64-bit little-endian
+// integer (see kTTLTimestampSize); values too short to hold one are kept.
+// The suffix is part of the value that Get() and iterators return.
+//
+// Expired values stay readable until a compaction reaches them.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const CompactionFilter* NewTTLCompactionFilter(
+    Env* env, uint64_t ttl_seconds);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
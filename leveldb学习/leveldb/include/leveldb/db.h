@@ -7,6 +7,8 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <string>
+#include <vector>
 
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
@@ -20,6 +22,7 @@ static const int kMinorVersion = 23;
 
 struct Options;
 struct ReadOptions;
+struct TraceOptions;
 struct WriteOptions;
 class WriteBatch;
 
@@ -40,6 +43,42 @@ struct LEVELDB_EXPORT Range {
   Slice limit;  // Not included in the range
 };
 
+// The memory held by a DB, as reported by DB::GetMemoryUsage().  Sizes
+// are in bytes.
+struct LEVELDB_EXPORT MemoryUsage {
+  struct Level {
+    int num_files = 0;
+
+    // The number of tables of the level that a lookup of one key may
+    // have to search: every table of level 0, and at most one table of
+    // each other level.
+    int read_amplification = 0;
+
+    // Combined charge of the data blocks of the level's tables in
+    // Options::block_cache.
+    uint64_t block_cache_usage = 0;
+
+    // Index and filter blocks of the level's open tables.  Unlike data
+    // blocks, these stay in memory for as long as the table is open.
+    uint64_t index_usage = 0;
+    uint64_t filter_usage = 0;
+  };
+
+  // Arenas of the memtable being written, and of the one being
+  // compacted, if any.
+  uint64_t mem_table_usage = 0;
+  uint64_t imm_mem_table_usage = 0;
+
+  // Combined charge of all entries of Options::block_cache, which may be
+  // shared with other DBs or hold blocks of tables that were deleted,
+  // and of those pinned by iterators and reads in progress.
+  uint64_t block_cache_usage = 0;
+  uint64_t block_cache_pinned_usage = 0;
+
+  // One entry for each level of the tree.
+  std::vector<Level> levels;
+};
+
 // A DB is a persistent ordered map from keys to values.
 // A DB is safe for concurrent access from multiple threads without
 // any external synchronization.
@@ -72,6 +111,22 @@ class LEVELDB_EXPORT DB {
   // Note: consider setting options.sync = true.
   virtual Status Delete(const WriteOptions& options, const Slice& key) = 0;
 
+  // Remove the database entries (if any) for every key in
+  // [begin_key, end_key).  This costs a single write no matter how many
+  // keys the range holds; the entries are dropped by later compactions.
+  // Returns OK on success, and a non-OK status on error.
+  // Note: consider setting options.sync = true.
+  virtual Status DeleteRange(const WriteOptions& options,
+                             const Slice& begin_key, const Slice& end_key);
+
+  // Apply "value" to the database entry for "key" with
+  // Options::merge_operator, without reading the entry.  The operand is
+  // combined with the entry when "key" is read or compacted.
+  // Returns OK on success, and a non-OK status on error.
+  // Note: consider setting options.sync = true.
+  virtual Status Merge(const WriteOptions& options, const Slice& key,
+                       const Slice& value);
+
   // Apply the specified updates to the database.
   // Returns OK on success, non-OK on failure.
   // Note: consider setting options.sync = true.
@@ -121,6 +176,15 @@ class LEVELDB_EXPORT DB {
   //     of the sstables that make up the db contents.
   //  "leveldb.approximate-memory-usage" - returns the approximate number of
   //     bytes of memory in use by the DB.
+  //  "leveldb.memory-usage" - returns a multi-line string that describes
+  //     the memory held by each level and by the memtables (see
+  //     GetMemoryUsage()).
+  //  "leveldb.block-cache-usage", "leveldb.block-cache-pinned-usage",
+  //  "leveldb.block-cache-usage-at-level<N>", "leveldb.mem-table-usage",
+  //  "leveldb.imm-mem-table-usage", "leveldb.table-readers-usage" and
+  //  "leveldb.read-amplification" - return single fields or sums over the
+  //     levels of GetMemoryUsage().  Table readers hold the index and filter
+  //     blocks of open tables.
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
 
   // For each i in [0,n-1], store in "sizes[i]", the approximate
@@ -145,6 +209,39 @@ class LEVELDB_EXPORT DB {
   // Therefore the following call will compact the entire database:
   //    db->CompactRange(nullptr, nullptr);
   virtual void CompactRange(const Slice* begin, const Slice* end) = 0;
+
+  // Add the table files in "files", built with SstFileWriter, to the
+  // database.  Each file is placed in the deepest level that does not
+  // overlap newer data, and all of its entries are assigned a single
+  // sequence number newer than any existing write, so they take effect
+  // atomically and are invisible to existing snapshots.
+  //
+  // The files must not overlap each other.  They are hard linked into
+  // the database when the Env supports it and copied otherwise; either
+  // way the caller may delete the originals afterwards but must not
+  // modify them in place.
+  //
+  // The default implementation returns a NotSupported status.
+  virtual Status IngestExternalFiles(const std::vector<std::string>& files);
+
+  // Record the Get() and Write() calls made on this database, and the
+  // seeks of the iterators it returns, with their start times, in a new
+  // file "trace_path" until EndTrace() is called or the database is
+  // closed.  The trace can be replayed with "db_bench --benchmarks=replay".
+  //
+  // The default implementations return a NotSupported status.
+  virtual Status StartTrace(const TraceOptions& options,
+                            const std::string& trace_path);
+
+  // Stop recording and close the trace file.
+  virtual Status EndTrace();
+
+  // Store in *usage the memory held by the memtables, by the table cache
+  // and by the block cache.  This does not read any files and is cheap
+  // enough to be called every second.
+  //
+  // The default implementation returns a NotSupported status.
+  virtual Status GetMemoryUsage(MemoryUsage* usage);
 };
 
 // Destroy the contents of the specified database.
@@ -0,0 +1,140 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// An EventListener set in Options::listeners is told about flushes,
+// compactions, table files and write stalls as they happen, so that
+// applications do not have to parse the info log for them.
+//
+// The callbacks run on the thread that caused the event, which is
+// usually the background compaction thread, without any database lock
+// held.  Slow callbacks hold up that thread, and with it flushes and
+// compactions, so they should hand off any real work.  Callbacks may
+// read from the database but must not write to it, compact it or close
+// it.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_LISTENER_H_
+#define STORAGE_LEVELDB_INCLUDE_LISTENER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "leveldb/export.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class DB;
+
+// A memtable compaction, which writes the memtable to a table file.
+struct LEVELDB_EXPORT FlushJobInfo {
+  std::string db_name;
+
+  // The table written and the level it went to.  file_number is zero if
+  // the memtable held nothing worth writing.  Only db_name is set when
+  // the flush begins.
+  uint64_t file_number = 0;
+  std::string file_path;
+  int level = 0;
+  uint64_t file_size = 0;
+
+  uint64_t micros = 0;
+  Status status;
+};
+
+struct LEVELDB_EXPORT CompactionJobInfo {
+  std::string db_name;
+
+  // The files from "level" and "output_level" that were merged.
+  int level = 0;
+  int output_level = 0;
+  std::vector<uint64_t> input_files;
+
+  // True if the input files were moved to output_level without being
+  // rewritten, in which case they are also the output files.
+  bool is_trivial_move = false;
+
+  // The remaining fields are only set when the compaction completes.
+  std::vector<uint64_t> output_files;
+  uint64_t bytes_read = 0;
+  uint64_t bytes_written = 0;
+  uint64_t micros = 0;
+  Status status;
+};
+
+enum TableFileCreationReason {
+  kTableFileFromFlush,
+  kTableFileFromCompaction,
+  kTableFileFromRecovery,  // A log replayed by DB::Open()
+};
+
+struct LEVELDB_EXPORT TableFileCreationInfo {
+  std::string db_name;
+  std::string file_path;
+  uint64_t file_number = 0;
+  uint64_t file_size = 0;
+  TableFileCreationReason reason = kTableFileFromFlush;
+  // Not ok if the table could not be written, in which case it is deleted.
+  Status status;
+};
+
+struct LEVELDB_EXPORT TableFileDeletionInfo {
+  std::string db_name;
+  std::string file_path;
+  uint64_t file_number = 0;
+  Status status;
+};
+
+enum WriteStallCondition {
+  kWriteStallNormal,
+  // Each write is delayed by a millisecond because level-0 is filling up.
+  kWriteStallDelayed,
+  // Writes wait for a memtable compaction, or for level-0 compactions.
+  kWriteStallStopped,
+};
+
+struct LEVELDB_EXPORT WriteStallInfo {
+  std::string db_name;
+  WriteStallCondition condition = kWriteStallNormal;
+  WriteStallCondition previous_condition = kWriteStallNormal;
+};
+
+class LEVELDB_EXPORT EventListener {
+ public:
+  EventListener() = default;
+
+  EventListener(const EventListener&) = delete;
+  EventListener& operator=(const EventListener&) = delete;
+
+  virtual ~EventListener();
+
+  // Called before and after a memtable compaction.  "Completed" is called
+  // once the table is part of the database, or the flush has failed.
+  virtual void OnFlushBegin(DB* /*db*/, const FlushJobInfo& /*info*/) {}
+  virtual void OnFlushCompleted(DB* /*db*/, const FlushJobInfo& /*info*/) {}
+
+  // Called before and after a compaction of table files, including those
+  // that only move files to another level.
+  virtual void OnCompactionBegin(DB* /*db*/,
+                                 const CompactionJobInfo& /*info*/) {}
+  virtual void OnCompactionCompleted(DB* /*db*/,
+                                     const CompactionJobInfo& /*info*/) {}
+
+  // Called whenever a writer finds that the condition under which writes
+  // are stalled has changed.
+  virtual void OnStallConditionsChanged(DB* /*db*/,
+                                        const WriteStallInfo& /*info*/) {}
+
+  // Called after a table file has been written, or has failed to be.
+  virtual void OnTableFileCreated(DB* /*db*/,
+                                  const TableFileCreationInfo& /*info*/) {}
+
+  // Called after an obsolete table file has been deleted.
+  virtual void OnTableFileDeleted(DB* /*db*/,
+                                  const TableFileDeletionInfo& /*info*/) {}
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_LISTENER_H_
@@ -0,0 +1,56 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A MergeOperator turns read-modify-write sequences into blind writes.
+// DB::Merge(key, operand) records "operand" without reading the current
+// value; reads and compactions later combine the operands for a key with
+// the value below them.  For example, a counter can be incremented by
+// merging the encoded delta instead of calling Get() and Put().
+
+#ifndef STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
+#define STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
+
+#include <string>
+#include <vector>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class Slice;
+
+class LEVELDB_EXPORT MergeOperator {
+ public:
+  virtual ~MergeOperator();
+
+  // The name of the merge operator.  The name is not checked when a
+  // database is opened, but it should identify the operator in logs and
+  // tools.
+  virtual const char* Name() const = 0;
+
+  // Store in *new_value the result of applying "operands" (oldest first)
+  // to "existing_value", which is nullptr if the key has no value.
+  // Return false if the operands cannot be applied (e.g. they are
+  // malformed), in which case the read fails with a Corruption status.
+  //
+  // Must be deterministic: compactions may apply an operand more than
+  // once to different copies of the same value.
+  virtual bool FullMerge(const Slice& key, const Slice* existing_value,
+                         const std::vector<Slice>& operands,
+                         std::string* new_value) const = 0;
+
+  // If possible, store in *new_value a single operand that has the same
+  // effect as applying "older_operand" and then "newer_operand", and
+  // return true.  Compactions use this to combine operands for which the
+  // value is not available.
+  //
+  // The default implementation returns false.
+  virtual bool PartialMerge(const Slice& key, const Slice& older_operand,
+                            const Slice& newer_operand,
+                            std::string* new_value) const;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
@@ -6,17 +6,23 @@
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
 #include <cstddef>
+#include <cstdint>
+#include <vector>
 
 #include "leveldb/export.h"
 
 namespace leveldb {
 
 class Cache;
+class CompactionFilter;
 class Comparator;
 class Env;
+class EventListener;
 class FilterPolicy;
 class Logger;
+class MergeOperator;
 class Snapshot;
+class Statistics;
 
 // DB contents are stored in a set of blocks, each of which holds a
 // sequence of key,value pairs.  Each block may be compressed before
@@ -28,6 +34,41 @@ enum CompressionType {
   kNoCompression = 0x0,
   kSnappyCompression = 0x1,
   kZstdCompression = 0x2,
+  kLZ4Compression = 0x3,
+  kLZ4HCCompression = 0x4,  // Slower LZ4 compression; same fast decoding
+};
+
+// When a level is too large, one of its files is compacted into the next
+// level.  The following enum describes how that file is chosen.
+enum CompactionPriority {
+  // Cycle through the key space of the level.
+  kRoundRobinCompaction = 0x0,
+  // Pick the file that overlaps the fewest bytes in the next level
+  // relative to its own size, which minimizes write amplification.
+  kMinOverlappingRatioCompaction = 0x1,
+  // Pick the file whose newest entry is oldest, i.e. the data that has
+  // gone longest without being compacted.
+  kOldestLargestSeqFirstCompaction = 0x2,
+};
+
+// How table files are organized and merged as the database grows.
+enum CompactionStyle {
+  // NOTE: do not change the values of existing entries, as these are
+  // part of the persistent format on disk.
+
+  // Keep the data of each level in non-overlapping files and merge a
+  // level into the next one when it grows too large.  Reads touch few
+  // files, at the cost of rewriting data once per level.
+  kCompactionStyleLevel = 0x0,
+  // Keep the data as a few sorted runs: the level-0 files and the last
+  // level.  Runs of similar size are merged together, so data is
+  // rewritten less often than with kCompactionStyleLevel, at the cost of
+  // more space and of reads that search more files.
+  kCompactionStyleUniversal = 0x1,
+  // Keep every table file in level-0 and never merge them; delete the
+  // oldest files once they take more than fifo_max_table_files_size
+  // bytes.  Suits data that is only useful for a limited time.
+  kCompactionStyleFIFO = 0x2,
 };
 
 // Options to control the behavior of a database (passed to DB::Open)
@@ -69,6 +110,15 @@ struct LEVELDB_EXPORT Options {
   // in the same directory as the DB contents if info_log is null.
   Logger* info_log = nullptr;
 
+  // If non-null, the database counts events and measures the latency of
+  // its operations in the specified object (see leveldb/statistics.h).
+  Statistics* statistics = nullptr;
+
+  // The database tells these listeners about flushes, compactions, table
+  // files and write stalls (see leveldb/listener.h).  The listeners must
+  // outlive the database.
+  std::vector<EventListener*> listeners;
+
   // -------------------
   // Parameters that affect performance
 
@@ -115,6 +165,59 @@ struct LEVELDB_EXPORT Options {
   // initially populating a large database.
   size_t max_file_size = 2 * 1024 * 1024;
 
+  // A table file in which some "deletion_compaction_window" consecutive
+  // entries include at least "deletion_compaction_trigger" deletion
+  // markers is compacted into the next level even if its own level is
+  // not full, so that the deleted entries are purged and scans no longer
+  // have to step over them.
+  //
+  // Default: 0 (files are not compacted because of their deletions)
+  int deletion_compaction_window = 0;
+  int deletion_compaction_trigger = 0;
+
+  // How to choose the file of a level-1 or higher level to compact when
+  // the level is too large.  Level-0 always uses kRoundRobinCompaction,
+  // after which every level-0 file overlapping the chosen one is added.
+  //
+  // Default: kRoundRobinCompaction
+  CompactionPriority compaction_priority = kRoundRobinCompaction;
+
+  // If true, the size limit of each level above the deepest non-empty
+  // level is a tenth of the limit of the level below, counting from the
+  // actual size of that deepest level, instead of 10MB for level-1 and 10
+  // times more for every level after it.  The levels then keep their
+  // 10x shape as the database grows, which bounds the space taken by
+  // obsolete data to about a tenth of the live data.
+  //
+  // Default: false
+  bool level_compaction_dynamic_level_bytes = false;
+
+  // How to organize and merge table files.  The style is recorded when
+  // the database is created, and Open() fails if it does not match.
+  //
+  // Default: kCompactionStyleLevel
+  CompactionStyle compaction_style = kCompactionStyleLevel;
+
+  // With kCompactionStyleUniversal, the newest sorted runs are merged
+  // while the next older run is at most this percent larger than the
+  // runs picked so far together.
+  //
+  // Default: 1
+  int universal_size_ratio = 1;
+
+  // With kCompactionStyleUniversal, all sorted runs are merged into the
+  // last level once the runs other than the oldest one take more than
+  // this percent of the space of the oldest run.
+  //
+  // Default: 200
+  int universal_max_size_amplification_percent = 200;
+
+  // With kCompactionStyleFIFO, the oldest table files are deleted once all
+  // of them take more than this many bytes.
+  //
+  // Default: 1GB
+  uint64_t fifo_max_table_files_size = 1024 * 1024 * 1024;
+
   // Compress blocks using the specified compression algorithm.  This
   // parameter can be changed dynamically.
   //
@@ -131,20 +234,99 @@ struct LEVELDB_EXPORT Options {
   // efficiently detect that and will switch to uncompressed mode.
   CompressionType compression = kSnappyCompression;
 
+  // If non-empty, overrides "compression" by level: tables written to
+  // level i use compression_per_level[i], and levels past the end of the
+  // vector use its last entry.  Memtable flushes use the level-0 entry.
+  //
+  // Useful to keep the short-lived upper levels cheap to write (e.g.
+  // kNoCompression or kLZ4Compression) while compressing the bottom of
+  // the tree, which holds most of the data, with kZstdCompression.
+  std::vector<CompressionType> compression_per_level;
+
   // Compression level for zstd.
   // Currently only the range [-5,22] is supported. Default is 1.
   int zstd_compression_level = 1;
 
+  // If non-zero and compression is kZstdCompression, each table trains a
+  // zstd dictionary of at most this many bytes from its leading data
+  // blocks, compresses all of its data blocks with it, and stores the
+  // dictionary in a meta block.  This greatly improves the ratio for
+  // small, similar values that share little redundancy within one block.
+  //
+  // Default: 0 (no dictionary).  Typical values are 16KB to 64KB.
+  size_t zstd_dictionary_size = 0;
+
+  // Amount of uncompressed data block bytes a table buffers as training
+  // samples before its dictionary is trained.  Tables smaller than this
+  // train on all of their data blocks.  Ignored unless
+  // zstd_dictionary_size is non-zero.
+  size_t zstd_dictionary_training_bytes = 1024 * 1024;
+
+  // Number of worker threads used to compress data blocks.  The workers
+  // are started on first use and shared by all TableBuilders in the
+  // process, which grows them to the largest value requested; each
+  // builder keeps at most 2 * compression_threads blocks in flight.
+  // Blocks are still written to the file in the order they were
+  // added, so the resulting table is identical to one built inline.
+  // Values of 0 or 1 compress on the thread calling TableBuilder::Add().
+  //
+  // Worth enabling when an expensive codec (e.g. kZstdCompression at a
+  // high level) dominates compaction CPU.
+  int compression_threads = 0;
+
+  // If non-zero, values of at least this many bytes are moved out of the
+  // tables into separate append-only blob files, and the tables only keep
+  // a small reference to them.  Compactions then rewrite the references
+  // instead of the values, which greatly reduces write amplification for
+  // large values at the cost of one extra read per lookup.
+  //
+  // Default: 0 (all values are stored in the tables).
+  size_t blob_value_threshold = 0;
+
+  // A blob file is garbage collected once at least this fraction of its
+  // bytes belongs to values that compactions have dropped.  Compactions
+  // then copy the values they still reference out of the file, and the
+  // file is deleted when no table refers to it any more.
+  double blob_garbage_collection_ratio = 0.5;
+
+  // If positive, DB::Open() opens the tables of the database with this many
+  // threads before returning, reading the footer, index and filter of
+  // each, so that the first reads after a restart do not have to.  Tables
+  // of lower levels are opened first, and no more tables are opened than
+  // fit in the table cache (see max_open_files).  With paranoid_checks, a
+  // table that cannot be opened makes DB::Open() fail.
+  int table_preload_threads = 0;
+
+  // Only the tables of this many levels, starting at level-0, are opened
+  // when table_preload_threads is positive.
+  int table_preload_levels = 7;
+
   // EXPERIMENTAL: If true, append to existing MANIFEST and log files
   // when a database is opened.  This can significantly speed up open.
   //
   // Default: currently false, but may become true later.
   bool reuse_logs = false;
 
+  // Once the MANIFEST file, which logs every change to the set of files
+  // of the database, grows past this size, the next change starts a new
+  // MANIFEST holding a snapshot of the current files.  This bounds the
+  // space the MANIFEST takes and the time it takes to open the database.
+  size_t max_manifest_file_size = 64 * 1024 * 1024;
+
   // If non-null, use the specified filter policy to reduce disk reads.
   // Many applications will benefit from passing the result of
   // NewBloomFilterPolicy() here.
   const FilterPolicy* filter_policy = nullptr;
+
+  // If non-null, use the specified operator to combine the operands
+  // written by DB::Merge() with the values below them.  Required to
+  // read keys that have merge operands.
+  const MergeOperator* merge_operator = nullptr;
+
+  // If non-null, compactions pass the values that no snapshot can see to
+  // this filter, which may keep, drop or rewrite them.  For
+  // example, NewTTLCompactionFilter() drops expired values.
+  const CompactionFilter* compaction_filter = nullptr;
 };
 
 // Options that control read operations
@@ -185,6 +367,17 @@ struct LEVELDB_EXPORT WriteOptions {
   bool sync = false;
 };
 
+// Options that control DB::StartTrace()
+struct LEVELDB_EXPORT TraceOptions {
+  TraceOptions() = default;
+
+  // Recording stops once the trace file would grow beyond this size.
+  uint64_t max_trace_file_size = uint64_t{64} << 30;
+
+  // Record only one of every this many operations.
+  uint64_t sampling_frequency = 1;
+};
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
@@ -0,0 +1,116 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A PerfContext breaks down where the current thread spent its time in
+// database operations, and an IOStatsContext counts the file I/O it
+// did.  Both are per thread and are only updated once SetPerfLevel()
+// enables them on that thread:
+//
+//   leveldb::SetPerfLevel(leveldb::kPerfEnableTime);
+//   leveldb::GetPerfContext()->Reset();
+//   db->Get(leveldb::ReadOptions(), key, &value);
+//   std::string breakdown = leveldb::GetPerfContext()->ToString();
+//   leveldb::SetPerfLevel(leveldb::kPerfDisable);
+//
+// Work done by background threads, such as compactions, is not counted.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PERF_CONTEXT_H_
+#define STORAGE_LEVELDB_INCLUDE_PERF_CONTEXT_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+enum PerfLevel {
+  kPerfDisable = 0,      // Update nothing (the default)
+  kPerfEnableCount = 1,  // Update counters only
+  kPerfEnableTime = 2,   // Also read the clock to update timers
+};
+
+// Set the level for the calling thread.
+LEVELDB_EXPORT void SetPerfLevel(PerfLevel level);
+
+// Return the level of the calling thread.
+LEVELDB_EXPORT PerfLevel GetPerfLevel();
+
+// All times are in nanoseconds.
+struct LEVELDB_EXPORT PerfContext {
+  // Set every field to zero.
+  void Reset();
+
+  // Return a listing like "block_read_count = 2, ...", leaving out the
+  // fields that are zero if "exclude_zero_counters" is true.
+  std::string ToString(bool exclude_zero_counters = false) const;
+
+  // DB::Get(): waiting for the DB mutex, memtables searched and the time
+  // spent searching them, and time spent searching the tables.
+  uint64_t db_mutex_lock_nanos = 0;
+  uint64_t get_from_memtable_count = 0;
+  uint64_t get_from_memtable_nanos = 0;
+  uint64_t get_from_output_files_nanos = 0;
+
+  // Tables searched by DB::Get(), and time spent finding them in the table
+  // cache, which includes opening the tables that were not open.
+  uint64_t get_from_table_count = 0;
+  uint64_t find_table_nanos = 0;
+
+  // Table lookups whose filter could not rule out the key, and those it
+  // did rule out.
+  uint64_t bloom_sst_hit_count = 0;
+  uint64_t bloom_sst_miss_count = 0;
+
+  // Seeking the index block of a table.
+  uint64_t index_seek_nanos = 0;
+
+  // Data blocks found in the block cache, and data blocks read from
+  // files, with their size and the time it took to read, verify and
+  // decompress them.
+  uint64_t block_cache_hit_count = 0;
+  uint64_t block_read_count = 0;
+  uint64_t block_read_byte = 0;
+  uint64_t block_read_nanos = 0;
+  uint64_t block_checksum_nanos = 0;
+  uint64_t block_decompress_nanos = 0;
+
+  // Iterators returned by DB::NewIterator(): entries that moving forward
+  // passed over because they were hidden, deletion markers passed over in
+  // either direction, and time spent in the internal Seek() of
+  // Iterator::Seek().
+  uint64_t internal_key_skipped_count = 0;
+  uint64_t internal_delete_skipped_count = 0;
+  uint64_t seek_internal_seek_nanos = 0;
+
+  // DB::Write(): appending to (and syncing) the log, and inserting into
+  // the memtable.
+  uint64_t write_wal_nanos = 0;
+  uint64_t write_memtable_nanos = 0;
+};
+
+// File I/O done on behalf of database operations.  Times are in
+// nanoseconds.
+struct LEVELDB_EXPORT IOStatsContext {
+  // Set every field to zero.
+  void Reset();
+
+  // Return a listing like "bytes_read = 4096, ...", leaving out the
+  // fields that are zero if "exclude_zero_counters" is true.
+  std::string ToString(bool exclude_zero_counters = false) const;
+
+  uint64_t bytes_read = 0;     // Table blocks read
+  uint64_t bytes_written = 0;  // Log records written
+  uint64_t read_nanos = 0;
+  uint64_t write_nanos = 0;
+  uint64_t fsync_nanos = 0;
+};
+
+// Return the context of the calling thread.
+LEVELDB_EXPORT PerfContext* GetPerfContext();
+LEVELDB_EXPORT IOStatsContext* GetIOStatsContext();
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PERF_CONTEXT_H_
@@ -0,0 +1,69 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// SstFileWriter builds a table file outside of any database that can later
+// be added to a database with DB::IngestExternalFiles().  This bypasses
+// the log, the memtable and compactions, which makes it the fastest way
+// to bulk load sorted data.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+#define STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/export.h"
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT SstFileWriter {
+ public:
+  // Create a writer for files to be ingested into databases opened with
+  // "options".  The comparator and filter policy must match those of the
+  // database; block and compression settings are taken from "options".
+  explicit SstFileWriter(const Options& options);
+
+  SstFileWriter(const SstFileWriter&) = delete;
+  SstFileWriter& operator=(const SstFileWriter&) = delete;
+
+  // Abandons the file being written, if any, and removes it.
+  ~SstFileWriter();
+
+  // Start writing a new file named "fname", replacing any existing file.
+  // REQUIRES: No file is being written.
+  Status Open(const std::string& fname);
+
+  // Add an entry that sets "key" to "value" when ingested.
+  // REQUIRES: key is after any previously added key according to the
+  // comparator.
+  Status Put(const Slice& key, const Slice& value);
+
+  // Add an entry that deletes "key" when ingested.
+  // REQUIRES: key is after any previously added key according to the
+  // comparator.
+  Status Delete(const Slice& key);
+
+  // Finish writing the file and sync it to storage.  Fails if no entries
+  // were added, in which case the file is removed.
+  Status Finish();
+
+  // Size of the file generated so far, or of the file most recently
+  // finished.
+  uint64_t FileSize() const;
+
+ private:
+  struct Rep;
+
+  Status Add(const Slice& key, const Slice& value, bool is_deletion);
+  void Abandon();
+
+  Rep* const rep_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
@@ -0,0 +1,125 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A Statistics object counts events inside a database (tickers) and keeps
+// histograms of how long operations take.  A database updates the object
+// set as Options::statistics; several databases may share one.
+//
+// The builtin implementation returned by NewStatistics() spreads updates
+// over per-CPU stripes of atomic counters, so recording is cheap and
+// never blocks.  Reads add up the stripes, so a reading taken while
+// other threads are updating the object may be slightly out of date.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_STATISTICS_H_
+#define STORAGE_LEVELDB_INCLUDE_STATISTICS_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+enum Ticker {
+  // Data block reads served by, or missing from, Options::block_cache.
+  kBlockCacheDataHit = 0,
+  kBlockCacheDataMiss,
+
+  // Table lookups that found the table open, or had to open it, reading
+  // its index and filter blocks.  Open tables keep those blocks in memory
+  // instead of in the block cache.
+  kTableCacheHit,
+  kTableCacheMiss,
+
+  // Table lookups that consulted a filter, and those the filter ruled out.
+  kBloomFilterChecked,
+  kBloomFilterUseful,
+
+  // Calls to DB::Get(), and bytes of the values they returned.
+  kKeysRead,
+  kBytesRead,
+
+  // Entries, and bytes of write batches, written by DB::Write().
+  kKeysWritten,
+  kBytesWritten,
+
+  // Bytes of tables written by memtable compactions, and read and written
+  // by other compactions.
+  kFlushBytesWritten,
+  kCompactionBytesRead,
+  kCompactionBytesWritten,
+
+  // Time writers spent delayed or stopped waiting for compactions.
+  kStallMicros,
+
+  kTickerCount
+};
+
+enum HistogramType {
+  kGetMicros = 0,
+  kWriteMicros,
+  kSeekMicros,  // Iterator::Seek() on iterators returned by DB::NewIterator()
+  kFlushMicros,
+  kCompactionMicros,
+
+  kHistogramCount
+};
+
+// Returns a name like "leveldb.block.cache.data.hit" for the ticker.
+LEVELDB_EXPORT const char* TickerName(Ticker ticker);
+
+// Returns a name like "leveldb.get.micros" for the histogram.
+LEVELDB_EXPORT const char* HistogramName(HistogramType type);
+
+// A summary of a histogram.  Percentiles are interpolated within buckets,
+// which keep them within about 3% of the exact value.
+struct LEVELDB_EXPORT HistogramData {
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  uint64_t min = 0;
+  uint64_t max = 0;
+  double average = 0;
+  double standard_deviation = 0;
+  double median = 0;
+  double percentile95 = 0;
+  double percentile99 = 0;
+  double percentile999 = 0;
+};
+
+class LEVELDB_EXPORT Statistics {
+ public:
+  Statistics() = default;
+
+  Statistics(const Statistics&) = delete;
+  Statistics& operator=(const Statistics&) = delete;
+
+  virtual ~Statistics();
+
+  // Add "count" to the ticker.
+  virtual void RecordTick(Ticker ticker, uint64_t count) = 0;
+
+  // Add a sample to the histogram.
+  virtual void MeasureTime(HistogramType type, uint64_t micros) = 0;
+
+  // Return the current value of the ticker.
+  virtual uint64_t GetTickerCount(Ticker ticker) const = 0;
+
+  // Summarize the current contents of the histogram in *data.
+  virtual void GetHistogramData(HistogramType type,
+                                HistogramData* data) const = 0;
+
+  // Set every ticker to zero and empty every histogram.
+  virtual void Reset() = 0;
+
+  // Return a human-readable listing of the tickers and histograms.
+  virtual std::string ToString() const;
+};
+
+// Create a new Statistics object, safe for concurrent use by multiple
+// threads.
+LEVELDB_EXPORT Statistics* NewStatistics();
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_STATISTICS_H_
@@ -50,6 +50,11 @@ class LEVELDB_EXPORT Table {
   // call one of the Seek methods on the iterator before using it).
   Iterator* NewIterator(const ReadOptions&) const;
 
+  // Returns a new iterator over the entries added with
+  // TableBuilder::AddRangeTombstone(), or nullptr if there are none.
+  // The iterator is valid while the table is live.
+  Iterator* NewRangeTombstoneIterator() const;
+
   // Given a key, return an approximate byte offset in the file where
   // the data for that key begins (or would begin if the key were
   // present in the file).  The returned value is in terms of file
@@ -58,6 +63,15 @@ class LEVELDB_EXPORT Table {
   // be close to the file length.
   uint64_t ApproximateOffsetOf(const Slice& key) const;
 
+  // Bytes of the index block (and of the range tombstone block, if any)
+  // and of the filter block, which stay in memory while the table is open.
+  uint64_t IndexMemoryUsage() const;
+  uint64_t FilterMemoryUsage() const;
+
+  // Combined charge of the data blocks of this table that are in
+  // Options::block_cache.
+  uint64_t BlockCacheUsage() const;
+
  private:
   friend class TableCache;
   struct Rep;
@@ -73,8 +87,9 @@ class LEVELDB_EXPORT Table {
                      void (*handle_result)(void* arg, const Slice& k,
                                            const Slice& v));
 
-  void ReadMeta(const Footer& footer);
+  Status ReadMeta(const Footer& footer);
   void ReadFilter(const Slice& filter_handle_value);
+  void ReadCompressionDict(const Slice& dict_handle_value);
 
   Rep* const rep_;
 };
@@ -51,6 +51,14 @@ class LEVELDB_EXPORT TableBuilder {
   // REQUIRES: Finish(), Abandon() have not been called
   void Add(const Slice& key, const Slice& value);
 
+  // Add key,value to a meta block of the table instead of its data
+  // blocks.  The table does not interpret these entries; leveldb stores
+  // range deletions in them.  See Table::NewRangeTombstoneIterator().
+  // REQUIRES: key is after any previously added range tombstone key
+  //           according to comparator.
+  // REQUIRES: Finish(), Abandon() have not been called
+  void AddRangeTombstone(const Slice& key, const Slice& value);
+
   // Advanced operation: flush any buffered key/value pairs to file.
   // Can be used to ensure that two adjacent entries never live in
   // the same data block.  Most clients should not need to use this method.
@@ -75,8 +83,10 @@ class LEVELDB_EXPORT TableBuilder {
   // Number of calls to Add() so far.
   uint64_t NumEntries() const;
 
-  // Size of the file generated so far.  If invoked after a successful
-  // Finish() call, returns the size of the final generated file.
+  // Size of the file generated so far, including an uncompressed estimate
+  // of data blocks that are buffered but not yet written.  If invoked
+  // after a successful Finish() call, returns the size of the final
+  // generated file.
   uint64_t FileSize() const;
 
  private:
@@ -84,6 +94,19 @@ class LEVELDB_EXPORT TableBuilder {
   void WriteBlock(BlockBuilder* block, BlockHandle* handle);
   void WriteRawBlock(const Slice& data, CompressionType, BlockHandle* handle);
 
+  // Hands the current data block to the compression workers, or buffers
+  // it as a dictionary training sample.
+  void SubmitBlock();
+
+  // Trains the zstd dictionary from the buffered blocks and releases them
+  // for compression.
+  void TrainDictionary();
+
+  // Writes out submitted blocks whose compression has completed, in
+  // submission order.  If "wait_all" is true, waits for every submitted
+  // block; otherwise waits only while too many blocks are in flight.
+  void WriteCompressedBlocks(bool wait_all);
+
   struct Rep;
   Rep* rep_;
 };
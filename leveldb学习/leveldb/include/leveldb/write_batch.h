@@ -37,6 +37,12 @@ class LEVELDB_EXPORT WriteBatch {
     virtual ~Handler();
     virtual void Put(const Slice& key, const Slice& value) = 0;
     virtual void Delete(const Slice& key) = 0;
+
+    // The default implementation ignores range deletions.
+    virtual void DeleteRange(const Slice& begin_key, const Slice& end_key);
+
+    // The default implementation ignores merge operands.
+    virtual void Merge(const Slice& key, const Slice& value);
   };
 
   WriteBatch();
@@ -53,6 +59,15 @@ class LEVELDB_EXPORT WriteBatch {
   // If the database contains a mapping for "key", erase it.  Else do nothing.
   void Delete(const Slice& key);
 
+  // Erase every mapping whose key is in [begin_key, end_key).  This is
+  // recorded as a single entry however many keys it covers.  Does nothing
+  // if begin_key is not before end_key.
+  void DeleteRange(const Slice& begin_key, const Slice& end_key);
+
+  // Apply "value" to the mapping for "key" with Options::merge_operator
+  // when it is read.
+  void Merge(const Slice& key, const Slice& value);
+
   // Clear all updates buffered in this batch.
   void Clear();
 
@@ -81,6 +81,30 @@ bool Snappy_GetUncompressedLength(const char* input, size_t length,
 bool Snappy_Uncompress(const char* input_data, size_t input_length,
                        char* output);
 
+// Store the LZ4 compression of "input[0,input_length-1]" in *output.
+// Lz4hc_Compress() uses the slower high-compression variant, whose output
+// is read back with the same functions.  Return false if LZ4 is not
+// supported by this port.
+bool Lz4_Compress(const char* input, size_t input_length, std::string* output);
+bool Lz4hc_Compress(const char* input, size_t input_length,
+                    std::string* output);
+
+// If input[0,input_length-1] looks like a valid LZ4 compressed buffer,
+// store the size of the uncompressed data in *result and return true.
+// Else return false.  Lengths that input_length bytes of LZ4 data cannot
+// decode to are rejected, so *result is safe to allocate.
+bool Lz4_GetUncompressedLength(const char* input, size_t length,
+                               size_t* result);
+
+// Attempt to LZ4 uncompress input[0,input_length-1] into *output.
+// Returns true if successful, false if the input is invalid LZ4
+// compressed data.
+//
+// REQUIRES: at least the first "n" bytes of output[] must be writable
+// where "n" is the result of a successful call to
+// Lz4_GetUncompressedLength.
+bool Lz4_Uncompress(const char* input_data, size_t input_length, char* output);
+
 // Store the zstd compression of "input[0,input_length-1]" in *output.
 // Returns false if zstd is not supported by this port.
 bool Zstd_Compress(int level, const char* input, size_t input_length,
@@ -101,6 +125,33 @@ bool Zstd_GetUncompressedLength(const char* input, size_t length,
 // Zstd_GetUncompressedLength.
 bool Zstd_Uncompress(const char* input_data, size_t input_length, char* output);
 
+// A zstd dictionary prepared once for compression at a fixed level
+// (ZstdCompressionDict) or for decompression (ZstdDecompressionDict).
+// Both are constructed from the raw dictionary bytes, report whether
+// preparation succeeded via ok(), and are safe for concurrent use.
+class ZstdCompressionDict;
+class ZstdDecompressionDict;
+
+// Train a zstd dictionary of at most max_dict_size bytes from the
+// concatenated samples in "samples", whose individual lengths are listed
+// in sample_sizes.  Stores the dictionary in *dict and returns true on
+// success.  Returns false if zstd is not supported by this port or the
+// samples are unsuitable for training.
+bool Zstd_TrainDictionary(const char* samples,
+                          const std::vector<size_t>& sample_sizes,
+                          size_t max_dict_size, std::string* dict);
+
+// Store the zstd compression of "input[0,input_length-1]" using "dict"
+// in *output.  Returns false if zstd is not supported by this port.
+bool Zstd_CompressWithDict(const ZstdCompressionDict& dict, const char* input,
+                           size_t input_length, std::string* output);
+
+// Like Zstd_Uncompress(), but for data compressed with a dictionary.
+// Data compressed without a dictionary is accepted as well.
+bool Zstd_UncompressWithDict(const ZstdDecompressionDict& dict,
+                             const char* input_data, size_t input_length,
+                             char* output);
+
 // ------------------ Miscellaneous -------------------
 
 // If heap profiling is not supported, returns false.
@@ -108,6 +159,10 @@ bool Zstd_Uncompress(const char* input_data, size_t input_length, char* output);
 // The concatenation of all "data[0,n-1]" fragments is the heap profile.
 bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg);
 
+// Returns the index of the CPU the calling thread is running on, or a
+// negative value if the platform cannot tell.
+int PhysicalCoreID();
+
 // Extend the CRC to include the first n bytes of buf.
 //
 // Returns zero if the CRC cannot be extended using acceleration, else returns
@@ -28,17 +28,27 @@
 #if HAVE_SNAPPY
 #include <snappy.h>
 #endif  // HAVE_SNAPPY
+#if HAVE_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif  // HAVE_LZ4
 #if HAVE_ZSTD
 #define ZSTD_STATIC_LINKING_ONLY  // For ZSTD_compressionParameters.
+#include <zdict.h>
 #include <zstd.h>
 #endif  // HAVE_ZSTD
 
+#if HAVE_SCHED_GETCPU
+#include <sched.h>
+#endif  // HAVE_SCHED_GETCPU
+
 #include <cassert>
 #include <condition_variable>  // NOLINT
 #include <cstddef>
 #include <cstdint>
 #include <mutex>  // NOLINT
 #include <string>
+#include <vector>
 
 #include "port/thread_annotations.h"
 
@@ -130,6 +140,102 @@ inline bool Snappy_Uncompress(const char* input, size_t length, char* output) {
 #endif  // HAVE_SNAPPY
 }
 
+// LZ4 blocks do not record their uncompressed size, so the compressed
+// form is prefixed with it as a little-endian 32-bit integer.
+static const size_t kLz4HeaderSize = 4;
+
+inline bool Lz4_CompressImpl(bool high_compression, const char* input,
+                             size_t length, std::string* output) {
+#if HAVE_LZ4
+  if (length > static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+    return false;
+  }
+  const int bound = LZ4_compressBound(static_cast<int>(length));
+  output->resize(kLz4HeaderSize + bound);
+  char* header = &(*output)[0];
+  for (size_t i = 0; i < kLz4HeaderSize; i++) {
+    header[i] = static_cast<char>((length >> (8 * i)) & 0xff);
+  }
+  const int outlen =
+      high_compression
+          ? LZ4_compress_HC(input, header + kLz4HeaderSize,
+                            static_cast<int>(length), bound,
+                            LZ4HC_CLEVEL_DEFAULT)
+          : LZ4_compress_default(input, header + kLz4HeaderSize,
+                                 static_cast<int>(length), bound);
+  if (outlen <= 0) {
+    return false;
+  }
+  output->resize(kLz4HeaderSize + outlen);
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)high_compression;
+  (void)input;
+  (void)length;
+  (void)output;
+  return false;
+#endif  // HAVE_LZ4
+}
+
+inline bool Lz4_Compress(const char* input, size_t length,
+                         std::string* output) {
+  return Lz4_CompressImpl(/*high_compression=*/false, input, length, output);
+}
+
+inline bool Lz4hc_Compress(const char* input, size_t length,
+                           std::string* output) {
+  return Lz4_CompressImpl(/*high_compression=*/true, input, length, output);
+}
+
+inline bool Lz4_GetUncompressedLength(const char* input, size_t length,
+                                      size_t* result) {
+#if HAVE_LZ4
+  if (length < kLz4HeaderSize) {
+    return false;
+  }
+  size_t size = 0;
+  for (size_t i = 0; i < kLz4HeaderSize; i++) {
+    size |= static_cast<size_t>(static_cast<unsigned char>(input[i]))
+            << (8 * i);
+  }
+  // Each compressed byte decodes to at most 255 bytes, so a larger length
+  // can only come from a corrupted header.  Reject it before the caller
+  // allocates a buffer of that size.
+  if (size > static_cast<size_t>(LZ4_MAX_INPUT_SIZE) ||
+      size / 255 > length - kLz4HeaderSize) {
+    return false;
+  }
+  *result = size;
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)result;
+  return false;
+#endif  // HAVE_LZ4
+}
+
+inline bool Lz4_Uncompress(const char* input, size_t length, char* output) {
+#if HAVE_LZ4
+  size_t outlen;
+  if (!Lz4_GetUncompressedLength(input, length, &outlen)) {
+    return false;
+  }
+  const int result = LZ4_decompress_safe(
+      input + kLz4HeaderSize, output,
+      static_cast<int>(length - kLz4HeaderSize), static_cast<int>(outlen));
+  return result >= 0 && static_cast<size_t>(result) == outlen;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)output;
+  return false;
+#endif  // HAVE_LZ4
+}
+
 inline bool Zstd_Compress(int level, const char* input, size_t length,
                           std::string* output) {
 #if HAVE_ZSTD
@@ -198,6 +304,173 @@ inline bool Zstd_Uncompress(const char* input, size_t length, char* output) {
 #endif  // HAVE_ZSTD
 }
 
+// A zstd dictionary digested once for compression at a fixed level.
+// Safe for concurrent use by multiple threads.
+class ZstdCompressionDict {
+ public:
+  ZstdCompressionDict(int level, const char* dict, size_t dict_size) {
+#if HAVE_ZSTD
+    cdict_ = ZSTD_createCDict(dict, dict_size, level);
+#else
+    // Silence compiler warnings about unused arguments.
+    (void)level;
+    (void)dict;
+    (void)dict_size;
+#endif  // HAVE_ZSTD
+  }
+
+  ZstdCompressionDict(const ZstdCompressionDict&) = delete;
+  ZstdCompressionDict& operator=(const ZstdCompressionDict&) = delete;
+
+  ~ZstdCompressionDict() {
+#if HAVE_ZSTD
+    ZSTD_freeCDict(cdict_);
+#endif  // HAVE_ZSTD
+  }
+
+  // Returns false if the dictionary could not be prepared.
+  bool ok() const {
+#if HAVE_ZSTD
+    return cdict_ != nullptr;
+#else
+    return false;
+#endif  // HAVE_ZSTD
+  }
+
+ private:
+  friend bool Zstd_CompressWithDict(const ZstdCompressionDict& dict,
+                                    const char* input, size_t length,
+                                    std::string* output);
+
+#if HAVE_ZSTD
+  ZSTD_CDict* cdict_;
+#endif  // HAVE_ZSTD
+};
+
+// A zstd dictionary digested once for decompression.  Safe for
+// concurrent use by multiple threads.
+class ZstdDecompressionDict {
+ public:
+  ZstdDecompressionDict(const char* dict, size_t dict_size) {
+#if HAVE_ZSTD
+    ddict_ = ZSTD_createDDict(dict, dict_size);
+#else
+    // Silence compiler warnings about unused arguments.
+    (void)dict;
+    (void)dict_size;
+#endif  // HAVE_ZSTD
+  }
+
+  ZstdDecompressionDict(const ZstdDecompressionDict&) = delete;
+  ZstdDecompressionDict& operator=(const ZstdDecompressionDict&) = delete;
+
+  ~ZstdDecompressionDict() {
+#if HAVE_ZSTD
+    ZSTD_freeDDict(ddict_);
+#endif  // HAVE_ZSTD
+  }
+
+  // Returns false if the dictionary could not be prepared.
+  bool ok() const {
+#if HAVE_ZSTD
+    return ddict_ != nullptr;
+#else
+    return false;
+#endif  // HAVE_ZSTD
+  }
+
+ private:
+  friend bool Zstd_UncompressWithDict(const ZstdDecompressionDict& dict,
+                                      const char* input, size_t length,
+                                      char* output);
+
+#if HAVE_ZSTD
+  ZSTD_DDict* ddict_;
+#endif  // HAVE_ZSTD
+};
+
+inline bool Zstd_TrainDictionary(const char* samples,
+                                 const std::vector<size_t>& sample_sizes,
+                                 size_t max_dict_size, std::string* dict) {
+#if HAVE_ZSTD
+  dict->resize(max_dict_size);
+  size_t dict_size = ZDICT_trainFromBuffer(
+      &(*dict)[0], dict->size(), samples, sample_sizes.data(),
+      static_cast<unsigned>(sample_sizes.size()));
+  if (ZDICT_isError(dict_size)) {
+    dict->clear();
+    return false;
+  }
+  dict->resize(dict_size);
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)samples;
+  (void)sample_sizes;
+  (void)max_dict_size;
+  (void)dict;
+  return false;
+#endif  // HAVE_ZSTD
+}
+
+inline bool Zstd_CompressWithDict(const ZstdCompressionDict& dict,
+                                  const char* input, size_t length,
+                                  std::string* output) {
+#if HAVE_ZSTD
+  size_t outlen = ZSTD_compressBound(length);
+  if (ZSTD_isError(outlen) || !dict.ok()) {
+    return false;
+  }
+  output->resize(outlen);
+  ZSTD_CCtx* ctx = ZSTD_createCCtx();
+  outlen = ZSTD_compress_usingCDict(ctx, &(*output)[0], output->size(), input,
+                                    length, dict.cdict_);
+  ZSTD_freeCCtx(ctx);
+  if (ZSTD_isError(outlen)) {
+    return false;
+  }
+  output->resize(outlen);
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)dict;
+  (void)input;
+  (void)length;
+  (void)output;
+  return false;
+#endif  // HAVE_ZSTD
+}
+
+inline bool Zstd_UncompressWithDict(const ZstdDecompressionDict& dict,
+                                    const char* input, size_t length,
+                                    char* output) {
+#if HAVE_ZSTD
+  if (ZSTD_getDictID_fromFrame(input, length) == 0) {
+    // Compressed without a dictionary.
+    return Zstd_Uncompress(input, length, output);
+  }
+  size_t outlen;
+  if (!dict.ok() || !Zstd_GetUncompressedLength(input, length, &outlen)) {
+    return false;
+  }
+  ZSTD_DCtx* ctx = ZSTD_createDCtx();
+  outlen = ZSTD_decompress_usingDDict(ctx, output, outlen, input, length,
+                                      dict.ddict_);
+  ZSTD_freeDCtx(ctx);
+  if (ZSTD_isError(outlen)) {
+    return false;
+  }
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)dict;
+  (void)input;
+  (void)length;
+  (void)output;
+  return false;
+#endif  // HAVE_ZSTD
+}
+
 inline bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg) {
   // Silence compiler warnings about unused arguments.
   (void)func;
@@ -205,6 +478,14 @@ inline bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg) {
   return false;
 }
 
+inline int PhysicalCoreID() {
+#if HAVE_SCHED_GETCPU
+  return ::sched_getcpu();
+#else
+  return -1;
+#endif  // HAVE_SCHED_GETCPU
+}
+
 inline uint32_t AcceleratedCRC32C(uint32_t crc, const char* buf, size_t size) {
 #if HAVE_CRC32C
   return ::crc32c::Extend(crc, reinterpret_cast<const uint8_t*>(buf), size);
@@ -0,0 +1,67 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Static tracepoints (USDT probes) of the "leveldb" provider, for tools
+// such as perf and bpftrace:
+//
+//    bpftrace -e 'usdt:./libleveldb.so:leveldb:get_start { @s[tid] = nsecs; }
+//                 usdt:./libleveldb.so:leveldb:get_end /@s[tid]/ {
+//                   @get_ns = hist(nsecs - @s[tid]); delete(@s[tid]); }'
+//
+// The probes are only compiled in when leveldb is built with the CMake
+// option LEVELDB_USDT, which needs <sys/sdt.h> from systemtap.  Otherwise
+// the macros expand to nothing and their arguments are not evaluated.
+// An enabled probe that no tool is attached to costs a nop instruction.
+//
+// Probes and their arguments:
+//    get_start(key, key_size), get_end(found)
+//    wal_append_start(record_size), wal_append_end(ok)
+//    wal_sync_start(), wal_sync_end(ok)
+//    memtable_switch(new_log_number, imm_bytes)
+//    write_stall_begin(condition), write_stall_end(previous_condition)
+//    flush_begin(imm_bytes), flush_end(ok)
+//    compaction_begin(level, output_level, num_input_files)
+//    compaction_end(level, bytes_written, ok)
+//    block_read_start(offset, size), block_read_end(size, ok)
+//    block_decompress_start(compression_type, size),
+//        block_decompress_end(uncompressed_size)
+//    block_cache_hit(cache_id, offset), block_cache_miss(cache_id, offset)
+//    table_cache_hit(file_number), table_cache_miss(file_number)
+//
+// The end probe of an operation may be skipped when it fails early, so
+// tools should not assume that every start probe is matched.
+
+#ifndef STORAGE_LEVELDB_PORT_PROBES_H_
+#define STORAGE_LEVELDB_PORT_PROBES_H_
+
+#include "port/port.h"
+
+#if HAVE_USDT
+
+#include <sys/sdt.h>
+
+#define LEVELDB_PROBE(name) DTRACE_PROBE(leveldb, name)
+#define LEVELDB_PROBE1(name, a1) DTRACE_PROBE1(leveldb, name, a1)
+#define LEVELDB_PROBE2(name, a1, a2) DTRACE_PROBE2(leveldb, name, a1, a2)
+#define LEVELDB_PROBE3(name, a1, a2, a3) \
+  DTRACE_PROBE3(leveldb, name, a1, a2, a3)
+
+#else  // HAVE_USDT
+
+#define LEVELDB_PROBE(name) \
+  do {                      \
+  } while (false)
+#define LEVELDB_PROBE1(name, a1) \
+  do {                           \
+  } while (false)
+#define LEVELDB_PROBE2(name, a1, a2) \
+  do {                               \
+  } while (false)
+#define LEVELDB_PROBE3(name, a1, a2, a3) \
+  do {                                   \
+  } while (false)
+
+#endif  // HAVE_USDT
+
+#endif  // STORAGE_LEVELDB_PORT_PROBES_H_
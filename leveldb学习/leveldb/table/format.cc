@@ -7,9 +7,11 @@
 #include "leveldb/env.h"
 #include "leveldb/options.h"
 #include "port/port.h"
+#include "port/probes.h"
 #include "table/block.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
+#include "util/perf_context_imp.h"
 
 namespace leveldb {
 
@@ -67,7 +69,8 @@ Status Footer::DecodeFrom(Slice* input) {
 }
 
 Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
-                 const BlockHandle& handle, BlockContents* result) {
+                 const BlockHandle& handle, BlockContents* result,
+                 const port::ZstdDecompressionDict* zstd_dict) {
   result->data = Slice();
   result->cachable = false;
   result->heap_allocated = false;
@@ -77,7 +80,14 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
   size_t n = static_cast<size_t>(handle.size());
   char* buf = new char[n + kBlockTrailerSize];
   Slice contents;
-  Status s = file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
+  Status s;
+  {
+    IOStatsTimer timer(&IOStatsContext::read_nanos);
+    LEVELDB_PROBE2(block_read_start, handle.offset(), n + kBlockTrailerSize);
+    s = file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
+    LEVELDB_PROBE2(block_read_end, contents.size(), s.ok());
+  }
+  IOStatsAdd(&IOStatsContext::bytes_read, contents.size());
   if (!s.ok()) {
     delete[] buf;
     return s;
@@ -90,6 +100,7 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
   // Check the crc of the type and the block contents
   const char* data = contents.data();  // Pointer to where Read put the data
   if (options.verify_checksums) {
+    PerfTimer timer(&PerfContext::block_checksum_nanos);
     const uint32_t crc = crc32c::Unmask(DecodeFixed32(data + n + 1));
     const uint32_t actual = crc32c::Value(data, n + 1);
     if (actual != crc) {
@@ -99,6 +110,8 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
     }
   }
 
+  PerfTimer timer(&PerfContext::block_decompress_nanos);
+  LEVELDB_PROBE2(block_decompress_start, static_cast<int>(data[n]), n);
   switch (data[n]) {
     case kNoCompression:
       if (data != buf) {
@@ -135,6 +148,25 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
       result->cachable = true;
       break;
     }
+    case kLZ4Compression:
+    case kLZ4HCCompression: {
+      size_t ulength = 0;
+      if (!port::Lz4_GetUncompressedLength(data, n, &ulength)) {
+        delete[] buf;
+        return Status::Corruption("corrupted lz4 compressed block length");
+      }
+      char* ubuf = new char[ulength];
+      if (!port::Lz4_Uncompress(data, n, ubuf)) {
+        delete[] buf;
+        delete[] ubuf;
+        return Status::Corruption("corrupted lz4 compressed block contents");
+      }
+      delete[] buf;
+      result->data = Slice(ubuf, ulength);
+      result->heap_allocated = true;
+      result->cachable = true;
+      break;
+    }
     case kZstdCompression: {
       size_t ulength = 0;
       if (!port::Zstd_GetUncompressedLength(data, n, &ulength)) {
@@ -142,7 +174,11 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
         return Status::Corruption("corrupted zstd compressed block length");
       }
       char* ubuf = new char[ulength];
-      if (!port::Zstd_Uncompress(data, n, ubuf)) {
+      const bool uncompressed_ok =
+          (zstd_dict != nullptr)
+              ? port::Zstd_UncompressWithDict(*zstd_dict, data, n, ubuf)
+              : port::Zstd_Uncompress(data, n, ubuf);
+      if (!uncompressed_ok) {
         delete[] buf;
         delete[] ubuf;
         return Status::Corruption("corrupted zstd compressed block contents");
@@ -158,6 +194,7 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
       return Status::Corruption("bad block type");
   }
 
+  LEVELDB_PROBE1(block_decompress_end, result->data.size());
   return Status::OK();
 }
 
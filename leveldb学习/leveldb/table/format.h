@@ -18,6 +18,10 @@ class Block;
 class RandomAccessFile;
 struct ReadOptions;
 
+namespace port {
+class ZstdDecompressionDict;
+}  // namespace port
+
 // BlockHandle is a pointer to the extent of a file that stores a data
 // block or a meta block.
 class BlockHandle {
@@ -85,9 +89,11 @@ struct BlockContents {
 };
 
 // Read the block identified by "handle" from "file".  On failure
-// return non-OK.  On success fill *result and return OK.
+// return non-OK.  On success fill *result and return OK.  If "zstd_dict"
+// is non-null, it is used to decompress zstd compressed blocks.
 Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
-                 const BlockHandle& handle, BlockContents* result);
+                 const BlockHandle& handle, BlockContents* result,
+                 const port::ZstdDecompressionDict* zstd_dict = nullptr);
 
 // Implementation details follow.  Clients should ignore,
 
@@ -4,35 +4,86 @@
 
 #include "leveldb/table.h"
 
+#include <atomic>
+
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "port/port.h"
+#include "port/probes.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
+#include "util/perf_context_imp.h"
+#include "util/stop_watch.h"
 
 namespace leveldb {
 
+namespace {
+
+// The combined charge of the blocks of a table in the block cache.  Each
+// cached block holds a reference, since it may be evicted after the
+// table is closed.
+class BlockCacheCharge {
+ public:
+  BlockCacheCharge() : refs_(1), charge_(0) {}
+
+  BlockCacheCharge(const BlockCacheCharge&) = delete;
+  BlockCacheCharge& operator=(const BlockCacheCharge&) = delete;
+
+  void Ref() { refs_.fetch_add(1, std::memory_order_relaxed); }
+  void Unref() {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  void Add(size_t n) { charge_.fetch_add(n, std::memory_order_relaxed); }
+  void Sub(size_t n) { charge_.fetch_sub(n, std::memory_order_relaxed); }
+  uint64_t charge() const { return charge_.load(std::memory_order_relaxed); }
+
+ private:
+  ~BlockCacheCharge() = default;
+
+  std::atomic<int> refs_;
+  std::atomic<uint64_t> charge_;
+};
+
+// The value of a block cache entry.
+struct CachedBlock {
+  Block* block;
+  BlockCacheCharge* owner;
+};
+
+}  // namespace
+
 struct Table::Rep {
   ~Rep() {
+    cache_charge->Unref();
     delete filter;
     delete[] filter_data;
+    delete zstd_dict;
     delete index_block;
+    delete range_del_block;
   }
 
   Options options;
   Status status;
   RandomAccessFile* file;
   uint64_t cache_id;
+  BlockCacheCharge* cache_charge;
   FilterBlockReader* filter;
   const char* filter_data;
+  size_t filter_size;
+  port::ZstdDecompressionDict* zstd_dict;  // Null if the table has none
 
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
   Block* index_block;
+  Block* range_del_block;  // Null if the table has no range tombstones
 };
 
 Status Table::Open(const Options& options, RandomAccessFile* file,
@@ -70,22 +121,30 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
     rep->metaindex_handle = footer.metaindex_handle();
     rep->index_block = index_block;
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
+    rep->cache_charge = new BlockCacheCharge;
     rep->filter_data = nullptr;
+    rep->filter_size = 0;
     rep->filter = nullptr;
+    rep->zstd_dict = nullptr;
+    rep->range_del_block = nullptr;
     *table = new Table(rep);
-    (*table)->ReadMeta(footer);
+    s = (*table)->ReadMeta(footer);
+    if (!s.ok()) {
+      delete *table;
+      *table = nullptr;
+    }
   }
 
   return s;
 }
 
-void Table::ReadMeta(const Footer& footer) {
-  if (rep_->options.filter_policy == nullptr) {
-    return;  // Do not need any metadata
+Status Table::ReadMeta(const Footer& footer) {
+  // An empty metaindex block holds only its restart array: one restart
+  // point plus the restart count.
+  if (footer.metaindex_handle().size() <= 2 * sizeof(uint32_t)) {
+    return Status::OK();  // No metadata
   }
 
-  // TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
-  // it is an empty block.
   ReadOptions opt;
   if (rep_->options.paranoid_checks) {
     opt.verify_checksums = true;
@@ -93,19 +152,42 @@ void Table::ReadMeta(const Footer& footer) {
   BlockContents contents;
   if (!ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents).ok()) {
     // Do not propagate errors since meta info is not needed for operation
-    return;
+    return Status::OK();
   }
   Block* meta = new Block(contents);
 
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
-  key.append(rep_->options.filter_policy->Name());
-  iter->Seek(key);
-  if (iter->Valid() && iter->key() == Slice(key)) {
-    ReadFilter(iter->value());
+  iter->Seek("compression_dict");
+  if (iter->Valid() && iter->key() == Slice("compression_dict")) {
+    ReadCompressionDict(iter->value());
+  }
+  if (rep_->options.filter_policy != nullptr) {
+    std::string key = "filter.";
+    key.append(rep_->options.filter_policy->Name());
+    iter->Seek(key);
+    if (iter->Valid() && iter->key() == Slice(key)) {
+      ReadFilter(iter->value());
+    }
+  }
+  // Unlike the blocks above, range tombstones affect what the table
+  // holds, so a failure to read them fails the open.
+  Status s;
+  iter->Seek("rangedel");
+  if (iter->Valid() && iter->key() == Slice("rangedel")) {
+    Slice v = iter->value();
+    BlockHandle handle;
+    s = handle.DecodeFrom(&v);
+    BlockContents block;
+    if (s.ok()) {
+      s = ReadBlock(rep_->file, opt, handle, &block);
+    }
+    if (s.ok()) {
+      rep_->range_del_block = new Block(block);
+    }
   }
   delete iter;
   delete meta;
+  return s;
 }
 
 void Table::ReadFilter(const Slice& filter_handle_value) {
@@ -128,18 +210,65 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
   if (block.heap_allocated) {
     rep_->filter_data = block.data.data();  // Will need to delete later
   }
+  rep_->filter_size = block.data.size();
   rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
 }
 
+void Table::ReadCompressionDict(const Slice& dict_handle_value) {
+  Slice v = dict_handle_value;
+  BlockHandle dict_handle;
+  if (!dict_handle.DecodeFrom(&v).ok()) {
+    return;
+  }
+
+  ReadOptions opt;
+  if (rep_->options.paranoid_checks) {
+    opt.verify_checksums = true;
+  }
+  BlockContents block;
+  if (!ReadBlock(rep_->file, opt, dict_handle, &block).ok()) {
+    // Data blocks compressed with the dictionary will report corruption.
+    return;
+  }
+  // The digested dictionary keeps its own copy of the bytes.
+  rep_->zstd_dict =
+      new port::ZstdDecompressionDict(block.data.data(), block.data.size());
+  if (block.heap_allocated) {
+    delete[] block.data.data();
+  }
+}
+
 Table::~Table() { delete rep_; }
 
+uint64_t Table::IndexMemoryUsage() const {
+  uint64_t usage = rep_->index_block->size();
+  if (rep_->range_del_block != nullptr) {
+    usage += rep_->range_del_block->size();
+  }
+  return usage;
+}
+
+uint64_t Table::FilterMemoryUsage() const { return rep_->filter_size; }
+
+uint64_t Table::BlockCacheUsage() const { return rep_->cache_charge->charge(); }
+
+Iterator* Table::NewRangeTombstoneIterator() const {
+  if (rep_->range_del_block == nullptr) {
+    return nullptr;
+  }
+  return rep_->range_del_block->NewIterator(rep_->options.comparator);
+}
+
 static void DeleteBlock(void* arg, void* ignored) {
   delete reinterpret_cast<Block*>(arg);
 }
 
 static void DeleteCachedBlock(const Slice& key, void* value) {
-  Block* block = reinterpret_cast<Block*>(value);
-  delete block;
+  CachedBlock* cached = reinterpret_cast<CachedBlock*>(value);
+  cached->owner->Sub(cached->block->size());
+  cached->owner->Unref();
+  delete cached->block;
+  delete cached;
 }
 
 static void ReleaseBlock(void* arg, void* h) {
@@ -148,6 +277,16 @@ static void ReleaseBlock(void* arg, void* h) {
   cache->Release(handle);
 }
 
+// Like ReadBlock(), counting the read in the PerfContext of the thread.
+static Status ReadDataBlock(RandomAccessFile* file, const ReadOptions& options,
+                            const BlockHandle& handle, BlockContents* contents,
+                            const port::ZstdDecompressionDict* zstd_dict) {
+  PerfCounterAdd(&PerfContext::block_read_count);
+  PerfCounterAdd(&PerfContext::block_read_byte, handle.size());
+  PerfTimer timer(&PerfContext::block_read_nanos);
+  return ReadBlock(file, options, handle, contents, zstd_dict);
+}
+
 // Convert an index iterator value (i.e., an encoded BlockHandle)
 // into an iterator over the contents of the corresponding block.
 Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
@@ -172,19 +311,33 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
       Slice key(cache_key_buffer, sizeof(cache_key_buffer));
       cache_handle = block_cache->Lookup(key);
       if (cache_handle != nullptr) {
-        block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
+        block = reinterpret_cast<CachedBlock*>(block_cache->Value(cache_handle))
+                    ->block;
+        RecordTick(table->rep_->options.statistics, kBlockCacheDataHit);
+        LEVELDB_PROBE2(block_cache_hit, table->rep_->cache_id, handle.offset());
+        PerfCounterAdd(&PerfContext::block_cache_hit_count);
       } else {
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
+        RecordTick(table->rep_->options.statistics, kBlockCacheDataMiss);
+        LEVELDB_PROBE2(block_cache_miss, table->rep_->cache_id,
+                       handle.offset());
+        s = ReadDataBlock(table->rep_->file, options, handle, &contents,
+                          table->rep_->zstd_dict);
         if (s.ok()) {
           block = new Block(contents);
           if (contents.cachable && options.fill_cache) {
-            cache_handle = block_cache->Insert(key, block, block->size(),
+            CachedBlock* cached = new CachedBlock;
+            cached->block = block;
+            cached->owner = table->rep_->cache_charge;
+            cached->owner->Ref();
+            cached->owner->Add(block->size());
+            cache_handle = block_cache->Insert(key, cached, block->size(),
                                                &DeleteCachedBlock);
           }
         }
       }
     } else {
-      s = ReadBlock(table->rep_->file, options, handle, &contents);
+      s = ReadDataBlock(table->rep_->file, options, handle, &contents,
+                        table->rep_->zstd_dict);
       if (s.ok()) {
         block = new Block(contents);
       }
@@ -216,15 +369,28 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
                                                 const Slice&)) {
   Status s;
   Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
-  iiter->Seek(k);
+  {
+    PerfTimer timer(&PerfContext::index_seek_nanos);
+    iiter->Seek(k);
+  }
   if (iiter->Valid()) {
     Slice handle_value = iiter->value();
     FilterBlockReader* filter = rep_->filter;
+    Statistics* statistics = rep_->options.statistics;
     BlockHandle handle;
-    if (filter != nullptr && handle.DecodeFrom(&handle_value).ok() &&
-        !filter->KeyMayMatch(handle.offset(), k)) {
+    const bool check_filter =
+        filter != nullptr && handle.DecodeFrom(&handle_value).ok();
+    if (check_filter) {
+      RecordTick(statistics, kBloomFilterChecked);
+    }
+    if (check_filter && !filter->KeyMayMatch(handle.offset(), k)) {
       // Not found
+      RecordTick(statistics, kBloomFilterUseful);
+      PerfCounterAdd(&PerfContext::bloom_sst_miss_count);
     } else {
+      if (check_filter) {
+        PerfCounterAdd(&PerfContext::bloom_sst_hit_count);
+      }
       Iterator* block_iter = BlockReader(this, options, iiter->value());
       block_iter->Seek(k);
       if (block_iter->Valid()) {
@@ -5,19 +5,201 @@
 #include "leveldb/table_builder.h"
 
 #include <cassert>
+#include <deque>
+#include <thread>
+#include <vector>
 
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
 #include "table/block_builder.h"
 #include "table/filter_block.h"
 #include "table/format.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
+#include "util/no_destructor.h"
 
 namespace leveldb {
 
+namespace {
+
+// Compresses "raw" using "*type" and returns the contents to store.  On
+// return *type holds the compression actually applied: the raw form is
+// kept when the codec is unavailable or saves less than 12.5%.  If
+// "zstd_dict" is non-null, zstd compression uses it.
+Slice CompressBlock(const Slice& raw, int zstd_compression_level,
+                    const port::ZstdCompressionDict* zstd_dict,
+                    std::string* compressed, CompressionType* type) {
+  // TODO(postrelease): Support more compression options: zlib?
+  switch (*type) {
+    case kNoCompression:
+      return raw;
+
+    case kSnappyCompression:
+      if (port::Snappy_Compress(raw.data(), raw.size(), compressed) &&
+          compressed->size() < raw.size() - (raw.size() / 8u)) {
+        return *compressed;
+      }
+      break;
+
+    case kLZ4Compression:
+      if (port::Lz4_Compress(raw.data(), raw.size(), compressed) &&
+          compressed->size() < raw.size() - (raw.size() / 8u)) {
+        return *compressed;
+      }
+      break;
+
+    case kLZ4HCCompression:
+      if (port::Lz4hc_Compress(raw.data(), raw.size(), compressed) &&
+          compressed->size() < raw.size() - (raw.size() / 8u)) {
+        return *compressed;
+      }
+      break;
+
+    case kZstdCompression: {
+      const bool compressed_ok =
+          (zstd_dict != nullptr)
+              ? port::Zstd_CompressWithDict(*zstd_dict, raw.data(),
+                                            raw.size(), compressed)
+              : port::Zstd_Compress(zstd_compression_level, raw.data(),
+                                    raw.size(), compressed);
+      if (compressed_ok &&
+          compressed->size() < raw.size() - (raw.size() / 8u)) {
+        return *compressed;
+      }
+      break;
+    }
+  }
+  *type = kNoCompression;
+  return raw;
+}
+
+// A data block whose compression is deferred, either to the compression
+// workers or until the table's zstd dictionary has been trained.
+struct PendingBlock {
+  std::string raw;
+  std::string compressed;
+  Slice contents;  // Points into raw or compressed once done is set
+  CompressionType type;
+  int zstd_compression_level;
+  const port::ZstdCompressionDict* zstd_dict = nullptr;
+
+  // Keys of the block, fed to the filter when the block is written so
+  // that the filter sees the final block offsets.
+  std::string filter_keys;
+  std::vector<size_t> filter_key_starts;
+
+  // Separator to record in the index block for this block.  Not known
+  // until the first key of the following block has been added.
+  std::string index_key;
+  bool has_index_key = false;
+
+  // False while the block is held back as a dictionary training sample.
+  bool dispatched = false;
+  bool done = false;  // Guarded by the BlockCompressor mutex
+};
+
+// A process-wide pool of threads that compresses PendingBlocks for all
+// table builders.  Completion is reported per block; ordering is left to
+// the caller.  The workers are never joined, like the Env background
+// thread.
+class BlockCompressor {
+ public:
+  // Returns the shared pool, grown to at least "num_threads" workers.
+  static BlockCompressor* Shared(int num_threads) {
+    static NoDestructor<BlockCompressor> shared;
+    BlockCompressor* compressor = shared.get();
+    compressor->AddWorkers(num_threads);
+    return compressor;
+  }
+
+  BlockCompressor() : work_cv_(&mu_), done_cv_(&mu_), num_workers_(0) {}
+
+  BlockCompressor(const BlockCompressor&) = delete;
+  BlockCompressor& operator=(const BlockCompressor&) = delete;
+
+  void Submit(PendingBlock* block) {
+    mu_.Lock();
+    queue_.push_back(block);
+    work_cv_.Signal();
+    mu_.Unlock();
+  }
+
+  bool IsDone(PendingBlock* block) {
+    mu_.Lock();
+    const bool done = block->done;
+    mu_.Unlock();
+    return done;
+  }
+
+  void WaitFor(PendingBlock* block) {
+    mu_.Lock();
+    while (!block->done) {
+      done_cv_.Wait();
+    }
+    mu_.Unlock();
+  }
+
+ private:
+  void AddWorkers(int num_threads) {
+    mu_.Lock();
+    while (num_workers_ < num_threads) {
+      std::thread worker(&BlockCompressor::WorkerMain, this);
+      worker.detach();
+      num_workers_++;
+    }
+    mu_.Unlock();
+  }
+
+  void WorkerMain() {
+    mu_.Lock();
+    while (true) {
+      while (queue_.empty()) {
+        work_cv_.Wait();
+      }
+      PendingBlock* block = queue_.front();
+      queue_.pop_front();
+      mu_.Unlock();
+
+      block->contents = CompressBlock(block->raw, block->zstd_compression_level,
+                                      block->zstd_dict, &block->compressed,
+                                      &block->type);
+
+      mu_.Lock();
+      block->done = true;
+      done_cv_.SignalAll();
+    }
+  }
+
+  port::Mutex mu_;
+  port::CondVar work_cv_;
+  port::CondVar done_cv_;
+  std::deque<PendingBlock*> queue_ GUARDED_BY(mu_);
+  int num_workers_ GUARDED_BY(mu_);
+};
+
+// Releases "block" for compression with "zstd_dict": to "compressor" if
+// non-null, otherwise compresses it on the calling thread.
+void DispatchBlock(BlockCompressor* compressor,
+                   const port::ZstdCompressionDict* zstd_dict,
+                   PendingBlock* block) {
+  block->zstd_dict = zstd_dict;
+  block->dispatched = true;
+  if (compressor != nullptr) {
+    compressor->Submit(block);
+  } else {
+    block->contents = CompressBlock(block->raw, block->zstd_compression_level,
+                                    zstd_dict, &block->compressed,
+                                    &block->type);
+    block->done = true;
+  }
+}
+
+}  // namespace
+
 struct TableBuilder::Rep {
   Rep(const Options& opt, WritableFile* f)
       : options(opt),
@@ -26,15 +208,37 @@ struct TableBuilder::Rep {
         offset(0),
         data_block(&options),
         index_block(&index_block_options),
+        range_del_block(&options),
         num_entries(0),
+        num_range_tombstones(0),
         closed(false),
         filter_block(opt.filter_policy == nullptr
                          ? nullptr
                          : new FilterBlockBuilder(opt.filter_policy)),
-        pending_index_entry(false) {
+        pending_index_entry(false),
+        compressor(opt.compression_threads > 1
+                       ? BlockCompressor::Shared(opt.compression_threads)
+                       : nullptr),
+        training_dictionary(opt.compression == kZstdCompression &&
+                            opt.zstd_dictionary_size > 0),
+        defer_blocks(compressor != nullptr || training_dictionary),
+        pending_bytes(0),
+        sampled_bytes(0),
+        zstd_dict(nullptr) {
     index_block_options.block_restart_interval = 1;
   }
 
+  ~Rep() {
+    for (PendingBlock* block : pending_blocks) {
+      if (compressor != nullptr && block->dispatched) {
+        // A worker may still be compressing the block of an abandoned table.
+        compressor->WaitFor(block);
+      }
+      delete block;
+    }
+    delete zstd_dict;
+  }
+
   Options options;
   Options index_block_options;
   WritableFile* file;
@@ -42,8 +246,10 @@ struct TableBuilder::Rep {
   Status status;
   BlockBuilder data_block;
   BlockBuilder index_block;
+  BlockBuilder range_del_block;
   std::string last_key;
   int64_t num_entries;
+  int64_t num_range_tombstones;
   bool closed;  // Either Finish() or Abandon() has been called.
   FilterBlockBuilder* filter_block;
 
@@ -60,6 +266,26 @@ struct TableBuilder::Rep {
   BlockHandle pending_handle;  // Handle to add to index block
 
   std::string compressed_output;
+
+  // The shared worker pool if data blocks are compressed by worker
+  // threads, otherwise null.
+  BlockCompressor* compressor;
+
+  // True until the zstd dictionary has been trained from the leading
+  // data blocks.  Those blocks are held in pending_blocks meanwhile.
+  bool training_dictionary;
+
+  // If true, the filter keys of the block being built are buffered here
+  // and blocks are written out in submission order from pending_blocks.
+  bool defer_blocks;
+  std::string filter_keys;
+  std::vector<size_t> filter_key_starts;
+  std::deque<PendingBlock*> pending_blocks;
+  uint64_t pending_bytes;  // Raw bytes of pending_blocks, not yet written
+
+  size_t sampled_bytes;  // Raw bytes buffered for dictionary training
+  std::string dictionary;  // Trained dictionary; empty if none
+  port::ZstdCompressionDict* zstd_dict;  // Digested form of dictionary
 };
 
 TableBuilder::TableBuilder(const Options& options, WritableFile* file)
@@ -102,14 +328,27 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
   if (r->pending_index_entry) {
     assert(r->data_block.empty());
     r->options.comparator->FindShortestSeparator(&r->last_key, key);
-    std::string handle_encoding;
-    r->pending_handle.EncodeTo(&handle_encoding);
-    r->index_block.Add(r->last_key, Slice(handle_encoding));
+    if (r->defer_blocks) {
+      // The block may still be compressing; its handle is added to the
+      // index when it is written.
+      PendingBlock* block = r->pending_blocks.back();
+      block->index_key = r->last_key;
+      block->has_index_key = true;
+    } else {
+      std::string handle_encoding;
+      r->pending_handle.EncodeTo(&handle_encoding);
+      r->index_block.Add(r->last_key, Slice(handle_encoding));
+    }
     r->pending_index_entry = false;
   }
 
   if (r->filter_block != nullptr) {
-    r->filter_block->AddKey(key);
+    if (r->defer_blocks) {
+      r->filter_key_starts.push_back(r->filter_keys.size());
+      r->filter_keys.append(key.data(), key.size());
+    } else {
+      r->filter_block->AddKey(key);
+    }
   }
 
   r->last_key.assign(key.data(), key.size());
@@ -122,12 +361,26 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
   }
 }
 
+void TableBuilder::AddRangeTombstone(const Slice& key, const Slice& value) {
+  Rep* r = rep_;
+  assert(!r->closed);
+  if (!ok()) return;
+  r->num_range_tombstones++;
+  r->range_del_block.Add(key, value);
+}
+
 void TableBuilder::Flush() {
   Rep* r = rep_;
   assert(!r->closed);
   if (!ok()) return;
   if (r->data_block.empty()) return;
   assert(!r->pending_index_entry);
+  if (r->defer_blocks) {
+    SubmitBlock();
+    r->pending_index_entry = true;
+    WriteCompressedBlocks(/*wait_all=*/false);
+    return;
+  }
   WriteBlock(&r->data_block, &r->pending_handle);
   if (ok()) {
     r->pending_index_entry = true;
@@ -147,43 +400,10 @@ void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
   Rep* r = rep_;
   Slice raw = block->Finish();
 
-  Slice block_contents;
   CompressionType type = r->options.compression;
-  // TODO(postrelease): Support more compression options: zlib?
-  switch (type) {
-    case kNoCompression:
-      block_contents = raw;
-      break;
-
-    case kSnappyCompression: {
-      std::string* compressed = &r->compressed_output;
-      if (port::Snappy_Compress(raw.data(), raw.size(), compressed) &&
-          compressed->size() < raw.size() - (raw.size() / 8u)) {
-        block_contents = *compressed;
-      } else {
-        // Snappy not supported, or compressed less than 12.5%, so just
-        // store uncompressed form
-        block_contents = raw;
-        type = kNoCompression;
-      }
-      break;
-    }
-
-    case kZstdCompression: {
-      std::string* compressed = &r->compressed_output;
-      if (port::Zstd_Compress(r->options.zstd_compression_level, raw.data(),
-                              raw.size(), compressed) &&
-          compressed->size() < raw.size() - (raw.size() / 8u)) {
-        block_contents = *compressed;
-      } else {
-        // Zstd not supported, or compressed less than 12.5%, so just
-        // store uncompressed form
-        block_contents = raw;
-        type = kNoCompression;
-      }
-      break;
-    }
-  }
+  Slice block_contents =
+      CompressBlock(raw, r->options.zstd_compression_level, nullptr,
+                    &r->compressed_output, &type);
   WriteRawBlock(block_contents, type, handle);
   r->compressed_output.clear();
   block->Reset();
@@ -208,6 +428,113 @@ void TableBuilder::WriteRawBlock(const Slice& block_contents,
   }
 }
 
+void TableBuilder::SubmitBlock() {
+  Rep* r = rep_;
+  PendingBlock* block = new PendingBlock;
+  block->raw = r->data_block.Finish().ToString();
+  block->type = r->options.compression;
+  block->zstd_compression_level = r->options.zstd_compression_level;
+  block->filter_keys.swap(r->filter_keys);
+  block->filter_key_starts.swap(r->filter_key_starts);
+  r->data_block.Reset();
+  r->pending_blocks.push_back(block);
+  r->pending_bytes += block->raw.size();
+  if (r->training_dictionary) {
+    r->sampled_bytes += block->raw.size();
+    if (r->sampled_bytes >= r->options.zstd_dictionary_training_bytes) {
+      TrainDictionary();
+    }
+    return;
+  }
+  DispatchBlock(r->compressor, r->zstd_dict, block);
+}
+
+void TableBuilder::TrainDictionary() {
+  Rep* r = rep_;
+  assert(r->training_dictionary);
+  r->training_dictionary = false;
+
+  std::string samples;
+  samples.reserve(r->sampled_bytes);
+  std::vector<size_t> sample_sizes;
+  for (PendingBlock* block : r->pending_blocks) {
+    samples.append(block->raw);
+    sample_sizes.push_back(block->raw.size());
+  }
+  // Training fails when there is too little data; the table is then
+  // compressed without a dictionary.
+  if (port::Zstd_TrainDictionary(samples.data(), sample_sizes,
+                                 r->options.zstd_dictionary_size,
+                                 &r->dictionary)) {
+    r->zstd_dict = new port::ZstdCompressionDict(
+        r->options.zstd_compression_level, r->dictionary.data(),
+        r->dictionary.size());
+    if (!r->zstd_dict->ok()) {
+      delete r->zstd_dict;
+      r->zstd_dict = nullptr;
+      r->dictionary.clear();
+    }
+  }
+
+  for (PendingBlock* block : r->pending_blocks) {
+    DispatchBlock(r->compressor, r->zstd_dict, block);
+  }
+}
+
+void TableBuilder::WriteCompressedBlocks(bool wait_all) {
+  Rep* r = rep_;
+  // Bound the memory held by blocks waiting for a compression worker.
+  const size_t max_in_flight =
+      (r->compressor != nullptr) ? 2 * r->options.compression_threads : 0;
+  while (!r->pending_blocks.empty()) {
+    PendingBlock* block = r->pending_blocks.front();
+    if (!block->has_index_key) {
+      // The newest block cannot be written before its separator is known.
+      assert(!wait_all);
+      break;
+    }
+    if (!block->dispatched) {
+      // Held back until the dictionary is trained.
+      assert(!wait_all);
+      break;
+    }
+    if (r->compressor == nullptr) {
+      // Compressed inline when dispatched.
+    } else if (wait_all || r->pending_blocks.size() > max_in_flight) {
+      r->compressor->WaitFor(block);
+    } else if (!r->compressor->IsDone(block)) {
+      break;
+    }
+    r->pending_blocks.pop_front();
+    r->pending_bytes -= block->raw.size();
+
+    if (ok()) {
+      if (r->filter_block != nullptr) {
+        const std::vector<size_t>& starts = block->filter_key_starts;
+        for (size_t i = 0; i < starts.size(); i++) {
+          const size_t limit = (i + 1 < starts.size())
+                                   ? starts[i + 1]
+                                   : block->filter_keys.size();
+          r->filter_block->AddKey(Slice(block->filter_keys.data() + starts[i],
+                                        limit - starts[i]));
+        }
+      }
+      BlockHandle handle;
+      WriteRawBlock(block->contents, block->type, &handle);
+      if (ok()) {
+        std::string handle_encoding;
+        handle.EncodeTo(&handle_encoding);
+        r->index_block.Add(block->index_key, Slice(handle_encoding));
+        r->status = r->file->Flush();
+      }
+      if (r->filter_block != nullptr) {
+        r->filter_block->StartBlock(r->offset);
+      }
+    }
+    delete block;
+  }
+}
+
 Status TableBuilder::status() const { return rep_->status; }
 
 Status TableBuilder::Finish() {
@@ -216,7 +543,27 @@ Status TableBuilder::Finish() {
   assert(!r->closed);
   r->closed = true;
 
-  BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+  if (r->defer_blocks) {
+    if (r->pending_index_entry) {
+      r->options.comparator->FindShortSuccessor(&r->last_key);
+      PendingBlock* block = r->pending_blocks.back();
+      block->index_key = r->last_key;
+      block->has_index_key = true;
+      r->pending_index_entry = false;
+    }
+    if (r->training_dictionary) {
+      TrainDictionary();
+    }
+    WriteCompressedBlocks(/*wait_all=*/true);
+  }
+
+  BlockHandle dictionary_block_handle, filter_block_handle,
+      range_del_block_handle, metaindex_block_handle, index_block_handle;
+
+  // Write zstd dictionary block
+  if (ok() && !r->dictionary.empty()) {
+    WriteRawBlock(r->dictionary, kNoCompression, &dictionary_block_handle);
+  }
 
   // Write filter block
   if (ok() && r->filter_block != nullptr) {
@@ -224,9 +571,24 @@ Status TableBuilder::Finish() {
                   &filter_block_handle);
   }
 
+  // Write range tombstone block
+  if (ok() && r->num_range_tombstones > 0) {
+    WriteBlock(&r->range_del_block, &range_del_block_handle);
+  }
+
   // Write metaindex block
   if (ok()) {
-    BlockBuilder meta_index_block(&r->options);
+    // Meta block names are ordered bytewise, as Table looks them up.
+    Options meta_index_options = r->options;
+    meta_index_options.comparator = BytewiseComparator();
+    BlockBuilder meta_index_block(&meta_index_options);
+    if (!r->dictionary.empty()) {
+      // Add mapping from "compression_dict" to location of the dictionary.
+      // Meta block names must be added in sorted order.
+      std::string handle_encoding;
+      dictionary_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add("compression_dict", handle_encoding);
+    }
     if (r->filter_block != nullptr) {
       // Add mapping from "filter.Name" to location of filter data
       std::string key = "filter.";
@@ -235,6 +597,12 @@ Status TableBuilder::Finish() {
       filter_block_handle.EncodeTo(&handle_encoding);
       meta_index_block.Add(key, handle_encoding);
     }
+    if (r->num_range_tombstones > 0) {
+      // Add mapping from "rangedel" to location of the range tombstones
+      std::string handle_encoding;
+      range_del_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add("rangedel", handle_encoding);
+    }
 
     // TODO(postrelease): Add stats and other meta blocks
     WriteBlock(&meta_index_block, &metaindex_block_handle);
@@ -275,6 +643,11 @@ void TableBuilder::Abandon() {
 
 uint64_t TableBuilder::NumEntries() const { return rep_->num_entries; }
 
-uint64_t TableBuilder::FileSize() const { return rep_->offset; }
+uint64_t TableBuilder::FileSize() const {
+  // Count blocks that are still being compressed or held back for
+  // dictionary training at their raw size, so that callers splitting
+  // output files by size see the table grow.
+  return rep_->offset + rep_->pending_bytes;
+}
 
 }  // namespace leveldb
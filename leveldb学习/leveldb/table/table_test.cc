@@ -13,12 +13,15 @@
 #include "db/write_batch_internal.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
 #include "leveldb/table_builder.h"
 #include "table/block.h"
 #include "table/block_builder.h"
 #include "table/format.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
 #include "util/random.h"
 #include "util/testutil.h"
 
@@ -792,6 +795,10 @@ static bool CompressionSupported(CompressionType type) {
     return port::Snappy_Compress(in.data(), in.size(), &out);
   } else if (type == kZstdCompression) {
     return port::Zstd_Compress(/*level=*/1, in.data(), in.size(), &out);
+  } else if (type == kLZ4Compression) {
+    return port::Lz4_Compress(in.data(), in.size(), &out);
+  } else if (type == kLZ4HCCompression) {
+    return port::Lz4hc_Compress(in.data(), in.size(), &out);
   }
   return false;
 }
@@ -801,7 +808,8 @@ class CompressionTableTest
 
 INSTANTIATE_TEST_SUITE_P(CompressionTests, CompressionTableTest,
                          ::testing::Values(kSnappyCompression,
-                                           kZstdCompression));
+                                           kZstdCompression, kLZ4Compression,
+                                           kLZ4HCCompression));
 
 TEST_P(CompressionTableTest, ApproximateOffsetOfCompressed) {
   CompressionType type = ::testing::get<0>(GetParam());
@@ -839,4 +847,156 @@ TEST_P(CompressionTableTest, ApproximateOffsetOfCompressed) {
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 2 * min_z, 2 * max_z));
 }
 
+static std::string BuildTable(const Options& options, Random* rnd,
+                              int num_entries) {
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  std::string value;
+  char key[20];
+  for (int i = 0; i < num_entries; i++) {
+    std::snprintf(key, sizeof(key), "%016d", i);
+    test::CompressibleString(rnd, 0.5, 100, &value);
+    builder.Add(key, value);
+  }
+  EXPECT_LEVELDB_OK(builder.Finish());
+  EXPECT_EQ(sink.contents().size(), builder.FileSize());
+  return sink.contents();
+}
+
+TEST(TableTest, ParallelCompressionMatchesInline) {
+  const FilterPolicy* filter_policy = NewBloomFilterPolicy(10);
+  Options options;
+  options.block_size = 512;
+  options.filter_policy = filter_policy;
+
+  Random inline_rnd(301);
+  const std::string inline_contents = BuildTable(options, &inline_rnd, 10000);
+
+  options.compression_threads = 4;
+  Random parallel_rnd(301);
+  const std::string parallel_contents =
+      BuildTable(options, &parallel_rnd, 10000);
+
+  // Blocks are written in order, so the files must be byte-identical.
+  ASSERT_EQ(inline_contents, parallel_contents);
+
+  StringSource source(parallel_contents);
+  Table* table;
+  ASSERT_LEVELDB_OK(
+      Table::Open(options, &source, parallel_contents.size(), &table));
+  Iterator* iter = table->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_LEVELDB_OK(iter->status());
+  ASSERT_EQ(10000, count);
+  delete iter;
+  delete table;
+  delete filter_policy;
+}
+
+TEST(TableTest, Lz4CorruptedLengthIsRejected) {
+  if (!CompressionSupported(kLZ4Compression)) {
+    GTEST_SKIP() << "skipping lz4 corruption test";
+  }
+
+  std::string block;
+  const std::string raw(1000, 'x');
+  ASSERT_TRUE(port::Lz4_Compress(raw.data(), raw.size(), &block));
+  // Claim an uncompressed length far beyond what the payload can hold.
+  EncodeFixed32(&block[0], 0x7d000000);
+  const size_t block_size = block.size();
+  block.push_back(static_cast<char>(kLZ4Compression));
+  uint32_t crc = crc32c::Value(block.data(), block.size());
+  PutFixed32(&block, crc32c::Mask(crc));
+
+  StringSource source(block);
+  BlockHandle handle;
+  handle.set_offset(0);
+  handle.set_size(block_size);
+  BlockContents contents;
+  Status s = ReadBlock(&source, ReadOptions(), handle, &contents);
+  ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+}
+
+// Builds a table of small JSON-like records that share their structure
+// but little else, as is typical for document stores.
+static std::string BuildRecordTable(const Options& options, int num_entries) {
+  Random rnd(301);
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  char key[20];
+  char value[200];
+  for (int i = 0; i < num_entries; i++) {
+    std::snprintf(key, sizeof(key), "%016d", i);
+    std::snprintf(value, sizeof(value),
+                  "{\"user_id\": %u, \"name\": \"user%u\", \"country\": "
+                  "\"%s\", \"score\": %u, \"active\": %s}",
+                  rnd.Next(), rnd.Uniform(100000),
+                  rnd.OneIn(2) ? "NL" : "DE", rnd.Uniform(1000),
+                  rnd.OneIn(2) ? "true" : "false");
+    builder.Add(key, value);
+  }
+  EXPECT_LEVELDB_OK(builder.Finish());
+  return sink.contents();
+}
+
+TEST(TableTest, ZstdDictionaryCompression) {
+  if (!CompressionSupported(kZstdCompression)) {
+    GTEST_SKIP() << "skipping zstd dictionary test";
+  }
+
+  const int kNumEntries = 20000;
+  Options options;
+  options.compression = kZstdCompression;
+  const std::string plain_contents = BuildRecordTable(options, kNumEntries);
+
+  options.zstd_dictionary_size = 16 * 1024;
+  options.zstd_dictionary_training_bytes = 256 * 1024;
+  for (int threads : {0, 4}) {
+    options.compression_threads = threads;
+    const std::string dict_contents = BuildRecordTable(options, kNumEntries);
+    ASSERT_LT(dict_contents.size(), plain_contents.size() * 9 / 10);
+
+    StringSource source(dict_contents);
+    Table* table;
+    ASSERT_LEVELDB_OK(
+        Table::Open(options, &source, dict_contents.size(), &table));
+    ReadOptions read_options;
+    read_options.verify_checksums = true;
+    Iterator* iter = table->NewIterator(read_options);
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      ASSERT_EQ('{', iter->value()[0]);
+      count++;
+    }
+    ASSERT_LEVELDB_OK(iter->status());
+    ASSERT_EQ(kNumEntries, count);
+    delete iter;
+    delete table;
+  }
+}
+
+TEST(TableTest, FileSizeCountsBufferedBlocks) {
+  Options options;
+  options.compression = kZstdCompression;
+  options.zstd_dictionary_size = 16 * 1024;
+  options.zstd_dictionary_training_bytes = 1024 * 1024;
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  std::string value(100, 'x');
+  char key[20];
+  for (int i = 0; i < 2000; i++) {
+    std::snprintf(key, sizeof(key), "%016d", i);
+    builder.Add(key, value);
+  }
+  // Nothing has been written while the dictionary samples are collected,
+  // but the buffered blocks must still count towards the size.
+  ASSERT_EQ(0, sink.contents().size());
+  ASSERT_GE(builder.FileSize(), 2000 * value.size());
+  ASSERT_LEVELDB_OK(builder.Finish());
+  ASSERT_EQ(sink.contents().size(), builder.FileSize());
+}
+
 }  // namespace leveldb
@@ -168,6 +168,10 @@ class LRUCache {
     MutexLock l(&mutex_);
     return usage_;
   }
+  size_t TotalPinnedCharge() const {
+    MutexLock l(&mutex_);
+    return pinned_usage_;
+  }
 
  private:
   void LRU_Remove(LRUHandle* e);
@@ -182,6 +186,7 @@ class LRUCache {
   // mutex_ protects the following state.
   mutable port::Mutex mutex_;
   size_t usage_ GUARDED_BY(mutex_);
+  size_t pinned_usage_ GUARDED_BY(mutex_);  // Charge of the in_use_ entries
 
   // Dummy head of LRU list.
   // lru.prev is newest entry, lru.next is oldest entry.
@@ -195,7 +200,7 @@ class LRUCache {
   HandleTable table_ GUARDED_BY(mutex_);
 };
 
-LRUCache::LRUCache() : capacity_(0), usage_(0) {
+LRUCache::LRUCache() : capacity_(0), usage_(0), pinned_usage_(0) {
   // Make empty circular linked lists.
   lru_.next = &lru_;
   lru_.prev = &lru_;
@@ -219,6 +224,7 @@ void LRUCache::Ref(LRUHandle* e) {
   if (e->refs == 1 && e->in_cache) {  // If on lru_ list, move to in_use_ list.
     LRU_Remove(e);
     LRU_Append(&in_use_, e);
+    pinned_usage_ += e->charge;
   }
   e->refs++;
 }
@@ -234,6 +240,7 @@ void LRUCache::Unref(LRUHandle* e) {
     // No longer in use; move to lru_ list.
     LRU_Remove(e);
     LRU_Append(&lru_, e);
+    pinned_usage_ -= e->charge;
   }
 }
 
@@ -286,6 +293,7 @@ Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
     e->in_cache = true;
     LRU_Append(&in_use_, e);
     usage_ += charge;
+    pinned_usage_ += charge;
     FinishErase(table_.Insert(e));
   } else {  // don't cache. (capacity_==0 is supported and turns off caching.)
     // next is read by key() in an assert, so it must be initialized
@@ -311,6 +319,9 @@ bool LRUCache::FinishErase(LRUHandle* e) {
     LRU_Remove(e);
     e->in_cache = false;
     usage_ -= e->charge;
+    if (e->refs > 1) {  // Was on the in_use_ list
+      pinned_usage_ -= e->charge;
+    }
     Unref(e);
   }
   return e != nullptr;
@@ -392,6 +403,13 @@ class ShardedLRUCache : public Cache {
     }
     return total;
   }
+  size_t TotalPinnedCharge() const override {
+    size_t total = 0;
+    for (int s = 0; s < kNumShards; s++) {
+      total += shard_[s].TotalPinnedCharge();
+    }
+    return total;
+  }
 };
 
 }  // end anonymous namespace
@@ -213,6 +213,26 @@ TEST_F(CacheTest, Prune) {
   ASSERT_EQ(-1, Lookup(2));
 }
 
+TEST_F(CacheTest, PinnedCharge) {
+  Insert(1, 101, 10);
+  ASSERT_EQ(0, cache_->TotalPinnedCharge());
+
+  Cache::Handle* h1 = cache_->Lookup(EncodeKey(1));
+  Cache::Handle* h2 = InsertAndReturnHandle(2, 102, 20);
+  ASSERT_EQ(30, cache_->TotalPinnedCharge());
+  ASSERT_EQ(30, cache_->TotalCharge());
+
+  // An erased entry no longer counts, though its handle is outstanding.
+  Erase(1);
+  ASSERT_EQ(20, cache_->TotalPinnedCharge());
+  ASSERT_EQ(20, cache_->TotalCharge());
+  cache_->Release(h1);
+
+  cache_->Release(h2);
+  ASSERT_EQ(0, cache_->TotalPinnedCharge());
+  ASSERT_EQ(20, cache_->TotalCharge());
+}
+
 TEST_F(CacheTest, ZeroSizeCache) {
   delete cache_;
   cache_ = NewLRUCache(0);
@@ -0,0 +1,51 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/compaction_filter.h"
+
+#include "leveldb/env.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+CompactionFilter::~CompactionFilter() = default;
+
+namespace {
+
+class TTLCompactionFilter : public CompactionFilter {
+ public:
+  TTLCompactionFilter(Env* env, uint64_t ttl_seconds)
+      : env_(env), ttl_seconds_(ttl_seconds) {}
+
+  const char* Name() const override { return "leveldb.TTLCompactionFilter"; }
+
+  Decision Filter(int /*level*/, const Slice& /*key*/,
+                  const Slice& existing_value,
+                  std::string* /*new_value*/) const override {
+    if (existing_value.size() < kTTLTimestampSize) {
+      return kKeep;
+    }
+    const uint64_t written = DecodeFixed64(
+        existing_value.data() + existing_value.size() - kTTLTimestampSize);
+    const uint64_t now = env_->NowMicros() / 1000000;
+    if (now > written && now - written > ttl_seconds_) {
+      return kRemove;
+    }
+    return kKeep;
+  }
+
+ private:
+  Env* const env_;
+  const uint64_t ttl_seconds_;
+};
+
+}  // namespace
+
+const CompactionFilter* NewTTLCompactionFilter(Env* env,
+                                               uint64_t ttl_seconds) {
+  return new TTLCompactionFilter(env, ttl_seconds);
+}
+
+}  // namespace leveldb
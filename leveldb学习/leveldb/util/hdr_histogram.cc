@@ -0,0 +1,171 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/hdr_histogram.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+namespace leveldb {
+
+HdrBuckets::HdrBuckets(int precision, int max_bits)
+    : precision_(precision),
+      max_bits_(max_bits),
+      size_((max_bits + 1 - precision) << precision),
+      max_value_((uint64_t{1} << max_bits) - 1) {
+  assert(1 <= precision && precision < max_bits && max_bits <= 63);
+}
+
+// Buckets below 2^(precision+1) hold one value each.  Above that, bucket
+// (shift + 1) * 2^precision + j holds 2^shift values starting at
+// (2^precision + j) << shift.
+uint64_t HdrBuckets::LowerBound(int index) const {
+  const int shift = std::max((index >> precision_) - 1, 0);
+  const uint64_t mantissa = index - (shift << precision_);
+  return mantissa << shift;
+}
+
+uint64_t HdrBuckets::UpperBound(int index) const {
+  const int shift = std::max((index >> precision_) - 1, 0);
+  const uint64_t mantissa = index - (shift << precision_);
+  return (mantissa + 1) << shift;
+}
+
+double HdrBuckets::Percentile(const uint64_t* buckets, uint64_t total,
+                              uint64_t min, uint64_t max, double p) const {
+  if (total == 0) {
+    return 0;
+  }
+  const double threshold = total * (p / 100.0);
+  double sum = 0;
+  for (int b = 0; b < size_; b++) {
+    if (buckets[b] == 0) {
+      continue;
+    }
+    sum += buckets[b];
+    if (sum >= threshold) {
+      // Scale linearly within this bucket
+      const double left_point = static_cast<double>(LowerBound(b));
+      const double right_point = static_cast<double>(UpperBound(b));
+      const double left_sum = sum - buckets[b];
+      const double pos = (threshold - left_sum) / buckets[b];
+      double r = left_point + (right_point - left_point) * pos;
+      if (r < min) r = min;
+      if (r > max) r = max;
+      return r;
+    }
+  }
+  return max;
+}
+
+HdrHistogram::HdrHistogram(int precision, int max_bits)
+    : layout_(precision, max_bits), buckets_(layout_.size()) {
+  Clear();
+}
+
+void HdrHistogram::Clear() {
+  std::fill(buckets_.begin(), buckets_.end(), 0);
+  count_ = 0;
+  min_ = std::numeric_limits<uint64_t>::max();
+  max_ = 0;
+  sum_ = 0;
+  sum_squares_ = 0;
+}
+
+void HdrHistogram::Add(uint64_t value) {
+  buckets_[layout_.Index(value)]++;
+  count_++;
+  if (value < min_) min_ = value;
+  if (value > max_) max_ = value;
+  const double v = static_cast<double>(value);
+  sum_ += v;
+  sum_squares_ += v * v;
+}
+
+void HdrHistogram::Merge(const HdrHistogram& other) {
+  assert(layout_.precision() == other.layout_.precision() &&
+         layout_.max_bits() == other.layout_.max_bits());
+  for (size_t b = 0; b < buckets_.size(); b++) {
+    buckets_[b] += other.buckets_[b];
+  }
+  count_ += other.count_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+  sum_ += other.sum_;
+  sum_squares_ += other.sum_squares_;
+}
+
+double HdrHistogram::Average() const {
+  if (count_ == 0) return 0;
+  return sum_ / count_;
+}
+
+double HdrHistogram::StandardDeviation() const {
+  if (count_ == 0) return 0;
+  const double n = static_cast<double>(count_);
+  const double variance = (sum_squares_ * n - sum_ * sum_) / (n * n);
+  return variance > 0 ? std::sqrt(variance) : 0;
+}
+
+double HdrHistogram::Percentile(double p) const {
+  return layout_.Percentile(buckets_.data(), count_, Min(), max_, p);
+}
+
+std::string HdrHistogram::ToString() const {
+  std::string r;
+  char buf[200];
+  std::snprintf(buf, sizeof(buf),
+                "Count: %llu  Average: %.4f  StdDev: %.2f\n",
+                static_cast<unsigned long long>(count_), Average(),
+                StandardDeviation());
+  r.append(buf);
+  std::snprintf(buf, sizeof(buf), "Min: %llu  Median: %.4f  Max: %llu\n",
+                static_cast<unsigned long long>(Min()), Median(),
+                static_cast<unsigned long long>(max_));
+  r.append(buf);
+  std::snprintf(buf, sizeof(buf),
+                "Percentiles: P50: %.2f P75: %.2f P99: %.2f P99.9: %.2f "
+                "P99.99: %.2f\n",
+                Percentile(50), Percentile(75), Percentile(99),
+                Percentile(99.9), Percentile(99.99));
+  r.append(buf);
+  r.append("------------------------------------------------------\n");
+  if (count_ == 0) return r;
+
+  // One row for zero and one for each power of two [2^k, 2^(k+1)).
+  const double mult = 100.0 / count_;
+  double cumulative = 0;
+  int b = 0;
+  while (b < layout_.size()) {
+    const uint64_t left = layout_.LowerBound(b);
+    uint64_t right = left == 0 ? 1 : left * 2;
+    uint64_t count = 0;
+    while (b < layout_.size() && layout_.LowerBound(b) < right) {
+      count += buckets_[b];
+      b++;
+    }
+    right = layout_.UpperBound(b - 1);
+    if (count == 0) continue;
+    cumulative += count;
+    std::snprintf(buf, sizeof(buf),
+                  "[ %11llu, %11llu ) %7llu %7.3f%% %7.3f%% ",
+                  static_cast<unsigned long long>(left),
+                  static_cast<unsigned long long>(right),
+                  static_cast<unsigned long long>(count), mult * count,
+                  mult * cumulative);
+    r.append(buf);
+
+    // Add hash marks based on percentage; 20 marks for 100%.
+    int marks = static_cast<int>(20 * (count / static_cast<double>(count_)) +
+                                 0.5);
+    r.append(marks, '#');
+    r.push_back('\n');
+  }
+  return r;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,111 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A histogram of non-negative integers with log-linear buckets, in the
+// manner of HdrHistogram.  Values below 2^precision get a bucket each, and
+// every larger power of two is split into 2^precision equal buckets, so
+// that the bucket of a value is found in constant time and any value read
+// back from a bucket is within a relative error of 2^-precision.
+
+#ifndef STORAGE_LEVELDB_UTIL_HDR_HISTOGRAM_H_
+#define STORAGE_LEVELDB_UTIL_HDR_HISTOGRAM_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace leveldb {
+
+// The bucket boundaries of a histogram, for callers that keep the bucket
+// counts themselves (for instance in atomics).
+class HdrBuckets {
+ public:
+  // Values of 2^max_bits and more are counted as 2^max_bits - 1.
+  // REQUIRES: 1 <= precision < max_bits <= 63
+  HdrBuckets(int precision, int max_bits);
+
+  int precision() const { return precision_; }
+  int max_bits() const { return max_bits_; }
+
+  // Number of buckets.
+  int size() const { return size_; }
+
+  // Return the bucket that counts "value".
+  int Index(uint64_t value) const {
+    if (value > max_value_) value = max_value_;
+    const int msb = MostSignificantBit(value | 1);
+    const int shift = msb > precision_ ? msb - precision_ : 0;
+    return (shift << precision_) + static_cast<int>(value >> shift);
+  }
+
+  // The values counted by bucket "index" are [LowerBound, UpperBound).
+  uint64_t LowerBound(int index) const;
+  uint64_t UpperBound(int index) const;
+
+  // Interpolate the "p"th percentile (0 <= p <= 100) of "total" values
+  // spread over buckets[0, size()) whose extremes are min and max.
+  double Percentile(const uint64_t* buckets, uint64_t total, uint64_t min,
+                    uint64_t max, double p) const;
+
+ private:
+  // REQUIRES: v != 0
+  static int MostSignificantBit(uint64_t v) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+  }
+
+  int precision_;
+  int max_bits_;
+  int size_;
+  uint64_t max_value_;
+};
+
+// Not thread-safe.  Threads should each record into their own instance and
+// Merge() the instances for reading.
+class HdrHistogram {
+ public:
+  // With the defaults, values up to about 12 days in microseconds are
+  // kept within 1% in about 35KB.
+  explicit HdrHistogram(int precision = 7, int max_bits = 40);
+
+  void Clear();
+  void Add(uint64_t value);
+
+  // REQUIRES: "other" was built with the same precision and max_bits.
+  void Merge(const HdrHistogram& other);
+
+  uint64_t Count() const { return count_; }
+  uint64_t Min() const { return count_ == 0 ? 0 : min_; }
+  uint64_t Max() const { return max_; }
+  double Average() const;
+  double StandardDeviation() const;
+  double Median() const { return Percentile(50.0); }
+  double Percentile(double p) const;
+
+  // A summary with the common percentiles, followed by the bucket counts
+  // of each power of two.
+  std::string ToString() const;
+
+ private:
+  HdrBuckets layout_;
+  std::vector<uint64_t> buckets_;
+  uint64_t count_;
+  uint64_t min_;
+  uint64_t max_;
+  double sum_;
+  double sum_squares_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_HDR_HISTOGRAM_H_
@@ -0,0 +1,138 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/hdr_histogram.h"
+
+#include <cstdint>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+TEST(HdrBucketsTest, Layout) {
+  for (int precision = 1; precision <= 8; precision++) {
+    HdrBuckets layout(precision, 40);
+    ASSERT_EQ((41 - precision) << precision, layout.size());
+
+    // The buckets tile [0, 2^40) without gaps.
+    uint64_t expected_lower = 0;
+    for (int b = 0; b < layout.size(); b++) {
+      ASSERT_EQ(expected_lower, layout.LowerBound(b)) << b;
+      ASSERT_LT(layout.LowerBound(b), layout.UpperBound(b));
+      ASSERT_EQ(b, layout.Index(layout.LowerBound(b)));
+      ASSERT_EQ(b, layout.Index(layout.UpperBound(b) - 1));
+      expected_lower = layout.UpperBound(b);
+    }
+    ASSERT_EQ(uint64_t{1} << 40, expected_lower);
+  }
+}
+
+TEST(HdrBucketsTest, RelativeError) {
+  const int kPrecision = 7;
+  HdrBuckets layout(kPrecision, 40);
+  Random rnd(301);
+  for (int i = 0; i < 100000; i++) {
+    const uint64_t value =
+        (uint64_t{rnd.Next()} << rnd.Uniform(9)) + (1 << kPrecision);
+    const int b = layout.Index(value);
+    ASSERT_LE(layout.LowerBound(b), value);
+    ASSERT_LT(value, layout.UpperBound(b));
+    const double width = layout.UpperBound(b) - layout.LowerBound(b);
+    ASSERT_LE(width / value, 1.0 / (1 << kPrecision)) << value;
+  }
+}
+
+TEST(HdrBucketsTest, LargeValuesAreClamped) {
+  HdrBuckets layout(5, 20);
+  ASSERT_EQ(layout.size() - 1, layout.Index(uint64_t{1} << 20));
+  ASSERT_EQ(layout.size() - 1, layout.Index(~uint64_t{0}));
+}
+
+TEST(HdrHistogramTest, Empty) {
+  HdrHistogram hist;
+  ASSERT_EQ(0, hist.Count());
+  ASSERT_EQ(0, hist.Min());
+  ASSERT_EQ(0, hist.Max());
+  ASSERT_EQ(0, hist.Average());
+  ASSERT_EQ(0, hist.Percentile(99));
+}
+
+TEST(HdrHistogramTest, Percentiles) {
+  HdrHistogram hist;
+  for (uint64_t i = 1; i <= 100000; i++) {
+    hist.Add(i);
+  }
+  ASSERT_EQ(100000, hist.Count());
+  ASSERT_EQ(1, hist.Min());
+  ASSERT_EQ(100000, hist.Max());
+  ASSERT_DOUBLE_EQ(50000.5, hist.Average());
+  ASSERT_NEAR(50000, hist.Median(), 50000 / 128.0);
+  ASSERT_NEAR(99000, hist.Percentile(99), 99000 / 128.0);
+  ASSERT_NEAR(99900, hist.Percentile(99.9), 99900 / 128.0);
+  ASSERT_NEAR(99990, hist.Percentile(99.99), 99990 / 128.0);
+  ASSERT_EQ(1, hist.Percentile(0));
+  ASSERT_EQ(100000, hist.Percentile(100));
+}
+
+TEST(HdrHistogramTest, TailOfSkewedValues) {
+  // Five slow operations in ten thousand show up in P99.99 but not P99.9.
+  HdrHistogram hist;
+  for (int i = 0; i < 9995; i++) {
+    hist.Add(10);
+  }
+  for (int i = 0; i < 5; i++) {
+    hist.Add(3000000);
+  }
+  ASSERT_NEAR(10, hist.Percentile(99.9), 1);
+  ASSERT_NEAR(3000000, hist.Percentile(99.99), 3000000 / 128.0);
+}
+
+TEST(HdrHistogramTest, Merge) {
+  HdrHistogram a;
+  HdrHistogram b;
+  HdrHistogram both;
+  Random rnd(42);
+  for (int i = 0; i < 10000; i++) {
+    const uint64_t value = rnd.Uniform(1 << 20);
+    (i % 3 == 0 ? a : b).Add(value);
+    both.Add(value);
+  }
+  a.Merge(b);
+  ASSERT_EQ(both.Count(), a.Count());
+  ASSERT_EQ(both.Min(), a.Min());
+  ASSERT_EQ(both.Max(), a.Max());
+  for (double p : {50.0, 90.0, 99.0, 99.9}) {
+    ASSERT_EQ(both.Percentile(p), a.Percentile(p));
+  }
+  ASSERT_EQ(both.ToString(), a.ToString());
+}
+
+TEST(HdrHistogramTest, Clear) {
+  HdrHistogram hist;
+  hist.Add(100);
+  hist.Clear();
+  ASSERT_EQ(0, hist.Count());
+  hist.Add(7);
+  ASSERT_EQ(7, hist.Min());
+  ASSERT_EQ(7, hist.Max());
+  ASSERT_EQ(7, hist.Median());
+}
+
+TEST(HdrHistogramTest, ToString) {
+  HdrHistogram hist;
+  hist.Add(0);
+  hist.Add(5);
+  hist.Add(1000);
+  const std::string s = hist.ToString();
+  ASSERT_NE(std::string::npos, s.find("Count: 3"));
+  ASSERT_NE(std::string::npos, s.find("P99.99:"));
+  // Rows are powers of two: [0, 1), [4, 8) and [512, 1024).
+  ASSERT_NE(std::string::npos, s.find("[           0,           1 )"));
+  ASSERT_NE(std::string::npos, s.find("[           4,           8 )"));
+  ASSERT_NE(std::string::npos, s.find("[         512,        1024 )"));
+}
+
+}  // namespace leveldb
@@ -0,0 +1,82 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/perf_context.h"
+
+#include <cstdio>
+
+#include "util/perf_context_imp.h"
+
+namespace leveldb {
+
+thread_local PerfLevel perf_level = kPerfDisable;
+thread_local PerfContext perf_context;
+thread_local IOStatsContext iostats_context;
+
+void SetPerfLevel(PerfLevel level) { perf_level = level; }
+
+PerfLevel GetPerfLevel() { return perf_level; }
+
+PerfContext* GetPerfContext() { return &perf_context; }
+
+IOStatsContext* GetIOStatsContext() { return &iostats_context; }
+
+namespace {
+
+void AppendField(std::string* r, const char* name, uint64_t value,
+                 bool exclude_zero_counters) {
+  if (value == 0 && exclude_zero_counters) {
+    return;
+  }
+  char buf[100];
+  std::snprintf(buf, sizeof(buf), "%s%s = %llu", r->empty() ? "" : ", ", name,
+                static_cast<unsigned long long>(value));
+  r->append(buf);
+}
+
+}  // namespace
+
+void PerfContext::Reset() { *this = PerfContext(); }
+
+std::string PerfContext::ToString(bool exclude_zero_counters) const {
+  std::string r;
+#define LEVELDB_PERF_FIELD(name) \
+  AppendField(&r, #name, name, exclude_zero_counters)
+  LEVELDB_PERF_FIELD(db_mutex_lock_nanos);
+  LEVELDB_PERF_FIELD(get_from_memtable_count);
+  LEVELDB_PERF_FIELD(get_from_memtable_nanos);
+  LEVELDB_PERF_FIELD(get_from_output_files_nanos);
+  LEVELDB_PERF_FIELD(get_from_table_count);
+  LEVELDB_PERF_FIELD(find_table_nanos);
+  LEVELDB_PERF_FIELD(bloom_sst_hit_count);
+  LEVELDB_PERF_FIELD(bloom_sst_miss_count);
+  LEVELDB_PERF_FIELD(index_seek_nanos);
+  LEVELDB_PERF_FIELD(block_cache_hit_count);
+  LEVELDB_PERF_FIELD(block_read_count);
+  LEVELDB_PERF_FIELD(block_read_byte);
+  LEVELDB_PERF_FIELD(block_read_nanos);
+  LEVELDB_PERF_FIELD(block_checksum_nanos);
+  LEVELDB_PERF_FIELD(block_decompress_nanos);
+  LEVELDB_PERF_FIELD(internal_key_skipped_count);
+  LEVELDB_PERF_FIELD(internal_delete_skipped_count);
+  LEVELDB_PERF_FIELD(seek_internal_seek_nanos);
+  LEVELDB_PERF_FIELD(write_wal_nanos);
+  LEVELDB_PERF_FIELD(write_memtable_nanos);
+  return r;
+}
+
+void IOStatsContext::Reset() { *this = IOStatsContext(); }
+
+std::string IOStatsContext::ToString(bool exclude_zero_counters) const {
+  std::string r;
+  LEVELDB_PERF_FIELD(bytes_read);
+  LEVELDB_PERF_FIELD(bytes_written);
+  LEVELDB_PERF_FIELD(read_nanos);
+  LEVELDB_PERF_FIELD(write_nanos);
+  LEVELDB_PERF_FIELD(fsync_nanos);
+#undef LEVELDB_PERF_FIELD
+  return r;
+}
+
+}  // namespace leveldb
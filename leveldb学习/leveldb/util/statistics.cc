@@ -0,0 +1,260 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/statistics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <thread>
+
+#include "port/port.h"
+#include "util/hdr_histogram.h"
+
+namespace leveldb {
+
+const char* TickerName(Ticker ticker) {
+  switch (ticker) {
+    case kBlockCacheDataHit:
+      return "leveldb.block.cache.data.hit";
+    case kBlockCacheDataMiss:
+      return "leveldb.block.cache.data.miss";
+    case kTableCacheHit:
+      return "leveldb.table.cache.hit";
+    case kTableCacheMiss:
+      return "leveldb.table.cache.miss";
+    case kBloomFilterChecked:
+      return "leveldb.bloom.filter.checked";
+    case kBloomFilterUseful:
+      return "leveldb.bloom.filter.useful";
+    case kKeysRead:
+      return "leveldb.keys.read";
+    case kBytesRead:
+      return "leveldb.bytes.read";
+    case kKeysWritten:
+      return "leveldb.keys.written";
+    case kBytesWritten:
+      return "leveldb.bytes.written";
+    case kFlushBytesWritten:
+      return "leveldb.flush.bytes.written";
+    case kCompactionBytesRead:
+      return "leveldb.compaction.bytes.read";
+    case kCompactionBytesWritten:
+      return "leveldb.compaction.bytes.written";
+    case kStallMicros:
+      return "leveldb.stall.micros";
+    case kTickerCount:
+      break;
+  }
+  return "leveldb.unknown";
+}
+
+const char* HistogramName(HistogramType type) {
+  switch (type) {
+    case kGetMicros:
+      return "leveldb.get.micros";
+    case kWriteMicros:
+      return "leveldb.write.micros";
+    case kSeekMicros:
+      return "leveldb.seek.micros";
+    case kFlushMicros:
+      return "leveldb.flush.micros";
+    case kCompactionMicros:
+      return "leveldb.compaction.micros";
+    case kHistogramCount:
+      break;
+  }
+  return "leveldb.unknown";
+}
+
+Statistics::~Statistics() = default;
+
+std::string Statistics::ToString() const {
+  std::string r;
+  char buf[200];
+  for (int t = 0; t < kTickerCount; t++) {
+    std::snprintf(buf, sizeof(buf), "%s COUNT : %llu\n",
+                  TickerName(static_cast<Ticker>(t)),
+                  static_cast<unsigned long long>(
+                      GetTickerCount(static_cast<Ticker>(t))));
+    r.append(buf);
+  }
+  for (int h = 0; h < kHistogramCount; h++) {
+    HistogramData data;
+    GetHistogramData(static_cast<HistogramType>(h), &data);
+    std::snprintf(buf, sizeof(buf),
+                  "%s P50 : %.2f P95 : %.2f P99 : %.2f P99.9 : %.2f "
+                  "MAX : %llu COUNT : %llu SUM : %llu\n",
+                  HistogramName(static_cast<HistogramType>(h)), data.median,
+                  data.percentile95, data.percentile99, data.percentile999,
+                  static_cast<unsigned long long>(data.max),
+                  static_cast<unsigned long long>(data.count),
+                  static_cast<unsigned long long>(data.sum));
+    r.append(buf);
+  }
+  return r;
+}
+
+namespace {
+
+// Stripe index for threads on platforms that cannot tell which CPU a
+// thread runs on: each thread keeps using the stripe it was first given.
+uint32_t ThreadStripeIndex() {
+  static std::atomic<uint32_t> next_index(0);
+  thread_local uint32_t index =
+      next_index.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+
+// Histograms keep microseconds up to about 19 hours within 1/32 (3%) in
+// 1024 buckets.
+const int kHistogramPrecision = 5;
+const int kHistogramMaxBits = 36;
+const int kHistogramBuckets = (kHistogramMaxBits + 1 - kHistogramPrecision)
+                              << kHistogramPrecision;
+
+const HdrBuckets& HistogramLayout() {
+  static const HdrBuckets layout(kHistogramPrecision, kHistogramMaxBits);
+  return layout;
+}
+
+class StripedStatistics : public Statistics {
+ public:
+  StripedStatistics() : num_stripes_(1) {
+    const unsigned int cpus = std::thread::hardware_concurrency();
+    while (num_stripes_ < cpus && num_stripes_ < kMaxStripes) {
+      num_stripes_ *= 2;
+    }
+    stripes_ = new Stripe[num_stripes_];
+    Reset();
+  }
+
+  ~StripedStatistics() override { delete[] stripes_; }
+
+  void RecordTick(Ticker ticker, uint64_t count) override {
+    CurrentStripe()->tickers[ticker].fetch_add(count,
+                                               std::memory_order_relaxed);
+  }
+
+  void MeasureTime(HistogramType type, uint64_t micros) override {
+    StripeHistogram* h = &CurrentStripe()->histograms[type];
+    h->count.fetch_add(1, std::memory_order_relaxed);
+    h->sum.fetch_add(micros, std::memory_order_relaxed);
+    h->sum_squares.fetch_add(micros * micros, std::memory_order_relaxed);
+    h->buckets[HistogramLayout().Index(micros)].fetch_add(
+        1, std::memory_order_relaxed);
+    uint64_t min = h->min.load(std::memory_order_relaxed);
+    while (micros < min && !h->min.compare_exchange_weak(
+                               min, micros, std::memory_order_relaxed)) {
+    }
+    uint64_t max = h->max.load(std::memory_order_relaxed);
+    while (micros > max && !h->max.compare_exchange_weak(
+                               max, micros, std::memory_order_relaxed)) {
+    }
+  }
+
+  uint64_t GetTickerCount(Ticker ticker) const override {
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < num_stripes_; i++) {
+      count += stripes_[i].tickers[ticker].load(std::memory_order_relaxed);
+    }
+    return count;
+  }
+
+  void GetHistogramData(HistogramType type,
+                        HistogramData* data) const override {
+    *data = HistogramData();
+    uint64_t sum_squares = 0;
+    uint64_t min = std::numeric_limits<uint64_t>::max();
+    uint64_t buckets[kHistogramBuckets] = {0};
+    for (uint32_t i = 0; i < num_stripes_; i++) {
+      const StripeHistogram& h = stripes_[i].histograms[type];
+      data->count += h.count.load(std::memory_order_relaxed);
+      data->sum += h.sum.load(std::memory_order_relaxed);
+      sum_squares += h.sum_squares.load(std::memory_order_relaxed);
+      min = std::min(min, h.min.load(std::memory_order_relaxed));
+      data->max = std::max(data->max, h.max.load(std::memory_order_relaxed));
+      for (int b = 0; b < kHistogramBuckets; b++) {
+        buckets[b] += h.buckets[b].load(std::memory_order_relaxed);
+      }
+    }
+    if (data->count == 0) {
+      return;
+    }
+    data->min = min;
+    const double num = static_cast<double>(data->count);
+    const double sum = static_cast<double>(data->sum);
+    data->average = sum / num;
+    const double variance =
+        (static_cast<double>(sum_squares) * num - sum * sum) / (num * num);
+    data->standard_deviation = variance > 0 ? std::sqrt(variance) : 0;
+    const HdrBuckets& layout = HistogramLayout();
+    data->median = layout.Percentile(buckets, data->count, min, data->max, 50);
+    data->percentile95 =
+        layout.Percentile(buckets, data->count, min, data->max, 95);
+    data->percentile99 =
+        layout.Percentile(buckets, data->count, min, data->max, 99);
+    data->percentile999 =
+        layout.Percentile(buckets, data->count, min, data->max, 99.9);
+  }
+
+  void Reset() override {
+    for (uint32_t i = 0; i < num_stripes_; i++) {
+      Stripe* stripe = &stripes_[i];
+      for (int t = 0; t < kTickerCount; t++) {
+        stripe->tickers[t].store(0, std::memory_order_relaxed);
+      }
+      for (int type = 0; type < kHistogramCount; type++) {
+        StripeHistogram* h = &stripe->histograms[type];
+        h->count.store(0, std::memory_order_relaxed);
+        h->sum.store(0, std::memory_order_relaxed);
+        h->sum_squares.store(0, std::memory_order_relaxed);
+        h->min.store(std::numeric_limits<uint64_t>::max(),
+                     std::memory_order_relaxed);
+        h->max.store(0, std::memory_order_relaxed);
+        for (int b = 0; b < kHistogramBuckets; b++) {
+          h->buckets[b].store(0, std::memory_order_relaxed);
+        }
+      }
+    }
+  }
+
+ private:
+  static const uint32_t kMaxStripes = 64;
+
+  struct StripeHistogram {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> sum_squares;
+    std::atomic<uint64_t> min;
+    std::atomic<uint64_t> max;
+    std::atomic<uint64_t> buckets[kHistogramBuckets];
+  };
+
+  struct Stripe {
+    std::atomic<uint64_t> tickers[kTickerCount];
+    StripeHistogram histograms[kHistogramCount];
+    // Keeps the counters of neighboring stripes off each other's cache
+    // lines.
+    char padding[64];
+  };
+
+  Stripe* CurrentStripe() const {
+    const int cpu = port::PhysicalCoreID();
+    const uint32_t index =
+        (cpu >= 0 ? static_cast<uint32_t>(cpu) : ThreadStripeIndex());
+    return &stripes_[index & (num_stripes_ - 1)];
+  }
+
+  uint32_t num_stripes_;  // A power of two
+  Stripe* stripes_;
+};
+
+}  // namespace
+
+Statistics* NewStatistics() { return new StripedStatistics(); }
+
+}  // namespace leveldb
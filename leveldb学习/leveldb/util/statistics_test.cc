@@ -0,0 +1,118 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/statistics.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace leveldb {
+
+TEST(StatisticsTest, Empty) {
+  std::unique_ptr<Statistics> stats(NewStatistics());
+  for (int t = 0; t < kTickerCount; t++) {
+    ASSERT_EQ(0, stats->GetTickerCount(static_cast<Ticker>(t)));
+  }
+  HistogramData data;
+  stats->GetHistogramData(kGetMicros, &data);
+  ASSERT_EQ(0, data.count);
+  ASSERT_EQ(0, data.min);
+  ASSERT_EQ(0, data.max);
+  ASSERT_EQ(0, data.median);
+}
+
+TEST(StatisticsTest, TickersFromManyThreads) {
+  std::unique_ptr<Statistics> stats(NewStatistics());
+  const int kThreads = 8;
+  const int kIterations = 10000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; i++) {
+    threads.emplace_back([&stats]() {
+      for (int j = 0; j < kIterations; j++) {
+        stats->RecordTick(kKeysRead, 1);
+        stats->RecordTick(kBytesRead, 10);
+        stats->MeasureTime(kGetMicros, j % 100);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(kThreads * kIterations, stats->GetTickerCount(kKeysRead));
+  ASSERT_EQ(kThreads * kIterations * 10, stats->GetTickerCount(kBytesRead));
+  ASSERT_EQ(0, stats->GetTickerCount(kKeysWritten));
+
+  HistogramData data;
+  stats->GetHistogramData(kGetMicros, &data);
+  ASSERT_EQ(kThreads * kIterations, data.count);
+  ASSERT_EQ(0, data.min);
+  ASSERT_EQ(99, data.max);
+}
+
+TEST(StatisticsTest, Histogram) {
+  std::unique_ptr<Statistics> stats(NewStatistics());
+  for (int i = 1; i <= 100; i++) {
+    stats->MeasureTime(kWriteMicros, i);
+  }
+  HistogramData data;
+  stats->GetHistogramData(kWriteMicros, &data);
+  ASSERT_EQ(100, data.count);
+  ASSERT_EQ(5050, data.sum);
+  ASSERT_EQ(1, data.min);
+  ASSERT_EQ(100, data.max);
+  ASSERT_DOUBLE_EQ(50.5, data.average);
+  ASSERT_NEAR(28.87, data.standard_deviation, 0.01);
+  // The buckets below 10 hold a single value each, and wider ones above.
+  ASSERT_NEAR(50, data.median, 5);
+  ASSERT_NEAR(95, data.percentile95, 5);
+  ASSERT_NEAR(99, data.percentile99, 5);
+  ASSERT_LE(data.median, data.percentile95);
+  ASSERT_LE(data.percentile95, data.percentile99);
+  ASSERT_LE(data.percentile99, data.max);
+
+  // Other histograms are unaffected.
+  stats->GetHistogramData(kGetMicros, &data);
+  ASSERT_EQ(0, data.count);
+}
+
+TEST(StatisticsTest, Reset) {
+  std::unique_ptr<Statistics> stats(NewStatistics());
+  stats->RecordTick(kStallMicros, 42);
+  stats->MeasureTime(kSeekMicros, 1000);
+  stats->Reset();
+  ASSERT_EQ(0, stats->GetTickerCount(kStallMicros));
+  HistogramData data;
+  stats->GetHistogramData(kSeekMicros, &data);
+  ASSERT_EQ(0, data.count);
+
+  stats->MeasureTime(kSeekMicros, 7);
+  stats->GetHistogramData(kSeekMicros, &data);
+  ASSERT_EQ(1, data.count);
+  ASSERT_EQ(7, data.min);
+  ASSERT_EQ(7, data.max);
+}
+
+TEST(StatisticsTest, ToString) {
+  std::unique_ptr<Statistics> stats(NewStatistics());
+  stats->RecordTick(kBlockCacheDataHit, 3);
+  stats->MeasureTime(kFlushMicros, 10);
+  const std::string s = stats->ToString();
+  ASSERT_NE(std::string::npos,
+            s.find("leveldb.block.cache.data.hit COUNT : 3"));
+  ASSERT_NE(std::string::npos, s.find("leveldb.flush.micros P50"));
+  for (int t = 0; t < kTickerCount; t++) {
+    ASSERT_NE(std::string::npos,
+              s.find(TickerName(static_cast<Ticker>(t))));
+  }
+  for (int h = 0; h < kHistogramCount; h++) {
+    ASSERT_NE(std::string::npos,
+              s.find(HistogramName(static_cast<HistogramType>(h))));
+  }
+}
+
+}  // namespace leveldb